@@ -100,6 +100,7 @@ void GLLogStream::clear()
 
 void GLLogStream::log(int level, const char * buf )
 {
+	QMutexLocker locker(&logMutex);
 	QString tmp(buf);
 	logTextList.push_back(std::make_pair(level,tmp));
 	qDebug("LOG: %i %s",level,buf);
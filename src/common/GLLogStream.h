@@ -28,6 +28,7 @@
 #include <list>
 #include <utility>
 #include <QMultiMap>
+#include <QMutex>
 #include <QPair>
 #include <QString>
 #include <QObject>
@@ -108,6 +109,7 @@ signals:
 
 private:
 	int bookmark; /// this field is used to place a bookmark for restoring the log. Useful for previeweing
+	QMutex logMutex; /// log can be called by the loaders running concurrently
 	QList<std::pair<int, QString> > logTextList;
 
 	// The list of strings used in realtime display of info over the mesh.
@@ -31,6 +31,10 @@
 #include <wrap/gl/math.h>
 
 #include <QDir>
+#include <QMutex>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <utility>
 
 using namespace vcg;
@@ -79,6 +83,18 @@ QString MeshModel::relativePathName(const QString& path) const
 	return relPath;
 }
 
+static QMutex& textureMutex()
+{
+	static QMutex mutex;
+	return mutex;
+}
+
+static std::atomic<std::size_t>& textureBudget()
+{
+	static std::atomic<std::size_t> budget(0);
+	return budget;
+}
+
 /**
  * @brief Starting from the (still unloaded) textures contained in the contained
  * CMeshO, loads the textures in the map of QImages contained in the MeshModel.
@@ -89,6 +105,10 @@ QString MeshModel::relativePathName(const QString& path) const
  *
  * When a texture is not found, a dummy texture will be used (":/img/dummy.png").
  *
+ * The files are decoded concurrently. If a texture memory budget is set, the
+ * files are just located here, and each texture is decoded the first time its
+ * pixels are asked with getTexture.
+ *
  * Returns the list of non-loaded textures that have been modified with
  * ":/img/dummy.png" in the contained mesh.
  */
@@ -97,74 +117,264 @@ std::list<std::string> MeshModel::loadTextures(
 		vcg::CallBackPos* cb)
 {
 	std::list<std::string> unloadedTextures;
+
+	// locate the file of each texture: absolute (or relative to the current
+	// dir), or relative to the meshmodel
+	std::vector<std::string*> pending;
+	std::vector<std::string> newNames;
+	QStringList paths;
 	for (std::string& textName : cm.textures){
-		if (textures.find(textName) == textures.end()){
-			QImage img(":/img/dummy.png");
-			QFileInfo finfo(QString::fromStdString(textName));
-			try {
-				img = meshlab::loadImage(finfo.absoluteFilePath(), log, cb);
-				textName = finfo.fileName().toStdString();
-			} catch (const MLException& e) {
-				try { //could be relative to the meshmodel
-					QFileInfo mfi(fullName());
-					QString fn2 = mfi.absolutePath() + "/" + finfo.filePath();
-					img = meshlab::loadImage(fn2, log, cb);
-					textName = finfo.filePath().toStdString();
-				} catch (const MLException& e) {
-					if (log){
-						log->log(
-							GLLogStream::WARNING, "Failed loading " + textName +
-							"; using a dummy texture");
-					}
-					else {
-						std::cerr <<
-							"Failed loading " + textName + "; using a dummy texture\n";
-					}
-					unloadedTextures.push_back(textName);
-					textName = "dummy.png";
-				}
+		if (textures.find(textName) != textures.end() ||
+			std::find_if(pending.begin(), pending.end(),
+				[&](const std::string* n) { return *n == textName; }) != pending.end())
+			continue;
+		QFileInfo finfo(QString::fromStdString(textName));
+		QFileInfo mfi(fullName());
+		QFileInfo relfi(mfi.absolutePath() + "/" + finfo.filePath());
+		pending.push_back(&textName);
+		if (finfo.isFile()) {
+			paths.push_back(finfo.absoluteFilePath());
+			newNames.push_back(finfo.fileName().toStdString());
+		}
+		else if (relfi.isFile()) {
+			paths.push_back(relfi.absoluteFilePath());
+			newNames.push_back(finfo.filePath().toStdString());
+		}
+		else {
+			paths.push_back(QString());
+			newNames.push_back(textName);
+		}
+	}
+
+	std::vector<QImage> images(pending.size());
+	if (textureMemoryBudget() == 0)
+		images = meshlab::loadImagesConcurrently(paths, 0, log, cb);
+
+	for (unsigned int i = 0; i < pending.size(); ++i){
+		std::string& textName = *pending[i];
+		const std::string oldName = textName;
+		bool found = textureMemoryBudget() == 0 ?
+			!images[i].isNull() : QFileInfo(paths[i]).isReadable();
+		if (found) {
+			textName = newNames[i];
+			textures[textName] = images[i];
+			textureFiles[textName] = paths[i];
+			if (!images[i].isNull())
+				touchTexture(textName);
+		}
+		else {
+			if (log){
+				log->log(
+					GLLogStream::WARNING, "Failed loading " + textName +
+					"; using a dummy texture");
+			}
+			else {
+				std::cerr <<
+					"Failed loading " + textName + "; using a dummy texture\n";
 			}
-			textures[textName] = img;
+			unloadedTextures.push_back(textName);
+			textName = "dummy.png";
+			textures[textName] = meshlab::getDummyTexture();
 		}
+		// the same texture can be listed more than once in the mesh
+		std::replace(cm.textures.begin(), cm.textures.end(), oldName, textName);
 	}
 	return unloadedTextures;
 }
 
+/**
+ * @brief Saves the textures of the mesh in the given directory. The textures
+ * are encoded concurrently, one per core, and each job writes its own file.
+ *
+ * If copyUnmodified is true, a texture whose pixels have not been modified
+ * since it was read is not encoded again: its file is copied, when it has the
+ * same format of the file to write.
+ *
+ * After saving, each texture is bound to the file just written. If a texture
+ * cannot be saved, the others are saved anyway and then an MLException is
+ * thrown.
+ */
 void MeshModel::saveTextures(
 		const QString& basePath,
 		int quality,
 		GLLogStream* log,
-		CallBackPos* cb)
+		CallBackPos* cb,
+		bool copyUnmodified)
 {
-	for (const std::string& tname : cm.textures){
-		meshlab::saveImage(
-				basePath + "/" + QString::fromStdString(tname),
-				textures.at(tname), quality, log, cb);
+	// unique names, in the order of the mesh
+	std::vector<std::string> names;
+	for (const std::string& tname : cm.textures)
+		if (std::find(names.begin(), names.end(), tname) == names.end())
+			names.push_back(tname);
+
+	std::vector<QString> sources(names.size());
+	std::vector<QString> paths(names.size());
+	{
+		QMutexLocker locker(&textureMutex());
+		for (unsigned int i = 0; i < names.size(); ++i) {
+			paths[i] = QFileInfo(basePath + "/" + QString::fromStdString(names[i])).absoluteFilePath();
+			auto fit = textureFiles.find(names[i]);
+			if (copyUnmodified && fit != textureFiles.end() &&
+				QFileInfo(fit->second).suffix().toLower() == QFileInfo(paths[i]).suffix().toLower())
+				sources[i] = fit->second;
+		}
+	}
+
+	const int n = names.size();
+	std::vector<QString> errors(n);
+	std::atomic<int> completed(0);
+	const std::thread::id caller = std::this_thread::get_id();
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < n; ++i) {
+		try {
+			if (!sources[i].isEmpty()) {
+				if (sources[i] != paths[i]) {
+					QDir().mkpath(QFileInfo(paths[i]).absolutePath());
+					QFile::remove(paths[i]);
+					if (!QFile::copy(sources[i], paths[i]))
+						throw MLException("Impossible to copy " + sources[i] + " to " + paths[i]);
+				}
+			}
+			else {
+				meshlab::saveImage(paths[i], getTexture(names[i]), quality, log, nullptr);
+			}
+		}
+		catch (const MLException& e) {
+			errors[i] = e.what();
+		}
+		int done = ++completed;
+		if (cb != nullptr && std::this_thread::get_id() == caller)
+			cb(100 * done / n, "Saving textures...");
 	}
+
+	// the saved textures are now backed by their files
+	QMutexLocker locker(&textureMutex());
+	for (int i = 0; i < n; ++i)
+		if (errors[i].isEmpty() && textures.find(names[i]) != textures.end())
+			textureFiles[names[i]] = paths[i];
+	locker.unlock();
+
+	for (const QString& err : errors)
+		if (!err.isEmpty())
+			throw MLException(err);
+}
+
+void MeshModel::setTextureMemoryBudget(std::size_t bytes)
+{
+	textureBudget() = bytes;
 }
 
+std::size_t MeshModel::textureMemoryBudget()
+{
+	return textureBudget();
+}
+
+/**
+ * @brief Returns the image of the given texture, decoding it from its file if
+ * it is not in memory. It can be called concurrently.
+ */
 QImage MeshModel::getTexture(const std::string& tn) const
 {
+	QMutexLocker locker(&textureMutex());
 	auto it = textures.find(tn);
-	if (it != textures.end())
-		return it->second;
-	else
+	if (it == textures.end())
 		return QImage();
+
+	if (it->second.isNull()) {
+		auto fit = textureFiles.find(tn);
+		if (fit == textureFiles.end())
+			return QImage();
+		// decode outside the lock, other textures can be used meanwhile
+		QString path = fit->second;
+		locker.unlock();
+		QImage img;
+		try {
+			img = meshlab::loadImage(path);
+		}
+		catch (const MLException&) {
+			std::cerr << "Failed loading " + tn + "; using a dummy texture\n";
+			img = meshlab::getDummyTexture();
+		}
+		locker.relock();
+		it = textures.find(tn);
+		if (it == textures.end())
+			return img;
+		if (it->second.isNull())
+			it->second = img;
+	}
+
+	QImage img = it->second;
+	touchTexture(tn);
+	evictTextures(tn);
+	return img;
+}
+
+/**
+ * @brief Returns the images of the given textures, as getTexture does. The ones
+ * that are not in memory are decoded concurrently, one per core.
+ */
+std::vector<QImage> MeshModel::getTextures(const std::vector<std::string>& names) const
+{
+	const int n = names.size();
+	std::vector<QImage> images(n);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < n; ++i)
+		images[i] = getTexture(names[i]);
+	return images;
 }
 
-const std::map<std::string, QImage>& MeshModel::getTextures() const
+/**
+ * @brief Returns a copy of all the textures of the mesh. All of them are
+ * decoded, even if this exceeds the texture memory budget: use getTexture when
+ * possible.
+ */
+std::map<std::string, QImage> MeshModel::getTextures() const
 {
+	QMutexLocker locker(&textureMutex());
+	for (auto& t : textures) {
+		auto fit = textureFiles.find(t.first);
+		if (t.second.isNull() && fit != textureFiles.end()) {
+			try {
+				t.second = meshlab::loadImage(fit->second);
+			}
+			catch (const MLException&) {
+				t.second = meshlab::getDummyTexture();
+			}
+			touchTexture(t.first);
+		}
+	}
 	return textures;
 }
 
+bool MeshModel::isTextureResident(const std::string& tn) const
+{
+	QMutexLocker locker(&textureMutex());
+	auto it = textures.find(tn);
+	return it != textures.end() && !it->second.isNull();
+}
+
+/**
+ * @brief A texture is modified if its pixels are not the ones of the file it
+ * was read from (or saved to), or if it has no file at all.
+ */
+bool MeshModel::isTextureModified(const std::string& tn) const
+{
+	QMutexLocker locker(&textureMutex());
+	return textureFiles.find(tn) == textureFiles.end();
+}
+
 void MeshModel::clearTextures()
 {
+	QMutexLocker locker(&textureMutex());
 	textures.clear();
+	textureFiles.clear();
+	textureUse.clear();
 	cm.textures.clear();
 }
 
 void MeshModel::addTexture(std::string name, const QImage& txt)
 {
+	QMutexLocker locker(&textureMutex());
 	if (textures.find(name) == textures.end()){
 		// just to be sure to not make duplicates in the contained mesh list of textures
 		if (std::find(cm.textures.begin(), cm.textures.end(), name) == cm.textures.end())
@@ -175,15 +385,21 @@ void MeshModel::addTexture(std::string name, const QImage& txt)
 
 void MeshModel::setTexture(std::string name, const QImage& txt)
 {
+	QMutexLocker locker(&textureMutex());
 	auto it = textures.find(name);
-	if (it != textures.end())
+	if (it != textures.end()) {
 		it->second = txt;
+		// the pixels do not come from the file anymore: keep them in memory
+		textureFiles.erase(name);
+		textureUse.remove(name);
+	}
 }
 
 void MeshModel::changeTextureName(
 		const std::string& oldName,
 		std::string newName)
 {
+	QMutexLocker locker(&textureMutex());
 	if (oldName != newName) {
 		auto mit = textures.find(oldName);
 		auto tit = std::find(cm.textures.begin(), cm.textures.end(), oldName);
@@ -192,10 +408,51 @@ void MeshModel::changeTextureName(
 
 			textures[newName] = mit->second;
 			textures.erase(mit);
+
+			auto fit = textureFiles.find(oldName);
+			if (fit != textureFiles.end()) {
+				textureFiles[newName] = fit->second;
+				textureFiles.erase(fit);
+			}
+			std::replace(textureUse.begin(), textureUse.end(), oldName, newName);
 		}
 	}
 }
 
+/// moves the given texture in front of the recently used ones (mutex locked)
+void MeshModel::touchTexture(const std::string& tn) const
+{
+	if (textureFiles.find(tn) == textureFiles.end())
+		return;
+	textureUse.remove(tn);
+	textureUse.push_front(tn);
+}
+
+/**
+ * @brief Evicts the least recently used textures that can be decoded again
+ * from their file, until the decoded ones fit in the texture memory budget
+ * (mutex locked). Textures without a file are never evicted.
+ */
+void MeshModel::evictTextures(const std::string& keep) const
+{
+	const std::size_t budget = textureMemoryBudget();
+	if (budget == 0)
+		return;
+	std::size_t used = 0;
+	for (const auto& t : textures)
+		used += (std::size_t) t.second.bytesPerLine() * t.second.height();
+	auto it = textureUse.end();
+	while (used > budget && it != textureUse.begin()) {
+		--it;
+		if (*it == keep)
+			continue;
+		QImage& img = textures[*it];
+		used -= (std::size_t) img.bytesPerLine() * img.height();
+		img = QImage();
+		it = textureUse.erase(it);
+	}
+}
+
 int MeshModel::io2mm(int single_iobit)
 {
 	switch(single_iobit)
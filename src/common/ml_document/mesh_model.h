@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <list>
 #include <map>
 
 #include "cmesh.h"
@@ -168,10 +169,18 @@ public:
 	void setVisible(bool vis = true) { visible = vis;}
 
 	std::list<std::string> loadTextures(GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr);
-	void saveTextures(const QString& basePath, int quality = -1, GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr);
+	void saveTextures(const QString& basePath, int quality = -1, GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr, bool copyUnmodified = false);
 
 	QImage getTexture(const std::string& tn) const;
-	const std::map<std::string, QImage>& getTextures() const;
+	std::vector<QImage> getTextures(const std::vector<std::string>& names) const;
+	std::map<std::string, QImage> getTextures() const;
+	bool isTextureResident(const std::string& tn) const;
+	bool isTextureModified(const std::string& tn) const;
+
+	// maximum memory used by the decoded textures of each layer; 0 means that
+	// textures are decoded when loaded and always kept in memory
+	static void setTextureMemoryBudget(std::size_t bytes);
+	static std::size_t textureMemoryBudget();
 	void clearTextures();
 	void addTexture(std::string name, const QImage& txt);
 	void setTexture(std::string name, const QImage& txt);
@@ -216,8 +225,15 @@ private:
 	//files containing just this mesh, this id will be -1.
 	int idInsideFile = -1;
 
-	//textures associated to mesh
-	std::map<std::string, QImage> textures;
+	void touchTexture(const std::string& tn) const;
+	void evictTextures(const std::string& keep) const;
+
+	//textures associated to mesh; a null image is a texture that is not
+	//decoded yet, or that has been evicted, and that can be read again from
+	//its file in textureFiles
+	mutable std::map<std::string, QImage> textures;
+	std::map<std::string, QString> textureFiles;
+	mutable std::list<std::string> textureUse; // most recently used first
 };// end class MeshModel
 
 #endif
@@ -23,19 +23,61 @@
 
 #include "render_raster.h"
 
+#include <QImageReader>
+#include <QMutex>
+#include <algorithm>
+#include <atomic>
+#include <list>
+
+namespace {
+
+// the decoded planes, most recently used first
+struct PlaneCache
+{
+    QMutex mutex;
+    std::list<RasterPlane*> planes;
+    std::atomic<std::size_t> budget{0};
+};
+
+PlaneCache& planeCache()
+{
+    static PlaneCache cache;
+    return cache;
+}
+
+std::size_t imageBytes(const QImage& img)
+{
+    return (std::size_t) img.bytesPerLine() * img.height();
+}
+
+} // namespace
+
 RasterPlane::RasterPlane(const RasterPlane& pl)
 {
+    QMutexLocker locker(&planeCache().mutex);
     semantic = pl.semantic;
     fullPathFileName = pl.fullPathFileName;
     image = QImage(pl.image);
+    imageSize = pl.imageSize;
+    backedByFile = pl.backedByFile;
+    pinCount = 0;
 }
 
 RasterPlane::RasterPlane(const QString& pathName, const int _semantic)
 {
     semantic =_semantic;
     fullPathFileName = pathName;
+    backedByFile = true;
+    pinCount = 0;
 
-    image = QImage(pathName);
+    if (memoryBudget() == 0) {
+        image = QImage(pathName);
+        imageSize = image.size();
+    }
+    else {
+        // out of core: just read the size, pixels are decoded when needed
+        imageSize = QImageReader(pathName).size();
+    }
 }
 
 RasterPlane::RasterPlane(
@@ -46,6 +88,197 @@ RasterPlane::RasterPlane(
     semantic =_semantic;
     fullPathFileName = pathName;
     image = img;
+    imageSize = img.size();
+    backedByFile = false;
+    pinCount = 0;
+}
+
+RasterPlane::~RasterPlane()
+{
+    PlaneCache& c = planeCache();
+    QMutexLocker locker(&c.mutex);
+    c.planes.remove(this);
+}
+
+/**
+ * @brief Decodes the pixels of the plane if needed, and returns them. The
+ * image is taken in the same critical section that puts the plane in the
+ * cache, so a concurrent trim cannot discard it before it is returned. A
+ * plane that fails to decode is not put in the cache.
+ */
+QImage RasterPlane::Load()
+{
+    PlaneCache& c = planeCache();
+    QMutexLocker locker(&c.mutex);
+    if (image.isNull() && backedByFile) {
+        // decode outside the lock, other planes can be used meanwhile
+        locker.unlock();
+        QImage img(fullPathFileName);
+        locker.relock();
+        if (image.isNull())
+            image = img;
+        if (!image.isNull())
+            imageSize = image.size();
+    }
+    QImage pixels = image;
+    if (!pixels.isNull()) {
+        touch();
+        trim(this);
+    }
+    return pixels;
+}
+
+bool RasterPlane::IsInCore() const
+{
+    QMutexLocker locker(&planeCache().mutex);
+    return !image.isNull();
+}
+
+void RasterPlane::Discard()
+{
+    PlaneCache& c = planeCache();
+    QMutexLocker locker(&c.mutex);
+    if (backedByFile && pinCount == 0) {
+        image = QImage();
+        mips.clear();
+        c.planes.remove(this);
+    }
+}
+
+/**
+ * @brief Returns the pixels of the plane, decoding them if needed. The
+ * returned image stays valid even if the plane is discarded later.
+ */
+QImage RasterPlane::pixels()
+{
+    return Load();
+}
+
+/**
+ * @brief Replaces the pixels of the plane. They are kept in memory from now
+ * on, since they cannot be decoded again from the file.
+ */
+void RasterPlane::setPixels(const QImage& img)
+{
+    QMutexLocker locker(&planeCache().mutex);
+    image = img;
+    imageSize = img.size();
+    backedByFile = false;
+    mips.clear();
+    touch();
+    trim(this);
+}
+
+/**
+ * @brief Returns the image downscaled by 2^level. If the plane is not in
+ * memory, the reduced image is decoded directly from the file, without
+ * decoding the full resolution pixels.
+ */
+QImage RasterPlane::mipLevel(int level)
+{
+    if (level <= 0)
+        return pixels();
+
+    PlaneCache& c = planeCache();
+    QMutexLocker locker(&c.mutex);
+    auto it = mips.find(level);
+    if (it == mips.end()) {
+        const QSize full = image.isNull() ? imageSize : image.size();
+        QSize scaled(std::max(1, full.width() >> level), std::max(1, full.height() >> level));
+        QImage pixels = image;
+        locker.unlock();
+        QImage mip;
+        if (!pixels.isNull()) {
+            mip = pixels.scaled(scaled, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        else if (backedByFile) {
+            QImageReader reader(fullPathFileName);
+            reader.setScaledSize(scaled);
+            mip = reader.read();
+        }
+        locker.relock();
+        it = mips.insert(std::make_pair(level, mip)).first;
+    }
+    QImage mip = it->second;
+    touch();
+    trim(this);
+    return mip;
+}
+
+QSize RasterPlane::size() const
+{
+    QMutexLocker locker(&planeCache().mutex);
+    if (!image.isNull())
+        return image.size();
+    return imageSize;
+}
+
+void RasterPlane::pin()
+{
+    QMutexLocker locker(&planeCache().mutex);
+    ++pinCount;
+}
+
+void RasterPlane::unpin()
+{
+    QMutexLocker locker(&planeCache().mutex);
+    if (pinCount > 0)
+        --pinCount;
+    trim(nullptr);
+}
+
+void RasterPlane::setMemoryBudget(std::size_t bytes)
+{
+    planeCache().budget = bytes;
+    QMutexLocker locker(&planeCache().mutex);
+    trim(nullptr);
+}
+
+std::size_t RasterPlane::memoryBudget()
+{
+    return planeCache().budget;
+}
+
+/// moves the plane in front of the recently used ones (cache locked)
+void RasterPlane::touch()
+{
+    PlaneCache& c = planeCache();
+    c.planes.remove(this);
+    c.planes.push_front(this);
+}
+
+/**
+ * @brief Discards the least recently used planes, until the decoded ones fit
+ * in the memory budget (cache locked).
+ */
+void RasterPlane::trim(const RasterPlane* keep)
+{
+    PlaneCache& c = planeCache();
+    const std::size_t budget = c.budget;
+    if (budget == 0)
+        return;
+    std::size_t used = 0;
+    for (const RasterPlane* p : c.planes)
+        used += p->residentBytes();
+    auto it = c.planes.end();
+    while (used > budget && it != c.planes.begin()) {
+        --it;
+        RasterPlane* p = *it;
+        if (p == keep || p->pinCount > 0 || !p->backedByFile)
+            continue;
+        used -= p->residentBytes();
+        p->image = QImage();
+        p->mips.clear();
+        it = c.planes.erase(it);
+    }
+}
+
+std::size_t RasterPlane::residentBytes() const
+{
+    std::size_t bytes = imageBytes(image);
+    for (const auto& m : mips)
+        bytes += imageBytes(m.second);
+    return bytes;
 }
 
 MeshLabRenderRaster::MeshLabRenderRaster()
@@ -27,11 +27,18 @@
 #include <QString>
 #include <QImage>
 #include <QFileInfo>
+#include <map>
 #include "cmesh.h"
 
 /*
 RasterPlane Class
 the base class for a registered image that contains the path, the semantic and the data of the image
+
+When a memory budget is set, planes built from a file keep only the size of
+the image and decode the pixels on demand (pixels(), mipLevel(), Load()).
+The decoded planes are kept in a least recently used cache shared by all the
+planes, and the ones beyond the budget are discarded. Pinned planes and
+planes whose pixels do not come from their file are never discarded.
 */
 
 class RasterPlane
@@ -57,12 +64,23 @@ public:
 
     int semantic;
     QString fullPathFileName;
-    QImage image;
+    QImage image; // decoded pixels, null if not in core: prefer pixels() and setPixels()
 
-    bool IsInCore() { return !image.isNull(); }
-    void Load();
+    bool IsInCore() const;
+    QImage Load(); // decodes the pixels if needed and returns them
     void Discard(); //discard  the loaded image freeing the mem.
 
+    QImage pixels();
+    void setPixels(const QImage& img); // the pixels do not come from the file anymore
+    QImage mipLevel(int level); // image downscaled by 2^level
+    QSize size() const;
+
+    void pin();   // keeps the pixels in memory until unpin
+    void unpin();
+
+    static void setMemoryBudget(std::size_t bytes); // 0 means no limit
+    static std::size_t memoryBudget();
+
     /// The whole full path name of the mesh
     const QString fullName() const {return fullPathFileName;}
     /// just the name of the file
@@ -71,7 +89,17 @@ public:
     RasterPlane(const RasterPlane& pl);
     RasterPlane(const QString& pathName, const int _semantic);
     RasterPlane(const QImage& image, const QString& pathName, const int _semantic);
+    ~RasterPlane();
+
+private:
+    void touch();
+    static void trim(const RasterPlane* keep);
+    std::size_t residentBytes() const;
 
+    QSize imageSize;
+    bool backedByFile; // the pixels can be decoded again from fullPathFileName
+    int pinCount;
+    std::map<int, QImage> mips;
 }; //end class Plane
 
 class MeshLabRenderRaster
@@ -140,6 +140,20 @@ public:
 	 */
 	virtual bool requiresGLContext(const QAction*) const {return false;}
 
+	/**
+	 * @brief This function should return true if the filter reads the pixels
+	 * of the raster planes through RasterPlane::image. When rasters are loaded
+	 * out of core, the framework decodes and keeps in memory all the planes
+	 * before invoking such filters. Filters that do not need pixels, or that
+	 * get them on demand with RasterPlane::pixels() or mipLevel(), should
+	 * return false.
+	 * By default, camera, raster and texture filters require pixels.
+	 */
+	virtual bool requiresRasterPixels(const QAction* a) const
+	{
+		return (getClass(a) & (Camera | RasterLayer | Texture)) != 0;
+	}
+
 	/** 
 	 * @brief The FilterPrecondition mask is used to explicitate what kind of data a filter really needs to be applied.
 	 * For example algorithms that compute per face quality have as precondition the existence of faces
@@ -32,6 +32,7 @@ void IOPlugin::reportWarning(const QString& warningMessage) const
 {
 	if (!warningMessage.isEmpty()){
 		MeshLabPluginLogger::log(GLLogStream::WARNING, warningMessage.toStdString());
+		QMutexLocker locker(&warnMutex);
 		warnString += "\n" + warningMessage;
 	}
 }
@@ -48,6 +49,7 @@ void IOPlugin::wrongSaveFormat(const QString& format) const
 
 QString IOPlugin::warningMessageString() const
 {
+	QMutexLocker locker(&warnMutex);
 	QString tmp = warnString;
 	warnString.clear();
 	return tmp;
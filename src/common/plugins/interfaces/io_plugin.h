@@ -24,6 +24,7 @@
 #ifndef MESHLAB_IO_PLUGIN_H
 #define MESHLAB_IO_PLUGIN_H
 
+#include <QMutex>
 #include <wrap/callback.h>
 
 #include "meshlab_plugin_logger.h"
@@ -164,6 +165,15 @@ public:
 			const RichParameterList & par,
 			vcg::CallBackPos *cb = nullptr) = 0;
 
+	/**
+	 * @brief Returns true if several files of the given format can be opened
+	 * at the same time, from different threads, by this plugin. Readers that
+	 * keep their state in static variables are not reentrant: the framework
+	 * opens the files of such formats one at a time.
+	 * By default, no format is reentrant.
+	 */
+	virtual bool isOpenReentrant(const QString& /*format*/) const { return false; }
+
 	/***********************
 	 * Save Mesh Functions *
 	 ***********************/
@@ -434,6 +444,7 @@ public:
 
 private:
 	mutable QString warnString;
+	mutable QMutex warnMutex; // meshes of a project can be opened concurrently
 };
 
 #define IO_PLUGIN_IID "vcg.meshlab.IOPlugin/1.0"
@@ -0,0 +1,313 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "icp_aligner.h"
+
+#include <vcg/math/gen_normal.h>
+#include <vcg/space/point_matching.h>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace meshlab {
+
+namespace {
+
+/* value below which the fraction perc of the (sorted) values lies */
+double percentile(const std::vector<double>& sorted, double perc)
+{
+	if (sorted.empty())
+		return 0;
+	size_t i = std::min(sorted.size() - 1, size_t(perc * sorted.size()));
+	return sorted[i];
+}
+
+vcg::Point3d rotate(const vcg::Matrix44d& m, const vcg::Point3d& n)
+{
+	vcg::Point3d r(
+		m[0][0] * n[0] + m[0][1] * n[1] + m[0][2] * n[2],
+		m[1][0] * n[0] + m[1][1] * n[1] + m[1][2] * n[2],
+		m[2][0] * n[0] + m[2][1] * n[1] + m[2][2] * n[2]);
+	return r.Normalize();
+}
+
+struct Correspondence
+{
+	bool         valid;
+	double       dist;
+	vcg::Point3d p, n; // moving sample, in the fixed reference frame
+	vcg::Point3d q, qn;
+};
+
+} // namespace
+
+IcpAligner::IcpAligner(const CMeshO& fix, bool useVertexOnly) :
+		fixMesh(fix), useFaces(fix.fn > 0 && !useVertexOnly)
+{
+	if (useFaces) {
+		// the grid stores non const pointers, but the faces are never modified
+		CMeshO& m = const_cast<CMeshO&>(fix);
+		faceGrid.Set(m.face.begin(), m.face.end());
+	}
+	else {
+		for (const CVertexO& v : fix.vert) {
+			if (!v.IsD()) {
+				vertPos.push_back(v.cP());
+				vertNorm.push_back(Point3m(v.cN()).Normalize());
+			}
+		}
+		vertTree.reset(new vcg::KdTree<Scalarm>(vcg::ConstDataWrapper<Point3m>(
+			vertPos.data(), vertPos.size(), sizeof(Point3m))));
+	}
+}
+
+bool IcpAligner::closest(const Point3m& p, Scalarm maxDist, Point3m& q, Point3m& qn, Scalarm& dist)
+	const
+{
+	if (useFaces) {
+		// no marks on the faces: the queries do not write on the mesh
+		vcg::tri::EmptyTMark<CMeshO>               marker;
+		vcg::face::PointDistanceBaseFunctor<Scalarm> distFunctor;
+		dist      = maxDist;
+		CFaceO* f = vcg::GridClosest(faceGrid, distFunctor, marker, p, maxDist, dist, q);
+		if (f == nullptr)
+			return false;
+		qn = vcg::TriangleNormal(*f).Normalize();
+		return true;
+	}
+	if (vertPos.empty())
+		return false;
+	unsigned int i;
+	Scalarm      d;
+	vertTree->doQueryClosest(p, i, d);
+	dist = vcg::Distance(p, vertPos[i]);
+	if (dist > maxDist)
+		return false;
+	q  = vertPos[i];
+	qn = vertNorm[i];
+	return true;
+}
+
+std::vector<int> IcpAligner::sampleOrder(
+	const std::vector<Point3m>& normals,
+	int                         num,
+	bool                        normalEqualized,
+	unsigned int                seed)
+{
+	std::mt19937     gen(seed);
+	std::vector<int> order;
+	if (!normalEqualized) {
+		order.resize(normals.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::shuffle(order.begin(), order.end(), gen);
+		if ((int) order.size() > num)
+			order.resize(num);
+		return order;
+	}
+
+	// buckets of the points with similar normal, picked in turn
+	std::vector<Point3m> dirs;
+	vcg::GenNormal<Scalarm>::Fibonacci(30, dirs);
+	std::vector<std::vector<int>> buckets(dirs.size());
+	for (size_t i = 0; i < normals.size(); ++i) {
+		size_t best = 0;
+		for (size_t j = 1; j < dirs.size(); ++j)
+			if (normals[i] * dirs[j] > normals[i] * dirs[best])
+				best = j;
+		buckets[best].push_back(i);
+	}
+	for (std::vector<int>& b : buckets)
+		std::shuffle(b.begin(), b.end(), gen);
+	for (size_t k = 0; (int) order.size() < num && order.size() < normals.size(); ++k)
+		for (const std::vector<int>& b : buckets)
+			if (k < b.size() && (int) order.size() < num)
+				order.push_back(b[k]);
+	return order;
+}
+
+vcg::Matrix44d IcpAligner::pointToPlaneMatrix(
+	const std::vector<vcg::Point3d>& mov,
+	const std::vector<vcg::Point3d>& fix,
+	const std::vector<vcg::Point3d>& fixNormals)
+{
+	// linearized rotation around the barycenter of the samples, for a better conditioning
+	vcg::Point3d c(0, 0, 0);
+	for (const vcg::Point3d& p : mov)
+		c += p;
+	c /= mov.size();
+
+	Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Zero();
+	Eigen::Matrix<double, 6, 1> b = Eigen::Matrix<double, 6, 1>::Zero();
+	for (size_t i = 0; i < mov.size(); ++i) {
+		vcg::Point3d p  = mov[i] - c;
+		vcg::Point3d n  = fixNormals[i];
+		vcg::Point3d pn = p ^ n;
+		Eigen::Matrix<double, 6, 1> row;
+		row << pn[0], pn[1], pn[2], n[0], n[1], n[2];
+		A += row * row.transpose();
+		b += row * ((fix[i] - mov[i]) * n);
+	}
+	Eigen::Matrix<double, 6, 1> x = A.ldlt().solve(b);
+
+	vcg::Point3d   omega(x[0], x[1], x[2]);
+	vcg::Matrix44d rot, toC, fromC;
+	double         angle = omega.Norm();
+	if (angle > 0)
+		rot.SetRotateRad(angle, omega / angle);
+	else
+		rot.SetIdentity();
+	toC.SetTranslate(c + vcg::Point3d(x[3], x[4], x[5]));
+	fromC.SetTranslate(-c);
+	return toC * rot * fromC;
+}
+
+bool IcpAligner::align(
+	const std::vector<Point3m>& movPoints,
+	const std::vector<Point3m>& movNormals,
+	const vcg::Matrix44d&       initial,
+	const Param&                par,
+	Result&                     res,
+	vcg::CallBackPos*           cb) const
+{
+	res = Result();
+	res.tr = initial;
+
+	const int        levels = std::max(1, par.sampleLevels);
+	std::vector<int> order  = sampleOrder(movNormals, par.sampleNum, par.normalEqualized, par.seed);
+	if (order.empty()) {
+		res.errorMessage = "No samples on the moving mesh";
+		return false;
+	}
+
+	std::vector<Correspondence> corr(order.size());
+	std::vector<vcg::Point3d>   pMov, pFix, nFix;
+	std::vector<int>            used;
+	std::vector<double>         dists;
+	double                      minDist      = par.minDistAbs;
+	int                         level        = 0;
+	int                         levelIter    = 0;
+	const int                   iterPerLevel = std::max(1, par.maxIterNum / levels);
+
+	for (int iter = 0; iter < par.maxIterNum; ++iter) {
+		if (cb)
+			cb(100 * iter / par.maxIterNum, "ICP iteration...");
+		const int n = std::max<int>(
+			std::min<int>(order.size(), 16), order.size() >> (2 * (levels - 1 - level)));
+		const vcg::Matrix44d tr = res.tr;
+
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int i = 0; i < n; ++i) {
+			Correspondence& c = corr[i];
+			c.p = tr * vcg::Point3d::Construct(movPoints[order[i]]);
+			c.n = rotate(tr, vcg::Point3d::Construct(movNormals[order[i]]));
+			Point3m q, qn;
+			Scalarm d;
+			c.valid = closest(Point3m::Construct(c.p), minDist, q, qn, d);
+			if (c.valid) {
+				c.dist = d;
+				c.q    = vcg::Point3d::Construct(q);
+				c.qn   = vcg::Point3d::Construct(qn);
+			}
+		}
+
+		// serial reductions, in sample order
+		IterInfo info = {minDist, 0, n, 0, 0, 0, level};
+		used.clear();
+		dists.clear();
+		for (int i = 0; i < n; ++i) {
+			if (!corr[i].valid)
+				info.distanceDiscarded++;
+			else if (corr[i].n * corr[i].qn < par.minNormalCos)
+				info.angleDiscarded++;
+			else {
+				used.push_back(i);
+				dists.push_back(corr[i].dist);
+			}
+		}
+		if (used.size() < 6) {
+			res.iterations.push_back(info);
+			res.errorMessage = "Too few samples: the meshes are too far or do not overlap";
+			return false;
+		}
+		std::sort(dists.begin(), dists.end());
+		info.pcl50            = percentile(dists, 0.5);
+		const double pclHi    = percentile(dists, par.passHiFilter);
+		minDist = std::min(minDist, std::max(par.trgDistAbs, 5.0 * percentile(dists, par.reduceFactorPerc)));
+
+		pMov.clear();
+		pFix.clear();
+		nFix.clear();
+		for (int i : used) {
+			if (corr[i].dist <= pclHi) {
+				pMov.push_back(corr[i].p);
+				pFix.push_back(corr[i].q);
+				nFix.push_back(corr[i].qn);
+			}
+		}
+		info.sampleUsed = pMov.size();
+		res.iterations.push_back(info);
+
+		vcg::Matrix44d step;
+		if (par.pointToPlane && par.rigid)
+			step = pointToPlaneMatrix(pMov, pFix, nFix);
+		else if (par.rigid)
+			vcg::ComputeRigidMatchMatrix(pFix, pMov, step);
+		else
+			vcg::ComputeSimilarityMatchMatrix(pFix, pMov, step);
+		res.tr  = step * res.tr;
+		res.err = info.pcl50;
+
+		// last correspondences, moving points in their own reference frame
+		vcg::Matrix44d inv = vcg::Inverse(tr);
+		res.pMov.clear();
+		res.nMov.clear();
+		res.pFix = pFix;
+		res.nFix = nFix;
+		for (int i : used) {
+			if (corr[i].dist <= pclHi) {
+				res.pMov.push_back(inv * corr[i].p);
+				res.nMov.push_back(vcg::Point3d::Construct(movNormals[order[i]]));
+			}
+		}
+
+		if (info.pcl50 < par.trgDistAbs) {
+			if (level == levels - 1) {
+				res.converged = true;
+				break;
+			}
+			++level;
+			levelIter = 0;
+		}
+		else if (++levelIter >= iterPerLevel && level < levels - 1) {
+			++level;
+			levelIter = 0;
+		}
+	}
+	return true;
+}
+
+} // namespace meshlab
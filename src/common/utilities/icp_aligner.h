@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_ICP_ALIGNER_H
+#define MESHLAB_ICP_ALIGNER_H
+
+#include "../ml_document/cmesh.h"
+
+#include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace meshlab {
+
+/**
+ * @brief ICP registration of a set of moving points against a fixed CMeshO.
+ *
+ * The spatial index of the fixed mesh (a uniform grid of its faces, or a
+ * kd-tree of its vertices when the mesh has no faces) is built once by the
+ * constructor and reused by all the iterations of any number of align()
+ * calls; the fixed mesh must not be modified while the aligner is in use.
+ *
+ * At each iteration the closest points of the samples are searched
+ * concurrently, while all the reductions (percentiles, matching matrix) are
+ * done serially in sample order: the result does not depend on the number of
+ * threads. The samples are chosen with a seeded generator, so the same input
+ * always gives the same result.
+ */
+class IcpAligner
+{
+public:
+	struct Param
+	{
+		int    sampleNum        = 2000;
+		double minDistAbs       = 10.0;  // starting max distance of the correspondences
+		double trgDistAbs       = 0.005; // converged when the median distance is below this value
+		int    maxIterNum       = 75;
+		bool   normalEqualized  = true;  // samples uniformly distributed w.r.t. the normals
+		double reduceFactorPerc = 0.80;  // min dist reduced to 5 times this percentile
+		double passHiFilter     = 0.75;  // only the correspondences below this percentile are used
+		bool   rigid            = true;  // otherwise a similarity (point to point only)
+		bool   pointToPlane     = false; // minimize the distances from the tangent planes
+		int    sampleLevels     = 1;     // level l uses sampleNum/4^(sampleLevels-1-l) samples
+		double minNormalCos     = 0.7071; // correspondences with more divergent normals are discarded
+		unsigned int seed       = 0;
+	};
+
+	struct IterInfo
+	{
+		double minDistAbs;
+		double pcl50;
+		int    sampleTested;
+		int    sampleUsed;
+		int    distanceDiscarded;
+		int    angleDiscarded;
+		int    level;
+	};
+
+	struct Result
+	{
+		vcg::Matrix44d        tr; // from the moving to the fixed reference frame
+		bool                  converged = false;
+		double                err       = 0; // median distance of the last iteration
+		std::vector<IterInfo> iterations;
+		// correspondences of the last iteration, each in its own reference frame
+		std::vector<vcg::Point3d> pFix, nFix, pMov, nMov;
+		std::string               errorMessage;
+	};
+
+	IcpAligner(const CMeshO& fix, bool useVertexOnly = false);
+
+	/**
+	 * Aligns the moving points (and normals) starting from the initial
+	 * transformation; returns false, with the reason in the errorMessage of
+	 * the result, when the ICP cannot be computed.
+	 */
+	bool align(
+		const std::vector<Point3m>& movPoints,
+		const std::vector<Point3m>& movNormals,
+		const vcg::Matrix44d&       initial,
+		const Param&                par,
+		Result&                     res,
+		vcg::CallBackPos*           cb = nullptr) const;
+
+	/** sample order used by align(): the first n samples of a level are the ones of the coarser levels */
+	static std::vector<int>
+	sampleOrder(const std::vector<Point3m>& normals, int num, bool normalEqualized, unsigned int seed);
+
+private:
+	bool closest(const Point3m& p, Scalarm maxDist, Point3m& q, Point3m& qn, Scalarm& dist) const;
+
+	static vcg::Matrix44d pointToPlaneMatrix(
+		const std::vector<vcg::Point3d>& mov,
+		const std::vector<vcg::Point3d>& fix,
+		const std::vector<vcg::Point3d>& fixNormals);
+
+	const CMeshO& fixMesh;
+	// queried concurrently, never modified after the construction
+	mutable vcg::GridStaticPtr<CFaceO, Scalarm> faceGrid;
+	std::unique_ptr<vcg::KdTree<Scalarm>>       vertTree;
+	std::vector<Point3m>                        vertPos, vertNorm;
+	bool                                        useFaces;
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_ICP_ALIGNER_H
@@ -25,6 +25,12 @@
 
 #include <QDir>
 #include <QElapsedTimer>
+#include <QImageReader>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "../globals.h"
 #include "../plugins/plugin_manager.h"
@@ -34,41 +40,17 @@
 namespace meshlab {
 
 /**
- * @brief This function assumes that you already have the following data:
- * - the plugin that is needed to load the mesh
- * - the number of meshes that will be loaded from the file
- * - the list of MeshModel(s) that will contain the loaded mesh(es)
- * - the open parameters that will be used to load the mesh(es)
- *
- * The function will take care to load the mesh, load textures if needed
- * and make all the clean operations after loading the meshes.
- * If load fails, throws a MLException.
- *
- * @param[i] fileName: the filename
- * @param[i] ioPlugin: the plugin that supports the file format to load
- * @param[i] prePar: the pre open parameters
- * @param[i/o] meshList: the list of meshes that will be loaded from the file
- * @param[o] maskList: masks of loaded components for each loaded mesh
- * @param cb: callback
- * @return the list of texture names that could not be loaded
+ * @brief Cleans the meshes just read by a plugin: textures, normals, bounding
+ * box and degenerate elements. Returns the list of texture names that could
+ * not be loaded.
  */
-std::list<std::string> loadMesh(
-	const QString&               fileName,
+static std::list<std::string> completeLoadedMeshes(
 	IOPlugin*                    ioPlugin,
-	const RichParameterList&     prePar,
 	const std::list<MeshModel*>& meshList,
-	std::list<int>&              maskList,
+	const std::list<int>&        maskList,
 	vcg::CallBackPos*            cb)
 {
 	std::list<std::string> unloadedTextures;
-	QFileInfo              fi(fileName);
-	QString                extension = fi.suffix();
-
-	QDir oldDir = QDir::current();
-	QDir::setCurrent(fi.absolutePath());
-	ioPlugin->open(extension, fi.fileName(), meshList, maskList, prePar, cb);
-	QDir::setCurrent(oldDir.absolutePath());
-
 	auto itmesh = meshList.begin();
 	auto itmask = maskList.begin();
 	for (unsigned int i = 0; i < meshList.size(); ++i) {
@@ -121,28 +103,14 @@ std::list<std::string> loadMesh(
 }
 
 /**
- * @brief loads the given filename and puts the loaded mesh(es) into the
- * given MeshDocument. Returns the list of loaded meshes.
- *
- * If you already know the open parameters that could be used to load the mesh,
- * you can pass a RichParameterList containing them.
- * Note: only parameters of your RPL that are actually required by the plugin
- * will be given as input to the load function.
- * If you don't know any parameter, leave the RichParameterList parameter empty.
- *
- * The function takes care to:
- * - find the plugin that loads the format of the file
- * - create the required MeshModels into the MeshDocument
- * - load the meshes and their textures, with standard parameters
- *
- * if an error occurs, an exception will be thrown, and MeshDocument won't
- * contain new meshes.
+ * @brief Finds the plugin that opens the given file and returns it, together
+ * with the standard open parameters (prePar values override the defaults).
+ * Throws a MLException if no plugin can open the file.
  */
-std::list<MeshModel*> loadMeshWithStandardParameters(
-	const QString&    filename,
-	MeshDocument&     md,
-	vcg::CallBackPos* cb,
-	RichParameterList prePar)
+static IOPlugin* standardOpenParameters(
+	const QString&           filename,
+	const RichParameterList& prePar,
+	RichParameterList&       openParams)
 {
 	QFileInfo      fi(filename);
 	QString        extension = fi.suffix();
@@ -156,15 +124,13 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 			"has not plugin to read " +
 			extension + " file format");
 
-	ioPlugin->setLog(&md.Log);
-
 	// get the open parameters for the given extension
-	RichParameterList openParams = ioPlugin->initPreOpenParameter(extension);
+	openParams = ioPlugin->initPreOpenParameter(extension);
 
 	// if some parameters were given in the prePar, then set their values into
 	// openParams.
 	// we need to be sure that openParams contains only parameters allowed by the plugin
-	for (RichParameter& rp : prePar) {
+	for (const RichParameter& rp : prePar) {
 		auto it = openParams.findParameter(rp.name());
 		if (it != openParams.end()) {
 			it->setValue(rp.value());
@@ -174,6 +140,87 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 	// openParams now contains:
 	// - if not specified in prePar, default parameter values
 	// - if specified in prePar, the values into prePar
+	return ioPlugin;
+}
+
+/**
+ * @brief Number of jobs that can run at the same time: the given limit, or the
+ * number of cores if it is zero.
+ */
+static int inFlightJobs(unsigned int maxInFlight, int jobNumber)
+{
+	int jobs = maxInFlight > 0 ? (int) maxInFlight : (int) std::thread::hardware_concurrency();
+	return std::max(1, std::min(jobs, jobNumber));
+}
+
+/**
+ * @brief This function assumes that you already have the following data:
+ * - the plugin that is needed to load the mesh
+ * - the number of meshes that will be loaded from the file
+ * - the list of MeshModel(s) that will contain the loaded mesh(es)
+ * - the open parameters that will be used to load the mesh(es)
+ *
+ * The function will take care to load the mesh, load textures if needed
+ * and make all the clean operations after loading the meshes.
+ * If load fails, throws a MLException.
+ *
+ * @param[i] fileName: the filename
+ * @param[i] ioPlugin: the plugin that supports the file format to load
+ * @param[i] prePar: the pre open parameters
+ * @param[i/o] meshList: the list of meshes that will be loaded from the file
+ * @param[o] maskList: masks of loaded components for each loaded mesh
+ * @param cb: callback
+ * @return the list of texture names that could not be loaded
+ */
+std::list<std::string> loadMesh(
+	const QString&               fileName,
+	IOPlugin*                    ioPlugin,
+	const RichParameterList&     prePar,
+	const std::list<MeshModel*>& meshList,
+	std::list<int>&              maskList,
+	vcg::CallBackPos*            cb)
+{
+	QFileInfo fi(fileName);
+	QString   extension = fi.suffix();
+
+	QDir oldDir = QDir::current();
+	QDir::setCurrent(fi.absolutePath());
+	ioPlugin->open(extension, fi.fileName(), meshList, maskList, prePar, cb);
+	QDir::setCurrent(oldDir.absolutePath());
+
+	return completeLoadedMeshes(ioPlugin, meshList, maskList, cb);
+}
+
+/**
+ * @brief loads the given filename and puts the loaded mesh(es) into the
+ * given MeshDocument. Returns the list of loaded meshes.
+ *
+ * If you already know the open parameters that could be used to load the mesh,
+ * you can pass a RichParameterList containing them.
+ * Note: only parameters of your RPL that are actually required by the plugin
+ * will be given as input to the load function.
+ * If you don't know any parameter, leave the RichParameterList parameter empty.
+ *
+ * The function takes care to:
+ * - find the plugin that loads the format of the file
+ * - create the required MeshModels into the MeshDocument
+ * - load the meshes and their textures, with standard parameters
+ *
+ * if an error occurs, an exception will be thrown, and MeshDocument won't
+ * contain new meshes.
+ */
+std::list<MeshModel*> loadMeshWithStandardParameters(
+	const QString&    filename,
+	MeshDocument&     md,
+	vcg::CallBackPos* cb,
+	RichParameterList prePar)
+{
+	QFileInfo         fi(filename);
+	QString           extension = fi.suffix();
+	RichParameterList openParams;
+	IOPlugin*         ioPlugin = standardOpenParameters(filename, prePar, openParams);
+
+	ioPlugin->setLog(&md.Log);
 
 	unsigned int nMeshes = ioPlugin->numberMeshesContainedInFile(extension, filename, openParams);
 	std::list<MeshModel*> meshList;
@@ -201,6 +248,105 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 	return meshList;
 }
 
+/**
+ * @brief loads the given files, with standard parameters, into new layers of
+ * the given MeshDocument. Returns, for each file, the list of its meshes.
+ *
+ * The layers are all created first, in the order of the files, then the files
+ * are decoded concurrently, at most maxInFlight at a time (0 means one per
+ * core), each one into its own layers. Files of formats that the plugin
+ * cannot open concurrently (see IOPlugin::isOpenReentrant) are decoded one at
+ * a time. Files are opened by absolute path and the current directory is
+ * never changed while decoding. The callback is only called by the calling
+ * thread, with the number of completed files.
+ *
+ * If any file fails, all the created layers are removed and the first error
+ * is thrown.
+ */
+std::vector<std::list<MeshModel*>> loadMeshesConcurrently(
+	const QStringList& filenames,
+	MeshDocument&      md,
+	unsigned int       maxInFlight,
+	vcg::CallBackPos*  cb)
+{
+	const int                          fileNumber = filenames.size();
+	std::vector<std::list<MeshModel*>> meshLists(fileNumber);
+	std::vector<IOPlugin*>             plugins(fileNumber);
+	std::vector<RichParameterList>     openParams(fileNumber);
+	std::vector<QString>               absolutePaths(fileNumber);
+
+	auto removeLayers = [&]() {
+		for (const std::list<MeshModel*>& l : meshLists)
+			for (const MeshModel* mm : l)
+				md.delMesh(mm->id());
+	};
+
+	// serial part: plugins, parameters and layers, in the order of the files
+	try {
+		for (int i = 0; i < fileNumber; ++i) {
+			QFileInfo fi(filenames[i]);
+			absolutePaths[i] = fi.absoluteFilePath();
+			plugins[i] = standardOpenParameters(absolutePaths[i], RichParameterList(), openParams[i]);
+			plugins[i]->setLog(&md.Log);
+			unsigned int nMeshes = plugins[i]->numberMeshesContainedInFile(
+				fi.suffix(), absolutePaths[i], openParams[i]);
+			for (unsigned int j = 0; j < nMeshes; j++) {
+				MeshModel* mm = md.addNewMesh(absolutePaths[i], fi.fileName());
+				if (nMeshes != 1)
+					mm->setIdInFile(j);
+				meshLists[i].push_back(mm);
+			}
+		}
+	}
+	catch (const MLException& e) {
+		removeLayers();
+		throw e;
+	}
+
+	// parallel part: every job touches only its own layers
+	std::vector<QString> errors(fileNumber);
+	std::atomic<int>     completed(0);
+	std::mutex           serialOpen;
+	const std::thread::id caller = std::this_thread::get_id();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(inFlightJobs(maxInFlight, fileNumber))
+	for (int i = 0; i < fileNumber; ++i) {
+		try {
+			const QString suffix = QFileInfo(absolutePaths[i]).suffix();
+			std::unique_lock<std::mutex> lock(serialOpen, std::defer_lock);
+			if (!plugins[i]->isOpenReentrant(suffix))
+				lock.lock();
+			std::list<int> masks;
+			plugins[i]->open(
+				suffix,
+				absolutePaths[i],
+				meshLists[i],
+				masks,
+				openParams[i],
+				nullptr);
+			if (lock.owns_lock())
+				lock.unlock();
+			completeLoadedMeshes(plugins[i], meshLists[i], masks, nullptr);
+		}
+		catch (const MLException& e) {
+			errors[i] = e.what();
+		}
+		catch (const std::exception& e) {
+			errors[i] = "Mesh " + absolutePaths[i] + " cannot be opened: " + e.what();
+		}
+		int done = ++completed;
+		if (cb != nullptr && std::this_thread::get_id() == caller)
+			cb(100 * done / fileNumber, "Loading meshes...");
+	}
+
+	for (const QString& err : errors) {
+		if (!err.isEmpty()) {
+			removeLayers();
+			throw MLException(err);
+		}
+	}
+	return meshLists;
+}
+
 void reloadMesh(
 	const QString&               filename,
 	const std::list<MeshModel*>& meshList,
@@ -267,7 +413,7 @@ void saveMeshWithStandardParameters(
 		m.updateDataMask(MeshModel::MM_FACEFACETOPO);
 	ioPlugin->save(extension, fileName, m, defaultBits, saveParams, cb);
 	m.setFileName(fileName);
-	m.saveTextures(fi.absolutePath(), -1, log, cb);
+	m.saveTextures(fi.absolutePath(), -1, log, cb, true);
 }
 
 void saveAllMeshes(
@@ -337,11 +483,54 @@ QImage loadImage(const QString& filename, GLLogStream* log, vcg::CallBackPos* cb
 	}
 }
 
+/**
+ * @brief decodes the given images concurrently, at most maxInFlight at a time
+ * (0 means one per core). The result keeps the order of the filenames; images
+ * that cannot be loaded are left null, without throwing. The callback is only
+ * called by the calling thread, with the number of completed images.
+ */
+std::vector<QImage> loadImagesConcurrently(
+	const QStringList& filenames,
+	unsigned int       maxInFlight,
+	GLLogStream*       log,
+	vcg::CallBackPos*  cb)
+{
+	const int           imageNumber = filenames.size();
+	std::vector<QImage> images(imageNumber);
+	std::atomic<int>    completed(0);
+	const std::thread::id caller = std::this_thread::get_id();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(inFlightJobs(maxInFlight, imageNumber))
+	for (int i = 0; i < imageNumber; ++i) {
+		try {
+			images[i] = loadImage(filenames[i], log, nullptr);
+		}
+		catch (const MLException&) {
+			images[i] = QImage();
+		}
+		int done = ++completed;
+		if (cb != nullptr && std::this_thread::get_id() == caller)
+			cb(100 * done / imageNumber, "Loading images...");
+	}
+	return images;
+}
+
 QImage getDummyTexture()
 {
 	return QImage(":/img/dummy.png");
 }
 
+static std::atomic<unsigned int> projectLoadingJobs {0};
+
+void setMaxProjectLoadingJobs(unsigned int jobs)
+{
+	projectLoadingJobs = jobs;
+}
+
+unsigned int maxProjectLoadingJobs()
+{
+	return projectLoadingJobs;
+}
+
 void saveImage(
 	const QString&    filename,
 	const QImage&     image,
@@ -375,9 +564,15 @@ void saveImage(
 
 void loadRaster(const QString& filename, RasterModel& rm, GLLogStream* log, vcg::CallBackPos* cb)
 {
-	QImage loadedImage = loadImage(filename, log, cb);
 	rm.setLabel(filename);
-	rm.addPlane(new RasterPlane(loadedImage, filename, RasterPlane::RGBA));
+	if (RasterPlane::memoryBudget() > 0 && QImageReader(filename).canRead()) {
+		// out of core: the pixels are decoded when they are needed
+		rm.addPlane(new RasterPlane(filename, RasterPlane::RGBA));
+	}
+	else {
+		QImage loadedImage = loadImage(filename, log, cb);
+		rm.addPlane(new RasterPlane(loadedImage, filename, RasterPlane::RGBA));
+	}
 
 	// Read the file into a buffer
 	FILE* fp = fopen(qUtf8Printable(filename), "rb");
@@ -409,12 +604,13 @@ void loadRaster(const QString& filename, RasterModel& rm, GLLogStream* log, vcg:
 	}
 
 	if (code || ImageInfo.FocalLengthIn35mm == 0.0f) {
+		const QSize imgSize = rm.currentPlane->size();
 		rm.shot.Intrinsics.ViewportPx =
-			vcg::Point2i(rm.currentPlane->image.width(), rm.currentPlane->image.height());
+			vcg::Point2i(imgSize.width(), imgSize.height());
 		rm.shot.Intrinsics.CenterPx = Point2m(
-			float(rm.currentPlane->image.width() / 2.0),
-			float(rm.currentPlane->image.width() / 2.0));
-		rm.shot.Intrinsics.PixelSizeMm[0] = 36.0f / (float) rm.currentPlane->image.width();
+			float(imgSize.width() / 2.0),
+			float(imgSize.width() / 2.0));
+		rm.shot.Intrinsics.PixelSizeMm[0] = 36.0f / (float) imgSize.width();
 		rm.shot.Intrinsics.PixelSizeMm[1] = rm.shot.Intrinsics.PixelSizeMm[0];
 		rm.shot.Intrinsics.FocalMm        = 50.0f;
 	}
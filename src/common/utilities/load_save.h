@@ -67,11 +67,27 @@ void saveAllMeshes(
 	GLLogStream*      log         = nullptr,
 	vcg::CallBackPos* cb          = nullptr);
 
+std::vector<std::list<MeshModel*>> loadMeshesConcurrently(
+	const QStringList& filenames,
+	MeshDocument&      md,
+	unsigned int       maxInFlight = 0,
+	vcg::CallBackPos*  cb          = nullptr);
+
 QImage
 loadImage(const QString& filename, GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr);
 
+std::vector<QImage> loadImagesConcurrently(
+	const QStringList& filenames,
+	unsigned int       maxInFlight = 0,
+	GLLogStream*       log         = nullptr,
+	vcg::CallBackPos*  cb          = nullptr);
+
 QImage getDummyTexture();
 
+// limit of files decoded at the same time while opening a project, 0 means one per core
+void setMaxProjectLoadingJobs(unsigned int jobs);
+unsigned int maxProjectLoadingJobs();
+
 void saveImage(
 	const QString&    filename,
 	const QImage&     image,
@@ -0,0 +1,422 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "mesh_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace meshlab {
+
+namespace {
+
+const int BIN_NUMBER = 16;
+const int MAX_DEPTH  = 100;
+
+Scalarm surfaceArea(const Box3m& b)
+{
+	if (b.IsNull())
+		return 0;
+	Point3m d = b.Dim();
+	return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+}
+
+} // namespace
+
+/**
+ * @brief Builds the hierarchy over the non deleted faces of m.
+ * @param m: the mesh
+ * @param maxLeafSize: number of triangles under which a node is never split
+ */
+MeshBVH::MeshBVH(const CMeshO& m, int maxLeafSize)
+{
+	std::vector<Triangle> faceTris;
+	std::vector<Box3m>    boxes;
+	std::vector<Point3m>  centroids;
+	faceTris.reserve(m.fn);
+	boxes.reserve(m.fn);
+	centroids.reserve(m.fn);
+	for (size_t i = 0; i < m.face.size(); ++i) {
+		const CFaceO& f = m.face[i];
+		if (f.IsD())
+			continue;
+		Triangle t;
+		t.p0   = f.cP(0);
+		t.e1   = f.cP(1) - f.cP(0);
+		t.e2   = f.cP(2) - f.cP(0);
+		t.face = i;
+		faceTris.push_back(t);
+		Box3m b;
+		b.Set(f.cP(0));
+		b.Add(f.cP(1));
+		b.Add(f.cP(2));
+		boxes.push_back(b);
+		centroids.push_back(b.Center());
+		bbox.Add(b);
+	}
+
+	std::vector<int> ids(faceTris.size());
+	for (size_t i = 0; i < ids.size(); ++i)
+		ids[i] = i;
+	if (!ids.empty()) {
+		nodes.reserve(2 * ids.size() / std::max(1, maxLeafSize) + 1);
+		buildNode(ids, boxes, centroids, 0, ids.size(), std::max(1, maxLeafSize), 0);
+	}
+
+	// leaves refer to consecutive triangles
+	tris.resize(ids.size());
+	for (size_t i = 0; i < ids.size(); ++i)
+		tris[i] = faceTris[ids[i]];
+}
+
+/* Visits the triangles of the leaves hit by the ray, nearest child first.
+ * visit(triangle, tMax) may shrink tMax to cull farther nodes, and returns
+ * false to stop the traversal. */
+template<class Visitor>
+void MeshBVH::traverse(const Ray& r, Scalarm tMin, Scalarm tMax, Visitor& visit) const
+{
+	if (nodes.empty())
+		return;
+	int stack[MAX_DEPTH + 2];
+	int top      = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const int   nodeId = stack[--top];
+		const Node& node   = nodes[nodeId];
+		if (!intersectBox(node.box, r, tMin, tMax))
+			continue;
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; ++i)
+				if (!visit(tris[i], tMax))
+					return;
+		}
+		else {
+			int nearChild = nodeId + 1;
+			int farChild  = node.first;
+			if (r.dirNeg[node.axis])
+				std::swap(nearChild, farChild);
+			stack[top++] = farChild;
+			stack[top++] = nearChild;
+		}
+	}
+}
+
+bool MeshBVH::closestHit(
+	const Point3m& origin,
+	const Point3m& dir,
+	Scalarm        tMin,
+	Scalarm        tMax,
+	Hit&           hit) const
+{
+	Ray  r     = makeRay(origin, dir);
+	bool found = false;
+	auto visit = [&](const Triangle& tri, Scalarm& tFar) {
+		if (intersectTriangle(tri, r, tMin, tFar, hit)) {
+			tFar  = hit.t;
+			found = true;
+		}
+		return true;
+	};
+	traverse(r, tMin, tMax, visit);
+	return found;
+}
+
+bool MeshBVH::anyHit(const Point3m& origin, const Point3m& dir, Scalarm tMin, Scalarm tMax) const
+{
+	Ray  r     = makeRay(origin, dir);
+	bool found = false;
+	Hit  hit;
+	auto visit = [&](const Triangle& tri, Scalarm& tFar) {
+		found = intersectTriangle(tri, r, tMin, tFar, hit);
+		return !found;
+	};
+	traverse(r, tMin, tMax, visit);
+	return found;
+}
+
+void MeshBVH::allHits(
+	const Point3m&    origin,
+	const Point3m&    dir,
+	Scalarm           tMin,
+	Scalarm           tMax,
+	std::vector<Hit>& hits) const
+{
+	hits.clear();
+	Ray  r     = makeRay(origin, dir);
+	auto visit = [&](const Triangle& tri, Scalarm& tFar) {
+		Hit hit;
+		if (intersectTriangle(tri, r, tMin, tFar, hit))
+			hits.push_back(hit);
+		return true;
+	};
+	traverse(r, tMin, tMax, visit);
+	std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) { return a.t < b.t; });
+}
+
+/* Depth first visit of the nodes closer than the current closest point,
+ * nearest child first. */
+bool MeshBVH::closestPoint(const Point3m& p, Scalarm maxDist, ClosestPoint& closest) const
+{
+	if (nodes.empty())
+		return false;
+	Scalarm best  = maxDist * maxDist;
+	bool    found = false;
+	int     stack[MAX_DEPTH + 2];
+	int     top   = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const int   nodeId = stack[--top];
+		const Node& node   = nodes[nodeId];
+		if (squaredBoxDistance(node.box, p) >= best)
+			continue;
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				const Triangle& tri = tris[i];
+				Scalarm         u, v;
+				closestOnTriangle(tri, p, u, v);
+				Scalarm d = (tri.p0 + tri.e1 * u + tri.e2 * v - p).SquaredNorm();
+				if (d < best) {
+					best         = d;
+					found        = true;
+					closest.face = tri.face;
+					closest.u    = u;
+					closest.v    = v;
+				}
+			}
+		}
+		else {
+			int nearChild = nodeId + 1;
+			int farChild  = node.first;
+			if (squaredBoxDistance(nodes[farChild].box, p) <
+				squaredBoxDistance(nodes[nearChild].box, p))
+				std::swap(nearChild, farChild);
+			stack[top++] = farChild;
+			stack[top++] = nearChild;
+		}
+	}
+	if (found)
+		closest.dist = std::sqrt(best);
+	return found;
+}
+
+int MeshBVH::buildNode(
+	std::vector<int>&           ids,
+	const std::vector<Box3m>&   boxes,
+	const std::vector<Point3m>& centroids,
+	int                         begin,
+	int                         end,
+	int                         maxLeafSize,
+	int                         depth)
+{
+	const int nodeId = nodes.size();
+	nodes.push_back(Node());
+
+	Box3m box, centroidBox;
+	for (int i = begin; i < end; ++i) {
+		box.Add(boxes[ids[i]]);
+		centroidBox.Add(centroids[ids[i]]);
+	}
+	nodes[nodeId].box   = box;
+	nodes[nodeId].first = begin;
+	nodes[nodeId].count = end - begin;
+	nodes[nodeId].axis  = 0;
+
+	const int     n      = end - begin;
+	const int     axis   = centroidBox.MaxDim();
+	const Scalarm extent = centroidBox.Dim()[axis];
+	if (n <= maxLeafSize || extent <= 0 || depth >= MAX_DEPTH)
+		return nodeId;
+
+	// binned surface area heuristic
+	auto binOf = [&](int id) {
+		int b = int(BIN_NUMBER * (centroids[id][axis] - centroidBox.min[axis]) / extent);
+		return std::min(b, BIN_NUMBER - 1);
+	};
+	Box3m binBox[BIN_NUMBER];
+	int   binCount[BIN_NUMBER] = {0};
+	for (int i = begin; i < end; ++i) {
+		int b = binOf(ids[i]);
+		binCount[b]++;
+		binBox[b].Add(boxes[ids[i]]);
+	}
+
+	Scalarm leftCost[BIN_NUMBER];
+	Box3m   acc;
+	int     count = 0;
+	for (int b = 0; b < BIN_NUMBER - 1; ++b) {
+		acc.Add(binBox[b]);
+		count += binCount[b];
+		leftCost[b] = surfaceArea(acc) * count;
+	}
+	Scalarm bestCost  = std::numeric_limits<Scalarm>::max();
+	int     bestSplit = -1;
+	acc.SetNull();
+	count = 0;
+	for (int b = BIN_NUMBER - 1; b > 0; --b) {
+		acc.Add(binBox[b]);
+		count += binCount[b];
+		Scalarm cost = leftCost[b - 1] + surfaceArea(acc) * count;
+		if (count > 0 && count < n && cost < bestCost) {
+			bestCost  = cost;
+			bestSplit = b;
+		}
+	}
+
+	// a traversal step costs about as much as a triangle test
+	const Scalarm area = surfaceArea(box);
+	if (bestSplit < 0 || (area > 0 && 1 + bestCost / area >= n && n <= 4 * maxLeafSize))
+		return nodeId;
+
+	int mid = std::partition(
+				  ids.begin() + begin,
+				  ids.begin() + end,
+				  [&](int id) { return binOf(id) < bestSplit; }) -
+			  ids.begin();
+
+	buildNode(ids, boxes, centroids, begin, mid, maxLeafSize, depth + 1);
+	int right = buildNode(ids, boxes, centroids, mid, end, maxLeafSize, depth + 1);
+	nodes[nodeId].first = right;
+	nodes[nodeId].count = 0;
+	nodes[nodeId].axis  = axis;
+	return nodeId;
+}
+
+MeshBVH::Ray MeshBVH::makeRay(const Point3m& origin, const Point3m& dir)
+{
+	Ray r;
+	r.o = origin;
+	r.d = dir;
+	for (int k = 0; k < 3; ++k) {
+		r.invD[k]   = Scalarm(1) / dir[k];
+		r.dirNeg[k] = dir[k] < 0;
+	}
+	return r;
+}
+
+bool MeshBVH::intersectBox(const Box3m& b, const Ray& r, Scalarm tMin, Scalarm tMax)
+{
+	for (int k = 0; k < 3; ++k) {
+		Scalarm t0 = (b.min[k] - r.o[k]) * r.invD[k];
+		Scalarm t1 = (b.max[k] - r.o[k]) * r.invD[k];
+		if (r.dirNeg[k])
+			std::swap(t0, t1);
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+		if (tMin > tMax)
+			return false;
+	}
+	return true;
+}
+
+/* Moller-Trumbore ray triangle intersection */
+bool MeshBVH::intersectTriangle(
+	const Triangle& tri,
+	const Ray&      r,
+	Scalarm         tMin,
+	Scalarm         tMax,
+	Hit&            hit)
+{
+	Point3m pvec = r.d ^ tri.e2;
+	Scalarm det  = tri.e1 * pvec;
+	if (det == 0)
+		return false;
+	Scalarm invDet = Scalarm(1) / det;
+	Point3m tvec   = r.o - tri.p0;
+	Scalarm u      = (tvec * pvec) * invDet;
+	if (u < 0 || u > 1)
+		return false;
+	Point3m qvec = tvec ^ tri.e1;
+	Scalarm v    = (r.d * qvec) * invDet;
+	if (v < 0 || u + v > 1)
+		return false;
+	Scalarm t = (tri.e2 * qvec) * invDet;
+	if (t <= tMin || t >= tMax)
+		return false;
+	hit.t    = t;
+	hit.face = tri.face;
+	hit.u    = u;
+	hit.v    = v;
+	return true;
+}
+
+Scalarm MeshBVH::squaredBoxDistance(const Box3m& b, const Point3m& p)
+{
+	Scalarm d = 0;
+	for (int k = 0; k < 3; ++k) {
+		if (p[k] < b.min[k])
+			d += (b.min[k] - p[k]) * (b.min[k] - p[k]);
+		else if (p[k] > b.max[k])
+			d += (p[k] - b.max[k]) * (p[k] - b.max[k]);
+	}
+	return d;
+}
+
+/* closest point of a triangle to p, by Voronoi regions (Ericson, Real-Time
+ * Collision Detection, 5.1.5) */
+void MeshBVH::closestOnTriangle(const Triangle& tri, const Point3m& p, Scalarm& u, Scalarm& v)
+{
+	const Point3m ap = p - tri.p0;
+	const Scalarm d1 = tri.e1 * ap;
+	const Scalarm d2 = tri.e2 * ap;
+	u = v = 0;
+	if (d1 <= 0 && d2 <= 0)
+		return;
+	const Point3m bp = ap - tri.e1;
+	const Scalarm d3 = tri.e1 * bp;
+	const Scalarm d4 = tri.e2 * bp;
+	if (d3 >= 0 && d4 <= d3) {
+		u = 1;
+		return;
+	}
+	const Scalarm vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+		u = d1 / (d1 - d3);
+		return;
+	}
+	const Point3m cp = ap - tri.e2;
+	const Scalarm d5 = tri.e1 * cp;
+	const Scalarm d6 = tri.e2 * cp;
+	if (d6 >= 0 && d5 <= d6) {
+		v = 1;
+		return;
+	}
+	const Scalarm vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+		v = d2 / (d2 - d6);
+		return;
+	}
+	const Scalarm va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+		v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		u = 1 - v;
+		return;
+	}
+	const Scalarm sum = va + vb + vc;
+	if (sum <= 0) // degenerate triangle
+		return;
+	u = vb / sum;
+	v = vc / sum;
+}
+
+} // namespace meshlab
@@ -0,0 +1,134 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_MESH_BVH_H
+#define MESHLAB_MESH_BVH_H
+
+#include "../ml_document/cmesh.h"
+
+#include <vector>
+
+namespace meshlab {
+
+/**
+ * @brief Bounding volume hierarchy over the triangles of a CMeshO, built with
+ * the binned surface area heuristic, used for ray casting and closest point queries on the CPU.
+ *
+ * The hierarchy keeps its own copy of the triangles, therefore the mesh
+ * attributes (quality, color...) can be modified while the hierarchy is used;
+ * after any change of the geometry the hierarchy must be built again.
+ * All the queries are const and can be issued concurrently by any number of
+ * threads.
+ */
+class MeshBVH
+{
+public:
+	struct Hit
+	{
+		Scalarm t;    // ray parameter of the hit
+		int     face; // index of the hit face in the mesh face vector
+		Scalarm u, v; // barycentric coordinates of the hit w.r.t. V(1) and V(2)
+	};
+
+	struct ClosestPoint
+	{
+		Scalarm dist; // distance of the closest point from the query point
+		int     face; // index of the closest face in the mesh face vector
+		Scalarm u, v; // barycentric coordinates of the closest point w.r.t. V(1) and V(2)
+	};
+
+	MeshBVH(const CMeshO& m, int maxLeafSize = 4);
+
+	/** closest hit of the ray origin + t*dir, with t in (tMin, tMax) */
+	bool closestHit(
+		const Point3m& origin,
+		const Point3m& dir,
+		Scalarm        tMin,
+		Scalarm        tMax,
+		Hit&           hit) const;
+
+	/** true if the ray origin + t*dir hits something, with t in (tMin, tMax) */
+	bool anyHit(const Point3m& origin, const Point3m& dir, Scalarm tMin, Scalarm tMax) const;
+
+	/** all the hits of the ray origin + t*dir with t in (tMin, tMax), sorted by t */
+	void allHits(
+		const Point3m&    origin,
+		const Point3m&    dir,
+		Scalarm           tMin,
+		Scalarm           tMax,
+		std::vector<Hit>& hits) const;
+
+	/** closest point of the surface to p, if its distance from p is less than maxDist */
+	bool closestPoint(const Point3m& p, Scalarm maxDist, ClosestPoint& closest) const;
+
+	const Box3m& boundingBox() const { return bbox; }
+	size_t       triangleNumber() const { return tris.size(); }
+
+private:
+	struct Node
+	{
+		Box3m box;
+		int   first; // first triangle if leaf, second child otherwise (first child is next)
+		int   count; // number of triangles, 0 for inner nodes
+		int   axis;  // split axis of inner nodes
+	};
+
+	struct Triangle
+	{
+		Point3m p0, e1, e2;
+		int     face;
+	};
+
+	struct Ray
+	{
+		Point3m o, d, invD;
+		int     dirNeg[3];
+	};
+
+	int buildNode(
+		std::vector<int>&           ids,
+		const std::vector<Box3m>&   boxes,
+		const std::vector<Point3m>& centroids,
+		int                         begin,
+		int                         end,
+		int                         maxLeafSize,
+		int                         depth);
+
+	static Ray  makeRay(const Point3m& origin, const Point3m& dir);
+	static bool intersectBox(const Box3m& b, const Ray& r, Scalarm tMin, Scalarm tMax);
+	static bool
+	intersectTriangle(const Triangle& tri, const Ray& r, Scalarm tMin, Scalarm tMax, Hit& hit);
+	static Scalarm squaredBoxDistance(const Box3m& b, const Point3m& p);
+	static void    closestOnTriangle(const Triangle& tri, const Point3m& p, Scalarm& u, Scalarm& v);
+
+	template<class Visitor>
+	void traverse(const Ray& r, Scalarm tMin, Scalarm tMax, Visitor& visit) const;
+
+	Box3m                 bbox;
+	std::vector<Node>     nodes;
+	std::vector<Triangle> tris;
+};
+
+} // namespace meshlab
+
+#endif // MESHLAB_MESH_BVH_H
@@ -247,10 +247,11 @@ void GLArea::pasteTile()
 
 						RasterModel* rastm = md()->rm();
 						rastm->shot        = shot_tmp;
-						float ratio        = (float) rastm->currentPlane->image.height() /
+						const QSize imgSize = rastm->currentPlane->size();
+						float ratio        = (float) imgSize.height() /
 									  (float) rastm->shot.Intrinsics.ViewportPx[1];
-						rastm->shot.Intrinsics.ViewportPx[0] = rastm->currentPlane->image.width();
-						rastm->shot.Intrinsics.ViewportPx[1] = rastm->currentPlane->image.height();
+						rastm->shot.Intrinsics.ViewportPx[0] = imgSize.width();
+						rastm->shot.Intrinsics.ViewportPx[1] = imgSize.height();
 						rastm->shot.Intrinsics.PixelSizeMm[1] /= ratio;
 						rastm->shot.Intrinsics.PixelSizeMm[0] /= ratio;
 						rastm->shot.Intrinsics.CenterPx[0] =
@@ -1874,11 +1875,13 @@ void GLArea::loadRaster(int id)
 	for(RasterModel& rm: md()->rasterIterator()) {
 		if(rm.id() == id) {
 			this->md()->setCurrentRaster(id);
-			if (rm.currentPlane->image.isNull()) {
+			QImage img = rm.currentPlane->pixels();
+			if (img.isNull()) {
 				Logf(0,"Image file %s has not been correctly loaded, a fake image is going to be shown.",rm.currentPlane->fullPathFileName.toUtf8().constData());
-				rm.currentPlane->image.load(":/images/dummy.png");
+				img.load(":/images/dummy.png");
+				rm.currentPlane->setPixels(img);
 			}
-			setTarget(rm.currentPlane->image);
+			setTarget(img);
 			//load his shot or a default shot
 
 			if (rm.shot.IsValid()) {
@@ -1917,8 +1920,8 @@ void GLArea::drawTarget()
     if(!targetTex) return;
 
     if(this->md()->rm()==0) return;
-    QImage &curImg = this->md()->rm()->currentPlane->image;
-    float imageRatio = float(curImg.width())/float(curImg.height());
+    const QSize curSize = this->md()->rm()->currentPlane->size();
+    float imageRatio = float(curSize.width())/float(curSize.height());
     float screenRatio = float(this->width())/float(this->height());
     //set orthogonal view
     glPushMatrix();
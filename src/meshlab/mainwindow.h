@@ -95,6 +95,12 @@ public:
 
 	QString meshSetName;
 	inline static QString meshSetNameParam() {return "MeshLab::System::meshSetName";};
+
+	inline static QString maxProjectLoadingJobsParam() {return "MeshLab::System::maxProjectLoadingJobs";}
+
+	inline static QString maxResidentTextureMemoryParam() {return "MeshLab::System::maxResidentTextureMemory";}
+
+	inline static QString maxRasterMemoryParam() {return "MeshLab::System::maxRasterMemory";}
 };
 
 class MainWindow : public QMainWindow
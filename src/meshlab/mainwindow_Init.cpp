@@ -38,6 +38,7 @@
 #include <common/mlapplication.h>
 #include <common/mlexception.h>
 #include <common/globals.h>
+#include <common/utilities/load_save.h>
 #include "dialogs/options_dialog.h"
 #include "dialogs/save_snapshot_dialog.h"
 #include "dialogs/congrats_dialog.h"
@@ -1300,6 +1301,9 @@ void MainWindowSetting::initGlobalParameterList(RichParameterList& gbllist)
 	gbllist.addParam(RichInt(startupWindowWidthParam(), 0, "Startup Window Width (in pixels)", "Window width on startup"));
 	gbllist.addParam(RichInt(startupWindowHeightParam(), 0, "Startup Window Height (in pixels)", "Window height on startup"));
 	gbllist.addParam(RichString(meshSetNameParam(), "ms", "Name of the MeshSet object.", "Set the MeshSet name object in the PyMeshLab call copied in the clipboard from the filter dock dialog."));
+	gbllist.addParam(RichInt(maxProjectLoadingJobsParam(), 0, "Max concurrent files while opening a project", "Maximum number of mesh and image files of a project that are decoded at the same time. 0 means one for each core."));
+	gbllist.addParam(RichInt(maxResidentTextureMemoryParam(), 0, "Max decoded texture memory per layer (in MB)", "Maximum memory used by the decoded textures of each layer. Textures are decoded when first used and the least recently used ones are released when the limit is exceeded. 0 means that all the textures are decoded when the mesh is opened."));
+	gbllist.addParam(RichInt(maxRasterMemoryParam(), 0, "Max decoded raster memory (in MB)", "Maximum memory used by the decoded images of the raster layers. Images are decoded when first used and the least recently used ones are released when the limit is exceeded. 0 means that all the images are decoded when they are opened."));
 }
 
 void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
@@ -1314,6 +1318,9 @@ void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
 	startupWindowWidth = rpl.getInt(startupWindowWidthParam());
 	startupWindowHeight = rpl.getInt(startupWindowHeightParam());
 	meshSetName = rpl.getString(meshSetNameParam());
+	MeshModel::setTextureMemoryBudget((std::size_t) std::max(0, rpl.getInt(maxResidentTextureMemoryParam())) * 1024 * 1024);
+	RasterPlane::setMemoryBudget((std::size_t) std::max(0, rpl.getInt(maxRasterMemoryParam())) * 1024 * 1024);
+	meshlab::setMaxProjectLoadingJobs(std::max(0, rpl.getInt(maxProjectLoadingJobsParam())));
 }
 
 void MainWindow::defaultPerViewRenderingData(MLRenderingData& dt) const
@@ -61,6 +61,35 @@
 using namespace std;
 using namespace vcg;
 
+/**
+ * Keeps in memory the pixels of all the raster planes while a filter that
+ * reads them directly is running, when rasters are loaded out of core.
+ */
+class RasterPixelsPin
+{
+public:
+	RasterPixelsPin(MeshDocument& md, bool needed)
+	{
+		if (!needed || RasterPlane::memoryBudget() == 0)
+			return;
+		for (RasterModel& rm : md.rasterIterator()) {
+			for (RasterPlane* pl : rm.planeList) {
+				pl->pin();
+				pl->Load();
+				planes.push_back(pl);
+			}
+		}
+	}
+	~RasterPixelsPin()
+	{
+		for (RasterPlane* pl : planes)
+			pl->unpin();
+	}
+
+private:
+	std::vector<RasterPlane*> planes;
+};
+
 void MainWindow::updateRecentFileActions()
 {
 	bool activeDoc = (bool) !mdiarea->subWindowList().empty() && mdiarea->currentSubWindow();
@@ -722,7 +751,10 @@ void MainWindow::runFilterScript()
 			if ((!created) || (!iFilter->glContext->isValid()))
 				throw MLException("A valid GLContext is required by the filter to work.\n");
 			meshDoc()->setBusy(true);
-			iFilter->applyFilter(action, pair.second, *meshDoc(), postCondMask, QCallBack);
+			{
+				RasterPixelsPin pin(*meshDoc(), iFilter->requiresRasterPixels(action));
+				iFilter->applyFilter(action, pair.second, *meshDoc(), postCondMask, QCallBack);
+			}
 			if (postCondMask == MeshModel::MM_UNKNOWN)
 				postCondMask = iFilter->postCondition(action);
 			for (MeshModel* mm = meshDoc()->nextMesh(); mm != NULL; mm = meshDoc()->nextMesh(mm))
@@ -1081,7 +1113,10 @@ void MainWindow::executeFilter(
 		meshDoc()->meshDocStateData().clear();
 		meshDoc()->meshDocStateData().create(*meshDoc());
 		unsigned int postCondMask = MeshModel::MM_UNKNOWN;
-		iFilter->applyFilter(action, mergedenvironment, *(meshDoc()), postCondMask, QCallBack);
+		{
+			RasterPixelsPin pin(*meshDoc(), iFilter->requiresRasterPixels(action));
+			iFilter->applyFilter(action, mergedenvironment, *(meshDoc()), postCondMask, QCallBack);
+		}
 		if (postCondMask == MeshModel::MM_UNKNOWN)
 			postCondMask = iFilter->postCondition(action);
 		for (MeshModel& mm : meshDoc()->meshIterator())
@@ -1469,7 +1504,19 @@ void MainWindow::saveProject()
 	int res = saveDiag->exec();
 
 	if (res == QFileDialog::AcceptSave){
-		if (!saveAllFilesCheckBox->isChecked()){
+		QString fileName = saveDiag->selectedFiles().first();
+		// this change of dir is needed for subsequent textures/materials loading
+		QFileInfo fi(fileName);
+		if (fi.suffix().isEmpty()) {
+			QRegExp reg("\\.\\w+");
+			saveDiag->selectedNameFilter().indexOf(reg);
+			QString ext = reg.cap();
+			fileName.append(ext);
+			fi.setFile(fileName);
+		}
+		// a binary project stores the layers itself, they need no file
+		const bool singleContainer = fi.suffix().toLower() == "mlb";
+		if (!saveAllFilesCheckBox->isChecked() && !singleContainer){
 			bool firstNotSaved = true;
 			//if a mesh has been created by a create filter we must before to save it.
 			//Otherwise the project will refer to a mesh without file name path.
@@ -1491,16 +1538,6 @@ void MainWindow::saveProject()
 			}
 		}
 
-		QString fileName = saveDiag->selectedFiles().first();
-		// this change of dir is needed for subsequent textures/materials loading
-		QFileInfo fi(fileName);
-		if (fi.suffix().isEmpty()) {
-			QRegExp reg("\\.\\w+");
-			saveDiag->selectedNameFilter().indexOf(reg);
-			QString ext = reg.cap();
-			fileName.append(ext);
-			fi.setFile(fileName);
-		}
 		QDir::setCurrent(fi.absoluteDir().absolutePath());
 
 		//save path away so we can use it again
@@ -1518,7 +1555,7 @@ void MainWindow::saveProject()
 		}
 
 		try {
-			if (saveAllFilesCheckBox->isChecked()) {
+			if (saveAllFilesCheckBox->isChecked() && !singleContainer) {
 				meshlab::saveAllMeshes(path, *meshDoc(), onlyVisibleLayersCheckBox->isChecked());
 			}
 			meshlab::saveProject(fileName, *meshDoc(), onlyVisibleLayersCheckBox->isChecked(), rendData);
@@ -2393,7 +2430,8 @@ bool MainWindow::exportMesh(QString fileName,MeshModel* mod,const bool saveAllPo
 				pCurrentIOPlugin->save(extension, fileName, *mod ,mask,savePar,QCallBack);
 				QFileInfo finfo(fileName);
 				if (saveTextures)
-					mod->saveTextures(finfo.absolutePath(), quality, &meshDoc()->Log, QCallBack);
+					// with the default quality, unmodified texture files are just copied
+					mod->saveTextures(finfo.absolutePath(), quality, &meshDoc()->Log, QCallBack, quality == -1);
 				GLA()->Logf(GLLogStream::SYSTEM, "Saved Mesh %s in %i msec", qUtf8Printable(fileName), tt.elapsed());
 				mod->setFileName(fileName);
 				QSettings settings;
@@ -2649,21 +2687,28 @@ void MainWindow::updateTexture(int meshid)
 	
 	int singleMaxTextureSizeMpx = int(textmemMB/((totalTextureNum != 0)? totalTextureNum : 1));
 
+	// textures that are not in memory are decoded concurrently, a batch at a
+	// time, and only the batch being uploaded is kept here
+	const std::vector<std::string> textnames(mymesh->cm.textures.begin(), mymesh->cm.textures.end());
+	const size_t batch = std::max(QThread::idealThreadCount(), 1);
 	bool sometextnotfound = false;
-	for(const std::string& textname : mymesh->cm.textures)
+	for(size_t first = 0; first < textnames.size(); first += batch)
 	{
-		QImage img = mymesh->getTexture(textname);
-
-		if (img.isNull()){
-			img.load(":/images/dummy.png");
-		}
-		GLuint textid = shared->allocateTexturePerMesh(meshid,img,singleMaxTextureSizeMpx);
-		
-		for(int tt = 0;tt < mvc->viewerCounter();++tt)
+		std::vector<QImage> imgs = mymesh->getTextures(std::vector<std::string>(
+			textnames.begin() + first, textnames.begin() + std::min(first + batch, textnames.size())));
+		for(QImage& img : imgs)
 		{
-			GLArea* ar = mvc->getViewer(tt);
-			if (ar != NULL)
-				ar->setupTextureEnv(textid);
+			if (img.isNull()){
+				img.load(":/images/dummy.png");
+			}
+			GLuint textid = shared->allocateTexturePerMesh(meshid,img,singleMaxTextureSizeMpx);
+
+			for(int tt = 0;tt < mvc->viewerCounter();++tt)
+			{
+				GLArea* ar = mvc->getViewer(tt);
+				if (ar != NULL)
+					ar->setupTextureEnv(textid);
+			}
 		}
 	}
 	if (sometextnotfound)
@@ -57,6 +57,31 @@ void AlignParameter::AlignPairParamToRichParameterSet(const AlignPair::Param &ap
   rps.addParam(RichBool("MatchMode",app.MatchMode == AlignPair::Param::MMRigid,"Rigid matching","If true the ICP is constrained to perform matching only through roto-translations (no scaling allowed). If false a more relaxed transformation matrix is allowed (scaling and shearing can appear)."));
 }
 
+void AlignParameter::AlignPairParamToIcpParam(const AlignPair::Param &app, meshlab::IcpAligner::Param &ip)
+{
+  ip.sampleNum       =app.SampleNum;
+  ip.minDistAbs      =app.MinDistAbs;
+  ip.trgDistAbs      =app.TrgDistAbs;
+  ip.maxIterNum      =app.MaxIterNum;
+  ip.normalEqualized =app.SampleMode == AlignPair::Param::SMNormalEqualized;
+  ip.reduceFactorPerc=app.ReduceFactorPerc;
+  ip.passHiFilter    =app.PassHiFilter;
+  ip.rigid           =app.MatchMode == AlignPair::Param::MMRigid;
+}
+
+void AlignParameter::RichParameterSetToIcpParam(const RichParameterList &rps, meshlab::IcpAligner::Param &ip)
+{
+  ip.pointToPlane =rps.getBool("PointToPlane");
+  ip.sampleLevels =rps.getInt( "SampleLevels");
+}
+
+// appends the IcpAligner parameters that are not in the AlignPair set
+void AlignParameter::IcpParamToRichParameterSet(const meshlab::IcpAligner::Param &ip, RichParameterList &rps)
+{
+  rps.addParam(RichBool("PointToPlane",ip.pointToPlane,"Point to plane","If true each ICP iteration minimizes the distances of the samples from the tangent planes of the corresponding points, instead of the distances from the points. It usually converges in much less iterations on smooth surfaces. Only rigid matching is supported."));
+  rps.addParam(RichInt("SampleLevels",ip.sampleLevels,"Sample Levels","Number of levels of the coarse to fine sampling schedule: the first level uses 1/4^(levels-1) of the samples, each level four times the samples of the previous one. A level ends when it converges or after MaxIterNum/levels iterations. 1 means that all the samples are always used."));
+}
+
 void AlignParameter::RichParameterSetToMeshTreeParam(const RichParameterList &fps , MeshTreem::Param &mtp)
 {
   mtp.arcThreshold=fps.getFloat("arcThreshold");
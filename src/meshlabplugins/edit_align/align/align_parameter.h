@@ -22,6 +22,7 @@
 ****************************************************************************/
 
 #include <common/parameters/rich_parameter_list.h>
+#include <common/utilities/icp_aligner.h>
 #include <vcg/complex/algorithms/meshtree.h>
 
 typedef vcg::MeshTree<MeshModel, Scalarm> MeshTreem;
@@ -35,6 +36,11 @@ public:
 	static void RichParameterSetToMeshTreeParam(const RichParameterList &rps, MeshTreem::Param &mtp);
 	static void MeshTreeParamToRichParameterSet(const MeshTreem::Param &mtp, RichParameterList &rps);
 
+	// the IcpAligner parameters are the AlignPair ones, plus the point to plane and sample levels ones of ip
+	static void AlignPairParamToIcpParam(const vcg::AlignPair::Param &app, meshlab::IcpAligner::Param &ip);
+	static void RichParameterSetToIcpParam(const RichParameterList &rps, meshlab::IcpAligner::Param &ip);
+	static void IcpParamToRichParameterSet(const meshlab::IcpAligner::Param &ip, RichParameterList &rps);
+
 private:
 	//no need to have an instance of this class
 	AlignParameter();
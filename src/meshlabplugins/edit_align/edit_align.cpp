@@ -37,6 +37,9 @@ $Log: meshedit.cpp,v $
 #include <vcg/complex/algorithms/point_matching_scale.h>
 
 #include <QMessageBox>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
 
 using namespace vcg;
 
@@ -383,6 +386,7 @@ void EditAlignPlugin:: alignParam()
 {
     RichParameterList alignParamSet;
     AlignParameter::AlignPairParamToRichParameterSet(defaultAP, alignParamSet);
+    AlignParameter::IcpParamToRichParameterSet(defaultIcp, alignParamSet);
 	RichParameterListDialog ad(alignDialog, alignParamSet, "Default Alignment Parameters");
     ad.setWindowFlags(Qt::Dialog);
     ad.setWindowModality(Qt::WindowModal);
@@ -390,6 +394,7 @@ void EditAlignPlugin:: alignParam()
     if(result != QDialog::Accepted) return;
     // Dialog accepted. get back the values
     AlignParameter::RichParameterSetToAlignPairParam(alignParamSet, defaultAP);
+    AlignParameter::RichParameterSetToIcpParam(alignParamSet, defaultIcp);
 }
 
 void EditAlignPlugin::setAlignParamMM()
@@ -460,7 +465,8 @@ void EditAlignPlugin::process()
         return;
     }
     alignDialog->setEnabled(false);
-    meshTree.Process(defaultAP, defaultMTP);
+    if(processArcs(defaultAP, defaultMTP) > 0)
+        meshTree.ProcessGlobal(defaultAP);
     alignDialog->rebuildTree();
     _gla->update();
     alignDialog->setEnabled(true);
@@ -471,7 +477,9 @@ void EditAlignPlugin::recalcCurrentArc()
     assert(currentArc());
 
     alignDialog->setEnabled(false);
-    meshTree.ProcessArc(currentArc()->FixName,currentArc()->MovName,*currentArc(),currentArc()->ap);
+    AlignPair::Result *arc = currentArc();
+    if(!alignArc(meshTree.find(arc->FixName), meshTree.find(arc->MovName), arc->ap, *arc))
+        QMessageBox::warning(nullptr, "Align tool", "The ICP of the current arc failed: " + QString(AlignPair::errorMsg(arc->status)));
     meshTree.ProcessGlobal(currentArc()->ap);
     AlignPair::Result *recomputedArc = currentArc();
     alignDialog->rebuildTree();
@@ -481,6 +489,190 @@ void EditAlignPlugin::recalcCurrentArc()
 }
 
 
+int EditAlignPlugin::processArcs(const AlignPair::Param &ap, const MeshTreem::Param &mtp)
+{
+    char buf[1024];
+    std::vector<MeshTreem::MeshNode*> glued;
+    std::vector<Box3m> worldBox; // cached once, the transformed bbox of each glued node
+    Box3m gluedBox;
+    int maxId = 0;
+    for(auto &ni : meshTree.nodeMap)
+        if(ni.second->glued)
+        {
+            glued.push_back(ni.second);
+            worldBox.push_back(ni.second->m->cm.trBB());
+            gluedBox.Add(worldBox.back());
+            maxId = std::max(maxId, ni.second->Id());
+        }
+    std::snprintf(buf, sizeof(buf), "Starting Processing of %zu glued meshes out of %zu meshes\n", glued.size(), meshTree.nodeMap.size());
+    meshTree.cb(0, buf);
+
+    // coarse overlap estimation on a sampled occupancy grid; the s and t of the grid arcs are the fix and mov ids
+    vcg::OccupancyGrid<CMeshO, Scalarm> og;
+    og.Init(maxId + 1, gluedBox, mtp.OGSize);
+    for(MeshTreem::MeshNode *mn : glued)
+        og.AddMesh(mn->m->cm, Matrix44m::Construct(mn->tr()), mn->Id());
+    og.Compute();
+
+    // a voxel of the grid can be shared by meshes far apart, discard the pairs whose boxes (grown by the ICP starting distance) do not meet
+    auto boxesMeet = [&](int s, int t) {
+        Box3m bs, bt;
+        for(size_t i = 0; i < glued.size(); ++i)
+        {
+            if(glued[i]->Id() == s) bs = worldBox[i];
+            if(glued[i]->Id() == t) bt = worldBox[i];
+        }
+        bs.Offset(ap.MinDistAbs);
+        return bs.Collide(bt);
+    };
+
+    // arcs already computed with an error below the percentile threshold are kept as they are
+    double percentileThr = 0;
+    if(!meshTree.resultList.empty())
+    {
+        std::vector<double> errs;
+        for(const AlignPair::Result &r : meshTree.resultList)
+            errs.push_back(r.err);
+        std::sort(errs.begin(), errs.end());
+        size_t pos = std::min(errs.size() - 1, size_t((1.0 - mtp.recalcThreshold) * errs.size()));
+        percentileThr = errs[pos];
+    }
+
+    struct ArcJob { int fix, mov; float area; AlignPair::Result res; };
+    std::vector<ArcJob> jobs;
+    int candidateNum = 0, prunedNum = 0, preservedNum = 0;
+    for(size_t i = 0; i < og.SVA.size() && og.SVA[i].norm_area > mtp.arcThreshold; ++i)
+    {
+        const auto &arc = og.SVA[i];
+        ++candidateNum;
+        if(!boxesMeet(arc.s, arc.t))
+        {
+            ++prunedNum;
+            continue;
+        }
+        AlignPair::Result *prev = meshTree.findResult(arc.s, arc.t);
+        if(prev != nullptr && prev->err < percentileThr)
+        {
+            ++preservedNum;
+            continue;
+        }
+        jobs.push_back({arc.s, arc.t, arc.norm_area, AlignPair::Result()});
+    }
+    if(candidateNum - prunedNum == 0)
+    {
+        meshTree.cb(0, "\n Failure. There are no overlapping meshes?\n No candidate alignment arcs. Nothing Done.\n");
+        return 0;
+    }
+    std::snprintf(buf, sizeof(buf), "Arc with good overlap %6i (on %6zu), pruned by bbox %i, preserved %i, to be computed %zu\n",
+                  candidateNum, og.SVA.size(), prunedNum, preservedNum, jobs.size());
+    meshTree.cb(0, buf);
+
+    // one spatial index for every node used as fix, built concurrently and shared read-only by all its arcs
+    std::vector<int> fixIds;
+    for(const ArcJob &j : jobs)
+        fixIds.push_back(j.fix);
+    std::sort(fixIds.begin(), fixIds.end());
+    fixIds.erase(std::unique(fixIds.begin(), fixIds.end()), fixIds.end());
+    std::vector<std::unique_ptr<meshlab::IcpAligner>> aligners(fixIds.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < int(fixIds.size()); ++i)
+        aligners[i].reset(new meshlab::IcpAligner(meshTree.find(fixIds[i])->m->cm, ap.UseVertexOnly));
+
+    // the arcs are independent jobs: each one writes only its own result
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < int(jobs.size()); ++i)
+    {
+        ArcJob &j = jobs[i];
+        size_t a = std::lower_bound(fixIds.begin(), fixIds.end(), j.fix) - fixIds.begin();
+        alignArc(*aligners[a], meshTree.find(j.fix), meshTree.find(j.mov), ap, j.res);
+        j.res.area = j.area;
+    }
+    aligners.clear();
+
+    // merge the results in the tree, serially and in the grid order
+    for(ArcJob &j : jobs)
+    {
+        if(j.res.isValid())
+        {
+            std::pair<double, double> dd = j.res.computeAvgErr();
+            std::snprintf(buf, sizeof(buf), "(%3i/%3i) %4i -> %4i Area:%5.3f Err: %8.5f -> %8.5f\n",
+                          int(&j - jobs.data()) + 1, int(jobs.size()), j.fix, j.mov, j.area, dd.first, dd.second);
+        }
+        else
+            std::snprintf(buf, sizeof(buf), "(%3i/%3i) %4i -> %4i Area:%5.3f Failed: %s\n",
+                          int(&j - jobs.data()) + 1, int(jobs.size()), j.fix, j.mov, j.area, AlignPair::errorMsg(j.res.status));
+        meshTree.cb(0, buf);
+
+        AlignPair::Result *prev = meshTree.findResult(j.fix, j.mov);
+        if(prev != nullptr)
+            *prev = j.res;
+        else
+            meshTree.resultList.push_back(j.res);
+    }
+
+    int validNum = int(std::count_if(meshTree.resultList.begin(), meshTree.resultList.end(),
+                                     [](const AlignPair::Result &r) { return r.isValid(); }));
+    if(validNum == 0)
+        meshTree.cb(0, "\n Failure. No successful arc among the candidate ones.\n No good candidate alignment arcs. Nothing Done.\n");
+    return validNum;
+}
+
+bool EditAlignPlugin::alignArc(MeshTreem::MeshNode *fix, MeshTreem::MeshNode *mov, const AlignPair::Param &ap, AlignPair::Result &result) const
+{
+    meshlab::IcpAligner aligner(fix->m->cm, ap.UseVertexOnly);
+    return alignArc(aligner, fix, mov, ap, result);
+}
+
+bool EditAlignPlugin::alignArc(const meshlab::IcpAligner &aligner, MeshTreem::MeshNode *fix, MeshTreem::MeshNode *mov, const AlignPair::Param &ap, AlignPair::Result &result) const
+{
+    meshlab::IcpAligner::Param ip = defaultIcp;
+    AlignParameter::AlignPairParamToIcpParam(ap, ip);
+
+    // the samples are in the mov reference frame, the result maps them into the fix one
+    Matrix44d movToFix = Inverse(Matrix44d::Construct(fix->tr())) * Matrix44d::Construct(mov->tr());
+
+    std::vector<Point3m> movPoints, movNormals;
+    for(const CVertexO &v : mov->m->cm.vert)
+        if(!v.IsD())
+        {
+            movPoints.push_back(v.cP());
+            movNormals.push_back(Point3m(v.cN()).Normalize());
+        }
+
+    meshlab::IcpAligner::Result icp;
+    bool ok = aligner.align(movPoints, movNormals, movToFix, ip, icp);
+
+    result.FixName = fix->Id();
+    result.MovName = mov->Id();
+    result.ap = ap;
+    result.as.I.clear();
+    for(const meshlab::IcpAligner::IterInfo &it : icp.iterations)
+    {
+        AlignPair::Stat::IterInfo ii;
+        ii.MinDistAbs = it.minDistAbs;
+        ii.pcl50 = it.pcl50;
+        ii.SampleTested = it.sampleTested;
+        ii.SampleUsed = it.sampleUsed;
+        ii.DistanceDiscarded = it.distanceDiscarded;
+        ii.AngleDiscarded = it.angleDiscarded;
+        ii.BorderDiscarded = 0;
+        result.as.I.push_back(ii);
+    }
+    if(!ok)
+    {
+        result.status = AlignPair::TOO_FEW_POINTS;
+        return false;
+    }
+    result.Tr = icp.tr;
+    result.err = icp.err;
+    result.Pfix = icp.pFix;
+    result.Nfix = icp.nFix;
+    result.Pmov = icp.pMov;
+    result.Nmov = icp.nMov;
+    result.status = AlignPair::SUCCESS;
+    return true;
+}
+
 void EditAlignPlugin::mousePressEvent(QMouseEvent *e, MeshModel &, GLArea * )
 {
     if(mode==ALIGN_MOVE)
@@ -32,6 +32,7 @@
 
 #include <vcg/complex/algorithms/meshtree.h>
 #include <wrap/gui/trackball.h>
+#include <common/utilities/icp_aligner.h>
 #include "alignDialog.h"
 
 class EditAlignPlugin : public QObject, public EditTool
@@ -80,6 +81,14 @@ public:
 public:
 	vcg::AlignPair::Param defaultAP;  // default alignment parameters
 	MeshTreem::Param defaultMTP;  // default MeshTree parameters
+	meshlab::IcpAligner::Param defaultIcp;  // point to plane and sample levels used by the pairwise ICP
+
+	// pairwise ICP of the mov node on the fix node with the IcpAligner, the result is stored as an AlignPair one
+	bool alignArc(MeshTreem::MeshNode *fix, MeshTreem::MeshNode *mov, const vcg::AlignPair::Param &ap, vcg::AlignPair::Result &result) const;
+	// same as above, reusing an aligner already built on the fix node
+	bool alignArc(const meshlab::IcpAligner &aligner, MeshTreem::MeshNode *fix, MeshTreem::MeshNode *mov, const vcg::AlignPair::Param &ap, vcg::AlignPair::Result &result) const;
+	// finds the overlapping pairs of glued meshes and computes all their arcs concurrently; returns the number of valid arcs
+	int processArcs(const vcg::AlignPair::Param &ap, const MeshTreem::Param &mtp);
 
 	// this callback MUST be redefined because we are able to manage internally the layer change.
 	void layerChanged(MeshDocument & /*md*/, MeshModel & /*oldMeshModel*/, GLArea * /*parent*/, MLSceneGLSharedDataContext* )
@@ -79,6 +79,7 @@ public:
 
 private:
 	AlignSet align;
+	QImage alignImage; // pixels of the current raster, read by align
 
 public slots:
     void addNewPoint();
@@ -22,6 +22,7 @@
 ****************************************************************************/
 
 #include <common/GLExtensionsManager.h>
+#include <common/utilities/mesh_bvh.h>
 #include "filter_ao.h"
 #include <QGLFramebufferObject>
 #include <QElapsedTimer>
@@ -30,13 +31,16 @@
 
 #include <wrap/qt/checkGLError.h>
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <random>
 
 #define AMBOCC_MAX_TEXTURE_SIZE 2048
 #define AMBOCC_DEFAULT_TEXTURE_SIZE 512
 #define AMBOCC_DEFAULT_NUM_VIEWS 128
 #define AMBOCC_USEGPU_BY_DEFAULT false
+#define AMBOCC_USERAYTRACING_BY_DEFAULT false
 #define AMBOCC_USEVBO_BY_DEFAULT true
 
 using namespace std;
@@ -92,7 +96,7 @@ QString AmbientOcclusionPlugin::filterInfo(ActionIDType filterId) const
 {
 	switch(filterId) {
 	case FP_AMBIENT_OCCLUSION: 
-		return QString("Compute ambient occlusions values; it takes a number of well distributed view direction and for point of the surface it computes how many time it is visible from these directions. This value is saved into quality and automatically mapped into a gray shade. The average direction is saved into an attribute named 'BentNormal'");
+		return QString("Compute ambient occlusions values; it takes a number of well distributed view direction and for point of the surface it computes how many time it is visible from these directions. This value is saved into quality and automatically mapped into a gray shade. The average direction is saved into an attribute named 'BentNormal'.<br>The visibility can be computed either with OpenGL depth maps or by casting rays on the CPU, which does not depend on the graphics hardware.");
 	default : assert(0);
 	}
 	return QString("");
@@ -143,6 +147,7 @@ RichParameterList AmbientOcclusionPlugin::initParameterList(const QAction *actio
 			parlst.addParam(RichDirection("coneDir",Point3m(0,1,0),"Lighting Direction", "Number of different views placed around the mesh. More views means better accuracy at the cost of increased calculation time"));
 			parlst.addParam(RichFloat("coneAngle",30,"Cone amplitude", "Number of different views uniformly placed around the mesh. More views means better accuracy at the cost of increased calculation time"));
 			parlst.addParam(RichBool("useGPU",AMBOCC_USEGPU_BY_DEFAULT,"Use GPU acceleration","Only works for per-vertex AO. In order to use GPU-Mode, your hardware must support FBOs, FP32 Textures and Shaders. Normally increases the performance by a factor of 4x-5x"));
+			parlst.addParam(RichBool("useRayTracing",AMBOCC_USERAYTRACING_BY_DEFAULT,"Use CPU ray tracing","Compute the occlusion by casting rays on the CPU, on all the available cores, instead of rendering the mesh with OpenGL. It gives the same results and it is the fastest choice when only a software OpenGL implementation is available (e.g. on headless machines). When enabled, GPU acceleration and depth texture size are ignored."));
 			//parlst.addParam(RichBool("useVBO",AMBOCC_USEVBO_BY_DEFAULT,"Use VBO if supported","By using VBO, Meshlab loads all the vertex structure in the VRam, greatly increasing rendering speed (for both CPU and GPU mode). Disable it if problem occurs"));
 			parlst.addParam(RichInt ("depthTexSize",AMBOCC_DEFAULT_TEXTURE_SIZE,"Depth texture size(should be 2^n)", "Defines the depth texture size used to compute occlusion from each point of view. Higher values means better accuracy usually with low impact on performance"));
 		break;
@@ -154,7 +159,8 @@ RichParameterList AmbientOcclusionPlugin::initParameterList(const QAction *actio
 std::map<std::string, QVariant> AmbientOcclusionPlugin::applyFilter(const QAction * filter, const RichParameterList & par, MeshDocument &md, unsigned int& /*postConditionMask*/, vcg::CallBackPos *cb)
 {
 	if (ID(filter) == FP_AMBIENT_OCCLUSION) {
-		if (glContext != nullptr) {
+		bool useRayTracing = par.getBool("useRayTracing");
+		if (glContext != nullptr || useRayTracing) {
 			MeshModel &m=*(md.mm());
 
 			int occlusionMode = par.getEnum("occMode");
@@ -199,6 +205,11 @@ std::map<std::string, QVariant> AmbientOcclusionPlugin::applyFilter(const QActio
 			viewDirVec.insert(viewDirVec.end(),coneDirVec.begin(),coneDirVec.begin()+coneNum);
 			numViews = viewDirVec.size();
 
+			if (useRayTracing) {
+				processRayTracing(m, viewDirVec, cb);
+				return std::map<std::string, QVariant>();
+			}
+
 			this->glContext->makeCurrent();
 			this->initGL(cb,m.cm.vn);
 			unsigned int widgetSize = std::min(maxTexSize, depthTexSize);
@@ -418,6 +429,85 @@ bool AmbientOcclusionPlugin::processGL(MeshModel &m, vector<Point3f> &posVect)
     return true;
 }
 
+/* CPU version of processGL: for each vertex (face) and direction, a ray is cast
+ * from the vertex (face barycenter) toward the direction. The results are the
+ * same of the depth map test done by processGL, without its discretization. */
+bool AmbientOcclusionPlugin::processRayTracing(MeshModel &m, std::vector<vcg::Point3f> &posVect, vcg::CallBackPos *cb)
+{
+	QElapsedTimer tInit, tAll;
+	tInit.start();
+	tAll.start();
+
+	vcg::tri::Allocator<CMeshO>::CompactVertexVector(m.cm);
+	vcg::tri::Allocator<CMeshO>::CompactFaceVector(m.cm);
+	vcg::tri::UpdateNormal<CMeshO>::PerVertexNormalizedPerFaceNormalized(m.cm);
+	tri::UpdateBounding<CMeshO>::Box(m.cm);
+
+	cb(0, "Building the bounding volume hierarchy");
+	meshlab::MeshBVH bvh(m.cm);
+	int tInitElapsed = tInit.elapsed();
+
+	std::vector<Point3m> dirs(posVect.size());
+	for (size_t j = 0; j < posVect.size(); ++j)
+		dirs[j] = Point3m::Construct(posVect[j]).Normalize();
+
+	// skip the surface where the rays start
+	const Scalarm eps = m.cm.bbox.Diag() * 1e-5;
+	const Scalarm tMax = std::numeric_limits<Scalarm>::max();
+
+	// occlusion of the point p with normal n, accumulated in q and bn
+	auto occlusion = [&](const Point3m& p, const Point3m& n, Scalarm& q, Point3m& bn) {
+		q = 0;
+		bn = Point3m(0, 0, 0);
+		for (const Point3m& d : dirs) {
+			if (!bvh.anyHit(p, d, eps, tMax)) {
+				q += std::max<Scalarm>(n * d, 0);
+				bn += d;
+			}
+		}
+	};
+
+	const int n = perFace ? m.cm.face.size() : m.cm.vert.size();
+	const int chunkSize = std::max(1024, n / 100);
+	if (perFace) {
+		CMeshO::PerFaceAttributeHandle<Point3m> FBN = tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3m>(m.cm, "BentNormal");
+		for (int begin = 0; begin < n; begin += chunkSize) {
+			cb(100 * begin / n, "Casting rays");
+			const int end = std::min(n, begin + chunkSize);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (int i = begin; i < end; ++i) {
+				CFaceO& f = m.cm.face[i];
+				occlusion(Barycenter(f), f.cN(), f.Q(), FBN[i]);
+			}
+		}
+		tri::UpdateColor<CMeshO>::PerFaceQualityGray(m.cm);
+		for (CMeshO::FaceIterator fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi) {
+			(*fi).Q() = (*fi).Q() / numViews;
+			FBN[fi].Normalize();
+		}
+	}
+	else {
+		CMeshO::PerVertexAttributeHandle<Point3m> BN = tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3m>(m.cm, "BentNormal");
+		for (int begin = 0; begin < n; begin += chunkSize) {
+			cb(100 * begin / n, "Casting rays");
+			const int end = std::min(n, begin + chunkSize);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (int i = begin; i < end; ++i) {
+				CVertexO& v = m.cm.vert[i];
+				occlusion(v.cP(), v.cN(), v.Q(), BN[i]);
+			}
+		}
+		tri::UpdateColor<CMeshO>::PerVertexQualityGray(m.cm,0.0f,0.0f);
+		for (CMeshO::VertexIterator vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi) {
+			(*vi).Q() = (*vi).Q() / numViews;
+			BN[vi].Normalize();
+		}
+	}
+
+	log(GLLogStream::SYSTEM,"Successfully calculated A.O. after %3.2f sec, %3.2f of which is due to initialization", ((float)tAll.elapsed()/1000.0f), ((float)tInitElapsed/1000.0f) );
+	return true;
+}
+
 void AmbientOcclusionPlugin::initGL(vcg::CallBackPos *cb, unsigned int numVertices)
 {
     //******* INIT GLEW ********/
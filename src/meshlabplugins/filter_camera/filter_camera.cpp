@@ -575,9 +575,10 @@ std::map<std::string, QVariant> FilterCameraPlugin::applyFilter(const QAction *f
 		}
 		Shotm shotGot=par.getShotf("Shot");
 		currentRaster->shot = shotGot;
-		float ratio=(float)currentRaster->currentPlane->image.height()/(float)shotGot.Intrinsics.ViewportPx[1];
-		currentRaster->shot.Intrinsics.ViewportPx[0]=currentRaster->currentPlane->image.width();
-		currentRaster->shot.Intrinsics.ViewportPx[1]=currentRaster->currentPlane->image.height();
+		const QSize imgSize = currentRaster->currentPlane->size();
+		float ratio=(float)imgSize.height()/(float)shotGot.Intrinsics.ViewportPx[1];
+		currentRaster->shot.Intrinsics.ViewportPx[0]=imgSize.width();
+		currentRaster->shot.Intrinsics.ViewportPx[1]=imgSize.height();
 		currentRaster->shot.Intrinsics.PixelSizeMm[1]/=ratio;
 		currentRaster->shot.Intrinsics.PixelSizeMm[0]/=ratio;
 		currentRaster->shot.Intrinsics.CenterPx[0]=(int)((float)currentRaster->shot.Intrinsics.ViewportPx[0]/2.0);
@@ -702,6 +703,15 @@ FilterCameraPlugin::FilterClass FilterCameraPlugin::getClass(const QAction *a) c
 	return FilterPlugin::Camera;
 }
 
+/**
+ * @brief Camera filters only need the size of the rasters, their pixels can
+ * stay out of core.
+ */
+bool FilterCameraPlugin::requiresRasterPixels(const QAction*) const
+{
+	return false;
+}
+
 int FilterCameraPlugin::getPreConditions(const QAction * a) const
 {
 	switch (ID(a))
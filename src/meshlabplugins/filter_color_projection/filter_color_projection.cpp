@@ -23,9 +23,12 @@
 
 #include <QFileDialog>
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <utility>
+#include <vector>
 
 #include <vcg/space/colorspace.h>
 
@@ -55,6 +58,140 @@ static QString extractFilenameWOExt(const MeshModel* mm)
 	QFileInfo fi(mm->fullName());
 	return fi.baseName();
 }
+
+// weighting options of the multi raster projections
+struct ProjectionWeighting
+{
+	Scalarm eta;
+	bool    useangle;
+	bool    usedistance;
+	bool    useborders;
+	bool    usesilhouettes;
+	bool    usealphamask;
+	float   allcammindepth;
+	float   allcammaxdepth;
+};
+
+// accumulates the colors of a single raster on the points, using a software depth buffer
+static void accumulateRasterCPU(
+	const RasterModel&          raster,
+	const CMeshO&               m,
+	const std::vector<Point3m>& points,
+	const std::vector<Point3m>& normals,
+	const ProjectionWeighting&  pw,
+	std::vector<TexelAccum>&    accums)
+{
+	// images that are not in memory are decoded through the raster plane cache
+	const QImage image = raster.currentPlane->pixels();
+	if (image.isNull())
+		return;
+
+	floatbuffer depthbuf;
+	RenderHelper::renderDepthCPU(raster.shot, m, depthbuf);
+
+	floatbuffer silhouette_buff;
+	float       maxsildist = depthbuf.sx + depthbuf.sy;
+	if (pw.usesilhouettes) {
+		silhouette_buff.init(depthbuf.sx, depthbuf.sy);
+		silhouette_buff.applysobel(&depthbuf);
+		silhouette_buff.initborder(&depthbuf);
+		maxsildist = silhouette_buff.distancefield();
+	}
+
+	const int vpw = raster.shot.Intrinsics.ViewportPx[0];
+	const int vph = raster.shot.Intrinsics.ViewportPx[1];
+	for (size_t i = 0; i < points.size(); i++) {
+		Point2m pp = raster.shot.Project(points[i]);
+		// pray is the vector from the point-to-be-colored to the camera center
+		Point3m pray = (raster.shot.GetViewPoint() - points[i]).Normalize();
+
+		if (pp[0] < 0 || pp[1] < 0 || pp[0] >= vpw || pp[1] >= vph)
+			continue;
+		if ((pray.dot(-raster.shot.Axis(2))) > 0.0)
+			continue;
+
+		Scalarm depth  = raster.shot.Depth(points[i]);
+		Scalarm pdepth = depthbuf.getval(int(pp[0]), int(pp[1]));
+		if (depth > (pdepth + pw.eta))
+			continue;
+
+		int  iy     = std::min(image.height() - 1, std::max(0, int(vph - pp[1])));
+		int  ix     = std::min(image.width() - 1, int(pp[0]));
+		QRgb pcolor = image.pixel(ix, iy);
+
+		double pweight = 1.0;
+		if (pw.useangle) {
+			Point3m pixnorm  = normals[i];
+			Point3m viewaxis = raster.shot.GetViewPoint() - points[i];
+			pixnorm.Normalize();
+			viewaxis.Normalize();
+			pweight *= std::min(1.0f, float(std::abs(pixnorm * viewaxis)));
+		}
+		if (pw.usedistance) {
+			float distw = 1.0 - (depth - (pw.allcammindepth * 0.99)) /
+									((pw.allcammaxdepth * 1.01) - (pw.allcammindepth * 0.99));
+			pweight *= distw * distw;
+		}
+		if (pw.useborders) {
+			double xdist = 1.0 - (std::abs(pp[0] - (vpw / 2.0)) / (vpw / 2.0));
+			double ydist = 1.0 - (std::abs(pp[1] - (vph / 2.0)) / (vph / 2.0));
+			pweight *= std::min(xdist, ydist);
+		}
+		if (pw.usesilhouettes)
+			pweight *= silhouette_buff.getval(int(pp[0]), int(pp[1])) / maxsildist;
+		if (pw.usealphamask)
+			pweight *= (qAlpha(pcolor) / 255.0);
+
+		accums[i].weights += pweight;
+		accums[i].acc_red += (qRed(pcolor) * pweight / 255.0);
+		accums[i].acc_grn += (qGreen(pcolor) * pweight / 255.0);
+		accums[i].acc_blu += (qBlue(pcolor) * pweight / 255.0);
+	}
+}
+
+// Projects all the visible rasters with a valid shot on the points, adding to accums.
+// Rasters are processed concurrently; every thread accumulates in its own buffer and
+// the buffers are summed at the end.
+static void projectRastersCPU(
+	MeshDocument&               md,
+	const CMeshO&               m,
+	const std::vector<Point3m>& points,
+	const std::vector<Point3m>& normals,
+	const ProjectionWeighting&  pw,
+	std::vector<TexelAccum>&    accums)
+{
+	std::vector<const RasterModel*> rasters;
+	for (const RasterModel& raster : md.rasterIterator())
+		if (raster.isVisible() && raster.shot.IsValid() && raster.currentPlane != nullptr)
+			rasters.push_back(&raster);
+
+	std::vector<std::vector<TexelAccum>> threadAccums;
+#pragma omp parallel
+	{
+		std::vector<TexelAccum> local;
+#pragma omp for schedule(dynamic, 1) nowait
+		for (int r = 0; r < int(rasters.size()); r++) {
+			if (local.empty())
+				local.resize(points.size(), TexelAccum {0, 0, 0, 0});
+			accumulateRasterCPU(*rasters[r], m, points, normals, pw, local);
+		}
+#pragma omp critical
+		{
+			if (!local.empty())
+				threadAccums.push_back(std::move(local));
+		}
+	}
+
+#pragma omp parallel for
+	for (int i = 0; i < int(points.size()); i++) {
+		for (const std::vector<TexelAccum>& local : threadAccums) {
+			accums[i].weights += local[i].weights;
+			accums[i].acc_red += local[i].acc_red;
+			accums[i].acc_grn += local[i].acc_grn;
+			accums[i].acc_blu += local[i].acc_blu;
+		}
+	}
+}
 //-----------------------------------------
 
 // Constructor
@@ -127,17 +264,24 @@ int FilterColorProjectionPlugin::getRequirements(const QAction* action)
 	return 0;
 }
 
+// the multi image projections fall back to the CPU path without a glContext
 bool FilterColorProjectionPlugin::requiresGLContext(const QAction* action) const
 {
 	switch (ID(action)) {
-	case FP_SINGLEIMAGEPROJ:
+	case FP_SINGLEIMAGEPROJ: return true;
 	case FP_MULTIIMAGETRIVIALPROJ:
-	case FP_MULTIIMAGETRIVIALPROJTEXTURE: return true;
+	case FP_MULTIIMAGETRIVIALPROJTEXTURE: return false;
 	default: assert(0);
 	}
 	return false;
 }
 
+// rasters are decoded one at a time through RasterPlane::pixels()
+bool FilterColorProjectionPlugin::requiresRasterPixels(const QAction*) const
+{
+	return false;
+}
+
 // This function define the needed parameters for each filter.
 RichParameterList
 FilterColorProjectionPlugin::initParameterList(const QAction* action, const MeshDocument& md)
@@ -209,6 +353,14 @@ FilterColorProjectionPlugin::initParameterList(const QAction* action, const Mesh
 			"possible to mask-out parts of the images that should not be projected on the mesh. "
 			"Please note this is not a transparency effect, but just influences the weigthing "
 			"between different images"));
+		parlst.addParam(RichBool(
+			"usecpu",
+			false,
+			"CPU projection",
+			"If true, visibility is computed on a software depth buffer and the rasters are "
+			"projected concurrently, without using OpenGL. Images that are not in memory are "
+			"loaded from disk one at a time per thread. It is always used when no OpenGL "
+			"context is available"));
 		QColor color1 = QColor(0, 0, 0, 255);
 		parlst.addParam(RichColor(
 			"blankColor",
@@ -274,6 +426,14 @@ FilterColorProjectionPlugin::initParameterList(const QAction* action, const Mesh
 			"possible to mask-out parts of the images that should not be projected on the mesh. "
 			"Please note this is not a transparency effect, but just influences the weigthing "
 			"between different images"));
+		parlst.addParam(RichBool(
+			"usecpu",
+			false,
+			"CPU projection",
+			"If true, visibility is computed on a software depth buffer and the rasters are "
+			"projected concurrently, without using OpenGL. Images that are not in memory are "
+			"loaded from disk one at a time per thread. It is always used when no OpenGL "
+			"context is available"));
 	} break;
 
 	default: break; // do not add any parameter for the other filters
@@ -289,7 +449,8 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 	unsigned int& /*postConditionMask*/,
 	vcg::CallBackPos* cb)
 {
-	if (glContext != nullptr) {
+	bool usecpu = (ID(filter) != FP_SINGLEIMAGEPROJ) && (par.getBool("usecpu") || glContext == nullptr);
+	if (glContext != nullptr || usecpu) {
 		// CMeshO::FaceIterator fi;
 		CMeshO::VertexIterator vi;
 
@@ -347,6 +508,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 				"Viewport %i %i",
 				raster->shot.Intrinsics.ViewportPx[0],
 				raster->shot.Intrinsics.ViewportPx[1]);
+			const QImage rasterImage = raster->currentPlane->pixels();
 			for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
 				if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
 					Point2m pp = raster->shot.Project((*vi).P());
@@ -371,7 +533,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							}
 
 							if (!use_depth || (depth <= (pdepth + eta))) {
-								QRgb pcolor = raster->currentPlane->image.pixel(
+								QRgb pcolor = rasterImage.pixel(
 									pp[0], raster->shot.Intrinsics.ViewportPx[1] - pp[1]);
 								(*vi).C() =
 									vcg::Color4b(qRed(pcolor), qGreen(pcolor), qBlue(pcolor), 255);
@@ -467,10 +629,34 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 				cam_ind++;
 			}
 
-			//-- cycle all cameras
+			if (usecpu) {
+				ProjectionWeighting pw = {eta, useangle, usedistance, useborders, usesilhouettes,
+										  usealphamask, allcammindepth, allcammaxdepth};
+				std::vector<Point3m> points, normals;
+				std::vector<int>     pointind;
+				buff_ind = 0;
+				for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi, ++buff_ind) {
+					if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
+						points.push_back((*vi).P());
+						normals.push_back((*vi).N());
+						pointind.push_back(buff_ind);
+					}
+				}
+				std::vector<TexelAccum> accums(points.size(), TexelAccum {0, 0, 0, 0});
+				cb(10, "Projecting rasters...");
+				projectRastersCPU(md, model->cm, points, normals, pw, accums);
+				for (size_t i = 0; i < pointind.size(); i++) {
+					weights[pointind[i]] = accums[i].weights;
+					acc_red[pointind[i]] = accums[i].acc_red;
+					acc_grn[pointind[i]] = accums[i].acc_grn;
+					acc_blu[pointind[i]] = accums[i].acc_blu;
+				}
+			}
+
+			//-- cycle all cameras, the CPU projection has already done them all
 			cam_ind = 0;
 			for (const RasterModel& raster : md.rasterIterator()) {
-				if (raster.isVisible()) {
+				if (raster.isVisible() && !usecpu) {
 					do_project = true;
 
 					// no drawing if camera not valid
@@ -536,6 +722,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							// silhouette_buff->dumppfm(dumpFileName);
 						}
 
+						const QImage rasterImage = raster.currentPlane->pixels();
 						for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
 							if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
 								// pp is the projected point in image space
@@ -558,7 +745,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 
 										if (depth <= (pdepth + eta)) {
 											// determine color
-											QRgb pcolor = raster.currentPlane->image.pixel(
+											QRgb pcolor = rasterImage.pixel(
 												pp[0],
 												raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
 											// determine weight
@@ -801,10 +988,22 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 				cam_ind++;
 			}
 
-			//-- cycle all cameras
+			if (usecpu) {
+				ProjectionWeighting pw = {eta, useangle, usedistance, useborders, usesilhouettes,
+										  usealphamask, allcammindepth, allcammaxdepth};
+				std::vector<Point3m> points(texels.size()), normals(texels.size());
+				for (size_t texcount = 0; texcount < texels.size(); texcount++) {
+					points[texcount]  = texels[texcount].meshpoint;
+					normals[texcount] = texels[texcount].meshnormal;
+				}
+				cb(82, "Projecting rasters...");
+				projectRastersCPU(md, model->cm, points, normals, pw, accums);
+			}
+
+			//-- cycle all cameras, the CPU projection has already done them all
 			cam_ind = 0;
 			for (const RasterModel& raster : md.rasterIterator()) {
-				if (raster.isVisible()) {
+				if (raster.isVisible() && !usecpu) {
 					do_project = true;
 
 					// no drawing if camera not valid
@@ -868,6 +1067,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							// silhouette_buff->dumpbmp(dumpFileName);
 						}
 
+						const QImage rasterImage = raster.currentPlane->pixels();
 						for (size_t texcount = 0; texcount < texels.size(); texcount++) {
 							Point2m pp = raster.shot.Project(texels[texcount].meshpoint);
 							// pray is the vector from the point-to-be-colored to the camera center
@@ -888,7 +1088,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 
 									if (depth <= (pdepth + eta)) {
 										// determine color
-										QRgb pcolor = raster.currentPlane->image.pixel(
+										QRgb pcolor = rasterImage.pixel(
 											pp[0], raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
 										// determine weight
 										pweight = 1.0;
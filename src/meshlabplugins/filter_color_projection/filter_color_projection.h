@@ -48,6 +48,7 @@ class FilterColorProjectionPlugin : public QObject, public FilterPlugin
 	RichParameterList initParameterList(const QAction*, const MeshDocument &/*m*/);
 	int getRequirements(const QAction*);
 	bool requiresGLContext(const QAction* action) const;
+	bool requiresRasterPixels(const QAction* action) const;
 	std::map<std::string, QVariant> applyFilter(const QAction* action, const RichParameterList & /*parent*/, MeshDocument &md, unsigned int& postConditionMask, vcg::CallBackPos * cb);
 
 	FilterArity filterArity(const QAction *) const {return SINGLE_MESH;}
@@ -28,6 +28,10 @@
 #include <QGLContext>
 #include <QGLFramebufferObject>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "render_helper.h"
 
 using namespace std;
@@ -341,6 +345,71 @@ void RenderHelper::renderScene(const Shotm &view, MeshModel *mesh, RenderingMode
 }
 
 
+// Same content of the depth read back by renderScene: eye space depth in world units, 0 on the background,
+// rows stored bottom-up. Faces crossing the camera plane are skipped instead of being clipped.
+void RenderHelper::renderDepthCPU(const Shotm &view, const CMeshO &m, floatbuffer &depthbuf)
+{
+  int wt = view.Intrinsics.ViewportPx[0];
+  int ht = view.Intrinsics.ViewportPx[1];
+
+  depthbuf.init(wt, ht);
+  depthbuf.fillwith(0);
+
+  // window position and depth of every vertex
+  std::vector<vcg::Point3f> win(m.vert.size());
+  for(size_t i = 0; i < m.vert.size(); i++)
+  {
+    if(m.vert[i].IsD()) { win[i] = vcg::Point3f(0, 0, -1); continue; }
+    Point2m pp = view.Project(m.vert[i].cP());
+    win[i] = vcg::Point3f(pp[0], pp[1], view.Depth(m.vert[i].cP()));
+  }
+
+  if(m.fn == 0)
+  {
+    for(size_t i = 0; i < win.size(); i++)
+    {
+      int x = int(win[i][0]), y = int(win[i][1]);
+      if(win[i][2] <= 0 || x < 0 || y < 0 || x >= wt || y >= ht) continue;
+      float &d = depthbuf.data[y*wt + x];
+      if(d == 0 || win[i][2] < d) d = win[i][2];
+    }
+    return;
+  }
+
+  for(const CFaceO &f : m.face)
+  {
+    if(f.IsD()) continue;
+    const vcg::Point3f &p0 = win[f.cV(0) - &m.vert[0]];
+    const vcg::Point3f &p1 = win[f.cV(1) - &m.vert[0]];
+    const vcg::Point3f &p2 = win[f.cV(2) - &m.vert[0]];
+    if(p0[2] <= 0 || p1[2] <= 0 || p2[2] <= 0) continue;
+
+    float area = (p1[0]-p0[0])*(p2[1]-p0[1]) - (p2[0]-p0[0])*(p1[1]-p0[1]);
+    if(std::fabs(area) < 1e-12f) continue;
+    int xmin = std::max(0, int(std::floor(std::min(p0[0], std::min(p1[0], p2[0])))));
+    int xmax = std::min(wt - 1, int(std::ceil(std::max(p0[0], std::max(p1[0], p2[0])))));
+    int ymin = std::max(0, int(std::floor(std::min(p0[1], std::min(p1[1], p2[1])))));
+    int ymax = std::min(ht - 1, int(std::ceil(std::max(p0[1], std::max(p1[1], p2[1])))));
+
+    for(int y = ymin; y <= ymax; y++)
+    {
+      float py = y + 0.5f;
+      for(int x = xmin; x <= xmax; x++)
+      {
+        float px = x + 0.5f;
+        float w0 = ((p1[0]-px)*(p2[1]-py) - (p2[0]-px)*(p1[1]-py))/area;
+        float w1 = ((p2[0]-px)*(p0[1]-py) - (p0[0]-px)*(p2[1]-py))/area;
+        float w2 = 1 - w0 - w1;
+        if(w0 < 0 || w1 < 0 || w2 < 0) continue;
+        // 1/depth is linear in screen space
+        float z = 1.0f/(w0/p0[2] + w1/p1[2] + w2/p2[2]);
+        float &d = depthbuf.data[y*wt + x];
+        if(d == 0 || z < d) d = z;
+      }
+    }
+  }
+}
+
 //-------------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------------
 
@@ -65,6 +65,9 @@ class RenderHelper {
   // draw & readback
   void renderScene(const Shotm& view, MeshModel *mesh, RenderingMode mode, MLPluginGLContext* plugcontext, float camNear = 0, float camFar = 0);
 
+  // software depth buffer, no GL context needed
+  static void renderDepthCPU(const Shotm& view, const CMeshO &m, floatbuffer &depthbuf);
+
  private:
 
   GLuint createShaderFromFiles(QString basename); // converted into shader/basename.vert .frag
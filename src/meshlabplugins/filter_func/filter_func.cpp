@@ -25,10 +25,13 @@
 #include <vcg/complex/algorithms/create/platonic.h>
 
 #include <vcg/complex/algorithms/create/marching_cubes.h>
-#include <vcg/complex/algorithms/create/mc_trivial_walker.h>
 
 #include "muParser.h"
 #include "string_conversion.h"
+#include "tiled_marching_cubes.h"
+
+#include <limits>
+#include <memory>
 
 using namespace mu;
 using namespace vcg;
@@ -247,7 +250,9 @@ QString FilterFunctionPlugin::filterInfo(ActionIDType filterId) const
 	case FF_ISOSURFACE:
 		return tr(
 			"Generate a new mesh that corresponds to the 0 valued isosurface defined by the scalar "
-			"field generated by the given expression");
+			"field generated by the given expression.<br>"
+			"The field is sampled and polygonized in tiles, in parallel, so the whole grid is "
+			"never stored in memory.");
 
 	case FF_REFINE:
 		return tr("Refine current mesh with user defined parameters.<br>"
@@ -650,6 +655,14 @@ RichParameterList FilterFunctionPlugin::initParameterList(const QAction* action,
 			"Function =",
 			"This expression is evaluated for each voxel of the grid. The surface passing through "
 			"the zero valued points of this field is then extracted using marching cube."));
+		parlst.addParam(RichBool(
+			"skipEmpty",
+			false,
+			"Skip empty regions",
+			"The field is first sampled on a coarser grid, and the regions where it is far from "
+			"zero, with respect to its variation on the coarse grid, are not sampled at full "
+			"resolution. Much faster for large grids, but thin features that fall between the "
+			"coarse samples can be missed."));
 
 		break;
 
@@ -1506,13 +1519,7 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		m.updateBoxAndNormals();
 	} break;
 	case FF_ISOSURFACE: {
-		SimpleVolume<SimpleVoxel<float>> volume;
-
-		typedef vcg::tri::TrivialWalker<CMeshO, SimpleVolume<SimpleVoxel<float>>> MyWalker;
-		typedef vcg::tri::MarchingCubes<CMeshO, MyWalker>                         MyMarchingCubes;
-		MyWalker                                                                  walker;
-
-		Box3f RangeBBox;
+		Box3m RangeBBox;
 		RangeBBox.min[0] = par.getFloat("minX");
 		RangeBBox.min[1] = par.getFloat("minY");
 		RangeBBox.min[2] = par.getFloat("minZ");
@@ -1521,39 +1528,64 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		RangeBBox.max[2] = par.getFloat("maxZ");
 		double  step     = par.getFloat("voxelSize");
 		Point3i siz      = Point3i::Construct((RangeBBox.max - RangeBBox.min) * (1.0 / step));
-
-		Parser p;
-		double x, y, z;
-		p.DefineVar(conversion::fromStringToWString("x"), &x);
-		p.DefineVar(conversion::fromStringToWString("y"), &y);
-		p.DefineVar(conversion::fromStringToWString("z"), &z);
 		std::string expr = par.getString("expr").toStdString();
-		p.SetExpr(conversion::fromStringToWString(expr));
-		log("Filling a Volume of %i %i %i", siz[0], siz[1], siz[2]);
-		volume.Init(siz, RangeBBox);
-		for (double i = 0; i < siz[0]; i++)
-			for (double j = 0; j < siz[1]; j++)
-				for (double k = 0; k < siz[2]; k++) {
-					x = RangeBBox.min[0] + step * i;
-					y = RangeBBox.min[1] + step * j;
-					z = RangeBBox.min[2] + step * k;
-					try {
-						volume.Val(i, j, k) = p.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-					}
+
+		// muparser instances are not thread safe: each thread has its own one
+		struct FieldParser
+		{
+			Parser p;
+			double x, y, z;
+		};
+		auto makeParser = [&expr]() {
+			std::shared_ptr<FieldParser> fp = std::make_shared<FieldParser>();
+			fp->p.DefineVar(conversion::fromStringToWString("x"), &fp->x);
+			fp->p.DefineVar(conversion::fromStringToWString("y"), &fp->y);
+			fp->p.DefineVar(conversion::fromStringToWString("z"), &fp->z);
+			fp->p.SetExpr(conversion::fromStringToWString(expr));
+			return fp;
+		};
+
+		// check the expression before starting the threads
+		try {
+			std::shared_ptr<FieldParser> fp = makeParser();
+			fp->x = RangeBBox.min[0];
+			fp->y = RangeBBox.min[1];
+			fp->z = RangeBBox.min[2];
+			fp->p.Eval();
+		}
+		catch (Parser::exception_type& e) {
+			throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
+		}
+
+		std::string errorMessage;
+		auto makeField = [&]() -> tri::TiledImplicitWalker<CMeshO>::Field {
+			std::shared_ptr<FieldParser> fp = makeParser();
+			return [fp, &errorMessage](const Point3m& pos) -> float {
+				fp->x = pos[0];
+				fp->y = pos[1];
+				fp->z = pos[2];
+				try {
+					return fp->p.Eval();
 				}
+				catch (Parser::exception_type& e) {
+#pragma omp critical
+					if (errorMessage.empty())
+						errorMessage = conversion::fromWStringToString(e.GetMsg());
+					return std::numeric_limits<float>::quiet_NaN();
+				}
+			};
+		};
 
 		// MARCHING CUBES
-		log("[MARCHING CUBES] Building mesh...");
-		MyMarchingCubes mc(m.cm, walker);
-		walker.BuildMesh<MyMarchingCubes>(m.cm, volume, mc, 0);
-		//    Matrix44m tr; tr.SetIdentity(); tr.SetTranslate(rbb.min[0],rbb.min[1],rbb.min[2]);
-		//    Matrix44m sc; sc.SetIdentity(); sc.SetScale(step,step,step);
-		//    tr=tr*sc;
-
-		//    tri::UpdatePosition<CMeshO>::Matrix(m.cm,tr);
+		log("Sampling a Volume of %i %i %i in tiles", siz[0], siz[1], siz[2]);
+		tri::TiledImplicitWalker<CMeshO> walker(RangeBBox, step, siz);
+		walker.SkipEmpty = par.getBool("skipEmpty");
+		int skipped      = walker.BuildMesh(m.cm, makeField, cb);
+		if (!errorMessage.empty())
+			throw MLException(errorMessage.c_str());
+		if (walker.SkipEmpty)
+			log("%i empty tiles skipped", skipped);
+
 		tri::UpdateNormal<CMeshO>::PerVertexNormalizedPerFace(m.cm);
 		tri::UpdateBounding<CMeshO>::Box(m.cm); // updates bounding box
 
@@ -0,0 +1,341 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_FUNC_TILED_MARCHING_CUBES_H
+#define FILTER_FUNC_TILED_MARCHING_CUBES_H
+
+#include <vcg/space/point3.h>
+#include <vcg/space/box3.h>
+#include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace vcg {
+namespace tri {
+
+/*
+ * Marching cubes of a scalar field sampled on a regular grid of siz samples
+ * (the sample (i,j,k) is at box.min + step*(i,j,k)).
+ *
+ * The grid is processed in tiles of TileSize^3 cells, concurrently: each tile
+ * samples the field in its own buffer and is polygonized in its own mesh, so
+ * the whole grid is never stored. The vertices are identified by the global
+ * id of the grid edge they lie on, which allows to weld the seams exactly
+ * when the tile meshes are merged.
+ *
+ * With SkipEmpty, each tile is first sampled on a coarse lattice (one sample
+ * every CoarseStride): if there is no sign change and the distance from zero
+ * is larger than twice what the field variation between the coarse samples
+ * allows, the tile is considered empty and is not sampled at full resolution.
+ * Cells with a non finite corner value are not polygonized.
+ */
+template <class MeshType>
+class TiledImplicitWalker
+{
+public:
+	typedef typename MeshType::ScalarType    ScalarType;
+	typedef typename MeshType::CoordType     CoordType;
+	typedef typename MeshType::VertexPointer VertexPointer;
+	typedef long long unsigned int           Key;
+
+	/* evaluator of the field; each thread gets its own one from a FieldFactory */
+	typedef std::function<float(const CoordType&)> Field;
+	typedef std::function<Field()>                 FieldFactory;
+
+	int  TileSize     = 32;
+	int  CoarseStride = 4;
+	bool SkipEmpty    = false;
+
+	TiledImplicitWalker(const Box3<ScalarType>& box, ScalarType step, const Point3i& siz) :
+			mBox(box), mStep(step), mSiz(siz)
+	{
+	}
+
+	/* returns the number of tiles skipped as empty */
+	int BuildMesh(MeshType& mesh, const FieldFactory& makeField, CallBackPos* cb = 0)
+	{
+		mesh.Clear();
+		if (mSiz[0] < 2 || mSiz[1] < 2 || mSiz[2] < 2)
+			return 0;
+
+		Point3i nofTiles;
+		for (int k = 0; k < 3; ++k)
+			nofTiles[k] = (mSiz[k] - 2) / TileSize + 1;
+
+		// tiles are processed one layer at a time, the tiles of a layer concurrently
+		const int        tilesPerLayer = nofTiles[0] * nofTiles[1];
+		std::vector<TileMesh> tiles(tilesPerLayer * nofTiles[2]);
+		int              skipped = 0;
+		for (int tz = 0; tz < nofTiles[2]; ++tz) {
+			if (cb)
+				cb((100 * tz) / nofTiles[2], "Marching cube...");
+#pragma omp parallel
+			{
+				Field field = makeField();
+#pragma omp for schedule(dynamic, 1) reduction(+ : skipped)
+				for (int t = 0; t < tilesPerLayer; ++t) {
+					TileMesh&  tile = tiles[tz * tilesPerLayer + t];
+					TileWalker walker(*this, tile.mesh, tile.keys);
+					walker.Init(Point3i(t % nofTiles[0], t / nofTiles[0], tz));
+					if (SkipEmpty && walker.IsEmpty(field)) {
+						++skipped;
+						continue;
+					}
+					walker.Fill(field);
+					vcg::tri::MarchingCubes<MeshType, TileWalker> extractor(tile.mesh, walker);
+					extractor.Initialize();
+					walker.Extract(extractor);
+					extractor.Finalize();
+				}
+			}
+		}
+
+		MergeTiles(tiles, mesh);
+		return skipped;
+	}
+
+private:
+	/* result of a tile: its mesh and the edge key of each of its vertices */
+	struct TileMesh
+	{
+		MeshType         mesh;
+		std::vector<Key> keys;
+	};
+
+	/*
+	 * Walker of a single tile, used by vcg::tri::MarchingCubes.
+	 * The samples are addressed with global coordinates.
+	 */
+	class TileWalker
+	{
+	public:
+		TileWalker(const TiledImplicitWalker& parent, MeshType& mesh, std::vector<Key>& keys) :
+				mParent(parent), mMesh(mesh), mKeys(keys)
+		{
+		}
+
+		void Init(const Point3i& ti)
+		{
+			mOrigin = ti * mParent.TileSize;
+			for (int k = 0; k < 3; ++k)
+				mDim[k] = std::min(mParent.TileSize + 1, mParent.mSiz[k] - mOrigin[k]);
+		}
+
+		/* coarse test, see the class comment */
+		bool IsEmpty(const Field& field) const
+		{
+			const int  s = mParent.CoarseStride;
+			Point3i    cDim;
+			for (int k = 0; k < 3; ++k)
+				cDim[k] = (mDim[k] - 1 + s - 1) / s + 1;
+			std::vector<float> coarse(cDim[0] * cDim[1] * cDim[2]);
+			Point3i ci;
+			for (ci[2] = 0; ci[2] < cDim[2]; ++ci[2])
+				for (ci[1] = 0; ci[1] < cDim[1]; ++ci[1])
+					for (ci[0] = 0; ci[0] < cDim[0]; ++ci[0]) {
+						// the last coarse sample is clamped on the tile border
+						Point3i li(
+							std::min(ci[0] * s, mDim[0] - 1),
+							std::min(ci[1] * s, mDim[1] - 1),
+							std::min(ci[2] * s, mDim[2] - 1));
+						float v = field(mParent.Position(li + mOrigin));
+						if (!std::isfinite(v))
+							return false;
+						coarse[ci[0] + cDim[0] * (ci[1] + cDim[1] * ci[2])] = v;
+					}
+
+			float minAbs = std::abs(coarse[0]), maxDiff = 0;
+			for (size_t i = 0; i < coarse.size(); ++i) {
+				if ((coarse[i] > 0) != (coarse[0] > 0))
+					return false;
+				minAbs = std::min(minAbs, std::abs(coarse[i]));
+			}
+			for (ci[2] = 0; ci[2] < cDim[2]; ++ci[2])
+				for (ci[1] = 0; ci[1] < cDim[1]; ++ci[1])
+					for (ci[0] = 0; ci[0] < cDim[0]; ++ci[0]) {
+						int i = ci[0] + cDim[0] * (ci[1] + cDim[1] * ci[2]);
+						if (ci[0] + 1 < cDim[0])
+							maxDiff = std::max(maxDiff, std::abs(coarse[i] - coarse[i + 1]));
+						if (ci[1] + 1 < cDim[1])
+							maxDiff = std::max(maxDiff, std::abs(coarse[i] - coarse[i + cDim[0]]));
+						if (ci[2] + 1 < cDim[2])
+							maxDiff = std::max(maxDiff, std::abs(coarse[i] - coarse[i + cDim[0] * cDim[1]]));
+					}
+			// a fine sample is at most half a coarse cell diagonal (in coarse steps) from a coarse one
+			return minAbs > 2 * maxDiff * std::sqrt(3.0f) / 2;
+		}
+
+		void Fill(const Field& field)
+		{
+			mValues.resize(mDim[0] * mDim[1] * mDim[2]);
+			Point3i li;
+			for (li[2] = 0; li[2] < mDim[2]; ++li[2])
+				for (li[1] = 0; li[1] < mDim[1]; ++li[1])
+					for (li[0] = 0; li[0] < mDim[0]; ++li[0])
+						mValues[LocalId(li)] = field(mParent.Position(li + mOrigin));
+		}
+
+		template<class EXTRACTOR_TYPE>
+		void Extract(EXTRACTOR_TYPE& extractor)
+		{
+			Point3i li;
+			for (li[0] = 0; li[0] < mDim[0] - 1; ++li[0])
+				for (li[1] = 0; li[1] < mDim[1] - 1; ++li[1])
+					for (li[2] = 0; li[2] < mDim[2] - 1; ++li[2]) {
+						bool finite = true;
+						for (int c = 0; c < 8 && finite; ++c)
+							finite = std::isfinite(
+								mValues[LocalId(li + Point3i(c & 1, (c >> 1) & 1, (c >> 2) & 1))]);
+						if (finite)
+							extractor.ProcessCell(li + mOrigin, li + mOrigin + Point3i(1, 1, 1));
+					}
+		}
+
+		float V(int pi, int pj, int pk) { return mValues[LocalId(Point3i(pi, pj, pk) - mOrigin)]; }
+
+		void GetIntercept(const Point3i& p1, const Point3i& p2, VertexPointer& v, bool create)
+		{
+			Key id1 = mParent.GlobalId(p1);
+			Key id2 = mParent.GlobalId(p2);
+			if (id1 > id2)
+				std::swap(id1, id2);
+			// p1 and p2 are adjacent samples: the edge is identified by its first sample and direction
+			Key  k  = id1 * 3 + (p1[0] != p2[0] ? 0 : (p1[1] != p2[1] ? 1 : 2));
+			auto it = mVertexMap.find(k);
+			if (it != mVertexMap.end()) {
+				v = &mMesh.vert[it->second];
+			}
+			else if (create) {
+				int vi = (int) mMesh.vert.size();
+				Allocator<MeshType>::AddVertices(mMesh, 1);
+				mVertexMap[k] = vi;
+				mKeys.push_back(k);
+				v = &mMesh.vert[vi];
+				// interpolated with the same order on both the tiles sharing the edge
+				const Point3i& a  = id1 == mParent.GlobalId(p1) ? p1 : p2;
+				const Point3i& b  = id1 == mParent.GlobalId(p1) ? p2 : p1;
+				float          va = V(a[0], a[1], a[2]), vb = V(b[0], b[1], b[2]);
+				ScalarType     t  = (va == vb) ? ScalarType(0.5) : ScalarType(va / (va - vb));
+				v->P() = mParent.Position(a) + (mParent.Position(b) - mParent.Position(a)) * t;
+			}
+			else {
+				v = 0;
+			}
+		}
+
+		bool Exist(const Point3i& p0, const Point3i& p1, VertexPointer& v)
+		{
+			GetIntercept(p0, p1, v, false);
+			return v != 0;
+		}
+		void GetXIntercept(const Point3i& p1, const Point3i& p2, VertexPointer& v)
+		{
+			GetIntercept(p1, p2, v, true);
+		}
+		void GetYIntercept(const Point3i& p1, const Point3i& p2, VertexPointer& v)
+		{
+			GetIntercept(p1, p2, v, true);
+		}
+		void GetZIntercept(const Point3i& p1, const Point3i& p2, VertexPointer& v)
+		{
+			GetIntercept(p1, p2, v, true);
+		}
+
+	private:
+		int LocalId(const Point3i& li) const { return li[0] + mDim[0] * (li[1] + mDim[1] * li[2]); }
+
+		const TiledImplicitWalker&  mParent;
+		MeshType&                   mMesh;
+		std::vector<Key>&           mKeys;
+		std::unordered_map<Key, int> mVertexMap;
+		std::vector<float>          mValues;
+		Point3i                     mOrigin;
+		Point3i                     mDim;
+	};
+
+	CoordType Position(const Point3i& gi) const
+	{
+		return mBox.min + CoordType(gi[0], gi[1], gi[2]) * mStep;
+	}
+
+	Key GlobalId(const Point3i& gi) const
+	{
+		return Key(gi[0]) + Key(mSiz[0]) * (Key(gi[1]) + Key(mSiz[1]) * Key(gi[2]));
+	}
+
+	/* appends the tile meshes to mesh, welding the vertices lying on the same grid edge */
+	static void MergeTiles(std::vector<TileMesh>& tiles, MeshType& mesh)
+	{
+		size_t vertNum = 0, faceNum = 0;
+		for (const TileMesh& tile : tiles) {
+			vertNum += tile.mesh.vert.size();
+			faceNum += tile.mesh.face.size();
+		}
+
+		std::unordered_map<Key, int> globalIndex;
+		globalIndex.reserve(vertNum);
+		std::vector<int>       remap;
+		std::vector<CoordType> positions;
+		positions.reserve(vertNum);
+		std::vector<Point3i> faces;
+		faces.reserve(faceNum);
+		for (TileMesh& tile : tiles) {
+			remap.resize(tile.mesh.vert.size());
+			for (size_t i = 0; i < tile.mesh.vert.size(); ++i) {
+				auto ins = globalIndex.insert(std::make_pair(tile.keys[i], int(positions.size())));
+				if (ins.second)
+					positions.push_back(tile.mesh.vert[i].cP());
+				remap[i] = ins.first->second;
+			}
+			for (size_t i = 0; i < tile.mesh.face.size(); ++i) {
+				const typename MeshType::FaceType& f = tile.mesh.face[i];
+				faces.push_back(Point3i(
+					remap[vcg::tri::Index(tile.mesh, f.cV(0))],
+					remap[vcg::tri::Index(tile.mesh, f.cV(1))],
+					remap[vcg::tri::Index(tile.mesh, f.cV(2))]));
+			}
+			// release the tile as soon as it is merged
+			tile.mesh.Clear();
+			tile.keys = std::vector<Key>();
+		}
+
+		Allocator<MeshType>::AddVertices(mesh, positions.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+			mesh.vert[i].P() = positions[i];
+		Allocator<MeshType>::AddFaces(mesh, faces.size());
+		for (size_t i = 0; i < faces.size(); ++i)
+			for (int k = 0; k < 3; ++k)
+				mesh.face[i].V(k) = &mesh.vert[faces[i][k]];
+	}
+
+	Box3<ScalarType> mBox;
+	ScalarType       mStep;
+	Point3i          mSiz;
+};
+
+} // namespace tri
+} // namespace vcg
+
+#endif // FILTER_FUNC_TILED_MARCHING_CUBES_H
@@ -74,6 +74,31 @@ void FilterIcpAlignParameter::AlignPairParamToRichParameterSet(const AlignPair::
                           CATEGORY_ICP_PARAMETERS));
 }
 
+void FilterIcpAlignParameter::RichParameterSetToIcpParam(const RichParameterList &rps, meshlab::IcpAligner::Param &ip) {
+    ip.sampleNum = rps.getInt("SampleNum");
+    ip.minDistAbs = rps.getFloat("MinDistAbs");
+    ip.trgDistAbs = rps.getFloat("TrgDistAbs");
+    ip.maxIterNum = rps.getInt("MaxIterNum");
+    ip.normalEqualized = rps.getBool("SampleMode");
+    ip.reduceFactorPerc = rps.getFloat("ReduceFactorPerc");
+    ip.passHiFilter = rps.getFloat("PassHiFilter");
+    ip.rigid = rps.getBool("MatchMode");
+    ip.pointToPlane = rps.getBool("PointToPlane");
+    ip.sampleLevels = rps.getInt("SampleLevels");
+}
+
+// adds only the parameters that are not already in the AlignPair set
+void FilterIcpAlignParameter::IcpParamToRichParameterSet(const meshlab::IcpAligner::Param &ip, RichParameterList &rps) {
+    rps.addParam(RichBool("PointToPlane", ip.pointToPlane, "Point to plane",
+                          "If true each ICP iteration minimizes the distances of the samples from the tangent planes of the corresponding points, instead of the distances from the points. "
+                          "It usually converges in much less iterations on smooth surfaces. Only rigid matching is supported.", false,
+                          CATEGORY_ICP_PARAMETERS));
+    rps.addParam(RichInt("SampleLevels", ip.sampleLevels, "Sample Levels",
+                         "Number of levels of the coarse to fine sampling schedule: the first level uses 1/4^(levels-1) of the samples, each level four times the samples of the previous one. "
+                         "A level ends when it converges or after MaxIterNum/levels iterations. 1 means that all the samples are always used.", false,
+                         CATEGORY_ICP_PARAMETERS));
+}
+
 void FilterIcpAlignParameter::RichParameterSetToMeshTreeParam(const RichParameterList &fps, MeshTreem::Param &mtp) {
     mtp.arcThreshold = fps.getFloat("arcThreshold");
     mtp.OGSize = fps.getInt("OGSize");
@@ -22,6 +22,7 @@
 ****************************************************************************/
 
 #include <common/parameters/rich_parameter_list.h>
+#include <common/utilities/icp_aligner.h>
 
 #include <vcg/complex/algorithms/align_pair.h>
 #include <vcg/complex/algorithms/meshtree.h>
@@ -42,6 +43,10 @@ public:
 	static void RichParameterSetToMeshTreeParam(const RichParameterList &fps , MeshTreem::Param &mtp);
 	static void MeshTreeParamToRichParameterSet(const MeshTreem::Param &mtp, RichParameterList &rps);
 
+	/* The IcpAligner parameters are the AlignPair ones plus the point to plane and sampling schedule ones */
+	static void RichParameterSetToIcpParam(const RichParameterList &rps, meshlab::IcpAligner::Param &ip);
+	static void IcpParamToRichParameterSet(const meshlab::IcpAligner::Param &ip, RichParameterList &rps);
+
 private:
 	/* No need to have an instance of this class */
 	FilterIcpAlignParameter();
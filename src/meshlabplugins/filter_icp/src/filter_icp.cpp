@@ -108,7 +108,10 @@ QString FilterIcpPlugin::pythonFilterName(ActionIDType f) const
 QString FilterIcpPlugin::filterInfo(ActionIDType filterId) const {
     switch (filterId) {
         case FP_TWO_MESH_ICP : {
-            return tr("Perform the ICP algorithm to minimize the difference between two cloud of points.");
+            return tr("Perform the ICP algorithm to minimize the difference between two cloud of points. "
+                      "The closest points are searched in parallel on a spatial index of the reference mesh built once, "
+                      "with point to point or point to plane minimization and an optional coarse to fine sampling schedule. "
+                      "The result does not depend on the number of threads.");
         }
         case FP_GLOBAL_MESH_ICP: {
             return tr("Perform the global alignment process to align a set of visible meshes together. "
@@ -199,6 +202,7 @@ RichParameterList FilterIcpPlugin::initParameterList(const QAction *action, cons
 
             /* Add default ICP parameters to the parameters List */
             FilterIcpAlignParameter::AlignPairParamToRichParameterSet(this->alignParameters, parameterList);
+            FilterIcpAlignParameter::IcpParamToRichParameterSet(this->icpParameters, parameterList);
 
 
             /* Add a checkbox to toggle 'Save Last Iteration' */
@@ -259,7 +263,8 @@ std::map<std::string, QVariant> FilterIcpPlugin::applyFilter(
 
         case FP_TWO_MESH_ICP: {
             FilterIcpAlignParameter::RichParameterSetToAlignPairParam(par, this->alignParameters);
-            return applyIcpTwoMeshes(md, par);
+            FilterIcpAlignParameter::RichParameterSetToIcpParam(par, this->icpParameters);
+            return applyIcpTwoMeshes(md, par, cb);
         }
 
         case FP_GLOBAL_MESH_ICP: {
@@ -338,18 +343,7 @@ std::map<std::string, QVariant> FilterIcpPlugin::globalAlignment(MeshDocument& m
     return std::map<std::string, QVariant> {};
 }
 
-std::map<std::string, QVariant> FilterIcpPlugin::applyIcpTwoMeshes(MeshDocument& meshDocument, const RichParameterList &par) {
-
-    vcg::AlignPair aligner;
-
-    vcg::AlignPair::A2Mesh fix;
-
-    vcg::AlignPair::A2Grid UG;
-    vcg::AlignPair::A2GridVert VG;
-
-    vcg::AlignPair::Result alignerResult;
-
-    std::vector<vcg::AlignPair::A2Vertex> tempMoving;
+std::map<std::string, QVariant> FilterIcpPlugin::applyIcpTwoMeshes(MeshDocument& meshDocument, const RichParameterList &par, vcg::CallBackPos *cb) {
 
     MeshModel *fixedMesh = meshDocument.getMesh(par.getMeshId(PAR_REFERENCE_MESH));
     MeshModel *movingMesh = meshDocument.getMesh(par.getMeshId(PAR_SOURCE_MESH));
@@ -365,81 +359,76 @@ std::map<std::string, QVariant> FilterIcpPlugin::applyIcpTwoMeshes(MeshDocument&
     qDebug("Fixed Mesh: %s\nMoving Mesh: %s\n",
            qUtf8Printable(fixedMesh->fullName()), qUtf8Printable(movingMesh->fullName()));
 
-    // 1) Convert fixed mesh and put it into the grid.
-    fixedMesh->updateDataMask(MeshModel::MM_FACEMARK);
-    aligner.convertMesh<CMeshO>(fixedMesh->cm, fix);
-
-    if (fixedMesh->cm.fn == 0 || this->alignParameters.UseVertexOnly) {
-        fix.initVert(vcg::Matrix44d::Identity());
-        vcg::AlignPair::InitFixVert(&fix, this->alignParameters, VG);
-    } else {
-        fix.init(vcg::Matrix44d::Identity());
-        vcg::AlignPair::initFix(&fix, this->alignParameters, UG);
+    // 1) Build the spatial index of the fixed mesh, once for all the iterations.
+    meshlab::IcpAligner aligner(fixedMesh->cm, this->alignParameters.UseVertexOnly);
+
+    // 2) Collect the points of the moving mesh, the aligner samples <SampleNum> of them.
+    std::vector<Point3m> movingPoints, movingNormals;
+    movingPoints.reserve(movingMesh->cm.vn);
+    movingNormals.reserve(movingMesh->cm.vn);
+    for (const CVertexO &v : movingMesh->cm.vert) {
+        if (!v.IsD()) {
+            movingPoints.push_back(v.cP());
+            movingNormals.push_back(Point3m(v.cN()).Normalize());
+        }
     }
 
-    // 2) Convert the second mesh and sample a <alignParameters.SampleNum> points on it.
-    movingMesh->updateDataMask(MeshModel::MM_FACEMARK);
-
-    aligner.convertVertex(movingMesh->cm.vert, tempMoving);
-    aligner.sampleMovVert(tempMoving, this->alignParameters.SampleNum, this->alignParameters.SampleMode);
-
-    aligner.mov = &tempMoving;
-    aligner.fix = &fix;
-
-    // Set user's parameters to the aligner
-    aligner.ap = this->alignParameters;
+    if (this->icpParameters.pointToPlane && !this->icpParameters.rigid) {
+        log("Point to plane matching supports only rigid transformations, using point to point.");
+    }
 
     // 3) Execute the ICP algorithm
-    bool success = aligner.align(inputMatrix, UG, VG, alignerResult);
+    meshlab::IcpAligner::Result alignerResult;
+    bool success = aligner.align(movingPoints, movingNormals, inputMatrix, this->icpParameters, alignerResult, cb);
     if (!success) {
-        throw MLException{vcg::AlignPair::errorMsg(alignerResult.status)};
+        throw MLException{QString::fromStdString(alignerResult.errorMessage)};
     }
 
-    alignerResult.FixName = static_cast<int>(par.getMeshId(PAR_REFERENCE_MESH));
-    alignerResult.MovName = static_cast<int>(par.getMeshId(PAR_SOURCE_MESH));
-
     if (saveLastIterationFlag) {
         saveLastIterationPoints(meshDocument, alignerResult);
     }
 
     // Prints out the log
-    std::vector<vcg::AlignPair::Stat::IterInfo> &I = alignerResult.as.I;
+    const std::vector<meshlab::IcpAligner::IterInfo> &I = alignerResult.iterations;
 
-    std::list<double> minDistAbs(I.size());
-    std::list<double> pcl50(I.size());
-    std::list<double> sampleTested(I.size());
-    std::list<double> sampleUsed(I.size());
-    std::list<double> distancedDiscarded(I.size());
-    std::list<double> borderDiscarded(I.size());
-    std::list<double> angleDiscarded(I.size());
+    std::list<double> minDistAbs;
+    std::list<double> pcl50;
+    std::list<double> sampleTested;
+    std::list<double> sampleUsed;
+    std::list<double> distancedDiscarded;
+    std::list<double> borderDiscarded;
+    std::list<double> angleDiscarded;
 
     // Print the header
-    log("Iter | MinD | Error | Sample | Used | DistR | BordR | AnglR");
+    log("Iter | MinD | Error | Sample | Used | DistR | AnglR | Level");
     // Print the IterInfos
     for (size_t qi = 0; qi < I.size(); ++qi) {
 
         // Add values inside the vector
-        minDistAbs.push_back(I[qi].MinDistAbs);
+        minDistAbs.push_back(I[qi].minDistAbs);
         pcl50.push_back(I[qi].pcl50);
-        sampleTested.push_back(I[qi].SampleTested);
-        sampleUsed.push_back(I[qi].SampleUsed);
-        distancedDiscarded.push_back(I[qi].DistanceDiscarded);
-        borderDiscarded.push_back(I[qi].BorderDiscarded);
-        angleDiscarded.push_back(I[qi].AngleDiscarded);
+        sampleTested.push_back(I[qi].sampleTested);
+        sampleUsed.push_back(I[qi].sampleUsed);
+        distancedDiscarded.push_back(I[qi].distanceDiscarded);
+        borderDiscarded.push_back(0);
+        angleDiscarded.push_back(I[qi].angleDiscarded);
 
         log("%04zu | %6.2f | %7.4f | %05i | %05i | %5i | %5i | %5i",
                     qi,
-                    I[qi].MinDistAbs,
+                    I[qi].minDistAbs,
                     I[qi].pcl50,
-                    I[qi].SampleTested,
-                    I[qi].SampleUsed,
-                    I[qi].DistanceDiscarded,
-                    I[qi].BorderDiscarded,
-                    I[qi].AngleDiscarded);
+                    I[qi].sampleTested,
+                    I[qi].sampleUsed,
+                    I[qi].distanceDiscarded,
+                    I[qi].angleDiscarded,
+                    I[qi].level);
+    }
+    if (!alignerResult.converged) {
+        log("Warning: the target distance has not been reached in %d iterations.", this->icpParameters.maxIterNum);
     }
 
     // Apply the obtained transformation matrix to the moving mesh
-    movingMesh->cm.Tr.FromMatrix(alignerResult.Tr);
+    movingMesh->cm.Tr.FromMatrix(alignerResult.tr);
 
     return std::map<std::string, QVariant> {
             {"min_dist_abs",        QVariant::fromValue(minDistAbs)},
@@ -489,37 +478,37 @@ std::map<std::string, QVariant> FilterIcpPlugin::checkOverlappingMeshes(MeshDocu
     };
 }
 
-void FilterIcpPlugin::saveLastIterationPoints(MeshDocument &meshDocument, vcg::AlignPair::Result &alignerResult) {
+void FilterIcpPlugin::saveLastIterationPoints(MeshDocument &meshDocument, const meshlab::IcpAligner::Result &alignerResult) {
 
     /* Save the last points iteration */
     MeshModel *chosenMovingPointsMesh = meshDocument.addNewMesh("", "Chosen Source Points", false);
     MeshModel *correspondingFixedPointsMesh = meshDocument.addNewMesh("", "Corresponding Reference Points", false);
 
-    std::vector<vcg::Point3d> &movingPoints = alignerResult.Pmov;
-    std::vector<vcg::Point3d> &movingNormals = alignerResult.Nmov;
+    const std::vector<vcg::Point3d> &movingPoints = alignerResult.pMov;
+    const std::vector<vcg::Point3d> &movingNormals = alignerResult.nMov;
 
-    std::vector<vcg::Point3d> &fixedPoints = alignerResult.Pfix;
-    std::vector<vcg::Point3d> &fixedNormals = alignerResult.Nmov;
+    const std::vector<vcg::Point3d> &fixedPoints = alignerResult.pFix;
+    const std::vector<vcg::Point3d> &fixedNormals = alignerResult.nFix;
 
     auto viMoving = vcg::tri::Allocator<CMeshO>::AddVertices(chosenMovingPointsMesh->cm, movingPoints.size());
     auto viFixed = vcg::tri::Allocator<CMeshO>::AddVertices(correspondingFixedPointsMesh->cm, fixedPoints.size());
 
     // Load the moving points inside the mesh chosenMovingPointsMesh
     for (size_t i = 0; i < movingPoints.size(); i++, viMoving++) {
-        (*viMoving).P() = movingPoints[i];
-        (*viMoving).N() = movingNormals[i];
+        (*viMoving).P() = Point3m::Construct(movingPoints[i]);
+        (*viMoving).N() = Point3m::Construct(movingNormals[i]);
         (*viMoving).C() = vcg::Color4b::Green;
     }
 
     // Load the fixed points inside the mesh correspondingFixedPointsMesh
     for (size_t i = 0; i < fixedPoints.size(); i++, viFixed++) {
-        (*viFixed).P() = fixedPoints[i];
-        (*viFixed).N() = fixedPoints[i];
+        (*viFixed).P() = Point3m::Construct(fixedPoints[i]);
+        (*viFixed).N() = Point3m::Construct(fixedNormals[i]);
         (*viFixed).C() = vcg::Color4b::Red;
     }
 
     // Apply the result transformation matrix to the chosen points
-    chosenMovingPointsMesh->cm.Tr.FromMatrix(alignerResult.Tr);
+    chosenMovingPointsMesh->cm.Tr.FromMatrix(alignerResult.tr);
 
     // Update the data masks for the new meshes
     chosenMovingPointsMesh->updateDataMask(MeshModel::MM_VERTCOLOR);
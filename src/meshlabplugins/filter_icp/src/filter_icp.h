@@ -86,11 +86,12 @@ private:
 
     vcg::AlignPair::Param alignParameters;
     MeshTreem::Param meshTreeParameters;
+    meshlab::IcpAligner::Param icpParameters;
 
     std::map<std::string, QVariant> globalAlignment(MeshDocument &meshDocument, const RichParameterList &par);
-    std::map<std::string, QVariant> applyIcpTwoMeshes(MeshDocument &meshDocument, const RichParameterList &par);
+    std::map<std::string, QVariant> applyIcpTwoMeshes(MeshDocument &meshDocument, const RichParameterList &par, vcg::CallBackPos *cb);
     std::map<std::string, QVariant> checkOverlappingMeshes(MeshDocument& meshDocument, const RichParameterList& par);
-    static void saveLastIterationPoints(MeshDocument &meshDocument, vcg::AlignPair::Result &alignerResult) ;
+    static void saveLastIterationPoints(MeshDocument &meshDocument, const meshlab::IcpAligner::Result &alignerResult) ;
 };
 
 #endif //MESHLAB_FILTER_EXAMPLE_PLUGIN_H
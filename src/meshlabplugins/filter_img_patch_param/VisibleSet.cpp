@@ -108,17 +108,18 @@ float VisibleSet::getWeight( const RasterModel *rm, CFaceO &f )
 
     if( (m_WeightMask & W_IMG_ALPHA) && weight>0.0f )
     {
+        const QImage img = rm->currentPlane->pixels();
         float alpha[3];
         for(int i=0;i<3;++i)
         {
           Point2m ppoint = rm->shot.Project( f.V(i)->P() );
           if(ppoint[0] < 0 ||
              ppoint[1] < 0 ||
-             ppoint[0] >= rm->currentPlane->image.width() ||
-             ppoint[1] >= rm->currentPlane->image.height())
+             ppoint[0] >= img.width() ||
+             ppoint[1] >= img.height())
             alpha[i] = 0;
           else
-            alpha[i] = qAlpha(rm->currentPlane->image.pixel(ppoint[0],rm->shot.Intrinsics.ViewportPx[1] - ppoint[1]));
+            alpha[i] = qAlpha(img.pixel(ppoint[0],rm->shot.Intrinsics.ViewportPx[1] - ppoint[1]));
         }
 
         int minAlpha = vcg::math::Min(alpha[0],alpha[1],alpha[2]);
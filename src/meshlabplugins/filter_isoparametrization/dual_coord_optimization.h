@@ -397,133 +397,184 @@ public:
     }
 
 
-    void MinimizeStep(const int &phaseNum)
+    ///group the patches in classes such that the patches of a class share no
+    ///face of the domain: since each patch reassigns only the hres vertices
+    ///whose father is one of its faces, the patches of a class can be
+    ///minimized concurrently
+    void ColorPatches(const std::vector<param_domain> &patches,
+                      std::vector<std::vector<int> > &classes)
     {
+        std::vector<int> faceColor(domain->face.size(),-1);
+        std::vector<bool> colored(patches.size(),false);
+        size_t num_colored=0;
+        classes.clear();
+        while (num_colored<patches.size())
+        {
+            int color=classes.size();
+            classes.push_back(std::vector<int>());
+            for (unsigned int i=0;i<patches.size();i++)
+            {
+                if (colored[i])
+                    continue;
+                const std::vector<FaceType*> &faces=patches[i].ordered_faces;
+                bool isFree=true;
+                for (unsigned int k=0;(k<faces.size())&&(isFree);k++)
+                    isFree=(faceColor[vcg::tri::Index(*domain,faces[k])]!=color);
+                if (!isFree)
+                    continue;
+                for (unsigned int k=0;k<faces.size();k++)
+                    faceColor[vcg::tri::Index(*domain,faces[k])]=color;
+                classes.back().push_back(i);
+                colored[i]=true;
+                num_colored++;
+            }
+        }
+    }
 
-
-        //Ord_HVert[index]
-        for (unsigned int i=0;i<HRES_meshes.size();i++)
+    void MinimizePatch(const int &i,const int &phaseNum)
+    {
+        MeshType *currMesh=HRES_meshes[i];
+        if (currMesh->fn>0)
         {
+            UpdateTopologies<MeshType>(currMesh);
 
-            MeshType *currMesh=HRES_meshes[i];
-            if (currMesh->fn>0)
+            ///on star
+            int numDom=1;
+            switch (phaseNum)
             {
-                UpdateTopologies<MeshType>(currMesh);
-
-                ///on star
-                int numDom=1;
-                switch (phaseNum)
-                {
-                case 0:numDom=6;break;//star
-                case 1:numDom=2;break;//diam
-                case 2:numDom=1;break;//face
-                }
+            case 0:numDom=6;break;//star
+            case 1:numDom=2;break;//diam
+            case 2:numDom=1;break;//face
+            }
+            ///save previous values
+            #ifndef IMPLICIT
+                InitDampRestUV(*currMesh);
+                bool b=UnFold<MeshType>(*currMesh,numDom);
+                bool isOK=testParamCoords<MeshType>(*currMesh);
+
+                if ((!b)||(!isOK))
+                    RestoreRestUV<MeshType>(*currMesh);
                 ///save previous values
-                #ifndef IMPLICIT
-                    InitDampRestUV(*currMesh);
-                    bool b=UnFold<MeshType>(*currMesh,numDom);
-                    bool isOK=testParamCoords<MeshType>(*currMesh);
-
-                    if ((!b)||(!isOK))
-                        RestoreRestUV<MeshType>(*currMesh);
-                    ///save previous values
-                    InitDampRestUV(*currMesh);
+                InitDampRestUV(*currMesh);
 
 
 
-                    ///NEW SETTING SPEED
+                ///NEW SETTING SPEED
 
-                    ScalarType edge_esteem=GetSmallestUVHeight(*currMesh);
+                ScalarType edge_esteem=GetSmallestUVHeight(*currMesh);
 
 
-                    ScalarType speed0=edge_esteem*0.2;
-                    ScalarType conv=edge_esteem*0.01;
+                ScalarType speed0=edge_esteem*0.2;
+                ScalarType conv=edge_esteem*0.01;
 
-                if (accuracy>1)
-                    conv*=1.0/(ScalarType)((accuracy-1)*10.0);
-                #endif
+            if (accuracy>1)
+                conv*=1.0/(ScalarType)((accuracy-1)*10.0);
+            #endif
 #ifndef IMPLICIT
-                if (EType==EN_EXTMips)
+            if (EType==EN_EXTMips)
+            {
+                OptType opt(*currMesh);
+                opt.TargetCurrentGeometry();
+                opt.SetBorderAsFixed();
+                opt.SetSpeed(speed0);
+                opt.IterateUntilConvergence(conv);
+            }
+            else
+                if (EType==EN_MeanVal)
                 {
-                    OptType opt(*currMesh);
+                    OptType1 opt(*currMesh);
                     opt.TargetCurrentGeometry();
                     opt.SetBorderAsFixed();
                     opt.SetSpeed(speed0);
                     opt.IterateUntilConvergence(conv);
                 }
-                else
-                    if (EType==EN_MeanVal)
-                    {
-                        OptType1 opt(*currMesh);
-                        opt.TargetCurrentGeometry();
-                        opt.SetBorderAsFixed();
-                        opt.SetSpeed(speed0);
-                        opt.IterateUntilConvergence(conv);
-                    }
 #else
-                OptType opt(*currMesh);
-                opt.SetBorderAsFixed();
-                opt.SolvePoisson();
+            OptType opt(*currMesh);
+            opt.SetBorderAsFixed();
+            opt.SolvePoisson();
 #endif
-                    //opt.IterateUntilConvergence();
+                //opt.IterateUntilConvergence();
 
-                    ///test for uv errors
-                    //bool IsOK=true;
-                    for (unsigned int j=0;j<currMesh->vert.size();j++)
+                ///test for uv errors
+                //bool IsOK=true;
+                for (unsigned int j=0;j<currMesh->vert.size();j++)
+                {
+                    VertexType *ParamVert=&currMesh->vert[j];
+                    ScalarType u=ParamVert->T().U();
+                    ScalarType v=ParamVert->T().V();
+                    if ((!((u<=1.001)&&(u>=-1.001)))||
+                        (!(v<=1.001)&&(v>=-1.001)))
                     {
-                        VertexType *ParamVert=&currMesh->vert[j];
-                        ScalarType u=ParamVert->T().U();
-                        ScalarType v=ParamVert->T().V();
-                        if ((!((u<=1.001)&&(u>=-1.001)))||
-                            (!(v<=1.001)&&(v>=-1.001)))
-                        {
-                            //IsOK=false;
+                        //IsOK=false;
 
-                            for (unsigned int k=0;k<currMesh->vert.size();k++)
-                                currMesh->vert[k].T().P()=currMesh->vert[k].RestUV;
-                            break;
-                        }
+                        for (unsigned int k=0;k<currMesh->vert.size();k++)
+                            currMesh->vert[k].T().P()=currMesh->vert[k].RestUV;
+                        break;
                     }
-                    //reassing fathers and bary coordinates
-                    for (unsigned int j=0;j<currMesh->vert.size();j++)
+                }
+                //reassing fathers and bary coordinates
+                for (unsigned int j=0;j<currMesh->vert.size();j++)
+                {
+                    VertexType *ParamVert=&currMesh->vert[j];
+                    VertexType *OrigVert=Ord_HVert[i][j];
+                    ScalarType u=ParamVert->T().U();
+                    ScalarType v=ParamVert->T().V();
+                    ///then get face falling into and estimate (alpha,beta,gamma)
+                    CoordType bary;
+                    BaseFace* chosen;
+                    param_domain *currDom;
+                    switch (phaseNum)
                     {
-                        VertexType *ParamVert=&currMesh->vert[j];
-                        VertexType *OrigVert=Ord_HVert[i][j];
-                        ScalarType u=ParamVert->T().U();
-                        ScalarType v=ParamVert->T().V();
-                        ///then get face falling into and estimate (alpha,beta,gamma)
-                        CoordType bary;
-                        BaseFace* chosen;
-                        param_domain *currDom;
-                        switch (phaseNum)
-                        {
-                        case 0:currDom=&star_meshes[i];break;//star
-                        case 1:currDom=&diamond_meshes[i];break;//diam
-                        case 2:currDom=&face_meshes[i];break;//face
-                        }
-                        /*assert(currDom->domain->vn==3);
-                        assert(currDom->domain->fn==1);*/
-                        bool inside=GetBaryFaceFromUV(*currDom->domain,u,v,currDom->ordered_faces,bary,chosen);
-                        if (!inside)
-                        {
-                            /*#ifndef _MESHLAB*/
-                            printf("\n OUTSIDE %f,%f \n",u,v);
-                            /*#endif*/
-                            vcg::Point2<ScalarType> UV=vcg::Point2<ScalarType>(u,v);
-                            ForceInParam<MeshType>(UV,*currDom->domain);
-                            u=UV.X();
-                            v=UV.Y();
-                            inside=GetBaryFaceFromUV(*currDom->domain,u,v,currDom->ordered_faces,bary,chosen);
-                            //assert(0);
-                        }
-                        assert(inside);
-                        //OrigVert->father=chosen;
-                        //OrigVert->Bary=bary;
-                        AssingFather(*OrigVert,chosen,bary,*domain);
+                    case 0:currDom=&star_meshes[i];break;//star
+                    case 1:currDom=&diamond_meshes[i];break;//diam
+                    case 2:currDom=&face_meshes[i];break;//face
                     }
-            }
-            ///delete current mesh
-            delete(HRES_meshes[i]);
+                    /*assert(currDom->domain->vn==3);
+                    assert(currDom->domain->fn==1);*/
+                    bool inside=GetBaryFaceFromUV(*currDom->domain,u,v,currDom->ordered_faces,bary,chosen);
+                    if (!inside)
+                    {
+                        /*#ifndef _MESHLAB*/
+                        printf("\n OUTSIDE %f,%f \n",u,v);
+                        /*#endif*/
+                        vcg::Point2<ScalarType> UV=vcg::Point2<ScalarType>(u,v);
+                        ForceInParam<MeshType>(UV,*currDom->domain);
+                        u=UV.X();
+                        v=UV.Y();
+                        inside=GetBaryFaceFromUV(*currDom->domain,u,v,currDom->ordered_faces,bary,chosen);
+                        //assert(0);
+                    }
+                    assert(inside);
+                    //OrigVert->father=chosen;
+                    //OrigVert->Bary=bary;
+                    AssingFather(*OrigVert,chosen,bary,*domain);
+                }
+        }
+        ///delete current mesh
+        delete(HRES_meshes[i]);
+    }
+
+    void MinimizeStep(const int &phaseNum)
+    {
+        std::vector<param_domain> *patches=&star_meshes;
+        if (phaseNum==1)
+            patches=&diamond_meshes;
+        else
+        if (phaseNum==2)
+            patches=&face_meshes;
+
+        ///minimize the patches of each class in parallel
+        std::vector<std::vector<int> > classes;
+        ColorPatches(*patches,classes);
+        for (unsigned int c=0;c<classes.size();c++)
+        {
+            const std::vector<int> &patch_class=classes[c];
+            int num=patch_class.size();
+#ifdef _USE_OMP
+            #pragma omp parallel for schedule(dynamic,1)
+#endif
+            for (int k=0;k<num;k++)
+                MinimizePatch(patch_class[k],phaseNum);
         }
 
         ///clear father and bary
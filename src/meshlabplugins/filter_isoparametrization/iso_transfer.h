@@ -21,6 +21,15 @@ class IsoTransfer
     typedef ParamMesh::ScalarType ScalarType;
     TriMeshGrid TRGrid;
 
+    ///the grid is queried concurrently, so the face marks of the mesh
+    ///cannot be used to skip the faces already tested
+    struct NoMarker
+    {
+        template <class T> bool IsMarked(T) const {return false;}
+        template <class T> void Mark(T) {}
+        void UnMarkAll() {}
+    };
+
     void Clamp(CoordType &bary)
     {
     /*	float eps=0.01;*/
@@ -95,28 +104,28 @@ class IsoTransfer
 
         TRGrid.Set(IsoParam.ParaMesh()->face.begin(),IsoParam.ParaMesh()->face.end());
         ScalarType maxDist=IsoParam.ParaMesh()->bbox.Diag();
-        ///then for each vertex find the closest
-    for (size_t i=0;i<to_assing.vert.size();i++)
+        ///then for each vertex find the closest, the vertices are independent
+        ///so they are processed in parallel
+        int vertNum=int(to_assing.vert.size());
+#ifdef _USE_OMP
+        #pragma omp parallel for schedule(dynamic,1024)
+#endif
+        for (int i=0;i<vertNum;i++)
         {
-      typename MeshType::VertexType *vert=&to_assing.vert[i];
+            typename MeshType::VertexType *vert=&to_assing.vert[i];
             if (!vert->IsD())
             {
-                typename ParamMesh::ScalarType dist;
+                typename ParamMesh::ScalarType dist=maxDist;
                 typename ParamMesh::CoordType queryPoint,closest,bary;
                 ParamMesh::FaceType * f=NULL;
                 queryPoint.Import(vert->P());
-                f=GetClosestFaceBase(*IsoParam.ParaMesh(),TRGrid,queryPoint, maxDist,dist,closest);
-                vcg::InterpolationParameters<typename ParamMesh::FaceType,typename ParamMesh::ScalarType>(*f,f->N(),closest, bary);
+                vcg::face::PointDistanceBaseFunctor<typename ParamMesh::ScalarType> PDistFunct;
+                NoMarker mf;
+                f=TRGrid.GetClosest(PDistFunct,mf,queryPoint,maxDist,dist,closest);
                 assert(f!=NULL);
+                vcg::InterpolationParameters<typename ParamMesh::FaceType,typename ParamMesh::ScalarType>(*f,f->N(),closest, bary);
 
                 ///then find back the coordinates
-                if (!((bary.X()>=0)&&(bary.X()<=1)&&
-                      (bary.Y()>=0)&&(bary.Y()<=1)&&
-                        (bary.Z()>=0)&&(bary.Z()<=1)))
-                {
-            printf("%i,%3.3f,%3.3f,%3.3f",int(i),bary.X(),bary.Y(),bary.Z());
-                        system("pause");
-                }
                 Clamp(bary);
                 int I;
                 vcg::Point2<typename ParamMesh::ScalarType> UV;
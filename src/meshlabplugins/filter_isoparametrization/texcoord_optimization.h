@@ -289,9 +289,6 @@ public:
 	   sumY[k].Y()=0;
 	   sumY[k].Z()=0;
 	 }
-#ifdef _USE_OMP
-	 #pragma omp barrier
-#endif
  }
 
 ScalarType getProjArea()
@@ -306,9 +303,6 @@ ScalarType getProjArea()
 	  for (k=0;k<n; k++) {
 	      tot_proj_area+=Area(k);
 	  }
-#ifdef _USE_OMP
-	  #pragma omp barrier
-#endif
 	  return (tot_proj_area);
 }
 
@@ -377,9 +371,6 @@ void UpdateSum(const double &scale)
 			  sumY[k].V(1)=val1.Y();
 			  sumY[k].V(2)=val2.Y();
 	  }
-#ifdef _USE_OMP
-	  #pragma omp barrier
-#endif
 }
 
 
@@ -0,0 +1,233 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "curvature_parallel.h"
+
+#include <algorithm>
+#include <limits>
+#include <Eigen/Dense>
+#include <Eigen/Eigenvalues>
+#include <vcg/simplex/face/pos.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef KdTree<Scalarm> KdTreem;
+
+/* Appends to ring the vertices adjacent to v (v excluded), without duplicates. */
+void appendRing(const CVertexO* v, std::vector<const CVertexO*>& ring)
+{
+	face::VFIterator<CFaceO> vfi(const_cast<CVertexO*>(v));
+	for (; !vfi.End(); ++vfi) {
+		const CFaceO* f = vfi.F();
+		for (int j = 0; j < f->VN(); ++j) {
+			const CVertexO* w = f->cV(j);
+			if (w != v && std::find(ring.begin(), ring.end(), w) == ring.end())
+				ring.push_back(w);
+		}
+	}
+}
+
+/* Tangent frame (u, v, n) of the given normal. */
+void tangentFrame(const Point3m& n, Point3m& u, Point3m& v)
+{
+	if (std::abs(n[0]) > std::abs(n[1]))
+		u = Point3m(-n[2], 0, n[0]);
+	else
+		u = Point3m(0, n[2], -n[1]);
+	u.Normalize();
+	v = n ^ u;
+}
+
+/* Fits z = a u^2 + b uv + c v^2 + d u + e v to the first cnt points of pts
+ * (already expressed in the tangent frame of p) and returns the principal
+ * curvatures and directions of the fitted surface at the origin. */
+PrincipalCurvature fitQuadric(
+	const std::vector<Point3d>& pts,
+	size_t                      cnt,
+	const Point3m&              n,
+	const Point3m&              tu,
+	const Point3m&              tv)
+{
+	PrincipalCurvature c;
+	c.pd1 = tu;
+	c.pd2 = tv;
+	if (cnt < 5)
+		return c;
+
+	Eigen::Matrix<double, 5, 5> AtA = Eigen::Matrix<double, 5, 5>::Zero();
+	Eigen::Matrix<double, 5, 1> Atb = Eigen::Matrix<double, 5, 1>::Zero();
+	for (size_t i = 0; i < cnt; ++i) {
+		const Point3d&              q = pts[i];
+		Eigen::Matrix<double, 5, 1> row;
+		row << q[0] * q[0], q[0] * q[1], q[1] * q[1], q[0], q[1];
+		AtA.noalias() += row * row.transpose();
+		Atb += row * q[2];
+	}
+	Eigen::LDLT<Eigen::Matrix<double, 5, 5>> ldlt(AtA);
+	if (ldlt.info() != Eigen::Success)
+		return c;
+	Eigen::Matrix<double, 5, 1> x = ldlt.solve(Atb);
+
+	// first (I) and second (II) fundamental forms at the origin
+	const double fu = x[3], fv = x[4];
+	const double s  = std::sqrt(1.0 + fu * fu + fv * fv);
+	Eigen::Matrix2d I, II;
+	I << 1.0 + fu * fu, fu * fv, fu * fv, 1.0 + fv * fv;
+	II << 2.0 * x[0] / s, x[1] / s, x[1] / s, 2.0 * x[2] / s;
+
+	Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::Matrix2d> es(II, I);
+	if (es.info() != Eigen::Success)
+		return c;
+
+	// the fitted height grows along the normal, so convex regions have
+	// negative eigenvalues: the smallest one is the maximum curvature.
+	const Point3d xu = Point3d::Construct(tu) + Point3d::Construct(n) * fu;
+	const Point3d xv = Point3d::Construct(tv) + Point3d::Construct(n) * fv;
+	Point3d       d1 = xu * es.eigenvectors()(0, 0) + xv * es.eigenvectors()(1, 0);
+	Point3d       d2 = xu * es.eigenvectors()(0, 1) + xv * es.eigenvectors()(1, 1);
+	c.k1             = Scalarm(-es.eigenvalues()[0]);
+	c.k2             = Scalarm(-es.eigenvalues()[1]);
+	c.pd1            = Point3m::Construct(d1.Normalize());
+	c.pd2            = Point3m::Construct(d2.Normalize());
+	return c;
+}
+
+} // namespace
+
+void ParallelCurvatureFitting(
+	CMeshO&                                       m,
+	const std::vector<Scalarm>&                   radii,
+	std::vector<std::vector<PrincipalCurvature>>* otherScales,
+	CallBackPos*                                  cb)
+{
+	const int vn       = (int) m.vert.size();
+	const int scaleNum = std::max<int>(1, (int) radii.size());
+
+	Scalarm maxRadius = 0;
+	for (Scalarm r : radii)
+		maxRadius = std::max(maxRadius, r);
+
+	KdTreem* tree = nullptr;
+	if (!radii.empty()) {
+		if (cb) cb(1, "Building kd-tree");
+		VertexConstDataWrapper<CMeshO> ww(m);
+		tree = new KdTreem(ww);
+	}
+
+	if (otherScales != nullptr)
+		otherScales->assign(scaleNum - 1, std::vector<PrincipalCurvature>(vn));
+
+	if (cb) cb(10, "Fitting quadrics");
+#pragma omp parallel
+	{
+		std::vector<unsigned int>                     ids;
+		std::vector<Scalarm>                          sqDists;
+		std::vector<std::pair<Scalarm, unsigned int>> sorted;
+		std::vector<const CVertexO*>                  ring;
+		std::vector<Point3d>                          pts;
+
+#pragma omp for schedule(dynamic, 256)
+		for (int i = 0; i < vn; ++i) {
+			CVertexO& v = m.vert[i];
+			if (v.IsD())
+				continue;
+
+			Point3m n = v.cN();
+			n.Normalize();
+			Point3m tu, tv;
+			tangentFrame(n, tu, tv);
+			auto toLocal = [&](const Point3m& q) {
+				Point3d d = Point3d::Construct(q - v.cP());
+				return Point3d(
+					d.dot(Point3d::Construct(tu)),
+					d.dot(Point3d::Construct(tv)),
+					d.dot(Point3d::Construct(n)));
+			};
+
+			pts.clear();
+			if (radii.empty()) {
+				ring.clear();
+				appendRing(&v, ring);
+				if (ring.size() < 5) {
+					const size_t oneRing = ring.size();
+					for (size_t j = 0; j < oneRing; ++j)
+						appendRing(ring[j], ring);
+					ring.erase(std::remove(ring.begin(), ring.end(), &v), ring.end());
+				}
+				for (const CVertexO* w : ring)
+					pts.push_back(toLocal(w->cP()));
+				PrincipalCurvature c = fitQuadric(pts, pts.size(), n, tu, tv);
+				v.PD1() = c.pd1; v.PD2() = c.pd2;
+				v.K1()  = c.k1;  v.K2()  = c.k2;
+				continue;
+			}
+
+			// gather once with the largest radius, sorted by distance, so
+			// that each smaller scale is just a prefix of the same list
+			tree->doQueryDist(v.cP(), maxRadius, ids, sqDists);
+			sorted.clear();
+			for (size_t j = 0; j < ids.size(); ++j) {
+				if ((int) ids[j] != i && !m.vert[ids[j]].IsD())
+					sorted.push_back(std::make_pair(sqDists[j], ids[j]));
+			}
+			std::sort(sorted.begin(), sorted.end());
+			for (const auto& s : sorted)
+				pts.push_back(toLocal(m.vert[s.second].cP()));
+
+			for (int s = 0; s < scaleNum; ++s) {
+				const Scalarm r2  = radii[s] * radii[s];
+				const size_t  cnt = std::upper_bound(
+										sorted.begin(),
+										sorted.end(),
+										std::make_pair(r2, std::numeric_limits<unsigned int>::max())) -
+									sorted.begin();
+				PrincipalCurvature c = fitQuadric(pts, cnt, n, tu, tv);
+				if (s == 0) {
+					v.PD1() = c.pd1; v.PD2() = c.pd2;
+					v.K1()  = c.k1;  v.K2()  = c.k2;
+				}
+				else if (otherScales != nullptr) {
+					(*otherScales)[s - 1][i] = c;
+				}
+			}
+		}
+	}
+	delete tree;
+}
+
+Scalarm CurvatureMeasure(const PrincipalCurvature& c, int measure)
+{
+	Scalarm k1 = std::max(c.k1, c.k2);
+	Scalarm k2 = std::min(c.k1, c.k2);
+	switch (measure) {
+	case 0: return (k1 + k2) / 2.0;
+	case 1: return k1 * k2;
+	case 2: return k2;
+	case 3: return k1;
+	case 4: return (2.0 / M_PI) * std::atan2(k1 + k2, k1 - k2);
+	case 5: return std::sqrt((k1 * k1 + k2 * k2) / 2.0);
+	default: return 0;
+	}
+}
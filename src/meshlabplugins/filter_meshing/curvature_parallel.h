@@ -0,0 +1,67 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef CURVATURE_PARALLEL_H
+#define CURVATURE_PARALLEL_H
+
+#include <common/ml_document/cmesh.h>
+
+/** Principal curvatures (k1 >= k2) and directions of a single vertex. */
+struct PrincipalCurvature
+{
+	Point3m pd1 = Point3m(0, 0, 0);
+	Point3m pd2 = Point3m(0, 0, 0);
+	Scalarm k1  = 0;
+	Scalarm k2  = 0;
+};
+
+/**
+ * Multi-threaded quadric fitting curvature.
+ *
+ * For each vertex, a height function z = f(u,v) is fitted to the neighbours
+ * expressed in the tangent frame of the vertex normal, and the principal
+ * curvatures and directions are extracted from its shape operator.
+ *
+ * If radii is empty, the neighbourhood of each vertex is its one ring
+ * (expanded to the two ring when too small), gathered through VF adjacency.
+ * Otherwise the neighbourhood of each vertex is gathered only once, with the
+ * largest radius, from a kd-tree shared by all the threads, and the fit is
+ * repeated for every radius in radii.
+ *
+ * The result for the first scale is written in the per vertex curvature
+ * directions of m (PD1, PD2, K1, K2); if otherScales is not null, it is
+ * filled with the per vertex results of the remaining radii.
+ */
+void ParallelCurvatureFitting(
+	CMeshO&                                       m,
+	const std::vector<Scalarm>&                   radii,
+	std::vector<std::vector<PrincipalCurvature>>* otherScales = nullptr,
+	vcg::CallBackPos*                             cb          = nullptr);
+
+/**
+ * Returns the curvature measure used by the FP_COMPUTE_PRINC_CURV_DIR
+ * Quality/Color mapping enum (mean, gaussian, min, max, shape index,
+ * curvedness, none).
+ */
+Scalarm CurvatureMeasure(const PrincipalCurvature& c, int measure);
+
+#endif // CURVATURE_PARALLEL_H
@@ -0,0 +1,475 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "hole_filling_parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <vcg/complex/algorithms/hole.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/space/intersection3.h>
+#include <vcg/space/triangle3.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef std::array<const CVertexO*, 3>               Tri;
+typedef std::pair<const CVertexO*, const CVertexO*> Edge;
+
+Edge makeEdge(const CVertexO* a, const CVertexO* b)
+{
+	return a < b ? Edge(a, b) : Edge(b, a);
+}
+
+/* Minimal bounding volume hierarchy over a set of boxes, built by median split
+ * along the largest extent of the box centers. */
+class BoxHierarchy
+{
+public:
+	void build(const std::vector<Box3m>& boxes)
+	{
+		this->boxes = boxes;
+		ids.resize(boxes.size());
+		for (size_t i = 0; i < ids.size(); ++i)
+			ids[i] = (int) i;
+		nodes.clear();
+		if (!ids.empty())
+			buildNode(0, (int) ids.size());
+	}
+
+	/* calls f(id) for every box overlapping b */
+	template<class F>
+	void query(const Box3m& b, F f) const
+	{
+		if (nodes.empty())
+			return;
+		std::vector<int> stack(1, 0);
+		while (!stack.empty()) {
+			const Node& n = nodes[stack.back()];
+			stack.pop_back();
+			if (!n.box.Collide(b))
+				continue;
+			if (n.left < 0) {
+				for (int i = n.begin; i < n.end; ++i)
+					if (boxes[ids[i]].Collide(b))
+						f(ids[i]);
+			}
+			else {
+				stack.push_back(n.left);
+				stack.push_back(n.right);
+			}
+		}
+	}
+
+private:
+	struct Node
+	{
+		Box3m box;
+		int   left, right; // -1 for leaves
+		int   begin, end;
+	};
+	static const int leafSize = 8;
+
+	int buildNode(int begin, int end)
+	{
+		Box3m box, centers;
+		for (int i = begin; i < end; ++i) {
+			box.Add(boxes[ids[i]]);
+			centers.Add(boxes[ids[i]].Center());
+		}
+		const int id = (int) nodes.size();
+		nodes.push_back(Node {box, -1, -1, begin, end});
+		if (end - begin <= leafSize)
+			return id;
+
+		const Point3m dim  = centers.Dim();
+		const int     axis = dim[0] > dim[1] ? (dim[0] > dim[2] ? 0 : 2) : (dim[1] > dim[2] ? 1 : 2);
+		const int     mid  = (begin + end) / 2;
+		std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end, [&](int a, int b) {
+			return boxes[a].Center()[axis] < boxes[b].Center()[axis];
+		});
+		const int left  = buildNode(begin, mid);
+		const int right = buildNode(mid, end);
+		nodes[id].left  = left;
+		nodes[id].right = right;
+		return id;
+	}
+
+	std::vector<Box3m> boxes;
+	std::vector<int>   ids;
+	std::vector<Node>  nodes;
+};
+
+Box3m triBox(const Tri& t)
+{
+	Box3m b;
+	for (const CVertexO* v : t)
+		b.Add(v->cP());
+	return b;
+}
+
+/* Same logic of tri::Clean::TestFaceFaceIntersection: triangles sharing an
+ * edge never intersect, triangles sharing a vertex intersect only if the
+ * opposite edge of one crosses the other. */
+bool trianglesIntersect(const Tri& t0, const Tri& t1)
+{
+	int shared = 0, s0 = -1, s1 = -1;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			if (t0[i] == t1[j]) {
+				++shared;
+				s0 = i;
+				s1 = j;
+			}
+		}
+	}
+	if (shared >= 2)
+		return false;
+	if (shared == 1) {
+		Scalarm   a, b;
+		Segment3m e0(t0[(s0 + 1) % 3]->cP(), t0[(s0 + 2) % 3]->cP());
+		Segment3m e1(t1[(s1 + 1) % 3]->cP(), t1[(s1 + 2) % 3]->cP());
+		return IntersectionSegmentTriangle(e0, t1[0]->cP(), t1[1]->cP(), t1[2]->cP(), a, b) ||
+			   IntersectionSegmentTriangle(e1, t0[0]->cP(), t0[1]->cP(), t0[2]->cP(), a, b);
+	}
+	return NoDivTriTriIsect(
+		t0[0]->cP(), t0[1]->cP(), t0[2]->cP(), t1[0]->cP(), t1[1]->cP(), t1[2]->cP());
+}
+
+Point3m triNormal(const Point3m& p0, const Point3m& p1, const Point3m& p2)
+{
+	return ((p1 - p0) ^ (p2 - p0)).Normalize();
+}
+
+/* A boundary loop, oriented so that the triangles of the ears are consistent
+ * with the faces of the mesh. adjN[i] is the normal of the face adjacent to the
+ * loop edge (vert[i], vert[i+1]). */
+struct HoleLoop
+{
+	std::vector<const CVertexO*> vert;
+	std::vector<Point3m>         adjN;
+	Box3m                        box;
+	std::vector<int>             nearFaces;
+	std::vector<Tri>             tris;
+};
+
+struct EarScore
+{
+	Scalarm angle   = std::numeric_limits<Scalarm>::max();
+	Scalarm quality = 0;
+	bool    operator<(const EarScore& e) const
+	{
+		return angle < e.angle || (angle == e.angle && quality > e.quality);
+	}
+};
+
+/* The edges already present around the holes filled by a single task: the
+ * sorted edges of the mesh joining two hole vertices, and the ones added by
+ * the holes of the same group closed before. */
+struct GroupEdges
+{
+	const std::vector<Edge>* meshEdges;
+	std::set<Edge>           newEdges;
+	std::vector<Tri>         newTris;
+
+	bool contains(const Edge& e) const
+	{
+		return std::binary_search(meshEdges->begin(), meshEdges->end(), e) || newEdges.count(e) > 0;
+	}
+};
+
+/* Minimum weight ear cutting of a single hole; on failure tris is left empty.
+ * As in vcg TrivialEar::CheckManifoldAfterEarClose, ears whose closing edge
+ * already exists are rejected, since they would create non manifold edges. */
+void triangulateHole(
+	const CMeshO&       m,
+	HoleLoop&           h,
+	const BoxHierarchy* faceIndex,
+	bool                selfIntersection,
+	const GroupEdges&   group)
+{
+	const int n = (int) h.vert.size();
+	std::vector<int>      prev(n), next(n);
+	std::vector<EarScore> score(n);
+	std::vector<Point3m>  adjN = h.adjN;
+	for (int i = 0; i < n; ++i) {
+		prev[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+	}
+
+	auto earTri = [&](int i) { return Tri {h.vert[prev[i]], h.vert[i], h.vert[next[i]]}; };
+	auto evaluate = [&](int i) {
+		EarScore  s;
+		const Tri t = earTri(i);
+		if (t[0] == t[2])
+			return s; // pinched loop: this ear would be degenerate
+		const Point3m en = triNormal(t[0]->cP(), t[1]->cP(), t[2]->cP());
+		s.angle   = std::max(AngleN(en, adjN[prev[i]]), AngleN(en, adjN[i]));
+		s.quality = QualityRadii(t[0]->cP(), t[1]->cP(), t[2]->cP());
+		if (!(s.angle == s.angle)) // nan for null area ears
+			s.angle = std::numeric_limits<Scalarm>::max() / 2;
+		return s;
+	};
+	auto intersects = [&](const Tri& t) {
+		bool        found = false;
+		const Box3m b     = triBox(t);
+		faceIndex->query(b, [&](int k) {
+			const CFaceO& f = m.face[h.nearFaces[k]];
+			if (!found && trianglesIntersect(t, Tri {f.cV(0), f.cV(1), f.cV(2)}))
+				found = true;
+		});
+		for (size_t k = 0; k < h.tris.size() && !found; ++k)
+			found = trianglesIntersect(t, h.tris[k]);
+		for (size_t k = 0; k < group.newTris.size() && !found; ++k)
+			found = trianglesIntersect(t, group.newTris[k]);
+		return found;
+	};
+	std::set<Edge> holeEdges; // the edges closed by the ears of this hole
+	auto closesExistingEdge = [&](int i) {
+		const Edge e = makeEdge(h.vert[prev[i]], h.vert[next[i]]);
+		return group.contains(e) || holeEdges.count(e) > 0;
+	};
+
+	for (int i = 0; i < n; ++i)
+		score[i] = evaluate(i);
+
+	int remaining = n;
+	int start     = 0;
+	while (remaining > 3) {
+		int best = -1;
+		while (true) {
+			for (int i = start, c = 0; c < remaining; i = next[i], ++c) {
+				if (score[i].angle < std::numeric_limits<Scalarm>::max() &&
+					(best < 0 || score[i] < score[best]))
+					best = i;
+			}
+			if (best < 0 ||
+				(!closesExistingEdge(best) && (!selfIntersection || !intersects(earTri(best)))))
+				break;
+			score[best] = EarScore(); // rejected, look for the next best ear
+			best        = -1;
+		}
+		if (best < 0) {
+			h.tris.clear();
+			return;
+		}
+
+		const Tri t = earTri(best);
+		h.tris.push_back(t);
+		holeEdges.insert(makeEdge(t[0], t[2]));
+		const int p = prev[best], q = next[best];
+		adjN[p]     = triNormal(t[0]->cP(), t[1]->cP(), t[2]->cP());
+		next[p]     = q;
+		prev[q]     = p;
+		start       = p;
+		--remaining;
+		score[p] = evaluate(p);
+		score[q] = evaluate(q);
+	}
+
+	const Tri last = earTri(next[start]);
+	if (last[0] == last[1] || last[1] == last[2] || last[0] == last[2])
+		h.tris.clear();
+	else
+		h.tris.push_back(last);
+}
+
+} // namespace
+
+int ParallelHoleFill(CMeshO& m, int maxHoleSize, bool selected, bool selfIntersection, CallBackPos* cb)
+{
+	typedef tri::Hole<CMeshO> Hole;
+
+	if (cb) cb(0, "Gathering holes");
+	std::vector<Hole::Info> vinfo;
+	Hole::GetInfo(m, selected, vinfo);
+
+	std::vector<HoleLoop> holes;
+	for (const Hole::Info& info : vinfo) {
+		if (info.size >= maxHoleSize || info.size < 3)
+			continue;
+
+		// border edges, in the order NextB walks them
+		std::vector<std::pair<const CFaceO*, int>> edges;
+		Hole::PosType p = info.p;
+		do {
+			edges.push_back(std::make_pair(p.f, p.z));
+			p.NextB();
+		} while (p != info.p && (int) edges.size() <= info.size);
+
+		HoleLoop h;
+		const int en = (int) edges.size();
+		// the loop must traverse each border edge (a,b) as (b,a)
+		const bool forward = edges[1].first->cV(edges[1].second) == edges[0].first->cV1(edges[0].second);
+		for (int k = 0; k < en; ++k) {
+			const std::pair<const CFaceO*, int>& e = forward ? edges[en - 1 - k] : edges[k];
+			const CFaceO* f = e.first;
+			h.vert.push_back(f->cV1(e.second));
+			h.adjN.push_back(triNormal(f->cP(0), f->cP(1), f->cP(2)));
+			h.box.Add(f->cV1(e.second)->cP());
+		}
+		holes.push_back(std::move(h));
+	}
+	const int hn = (int) holes.size();
+
+	// edges of the mesh joining two hole vertices, that no ear can add again
+	std::vector<char> onHole(m.vert.size(), 0);
+	for (const HoleLoop& h : holes)
+		for (const CVertexO* v : h.vert)
+			onHole[tri::Index(m, v)] = 1;
+	std::vector<Edge> meshEdges;
+	const int         fn = (int) m.face.size();
+#pragma omp parallel
+	{
+		std::vector<Edge> local;
+#pragma omp for schedule(static) nowait
+		for (int i = 0; i < fn; ++i) {
+			const CFaceO& f = m.face[i];
+			if (f.IsD())
+				continue;
+			for (int j = 0; j < 3; ++j)
+				if (onHole[tri::Index(m, f.cV0(j))] && onHole[tri::Index(m, f.cV1(j))])
+					local.push_back(makeEdge(f.cV0(j), f.cV1(j)));
+		}
+#pragma omp critical
+		meshEdges.insert(meshEdges.end(), local.begin(), local.end());
+	}
+	std::sort(meshEdges.begin(), meshEdges.end());
+	meshEdges.erase(std::unique(meshEdges.begin(), meshEdges.end()), meshEdges.end());
+
+	// holes sharing a vertex (or, when intersections are checked, overlapping
+	// each other) are closed one after the other by the same task, each one
+	// seeing the faces added by the previous ones
+	std::vector<int> parent(hn);
+	std::iota(parent.begin(), parent.end(), 0);
+	std::function<int(int)> root = [&](int i) {
+		return parent[i] == i ? i : (parent[i] = root(parent[i]));
+	};
+	auto join = [&](int a, int b) { parent[root(a)] = root(b); };
+	std::vector<int> holeOfVert(m.vert.size(), -1);
+	for (int i = 0; i < hn; ++i) {
+		for (const CVertexO* v : holes[i].vert) {
+			int& owner = holeOfVert[tri::Index(m, v)];
+			if (owner >= 0)
+				join(owner, i);
+			owner = i;
+		}
+	}
+
+	if (selfIntersection && hn > 0) {
+		// assign to each hole the faces overlapping its box, in a single pass
+		if (cb) cb(10, "Collecting faces around holes");
+		std::vector<Box3m> holeBoxes(hn);
+		for (int i = 0; i < hn; ++i)
+			holeBoxes[i] = holes[i].box;
+		BoxHierarchy holeIndex;
+		holeIndex.build(holeBoxes);
+
+		// the ears of a hole lie inside its box
+		for (int i = 0; i < hn; ++i)
+			holeIndex.query(holes[i].box, [&](int k) { join(i, k); });
+
+#pragma omp parallel
+		{
+			std::vector<std::vector<int>> local(hn);
+#pragma omp for schedule(static) nowait
+			for (int i = 0; i < fn; ++i) {
+				const CFaceO& f = m.face[i];
+				if (f.IsD())
+					continue;
+				Box3m fb;
+				fb.Add(f.cP(0));
+				fb.Add(f.cP(1));
+				fb.Add(f.cP(2));
+				holeIndex.query(fb, [&](int h) { local[h].push_back(i); });
+			}
+#pragma omp critical
+			for (int h = 0; h < hn; ++h)
+				holes[h].nearFaces.insert(holes[h].nearFaces.end(), local[h].begin(), local[h].end());
+		}
+	}
+
+	std::vector<std::vector<int>> groups;
+	std::vector<int>              groupOfRoot(hn, -1);
+	for (int i = 0; i < hn; ++i) {
+		int& g = groupOfRoot[root(i)];
+		if (g < 0) {
+			g = (int) groups.size();
+			groups.emplace_back();
+		}
+		groups[g].push_back(i);
+	}
+	const int gn = (int) groups.size();
+
+	if (cb) cb(30, "Closing holes");
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int g = 0; g < gn; ++g) {
+		GroupEdges group;
+		group.meshEdges = &meshEdges;
+		for (int i : groups[g]) {
+			HoleLoop&    h = holes[i];
+			BoxHierarchy faceIndex;
+			if (selfIntersection) {
+				std::vector<Box3m> boxes(h.nearFaces.size());
+				for (size_t k = 0; k < boxes.size(); ++k) {
+					const CFaceO& f = m.face[h.nearFaces[k]];
+					boxes[k].Add(f.cP(0));
+					boxes[k].Add(f.cP(1));
+					boxes[k].Add(f.cP(2));
+				}
+				faceIndex.build(boxes);
+			}
+			triangulateHole(m, h, &faceIndex, selfIntersection, group);
+			for (const Tri& t : h.tris) {
+				group.newTris.push_back(t);
+				for (int j = 0; j < 3; ++j)
+					group.newEdges.insert(makeEdge(t[j], t[(j + 1) % 3]));
+			}
+		}
+	}
+
+	if (cb) cb(90, "Adding faces");
+	size_t newFaceNum = 0;
+	int    holeCnt    = 0;
+	for (const HoleLoop& h : holes) {
+		newFaceNum += h.tris.size();
+		if (!h.tris.empty())
+			++holeCnt;
+	}
+	if (newFaceNum > 0) {
+		auto fi = tri::Allocator<CMeshO>::AddFaces(m, newFaceNum);
+		for (const HoleLoop& h : holes) {
+			for (const Tri& t : h.tris) {
+				for (int j = 0; j < 3; ++j)
+					fi->V(j) = const_cast<CVertexO*>(t[j]);
+				++fi;
+			}
+		}
+		tri::UpdateTopology<CMeshO>::FaceFace(m);
+	}
+	return holeCnt;
+}
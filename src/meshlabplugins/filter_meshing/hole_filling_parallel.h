@@ -0,0 +1,57 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef HOLE_FILLING_PARALLEL_H
+#define HOLE_FILLING_PARALLEL_H
+
+#include <common/ml_document/cmesh.h>
+
+/**
+ * Multi-threaded replacement of vcg::tri::Hole<CMeshO>::EarCuttingFill and
+ * EarCuttingIntersectionFill, using the same minimum weight ear heuristic
+ * (minimum dihedral angle with the adjacent faces, then best aspect ratio).
+ *
+ * All the boundary loops smaller than maxHoleSize edges are gathered first;
+ * the holes are then triangulated concurrently, without touching the mesh,
+ * and all the new faces are committed at the end. Holes sharing a vertex (or,
+ * if selfIntersection is true, with overlapping bounding boxes) are closed
+ * one after the other by the same thread. Ears whose closing edge already
+ * exists, in the mesh or among the new faces, are rejected, so the result
+ * stays two manifold.
+ *
+ * If selfIntersection is true, ears intersecting either the faces of the mesh
+ * overlapping the hole bounding box or the ears already created for the same
+ * hole are rejected. The faces overlapping each hole are collected in a
+ * single parallel pass over the mesh and indexed in a small per hole bounding
+ * volume hierarchy. Holes that cannot be closed without self intersections are
+ * left open.
+ *
+ * Requires FF adjacency, which is updated. Returns the number of closed holes.
+ */
+int ParallelHoleFill(
+	CMeshO&           m,
+	int               maxHoleSize,
+	bool              selected,
+	bool              selfIntersection,
+	vcg::CallBackPos* cb = nullptr);
+
+#endif // HOLE_FILLING_PARALLEL_H
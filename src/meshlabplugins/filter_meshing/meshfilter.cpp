@@ -31,13 +31,15 @@
 #include <vcg/complex/algorithms/clustering.h>
 #include <vcg/complex/algorithms/attribute_seam.h>
 #include <vcg/complex/algorithms/update/curvature.h>
-#include <vcg/complex/algorithms/update/curvature_fitting.h>
-#include <vcg/complex/algorithms/pointcloud_normal.h>
 #include <vcg/complex/algorithms/isotropic_remeshing.h>
 #include <vcg/complex/algorithms/refine_doosabin.h>
 #include <vcg/space/fitting3.h>
 #include <wrap/gl/glu_tessellator_cap.h>
 #include "quadric_simp.h"
+#include "pointcloud_normal_parallel.h"
+#include "curvature_parallel.h"
+#include "hole_filling_parallel.h"
+#include "planar_sections.h"
 
 using namespace std;
 using namespace vcg;
@@ -105,6 +107,7 @@ ExtraMeshFilterPlugin::ExtraMeshFilterPlugin(void)
 		FP_VATTR_SEAM,
 		FP_REFINE_LS3_LOOP,
 		FP_SLICE_WITH_A_PLANE,
+		FP_SLICE_WITH_MULTIPLE_PLANES,
 		FP_PERIMETER_POLYLINE
 	};
 
@@ -186,6 +189,7 @@ ExtraMeshFilterPlugin::FilterClass ExtraMeshFilterPlugin::getClass(const QAction
 
 	case FP_PERIMETER_POLYLINE               :
 	case FP_SLICE_WITH_A_PLANE               :
+	case FP_SLICE_WITH_MULTIPLE_PLANES       :
 	case FP_CYLINDER_UNWRAP                  : return FilterPlugin::Measure;
 
 	default                                  : assert(0); return FilterPlugin::Generic;
@@ -218,6 +222,7 @@ int ExtraMeshFilterPlugin::getPreConditions(const QAction *filter) const
 	case FP_FAUX_EXTRACT                     :
 	case FP_VATTR_SEAM                       :
 	case FP_SLICE_WITH_A_PLANE               :
+	case FP_SLICE_WITH_MULTIPLE_PLANES       :
 	case FP_PERIMETER_POLYLINE               :
 	case FP_REFINE_LS3_LOOP                  : return MeshModel::MM_FACENUMBER;
 	case FP_NORMAL_SMOOTH_POINTCLOUD         : return MeshModel::MM_VERTNORMAL;
@@ -289,6 +294,7 @@ QString ExtraMeshFilterPlugin::pythonFilterName(ActionIDType f) const
 	case FP_VATTR_SEAM: return tr("meshing_vertex_attribute_seam");
 	case FP_REFINE_LS3_LOOP: return tr("meshing_surface_subdivision_ls3_loop");
 	case FP_SLICE_WITH_A_PLANE: return tr("generate_polyline_from_planar_section");
+	case FP_SLICE_WITH_MULTIPLE_PLANES: return tr("generate_polyline_from_multiple_planar_sections");
 	case FP_PERIMETER_POLYLINE: return tr("generate_polyline_from_selection_perimeter");
 
 	default: assert(0); return QString();
@@ -335,6 +341,7 @@ QString ExtraMeshFilterPlugin::filterName(ActionIDType filter) const
 	case FP_VATTR_SEAM: return tr("Vertex Attribute Seam");
 	case FP_REFINE_LS3_LOOP: return tr("Subdivision Surfaces: LS3 Loop");
 	case FP_SLICE_WITH_A_PLANE: return tr("Compute Planar Section");
+	case FP_SLICE_WITH_MULTIPLE_PLANES: return tr("Compute Multiple Planar Sections");
 	case FP_PERIMETER_POLYLINE: return tr("Create Selection Perimeter Polyline");
 
 	default: assert(0); return QString();
@@ -422,6 +429,7 @@ QString ExtraMeshFilterPlugin::filterInfo(ActionIDType filterID) const
 			                                               "vertices are duplicated whenever two or more selected wedge or face attributes do not match.<br/>"
 			                                               "This is particularly useful for GPU-friendly mesh layout, where a single index must be used to access all required vertex attributes.");
 	case FP_SLICE_WITH_A_PLANE                 : return tr("Compute the polyline representing a planar section (a slice) of a mesh; if the resulting polyline is closed the result is filled and also a triangular mesh representing the section is saved");
+	case FP_SLICE_WITH_MULTIPLE_PLANES         : return tr("Compute the polylines of a stack of equally spaced parallel planar sections of a mesh, spanning its whole extent along the chosen axis. All the sections are computed in a single pass over the faces; each section can be saved in its own layer or all of them in a single polyline layer, where the per vertex quality stores the index of the section.");
 	case FP_PERIMETER_POLYLINE                 : return tr("Create a new Layer with the perimeter polyline(s) of the selection borders");
 	case FP_FAUX_EXTRACT                       : return tr("Create a new Layer with an edge mesh composed only by the selected edges of the current mesh");
 
@@ -458,6 +466,8 @@ RichParameterList ExtraMeshFilterPlugin::initParameterList(const QAction * actio
 		parlst.addParam(RichEnum("CurvColorMethod", 0, curvColorMethods, tr("Quality/Color Mapping"), QString("Choose the curvature that is mapped into quality and visualized as per vertex color.")));
 		parlst.addParam(RichPercentage("Scale",maxVal*0.1,0,maxVal,"Curvature Scale","This parameter is used only for scale dependent methods: 'Scale Dependent Quadric Fitting' and 'PCA'."
 									" It specifies the scale at which the curvature is computed. e.g. for SDQF it specify how large is the patch where we fit the quadric used to compute curvature dirs."));
+		parlst.addParam(RichInt("ScaleNum",1,"Number of Scales","This parameter is used only by 'Scale Dependent Quadric Fitting'."
+									" If larger than one, the curvature selected in 'Quality/Color Mapping' is also computed, in the same pass, at Scale/2, Scale/4, ... and saved in the per vertex scalar attributes CurvatureScale1, CurvatureScale2, ... At most 16 scales are computed."));
 		parlst.addParam(RichBool("Autoclean",true,"Remove Unreferenced Vertices","If selected, before starting the filter will remove any unreference vertex (for which curvature values are not defined)"));
 		break;
 
@@ -715,6 +725,16 @@ RichParameterList ExtraMeshFilterPlugin::initParameterList(const QAction * actio
 	case FP_PERIMETER_POLYLINE:
 		break;
 
+	case FP_SLICE_WITH_MULTIPLE_PLANES:
+	{
+		QStringList axis = QStringList() <<"X Axis"<<"Y Axis"<<"Z Axis"<<"Custom Axis";
+		parlst.addParam(RichEnum   ("planeAxis", 2, axis, tr("Planes perpendicular to"), tr("The Slicing planes will be done perpendicular to the axis")));
+		parlst.addParam(RichDirection("customAxis",Point3f(0,1,0),"Custom axis","Specify a custom axis, this is only valid if the above parameter is set to Custom"));
+		parlst.addParam(RichInt    ("planeNum", 10, "Number of planes", "The number of equally spaced planes; the i-th plane is placed at (i+0.5)/planeNum of the extent of the mesh along the axis"));
+		parlst.addParam(RichBool   ("singleLayer", false, "Single layer", "If selected, all the sections are saved in a single polyline layer, with the index of the section stored in the per vertex quality; otherwise each section is saved in its own layer"));
+	}
+		break;
+
 	case FP_SLICE_WITH_A_PLANE:
 	{
 		QStringList axis = QStringList() <<"X Axis"<<"Y Axis"<<"Z Axis"<<"Custom Axis";
@@ -1386,18 +1406,18 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 
 	case FP_NORMAL_EXTRAPOLATION :
 	{
-		tri::PointCloudNormal<CMeshO>::Param p;
-		p.fittingAdjNum = par.getInt("K");
-		p.smoothingIterNum = par.getInt("smoothIter");
-		p.viewPoint = par.getPoint3m("viewPos");
-		p.useViewPoint = par.getBool("flipFlag");
-		tri::PointCloudNormal<CMeshO>::Compute(m.cm, p,cb);
+		ParallelPointCloudNormal(
+			m.cm,
+			par.getInt("K"),
+			par.getInt("smoothIter"),
+			par.getBool("flipFlag"),
+			par.getPoint3m("viewPos"),
+			cb);
 	} break;
 
 	case FP_NORMAL_SMOOTH_POINTCLOUD :
 	{
-		tri::Allocator<CMeshO>::CompactVertexVector(m.cm);
-		tri::Smooth<CMeshO>::VertexNormalPointCloud(m.cm,par.getInt("K"),1);
+		ParallelPointCloudNormalSmooth(m.cm, par.getInt("K"), 1, par.getBool("useDist"), cb);
 	} break;
 
 	case FP_COMPUTE_PRINC_CURV_DIR:
@@ -1415,15 +1435,31 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 			tri::Allocator<CMeshO>::CompactVertexVector(m.cm);
 			log( "Removed %d unreferenced vertices",delvert);
 		}
+		std::vector<std::vector<PrincipalCurvature>> otherScales;
 		switch(par.getEnum("Method"))
 		{
 		case 0:	tri::UpdateCurvature<CMeshO>::PrincipalDirections(m.cm); break;
 		case 1: tri::UpdateCurvature<CMeshO>::PrincipalDirectionsPCA(m.cm,CurvatureScale,true,cb); break;
 		case 2: tri::UpdateCurvature<CMeshO>::PrincipalDirectionsNormalCycle(m.cm); break;
-		case 3: tri::UpdateCurvatureFitting<CMeshO>::computeCurvature(m.cm); break;
-		case 4: tri::UpdateCurvatureFitting<CMeshO>::updateCurvatureLocal(m.cm,CurvatureScale,cb); break;
+		case 3: ParallelCurvatureFitting(m.cm, std::vector<Scalarm>(), nullptr, cb); break;
+		case 4: {
+			const int maxScaleNum = 16;
+			int scaleNum = par.getInt("ScaleNum");
+			if (scaleNum > maxScaleNum)
+				log("Number of Scales clamped to %d", maxScaleNum);
+			std::vector<Scalarm> radii(std::min(std::max(1, scaleNum), maxScaleNum));
+			for (size_t i = 0; i < radii.size(); ++i)
+				radii[i] = std::ldexp(CurvatureScale, -int(i));
+			ParallelCurvatureFitting(m.cm, radii, &otherScales, cb);
+		} break;
 		default:assert(0);break;
 		}
+		for (size_t s = 0; s < otherScales.size(); ++s) {
+			std::string attrName = "CurvatureScale" + std::to_string(s + 1);
+			auto h = tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m.cm, attrName);
+			for (size_t i = 0; i < m.cm.vert.size(); ++i)
+				h[i] = CurvatureMeasure(otherScales[s][i], par.getEnum("CurvColorMethod"));
+		}
 		switch(par.getEnum("CurvColorMethod"))
 		{
 		case 0: tri::UpdateQuality<CMeshO>::VertexMeanFromCurvatureDir    (m.cm); break;
@@ -1454,11 +1490,7 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 		bool SelectedFlag = par.getBool("Selected");
 		bool SelfIntersectionFlag = par.getBool("SelfIntersection");
 		bool NewFaceSelectedFlag = par.getBool("NewFaceSelected");
-		int holeCnt;
-		if( SelfIntersectionFlag )
-			holeCnt = tri::Hole<CMeshO>::EarCuttingIntersectionFill<tri::SelfIntersectionEar< CMeshO> >(m.cm,MaxHoleSize,SelectedFlag,cb);
-		else
-			holeCnt = tri::Hole<CMeshO>::EarCuttingFill<vcg::tri::MinimumWeightEar< CMeshO> >(m.cm,MaxHoleSize,SelectedFlag,cb);
+		int holeCnt = ParallelHoleFill(m.cm, MaxHoleSize, SelectedFlag, SelfIntersectionFlag, cb);
 		log("Closed %i holes and added %i new faces",holeCnt,m.cm.fn-OriginalSize);
 		outputValues["closed_holes"] = holeCnt;
 		outputValues["new_faces"] = (int)(m.cm.fn-OriginalSize);
@@ -1763,6 +1795,79 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 		tri::UpdateBounding<CMeshO>::Box(perimeter->cm);
 	}break;
 
+	case FP_SLICE_WITH_MULTIPLE_PLANES:
+	{
+		Point3m planeAxis(0,0,0);
+		int ind = par.getEnum("planeAxis");
+		if(ind>=0 && ind<3)
+			planeAxis[ind] = 1.0f;
+		else
+			planeAxis=par.getPoint3m("customAxis");
+		planeAxis.Normalize();
+
+		int planeNum = par.getInt("planeNum");
+		if (planeNum < 1)
+			throw MLException("The number of planes must be at least one");
+
+		// extent of the transformed mesh along the slicing axis
+		Scalarm minD = std::numeric_limits<Scalarm>::max();
+		Scalarm maxD = std::numeric_limits<Scalarm>::lowest();
+		for (const CVertexO& v : m.cm.vert) {
+			if (!v.IsD()) {
+				Scalarm d = (m.cm.Tr * v.cP()).dot(planeAxis);
+				minD = std::min(minD, d);
+				maxD = std::max(maxD, d);
+			}
+		}
+		std::vector<Scalarm> offsets(planeNum);
+		for (int i = 0; i < planeNum; ++i)
+			offsets[i] = minD + (maxD - minD) * (i + 0.5) / planeNum;
+
+		std::vector<PlanarSection> sections;
+		ComputePlanarSections(m.cm, m.cm.Tr, planeAxis, offsets, sections, cb);
+
+		QString sectionName = QFileInfo(m.shortName()).baseName() + "_sect";
+		switch(ind)
+		{
+		case 0:  sectionName.append("_X");  break;
+		case 1:  sectionName.append("_Y");  break;
+		case 2:  sectionName.append("_Z");  break;
+		case 3:  sectionName.append("_custom");  break;
+		}
+
+		bool singleLayer = par.getBool("singleLayer");
+		std::vector<MeshModel*> layers;
+		for (int i = 0; i < planeNum; ++i) {
+			const PlanarSection& s = sections[i];
+			if (!singleLayer || layers.empty()) {
+				layers.push_back(md.addNewMesh("", singleLayer ? sectionName : sectionName + "_" + QString::number(i), true));
+				// in a single layer, the vertex quality keeps the section index
+				if (singleLayer)
+					layers.back()->updateDataMask(MeshModel::MM_VERTQUALITY);
+			}
+			MeshModel* cap = layers.back();
+			if (s.edge.empty())
+				continue;
+			auto vi = tri::Allocator<CMeshO>::AddVertices(cap->cm, s.vert.size());
+			auto ei = tri::Allocator<CMeshO>::AddEdges(cap->cm, s.edge.size());
+			CMeshO::VertexPointer vBase = &*vi;
+			for (const Point3m& p : s.vert) {
+				vi->P() = p;
+				if (singleLayer)
+					vi->Q() = i;
+				++vi;
+			}
+			for (const std::pair<int, int>& e : s.edge) {
+				ei->V(0) = vBase + e.first;
+				ei->V(1) = vBase + e.second;
+				++ei;
+			}
+		}
+		for (MeshModel* cap : layers)
+			tri::UpdateBounding<CMeshO>::Box(cap->cm);
+		log("Computed %d sections", planeNum);
+	} break;
+
 	case FP_SLICE_WITH_A_PLANE:
 	{
 		Point3m planeAxis(0,0,0);
@@ -1920,6 +2025,7 @@ int ExtraMeshFilterPlugin::postCondition(const QAction * filter) const
 	case FP_COMPUTE_PRINC_CURV_DIR : return MeshModel::MM_VERTFACETOPO | MeshModel::MM_FACEFACETOPO | MeshModel::MM_VERTCURV | MeshModel::MM_VERTCURVDIR | MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTQUALITY;
 
 	case FP_SLICE_WITH_A_PLANE :
+	case FP_SLICE_WITH_MULTIPLE_PLANES :
 	case FP_PERIMETER_POLYLINE :
 	case FP_CYLINDER_UNWRAP : return MeshModel::MM_NONE; // they create a new layer
 
@@ -50,6 +50,7 @@ public:
 		FP_NORMAL_SMOOTH_POINTCLOUD,
 		FP_COMPUTE_PRINC_CURV_DIR,
 		FP_SLICE_WITH_A_PLANE,
+		FP_SLICE_WITH_MULTIPLE_PLANES,
 		FP_PERIMETER_POLYLINE,
 		FP_MIDPOINT,
 		FP_REORIENT ,
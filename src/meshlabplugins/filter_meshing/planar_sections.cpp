@@ -0,0 +1,127 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "planar_sections.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace vcg;
+
+void ComputePlanarSections(
+	const CMeshO&               m,
+	const Matrix44m&            tr,
+	const Point3m&              axis,
+	const std::vector<Scalarm>& offsets,
+	std::vector<PlanarSection>& sections,
+	CallBackPos*                cb)
+{
+	const int vn = (int) m.vert.size();
+	const int fn = (int) m.face.size();
+	const int pn = (int) offsets.size();
+
+	sections.assign(pn, PlanarSection());
+	for (int i = 0; i < pn; ++i)
+		sections[i].offset = offsets[i];
+	if (pn == 0)
+		return;
+
+	// transformed positions and their height along the slicing axis
+	std::vector<Point3m> pos(vn);
+	std::vector<double>  height(vn);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i) {
+		pos[i]    = tr * m.vert[i].cP();
+		height[i] = double(pos[i].dot(axis));
+	}
+
+	// range [first, last) of the planes crossing the extent of each face
+	if (cb) cb(10, "Sorting faces along the slicing axis");
+	std::vector<std::pair<int, int>> range(fn, std::make_pair(0, 0));
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i) {
+		const CFaceO& f = m.face[i];
+		if (f.IsD())
+			continue;
+		double fMin = height[tri::Index(m, f.cV(0))];
+		double fMax = fMin;
+		for (int j = 1; j < 3; ++j) {
+			fMin = std::min(fMin, height[tri::Index(m, f.cV(j))]);
+			fMax = std::max(fMax, height[tri::Index(m, f.cV(j))]);
+		}
+		range[i].first  = std::lower_bound(offsets.begin(), offsets.end(), Scalarm(fMin)) - offsets.begin();
+		range[i].second = std::upper_bound(offsets.begin(), offsets.end(), Scalarm(fMax)) - offsets.begin();
+	}
+
+	// bucket the faces per plane (counting sort over the plane ranges)
+	std::vector<size_t> start(pn + 1, 0);
+	for (int i = 0; i < fn; ++i)
+		for (int p = range[i].first; p < range[i].second; ++p)
+			++start[p + 1];
+	for (int p = 0; p < pn; ++p)
+		start[p + 1] += start[p];
+	std::vector<int>    bucket(start[pn]);
+	std::vector<size_t> fill(start.begin(), start.end() - 1);
+	for (int i = 0; i < fn; ++i)
+		for (int p = range[i].first; p < range[i].second; ++p)
+			bucket[fill[p]++] = i;
+	std::vector<std::pair<int, int>>().swap(range);
+
+	if (cb) cb(40, "Building sections");
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int p = 0; p < pn; ++p) {
+		PlanarSection& s   = sections[p];
+		const double   off = double(offsets[p]);
+		// shared vertices are keyed on the crossed mesh edge
+		std::unordered_map<uint64_t, int> edgeVert;
+		auto crossing = [&](int a, int b) {
+			if (a > b)
+				std::swap(a, b);
+			const uint64_t key = (uint64_t(a) << 32) | uint64_t(b);
+			auto           it  = edgeVert.find(key);
+			if (it != edgeVert.end())
+				return it->second;
+			const double t = (off - height[a]) / (height[b] - height[a]);
+			s.vert.push_back(pos[a] + (pos[b] - pos[a]) * Scalarm(t));
+			edgeVert[key] = (int) s.vert.size() - 1;
+			return (int) s.vert.size() - 1;
+		};
+
+		for (size_t k = start[p]; k < start[p + 1]; ++k) {
+			const CFaceO& f = m.face[bucket[k]];
+			int           vi[3];
+			bool          above[3];
+			for (int j = 0; j < 3; ++j) {
+				vi[j]    = (int) tri::Index(m, f.cV(j));
+				above[j] = height[vi[j]] >= off;
+			}
+			int seg[2], cnt = 0;
+			for (int j = 0; j < 3; ++j) {
+				if (above[j] != above[(j + 1) % 3])
+					seg[cnt++] = crossing(vi[j], vi[(j + 1) % 3]);
+			}
+			if (cnt == 2)
+				s.edge.push_back(std::make_pair(seg[0], seg[1]));
+		}
+	}
+}
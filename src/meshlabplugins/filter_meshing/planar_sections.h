@@ -0,0 +1,57 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef PLANAR_SECTIONS_H
+#define PLANAR_SECTIONS_H
+
+#include <common/ml_document/cmesh.h>
+
+/** Polyline of a single planar section: an indexed segment soup whose
+ * vertices are shared among the segments that cross the same mesh edge. */
+struct PlanarSection
+{
+	Scalarm                          offset;
+	std::vector<Point3m>             vert;
+	std::vector<std::pair<int, int>> edge;
+};
+
+/**
+ * Slices the mesh m, transformed by tr, with all the planes
+ * {p : p.dot(axis) == offsets[i]} in a single sweep.
+ *
+ * Each face is assigned, through a binary search over the sorted offsets,
+ * to the range of planes crossing its extent along axis; faces are then
+ * bucketed per plane and the polylines of the different planes are built
+ * concurrently. Vertices lying exactly on a plane are considered above it,
+ * so that every crossed face contributes exactly one segment.
+ *
+ * offsets must be sorted in increasing order; axis must be normalized.
+ */
+void ComputePlanarSections(
+	const CMeshO&               m,
+	const Matrix44m&            tr,
+	const Point3m&              axis,
+	const std::vector<Scalarm>& offsets,
+	std::vector<PlanarSection>& sections,
+	vcg::CallBackPos*           cb = nullptr);
+
+#endif // PLANAR_SECTIONS_H
@@ -0,0 +1,284 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "pointcloud_normal_parallel.h"
+
+#include <algorithm>
+#include <queue>
+#include <Eigen/Eigenvalues>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+
+using namespace vcg;
+
+namespace {
+
+typedef KdTree<Scalarm> KdTreem;
+
+/* Fills knn with the k nearest neighbours of each vertex, query point excluded.
+ * The neighbours of vertex i are stored, sorted by distance, starting at
+ * knn[i*k]; rows with less than k neighbours are padded with -1. */
+void computeNeighbourTable(CMeshO& m, int k, std::vector<int>& knn, CallBackPos* cb)
+{
+	if (cb) cb(1, "Building kd-tree");
+	VertexConstDataWrapper<CMeshO> ww(m);
+	KdTreem tree(ww);
+
+	const int vn = (int) m.vert.size();
+	knn.assign(size_t(vn) * k, -1);
+
+	if (cb) cb(10, "Querying nearest neighbours");
+#pragma omp parallel
+	{
+		KdTreem::PriorityQueue nq;
+		std::vector<std::pair<Scalarm, int>> nb;
+		nb.reserve(k + 1);
+#pragma omp for schedule(dynamic, 1024)
+		for (int i = 0; i < vn; ++i) {
+			tree.doQueryK(m.vert[i].cP(), k + 1, nq);
+			nb.clear();
+			for (int j = 0; j < nq.getNofElements(); ++j) {
+				if (nq.getIndex(j) != i)
+					nb.push_back(std::make_pair(nq.getWeight(j), nq.getIndex(j)));
+			}
+			std::sort(nb.begin(), nb.end());
+			int* row = &knn[size_t(i) * k];
+			for (int j = 0; j < k && j < (int) nb.size(); ++j)
+				row[j] = nb[j].second;
+		}
+	}
+}
+
+/* Least squares plane normal of the vertex i and its neighbours, computed with
+ * the closed form eigen solver for 3x3 symmetric matrices. */
+Point3m fitNormal(const CMeshO& m, int i, const int* row, int k)
+{
+	Point3d centroid = Point3d::Construct(m.vert[i].cP());
+	int     cnt      = 1;
+	for (int j = 0; j < k && row[j] >= 0; ++j, ++cnt)
+		centroid += Point3d::Construct(m.vert[row[j]].cP());
+	centroid /= double(cnt);
+
+	Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+	Point3d         d   = Point3d::Construct(m.vert[i].cP()) - centroid;
+	Eigen::Vector3d ed(d[0], d[1], d[2]);
+	cov.noalias() += ed * ed.transpose();
+	for (int j = 0; j < k && row[j] >= 0; ++j) {
+		d  = Point3d::Construct(m.vert[row[j]].cP()) - centroid;
+		ed = Eigen::Vector3d(d[0], d[1], d[2]);
+		cov.noalias() += ed * ed.transpose();
+	}
+
+	Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> es;
+	es.computeDirect(cov);
+	Eigen::Vector3d n = es.eigenvectors().col(0);
+	return Point3m(n[0], n[1], n[2]);
+}
+
+/* One Jacobi iteration of unoriented normal smoothing over the neighbour table:
+ * the neighbour normals are flipped to agree with the current one before
+ * being accumulated. If useDist, each contribution is weighted by a gaussian of
+ * the distance, with the farthest neighbour distance as sigma. */
+void smoothNormals(CMeshO& m, int k, const std::vector<int>& knn, bool useDist, std::vector<Point3m>& buf)
+{
+	const int vn = (int) m.vert.size();
+	buf.resize(vn);
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i) {
+		const int*     row = &knn[size_t(i) * k];
+		const Point3m& ni  = m.vert[i].cN();
+		const Point3m& pi  = m.vert[i].cP();
+		Scalarm        sigma2 = 0;
+		if (useDist) {
+			for (int j = 0; j < k && row[j] >= 0; ++j)
+				sigma2 = std::max(sigma2, SquaredDistance(pi, m.vert[row[j]].cP()));
+		}
+		Point3m acc = ni;
+		for (int j = 0; j < k && row[j] >= 0; ++j) {
+			Point3m nj = m.vert[row[j]].cN();
+			if (nj.dot(ni) < 0)
+				nj = -nj;
+			if (useDist && sigma2 > 0)
+				nj *= std::exp(-SquaredDistance(pi, m.vert[row[j]].cP()) / sigma2);
+			acc += nj;
+		}
+		buf[i] = acc.Normalize();
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		m.vert[i].N() = buf[i];
+}
+
+int findRoot(std::vector<int>& parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i         = parent[i];
+	}
+	return i;
+}
+
+/* Consistent orientation (Hoppe et al. 92): normals are propagated along a
+ * minimum spanning tree of the symmetric k-nn graph, with edge weights
+ * 1-|ni.nj|. Each connected component is seeded with its vertex farthest from
+ * the bbox center, whose normal is oriented outwards. */
+void orientByMinimumSpanningTree(CMeshO& m, int k, const std::vector<int>& knn, CallBackPos* cb)
+{
+	const int vn = (int) m.vert.size();
+
+	// symmetric adjacency of the neighbour graph, in compressed row format
+	std::vector<int> start(vn + 1, 0);
+	for (int i = 0; i < vn; ++i) {
+		const int* row = &knn[size_t(i) * k];
+		for (int j = 0; j < k && row[j] >= 0; ++j) {
+			++start[i + 1];
+			++start[row[j] + 1];
+		}
+	}
+	for (int i = 0; i < vn; ++i)
+		start[i + 1] += start[i];
+	std::vector<int> adj(start[vn]);
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (int i = 0; i < vn; ++i) {
+		const int* row = &knn[size_t(i) * k];
+		for (int j = 0; j < k && row[j] >= 0; ++j) {
+			adj[fill[i]++]      = row[j];
+			adj[fill[row[j]]++] = i;
+		}
+	}
+	std::vector<int>().swap(fill);
+
+	// connected components and their seeds
+	std::vector<int> parent(vn);
+	for (int i = 0; i < vn; ++i)
+		parent[i] = i;
+	for (int i = 0; i < vn; ++i)
+		for (int e = start[i]; e < start[i + 1]; ++e)
+			parent[findRoot(parent, i)] = findRoot(parent, adj[e]);
+
+	tri::UpdateBounding<CMeshO>::Box(m);
+	const Point3m    center = m.bbox.Center();
+	std::vector<int> seed(vn, -1);
+	for (int i = 0; i < vn; ++i) {
+		int r = findRoot(parent, i);
+		if (seed[r] < 0 || SquaredDistance(m.vert[i].cP(), center) >
+							   SquaredDistance(m.vert[seed[r]].cP(), center))
+			seed[r] = i;
+	}
+
+	if (cb) cb(80, "Orienting normals");
+	struct Arc
+	{
+		Scalarm w;
+		int     from, to;
+		bool    operator<(const Arc& a) const { return w > a.w; } // min-heap
+	};
+	std::vector<bool>        visited(vn, false);
+	std::priority_queue<Arc> heap;
+	auto visit = [&](int v) {
+		visited[v] = true;
+		for (int e = start[v]; e < start[v + 1]; ++e) {
+			int u = adj[e];
+			if (!visited[u])
+				heap.push(Arc {Scalarm(1) - std::abs(m.vert[v].cN().dot(m.vert[u].cN())), v, u});
+		}
+	};
+
+	for (int r = 0; r < vn; ++r) {
+		if (parent[r] != r)
+			continue;
+		int s = seed[r];
+		if (m.vert[s].cN().dot(m.vert[s].cP() - center) < 0)
+			m.vert[s].N() = -m.vert[s].N();
+		visit(s);
+		while (!heap.empty()) {
+			Arc a = heap.top();
+			heap.pop();
+			if (visited[a.to])
+				continue;
+			if (m.vert[a.from].cN().dot(m.vert[a.to].cN()) < 0)
+				m.vert[a.to].N() = -m.vert[a.to].N();
+			visit(a.to);
+		}
+	}
+}
+
+} // namespace
+
+void ParallelPointCloudNormal(
+	CMeshO&        m,
+	int            fittingAdjNum,
+	int            smoothingIterNum,
+	bool           useViewPoint,
+	const Point3m& viewPoint,
+	CallBackPos*   cb)
+{
+	tri::Allocator<CMeshO>::CompactVertexVector(m);
+	if (m.vn == 0 || fittingAdjNum < 1)
+		return;
+	const int vn = (int) m.vert.size();
+	const int k  = fittingAdjNum;
+
+	std::vector<int> knn;
+	computeNeighbourTable(m, k, knn, cb);
+
+	if (cb) cb(50, "Fitting planes");
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < vn; ++i)
+		m.vert[i].N() = fitNormal(m, i, &knn[size_t(i) * k], k);
+
+	std::vector<Point3m> buf;
+	for (int it = 0; it < smoothingIterNum; ++it) {
+		if (cb) cb(60 + 20 * it / smoothingIterNum, "Smoothing normals");
+		smoothNormals(m, k, knn, false, buf);
+	}
+
+	if (useViewPoint) {
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < vn; ++i) {
+			if (m.vert[i].cN().dot(viewPoint - m.vert[i].cP()) < 0)
+				m.vert[i].N() = -m.vert[i].N();
+		}
+	}
+	else {
+		orientByMinimumSpanningTree(m, k, knn, cb);
+	}
+}
+
+void ParallelPointCloudNormalSmooth(CMeshO& m, int neighborNum, int iterNum, bool useDist, CallBackPos* cb)
+{
+	tri::Allocator<CMeshO>::CompactVertexVector(m);
+	if (m.vn == 0 || neighborNum < 1)
+		return;
+
+	std::vector<int> knn;
+	computeNeighbourTable(m, neighborNum, knn, cb);
+
+	std::vector<Point3m> buf;
+	for (int it = 0; it < iterNum; ++it) {
+		if (cb) cb(50 + 50 * it / iterNum, "Smoothing normals");
+		smoothNormals(m, neighborNum, knn, useDist, buf);
+	}
+}
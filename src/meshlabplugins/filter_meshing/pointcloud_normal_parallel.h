@@ -0,0 +1,64 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef POINTCLOUD_NORMAL_PARALLEL_H
+#define POINTCLOUD_NORMAL_PARALLEL_H
+
+#include <common/ml_document/cmesh.h>
+
+/**
+ * Multi-threaded replacement of vcg::tri::PointCloudNormal<CMeshO>::Compute.
+ *
+ * The k nearest neighbours of every vertex are queried once (in parallel) and
+ * stored in a flat table that is then reused by the PCA plane fitting, by the
+ * optional smoothing iterations and by the orientation pass.
+ * If useViewPoint is true, normals are oriented towards viewPoint (e.g. the
+ * scanner position stored in the mesh Shot), otherwise the orientation is
+ * propagated along a minimum spanning tree of the neighbour graph.
+ *
+ * The mesh vertex vector is compacted.
+ */
+void ParallelPointCloudNormal(
+	CMeshO&           m,
+	int               fittingAdjNum,
+	int               smoothingIterNum,
+	bool              useViewPoint,
+	const Point3m&    viewPoint,
+	vcg::CallBackPos* cb = nullptr);
+
+/**
+ * Multi-threaded replacement of vcg::tri::Smooth<CMeshO>::VertexNormalPointCloud.
+ *
+ * Each normal is replaced by the (sign consistent) average of the normals of its
+ * neighborNum nearest neighbours; if useDist is true, the contribution of each
+ * neighbour is weighted by a gaussian of its distance.
+ *
+ * The mesh vertex vector is compacted.
+ */
+void ParallelPointCloudNormalSmooth(
+	CMeshO&           m,
+	int               neighborNum,
+	int               iterNum,
+	bool              useDist,
+	vcg::CallBackPos* cb = nullptr);
+
+#endif // POINTCLOUD_NORMAL_PARALLEL_H
@@ -59,11 +59,16 @@ class BallTree
         typedef vcg::Point3<Scalar> VectorType;
 
         BallTree(const vcg::ConstDataWrapper<VectorType>& points, const vcg::ConstDataWrapper<Scalar>& radii);
+        ~BallTree() { delete mRootNode; }
 
         void computeNeighbors(const VectorType& x, Neighborhood<Scalar>* pNei) const;
 
         void setRadiusScale(Scalar v) { mRadiusScale = v; mTreeIsUptodate = false; }
 
+        /** builds the tree if needed. Concurrent calls to computeNeighbors are
+          * safe only once the tree is up to date. */
+        void update() { if (!mTreeIsUptodate) rebuild(); }
+
     protected:
 
         struct Node
@@ -99,7 +104,7 @@ class BallTree
         void split(const IndexArray& indices, const AxisAlignedBoxType& aabbLeft, const AxisAlignedBoxType& aabbRight,
                             IndexArray& iLeft, IndexArray& iRight);
         void buildNode(Node& node, std::vector<int>& indices, AxisAlignedBoxType aabb, int level);
-        void queryNode(Node& node, Neighborhood<Scalar>* pNei) const;
+        void queryNode(const Node& node, const VectorType& x, Neighborhood<Scalar>* pNei) const;
 
     protected:
         vcg::ConstDataWrapper<VectorType> mPoints;
@@ -108,8 +113,7 @@ class BallTree
 
         int mMaxTreeDepth;
         int mTargetCellSize;
-        mutable bool mTreeIsUptodate;
-        mutable VectorType mQueryPosition;
+        bool mTreeIsUptodate;
 
         Node* mRootNode;
 };
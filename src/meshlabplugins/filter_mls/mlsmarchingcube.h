@@ -26,24 +26,35 @@
 
 #include <vcg/space/point3.h>
 #include <vcg/space/box3.h>
+#include <vcg/complex/algorithms/create/marching_cubes.h>
 #include <common/ml_document/mesh_model.h>
-#include <map>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include "mlssurface.h"
 
 namespace vcg {
 namespace tri {
 
+/*
+ * Marching cubes over an MLS surface.
+ *
+ * The grid is processed in blocks of mMaxBlockSize^3 corners, so the memory
+ * does not depend on the resolution. The blocks are polygonized concurrently,
+ * each one in its own mesh and through its own query context of the surface
+ * (see MlsSurface::clone()); the vertices are identified by the global id of
+ * the grid edge they lie on, which allows to weld the seams exactly when the
+ * block meshes are merged.
+ */
 template <class MeshType, class SurfaceType>
 class MlsWalker
 {
 private:
-    typedef int VertexIndex;
     typedef typename MeshType::ScalarType ScalarType;
     typedef typename MeshType::CoordType VectorType;
     typedef typename MeshType::VertexPointer VertexPointer;
-    //typedef GaelMls::MlsSurface<MeshType> SurfaceType;
     typedef long long unsigned int Key;
-    typedef std::map<Key,VertexIndex> MapType;
 
     struct GridElement
     {
@@ -52,11 +63,189 @@ private:
     };
 
     template <typename T>
-    inline bool IsFinite(T value)
+    static inline bool IsFinite(T value)
     {
         return (value>=-std::numeric_limits<T>::max()) && (value<=std::numeric_limits<T>::max());
     }
 
+    /*
+     * Walker of a single block, used by vcg::tri::MarchingCubes.
+     * The cells are addressed with global coordinates.
+     */
+    class BlockWalker
+    {
+    public:
+        BlockWalker(const MlsWalker& parent, MeshType& mesh, std::vector<Key>& keys) :
+            mParent(parent), mMesh(mesh), mKeys(keys)
+        {
+            int n = mParent.mMaxBlockSize;
+            mCache.resize(n*n*n);
+        }
+
+        /* fills the grid values of the block bi; returns false if the block
+         * does not intersect the surface definition domain */
+        bool Fill(const vcg::Point3i& bi, SurfaceType& surface)
+        {
+            const int n = mParent.mMaxBlockSize;
+            const ScalarType invalidValue = SurfaceType::InvalidValue();
+            mBlockOrigin = bi * (n-1);
+            for (int k=0 ; k<3 ; ++k)
+                mGridSize[k] = std::min<int>(n, mParent.mNofCells[k]-mBlockOrigin[k]);
+
+            bool valid = false;
+            vcg::Point3i ci; // local cell id
+            for (ci[2]=0 ; ci[2]<mGridSize[2] ; ++ci[2])
+            for (ci[1]=0 ; ci[1]<mGridSize[1] ; ++ci[1])
+            for (ci[0]=0 ; ci[0]<mGridSize[0] ; ++ci[0])
+            {
+                GridElement& el = mCache[GetLocalCellId(ci)];
+                // computed from the global index, so that corners shared by two blocks match
+                vcg::Point3i gi = ci + mBlockOrigin;
+                el.position = mParent.mAABB.min + VectorType(gi[0],gi[1],gi[2]) * mParent.mStep;
+                el.value = surface.potential(el.position);
+                if (!surface.isInDomain(el.position))
+                    el.value = invalidValue;
+                else
+                    valid = true;
+            }
+            return valid;
+        }
+
+        /* polygonizes the cells of the last filled block */
+        template<class EXTRACTOR_TYPE>
+        void Extract(EXTRACTOR_TYPE& extractor)
+        {
+            const int n = mParent.mMaxBlockSize;
+            const ScalarType invalidValue = SurfaceType::InvalidValue();
+
+            // precomputed offsets to access the cell corners
+            const int offsets[8] = {
+                    0,
+                    1,
+                    1+n*n,
+                    n*n,
+                    n,
+                    1+n,
+                    1+n+n*n,
+                    n+n*n
+            };
+
+            vcg::Point3i ci; // local cell id
+            for (ci[0]=0 ; ci[0]<mGridSize[0]-1 ; ++ci[0])
+            for (ci[1]=0 ; ci[1]<mGridSize[1]-1 ; ++ci[1])
+            for (ci[2]=0 ; ci[2]<mGridSize[2]-1 ; ++ci[2])
+            {
+                int cellId = GetLocalCellId(ci);
+                // check if one corner is outside the surface definition domain
+                bool out =false;
+                for (int k=0; k<8 && (!out); ++k)
+                    out = out || (!IsFinite(mCache[cellId+offsets[k]].value))
+                                        || mCache[cellId+offsets[k]].value==invalidValue;
+
+                if (!out)
+                {
+                    extractor.ProcessCell(ci+mBlockOrigin, ci+mBlockOrigin+vcg::Point3i(1,1,1));
+                }
+            }
+        }
+
+        int GetLocalCellId(const vcg::Point3i& p) const
+        {
+            const int n = mParent.mMaxBlockSize;
+            return p[0] + (p[1] + p[2]*n)*n;
+        }
+
+        int GetLocalCellIdFromGlobal(const vcg::Point3i& p) const
+        {
+            return GetLocalCellId(p - mBlockOrigin);
+        }
+
+        float V(int pi, int pj, int pk)
+        {
+            return mCache[GetLocalCellIdFromGlobal(vcg::Point3i(pi, pj, pk))].value;
+        }
+
+        void GetIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v, bool create)
+        {
+            Key id1 = mParent.GetGlobalCellId(p1);
+            Key id2 = mParent.GetGlobalCellId(p2);
+            if (id1>id2)
+                std::swap(id1,id2);
+            // p1 and p2 are adjacent corners: the edge is identified by its first corner and direction
+            Key k = id1*3 + (p1[0]!=p2[0] ? 0 : (p1[1]!=p2[1] ? 1 : 2));
+            typename std::unordered_map<Key,int>::iterator it = mVertexMap.find(k);
+            if (it!=mVertexMap.end())
+            {
+                // a vertex already exist
+                v = &mMesh.vert[it->second];
+            }
+            else if (create)
+            {
+                // let's create a new vertex
+                int vi = (int) mMesh.vert.size();
+                Allocator<MeshType>::AddVertices( mMesh, 1 );
+                mVertexMap[k] = vi;
+                mKeys.push_back(k);
+                v = &mMesh.vert[vi];
+                // interpol along the edge
+                ScalarType epsilon = ScalarType(1e-5);
+                const ScalarType isoValue = mParent.mIsoValue;
+                const GridElement& c1 = mCache[GetLocalCellIdFromGlobal(p1)];
+                const GridElement& c2 = mCache[GetLocalCellIdFromGlobal(p2)];
+                if (fabs(isoValue-c1.value) < epsilon)
+                    v->P().Import(c1.position);
+                else if (fabs(isoValue-c2.value) < epsilon)
+                    v->P().Import(c2.position);
+                else if (fabs(c1.value-c2.value) < epsilon)
+                    v->P().Import( (c1.position+c2.position)*0.5);
+                else
+                {
+                    ScalarType a = (isoValue - c1.value) / (c2.value - c1.value);
+                    v->P().Import(c1.position + (c2.position - c1.position) * a);
+                }
+            }
+            else
+            {
+                v = 0;
+            }
+        }
+
+        bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
+        {
+            GetIntercept(p0, p1, v, false);
+            return v!=0;
+        }
+
+        void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+        {
+            GetIntercept(p1, p2, v, true);
+        }
+        void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+        {
+            GetIntercept(p1, p2, v, true);
+        }
+        void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
+        {
+            GetIntercept(p1, p2, v, true);
+        }
+
+    private:
+        const MlsWalker& mParent;
+        MeshType& mMesh;
+        std::vector<Key>& mKeys;
+        std::unordered_map<Key,int> mVertexMap;
+        std::vector<GridElement> mCache;
+        vcg::Point3i mBlockOrigin;
+        vcg::Point3i mGridSize;
+    };
+
+    /* result of a block: its mesh and the edge key of each of its vertices */
+    struct BlockMesh
+    {
+        MeshType mesh;
+        std::vector<Key> keys;
+    };
+
 public:
 
     int resolution;
@@ -68,31 +257,16 @@ public:
         mIsoValue = 0;
     }
 
-    template<class EXTRACTOR_TYPE>
-    void BuildMesh(MeshType &mesh, SurfaceType &surface, EXTRACTOR_TYPE &extractor, CallBackPos *cb = 0)
+    void BuildMesh(MeshType &mesh, const SurfaceType &surface, CallBackPos *cb = 0)
     {
-        mpSurface = &surface;
-        const ScalarType invalidValue = SurfaceType::InvalidValue();
-
-        // precomputed offsets to access the cell corners
-        const int offsets[8] = {
-                0,
-                1,
-                1+mMaxBlockSize*mMaxBlockSize,
-                mMaxBlockSize*mMaxBlockSize,
-                mMaxBlockSize,
-                1+mMaxBlockSize,
-                1+mMaxBlockSize+mMaxBlockSize*mMaxBlockSize,
-                mMaxBlockSize+mMaxBlockSize*mMaxBlockSize
-        };
-
-        mAABB = mpSurface->boundingBox();
+        mAABB = surface.boundingBox();
 
         VectorType diag = mAABB.max - mAABB.min;
         mAABB.min -= diag * 0.1f;
         mAABB.max += diag * 0.1f;
         diag = mAABB.max - mAABB.min;
 
+        mesh.Clear();
         if (   (diag[0]<=0.)
                 || (diag[1]<=0.)
                 || (diag[2]<=0.)
@@ -101,175 +275,104 @@ public:
             return;
         }
 
-        mCache = new GridElement[(mMaxBlockSize)*(mMaxBlockSize)*(mMaxBlockSize)];
-        ScalarType step = vcg::math::Max(diag[0],diag[1],diag[2])/ScalarType(resolution);
-
-        unsigned int nofCells[3];
-        unsigned int nofBlocks[3];
+        mStep = vcg::math::Max(diag[0],diag[1],diag[2])/ScalarType(resolution);
 
-        for (uint k=0 ; k<3 ; ++k)
+        int nofBlocks[3];
+        for (int k=0 ; k<3 ; ++k)
         {
-            nofCells[k] = int(diag[k]/step)+2;
-            nofBlocks[k] = nofCells[k]/mMaxBlockSize + ( (nofCells[k]%mMaxBlockSize)==0 ? 0 : 1);
+            mNofCells[k] = int(diag[k]/mStep)+2;
+            nofBlocks[k] = (mNofCells[k]-1)/(mMaxBlockSize-1) + ( ((mNofCells[k]-1)%(mMaxBlockSize-1))==0 ? 0 : 1);
         }
 
-        _mesh = &mesh;
-        _mesh->Clear();
-
-        int countSubSlice = 0;
-        int totalSubSlices = nofBlocks[2] * nofBlocks[1] * nofCells[0];
-
-        extractor.Initialize();
-        // for each macro block
-        vcg::Point3i bi; // block id
-        for (bi[2]=0 ; (unsigned int)bi[2]<nofBlocks[2] ; ++bi[2])
-        for (bi[1]=0 ; (unsigned int)bi[1]<nofBlocks[1] ; ++bi[1])
-        for (bi[0]=0 ; (unsigned int)bi[0]<nofBlocks[0] ; ++bi[0])
+        // blocks are processed one layer at a time, the blocks of a layer concurrently
+        const int blocksPerLayer = nofBlocks[0]*nofBlocks[1];
+        std::vector<BlockMesh> blocks(blocksPerLayer * nofBlocks[2]);
+        for (int bz=0 ; bz<nofBlocks[2] ; ++bz)
         {
-            mBlockOrigin = bi * (mMaxBlockSize-1);
-
-            // compute the size of the local grid
-            for (uint k=0 ; k<3 ; ++k)
-            {
-                mGridSize[k] = std::min<int>(mMaxBlockSize, nofCells[k]-(mMaxBlockSize-1)*bi[k]);
-            }
-            VectorType origin = mAABB.min + VectorType(bi[0],bi[1],bi[2]) * (step * (mMaxBlockSize-1));
-
-            // fill the grid
-            vcg::Point3i ci; // local cell id
-
-            // for each corners...
-            for (ci[0]=0 ; ci[0]<mGridSize[0] ; ++ci[0])
+            if (cb)
+                cb((100*bz)/nofBlocks[2], "Marching cube...");
+#pragma omp parallel
             {
-                if (cb)
-                    cb((100*(++countSubSlice))/totalSubSlices, "Marching cube...");
-                for (ci[1]=0 ; ci[1]<mGridSize[1] ; ++ci[1])
-                for (ci[2]=0 ; ci[2]<mGridSize[2] ; ++ci[2])
+                std::unique_ptr<SurfaceType> context(surface.clone());
+#pragma omp for schedule(dynamic, 1)
+                for (int b=0 ; b<blocksPerLayer ; ++b)
                 {
-                    GridElement& el = mCache[(ci[2]*mMaxBlockSize + ci[1])*mMaxBlockSize + ci[0]];
-                    el.position = origin + VectorType(ci[0],ci[1],ci[2]) * step;
-                    el.value = mpSurface->potential(el.position);
-                    if (!mpSurface->isInDomain(el.position))
-                        el.value = invalidValue;
-                }
-            }
-
-            // polygonize the grid (marching cube)
-            // for each cell...
-            for (ci[0]=0 ; ci[0]<mGridSize[0]-1 ; ++ci[0])
-            for (ci[1]=0 ; ci[1]<mGridSize[1]-1 ; ++ci[1])
-            for (ci[2]=0 ; ci[2]<mGridSize[2]-1 ; ++ci[2])
-            {
-                uint cellId = ci[0]+mMaxBlockSize*(ci[1]+mMaxBlockSize*ci[2]);
-                // check if one corner is outside the surface definition domain
-                bool out =false;
-                for (int k=0; k<8 && (!out); ++k)
-                    out = out || (!IsFinite(mCache[cellId+offsets[k]].value))
-                                        || mCache[cellId+offsets[k]].value==invalidValue;
-
-                if (!out)
-                {
-                    extractor.ProcessCell(ci+mBlockOrigin, ci+mBlockOrigin+vcg::Point3i(1,1,1));
+                    BlockMesh& block = blocks[bz*blocksPerLayer + b];
+                    BlockWalker walker(*this, block.mesh, block.keys);
+                    if (walker.Fill(vcg::Point3i(b%nofBlocks[0], b/nofBlocks[0], bz), *context))
+                    {
+                        vcg::tri::MarchingCubes<MeshType, BlockWalker> extractor(block.mesh, walker);
+                        extractor.Initialize();
+                        walker.Extract(extractor);
+                        extractor.Finalize();
+                    }
                 }
             }
         }
-        extractor.Finalize();
-        _mesh   = NULL;
-        delete[] mCache;
-    };
 
-    int GetLocalCellId(const vcg::Point3i& p)
-    {
-        return p[0] + (p[1] + p[2]*mMaxBlockSize)*mMaxBlockSize;
+        MergeBlocks(blocks, mesh);
     }
 
-    int GetLocalCellIdFromGlobal(vcg::Point3i p)
-    {
-        p -= mBlockOrigin;
-        return GetLocalCellId(p);
-    }
-
-    float V(int pi, int pj, int pk)
-    {
-        return mCache[GetLocalCellIdFromGlobal(vcg::Point3i(pi, pj, pk))].value;
-    }
+protected:
 
-    int GetGlobalCellId(const vcg::Point3i &p)
+    Key GetGlobalCellId(const vcg::Point3i &p) const
     {
-        return p[0] + p[1] * resolution + p[2] * resolution * resolution;
+        return Key(p[0]) + Key(mNofCells[0]) * (Key(p[1]) + Key(mNofCells[1]) * Key(p[2]));
     }
 
-    void GetIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v, bool create)
+    /* appends the block meshes to mesh, welding the vertices lying on the same grid edge */
+    static void MergeBlocks(std::vector<BlockMesh>& blocks, MeshType& mesh)
     {
-        int id1 = GetGlobalCellId(p1);
-        int id2 = GetGlobalCellId(p2);
-        if (id1>id2)
-            std::swap(id1,id2);
-        Key k = Key(id1) + (Key(id2)<<32);
-        MapType::iterator it = mVertexMap.find(k);
-        if (it!=mVertexMap.end())
+        size_t vertNum = 0, faceNum = 0;
+        for (const BlockMesh& block : blocks)
         {
-            // a vertex already exist
-            v = &_mesh->vert[it->second];
+            vertNum += block.mesh.vert.size();
+            faceNum += block.mesh.face.size();
         }
-        else if (create)
+
+        std::unordered_map<Key,int> globalIndex;
+        globalIndex.reserve(vertNum);
+        std::vector<int> remap;
+        std::vector<VectorType> positions;
+        positions.reserve(vertNum);
+        std::vector<vcg::Point3i> faces;
+        faces.reserve(faceNum);
+        for (BlockMesh& block : blocks)
         {
-            // let's create a new vertex
-            VertexIndex vi = (VertexIndex) _mesh->vert.size();
-            Allocator<MeshType>::AddVertices( *_mesh, 1 );
-            mVertexMap[k] = vi;
-            v = &_mesh->vert[vi];
-            id1 = GetLocalCellIdFromGlobal(p1);
-            id2 = GetLocalCellIdFromGlobal(p2);
-            // interpol along the edge
-            ScalarType epsilon = ScalarType(1e-5);
-            const GridElement& c1 = mCache[id1];
-            const GridElement& c2 = mCache[id2];
-            if (fabs(mIsoValue-c1.value) < epsilon)
-                v->P().Import(c1.position);
-            else if (fabs(mIsoValue-c2.value) < epsilon)
-                v->P().Import(c2.position);
-            else if (fabs(c1.value-c2.value) < epsilon)
-                v->P().Import( (c1.position+c1.position)*0.5);
-            else
+            remap.resize(block.mesh.vert.size());
+            for (size_t i=0 ; i<block.mesh.vert.size() ; ++i)
             {
-                ScalarType a = (mIsoValue - c1.value) / (c2.value - c1.value);
-                v->P().Import(c1.position + (c2.position - c1.position) * a);
+                auto ins = globalIndex.insert(std::make_pair(block.keys[i], int(positions.size())));
+                if (ins.second)
+                    positions.push_back(block.mesh.vert[i].cP());
+                remap[i] = ins.first->second;
             }
+            for (size_t i=0 ; i<block.mesh.face.size() ; ++i)
+            {
+                const typename MeshType::FaceType& f = block.mesh.face[i];
+                faces.push_back(vcg::Point3i(
+                        remap[vcg::tri::Index(block.mesh, f.cV(0))],
+                        remap[vcg::tri::Index(block.mesh, f.cV(1))],
+                        remap[vcg::tri::Index(block.mesh, f.cV(2))]));
+            }
+            // release the block as soon as it is merged
+            block.mesh.Clear();
+            block.keys = std::vector<Key>();
         }
-        else
-        {
-            v = 0;
-        }
-    }
-
-    bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
-    {
-        GetIntercept(p0, p1, v, false);
-        return v!=0;
-    }
 
-    void GetXIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
-    {
-        GetIntercept(p1, p2, v, true);
-    }
-    void GetYIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
-    {
-        GetIntercept(p1, p2, v, true);
-    }
-    void GetZIntercept(const vcg::Point3i &p1, const vcg::Point3i &p2, VertexPointer &v)
-    {
-        GetIntercept(p1, p2, v, true);
+        Allocator<MeshType>::AddVertices(mesh, positions.size());
+        for (size_t i=0 ; i<positions.size() ; ++i)
+            mesh.vert[i].P() = positions[i];
+        Allocator<MeshType>::AddFaces(mesh, faces.size());
+        for (size_t i=0 ; i<faces.size() ; ++i)
+            for (int k=0 ; k<3 ; ++k)
+                mesh.face[i].V(k) = &mesh.vert[faces[i][k]];
     }
 
 protected:
     Box3m mAABB;
-    MapType mVertexMap;
-    MeshType    *_mesh;
-    SurfaceType* mpSurface;
-    GridElement* mCache;
-    vcg::Point3i mBlockOrigin;
-    vcg::Point3i mGridSize;
+    ScalarType mStep;
+    int mNofCells[3];
     int mMaxBlockSize;
     ScalarType mIsoValue;
 
@@ -278,4 +381,3 @@ protected:
 } // end namespace
 
 #endif
-
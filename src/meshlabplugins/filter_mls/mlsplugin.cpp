@@ -22,6 +22,7 @@
  ****************************************************************************/
 
 #include <iostream>
+#include <memory>
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
@@ -270,6 +271,34 @@ void UpdateFaceNormalFromVertex(MeshType& m)
 	}
 }
 
+/** apply fn to every vertex of m in parallel
+ *
+ * The MLS surfaces cache the state of the last query, so each thread works on its
+ * own clone of mls. The vertices are processed in chunks to report the progress.
+ */
+template<typename Fn>
+void parallelForEachVertex(
+	CMeshO&                   m,
+	const MlsSurface<CMeshO>& mls,
+	const char*               msg,
+	vcg::CallBackPos*         cb,
+	Fn                        fn)
+{
+	const int n         = m.vert.size();
+	const int chunkSize = std::max(1024, n / 100);
+	for (int begin = 0; begin < n; begin += chunkSize) {
+		cb(1 + 98 * begin / n, msg);
+		const int end = std::min(n, begin + chunkSize);
+#pragma omp parallel
+		{
+			std::unique_ptr<MlsSurface<CMeshO>> surface(mls.clone());
+#pragma omp for schedule(dynamic, 64)
+			for (int i = begin; i < end; i++)
+				fn(*surface, m.vert[i]);
+		}
+	}
+}
+
 std::map<std::string, QVariant> MlsPlugin::applyFilter(
 	const QAction*           filter,
 	const RichParameterList& par,
@@ -550,12 +579,11 @@ void MlsPlugin::computeProjection(
 				cb);
 		}
 		// project all vertices onto the MLS surface
-		for (unsigned int i = 0; i < mesh->cm.vert.size(); i++) {
-			cb(1 + 98 * i / mesh->cm.vert.size(), "MLS projection...");
-
-			if ((!selectionOnly) || (mesh->cm.vert[i].IsS()))
-				mesh->cm.vert[i].P() = mls->project(mesh->cm.vert[i].P(), &mesh->cm.vert[i].N());
-		}
+		parallelForEachVertex(mesh->cm, *mls, "MLS projection...", cb,
+			[&](const MlsSurface<CMeshO>& surface, CVertexO& v) {
+				if ((!selectionOnly) || v.IsS())
+					v.P() = surface.project(v.P(), &v.N());
+			});
 	}
 
 	log("Successfully projected %i vertices", mesh->cm.vn);
@@ -585,55 +613,46 @@ void MlsPlugin::computeColorize(
 	// bool approx = apss && par.getBool("ApproxCurvature");
 	int ct = par.getEnum("CurvatureType");
 
-	uint size = mesh->cm.vert.size();
-	// std::vector<float> curvatures(size);
-	Scalarm   minc = 1e9, maxc = -1e9, minabsc = 1e9;
-	Point3m   grad;
-	Matrix33m hess;
-
-	// pass 1: computes curvatures and statistics
-	for (unsigned int i = 0; i < size; i++) {
-		cb(1 + 98 * i / pPoints->cm.vert.size(), "MLS colorization...");
-
-		if ((!selectionOnly) || (pPoints->cm.vert[i].IsS())) {
-			Point3m p = mls->project(mesh->cm.vert[i].P());
-			Scalarm c = 0;
-
-			if (ct == CT_APSS) {
-				APSS<CMeshO>* apss = dynamic_cast<APSS<CMeshO>*>(mls);
-				c                  = apss->approxMeanCurvature(p);
-			}
-			else {
-				int errorMask;
-				grad = mls->gradient(p, &errorMask);
-				if (errorMask == MLS_OK && grad.Norm() > 1e-8) {
-					hess = mls->hessian(p);
-					implicits::WeingartenMap<CMeshO::ScalarType> W(grad, hess);
-
-					mesh->cm.vert[i].PD1() = W.K1Dir();
-					mesh->cm.vert[i].PD2() = W.K2Dir();
-					mesh->cm.vert[i].K1()  = W.K1();
-					mesh->cm.vert[i].K2()  = W.K2();
-
-					switch (ct) {
-					case CT_MEAN: c = W.MeanCurvature(); break;
-					case CT_GAUSS: c = W.GaussCurvature(); break;
-					case CT_K1: c = W.K1(); break;
-					case CT_K2: c = W.K2(); break;
-					default: assert(0 && "invalid curvature type");
+	// pass 1: computes curvatures
+	parallelForEachVertex(mesh->cm, *mls, "MLS colorization...", cb,
+		[&](const MlsSurface<CMeshO>& surface, CVertexO& v) {
+			const size_t i = &v - &mesh->cm.vert[0];
+			if ((!selectionOnly) || (pPoints->cm.vert[i].IsS())) {
+				Point3m p = surface.project(v.P());
+				Scalarm c = 0;
+
+				if (ct == CT_APSS) {
+					const APSS<CMeshO>* apss = dynamic_cast<const APSS<CMeshO>*>(&surface);
+					c                        = apss->approxMeanCurvature(p);
+				}
+				else {
+					int     errorMask;
+					Point3m grad = surface.gradient(p, &errorMask);
+					if (errorMask == MLS_OK && grad.Norm() > 1e-8) {
+						Matrix33m hess = surface.hessian(p);
+						implicits::WeingartenMap<CMeshO::ScalarType> W(grad, hess);
+
+						v.PD1() = W.K1Dir();
+						v.PD2() = W.K2Dir();
+						v.K1()  = W.K1();
+						v.K2()  = W.K2();
+
+						switch (ct) {
+						case CT_MEAN: c = W.MeanCurvature(); break;
+						case CT_GAUSS: c = W.GaussCurvature(); break;
+						case CT_K1: c = W.K1(); break;
+						case CT_K2: c = W.K2(); break;
+						default: assert(0 && "invalid curvature type");
+						}
 					}
+					assert(
+						!math::IsNAN(c) &&
+						"You should never try to compute Histogram with Invalid Floating "
+						"points numbers (NaN)");
 				}
-				assert(
-					!math::IsNAN(c) &&
-					"You should never try to compute Histogram with Invalid Floating "
-					"points numbers (NaN)");
+				v.Q() = c;
 			}
-			mesh->cm.vert[i].Q() = c;
-			minc                 = std::min(c, minc);
-			maxc                 = std::max(c, maxc);
-			minabsc              = std::min(std::abs(c), minabsc);
-		}
-	}
+		});
 	// pass 2: convert the curvature to color
 	cb(99, "Curvature to color...");
 
@@ -654,19 +673,17 @@ void MlsPlugin::computeMarchingCubes(
 	MeshModel* mesh = md.addNewMesh("", "mc_mesh");
 
 	typedef vcg::tri::MlsWalker<CMeshO, MlsSurface<CMeshO>> MlsWalker;
-	typedef vcg::tri::MarchingCubes<CMeshO, MlsWalker>      MlsMarchingCubes;
 	MlsWalker                                               walker;
 	walker.resolution = par.getInt("Resolution");
 
 	// iso extraction
-	MlsMarchingCubes mc(mesh->cm, walker);
-	walker.BuildMesh<MlsMarchingCubes>(mesh->cm, *mls, mc, cb);
+	walker.BuildMesh(mesh->cm, *mls, cb);
 
 	// accurate projection
-	for (unsigned int i = 0; i < mesh->cm.vert.size(); i++) {
-		cb(1 + 98 * i / mesh->cm.vert.size(), "MLS projection...");
-		mesh->cm.vert[i].P() = mls->project(mesh->cm.vert[i].P(), &mesh->cm.vert[i].N());
-	}
+	parallelForEachVertex(mesh->cm, *mls, "MLS projection...", cb,
+		[](const MlsSurface<CMeshO>& surface, CVertexO& v) {
+			v.P() = surface.project(v.P(), &v.N());
+		});
 
 	// extra zero detection and removal
 	{
@@ -27,6 +27,7 @@
 #include "balltree.h"
 #include <Eigen/Dense>
 #include <iostream>
+#include <memory>
 #include <vcg/math/matrix33.h>
 #include <vcg/space/box3.h>
 #include <vcg/complex/allocate.h>
@@ -69,7 +70,6 @@ public:
 		mFilterScale                = 4.0;
 		mMaxNofProjectionIterations = 20;
 		mProjectionAccuracy         = (Scalar) 1e-4;
-		mBallTree                   = 0;
 		mGradientHint               = MLS_DERIVATIVE_ACCURATE;
 		mHessianHint                = MLS_DERIVATIVE_ACCURATE;
 
@@ -80,6 +80,15 @@ public:
 
 	virtual ~MlsSurface() {}
 
+	/** \returns a new query context on the same surface
+	 *
+	 * The surfaces cache the state of the last query, hence a single instance cannot be
+	 * queried concurrently. A clone shares the points, the parameters and the ball tree with
+	 * this surface but owns its cached values: each thread can safely query its own clone.
+	 * The caller takes the ownership of the returned object.
+	 */
+	virtual MlsSurface* clone() const = 0;
+
 	/** \returns the value of the reconstructed scalar field at point \a x */
 	virtual Scalar potential(const VectorType& x, int* errorMask = 0) const = 0;
 
@@ -167,6 +176,7 @@ public:
 	//void computeVertexRaddi(const int nbNeighbors = 16);
 
 protected:
+	void initBallTree() const;
 	void computeNeighborhood(const VectorType& x, bool computeDerivatives) const;
 	void requestSecondDerivatives() const;
 
@@ -195,7 +205,8 @@ protected:
 	int               mGradientHint;
 	int               mHessianHint;
 
-	BallTree<Scalar>* mBallTree;
+	// shared among the clones, built before the first clone is made
+	mutable std::shared_ptr<BallTree<Scalar>> mBallTree;
 
 	int    mMaxNofProjectionIterations;
 	Scalar mFilterScale;
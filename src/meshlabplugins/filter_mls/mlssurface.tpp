@@ -49,10 +49,14 @@ void computeVertexRadius(_MeshType& mesh, int nNeighbors)
 		size_t(mesh.vert[1].P().V()) - size_t(mesh.vert[0].P().V()));
 
 	vcg::KdTree<Scalar> knn(positions);
-	typename vcg::KdTree<Scalar>::PriorityQueue pq;
-	for (size_t i = 0; i < mesh.vert.size(); i++) {
-		knn.doQueryK(mesh.vert[i].cP(), nNeighbors, pq);
-		h[i] = 2. * sqrt(pq.getTopWeight() / Scalarm(pq.getNofElements()));
+#pragma omp parallel
+	{
+		typename vcg::KdTree<Scalar>::PriorityQueue pq;
+#pragma omp for schedule(static)
+		for (int i = 0; i < (int) mesh.vert.size(); i++) {
+			knn.doQueryK(mesh.vert[i].cP(), nNeighbors, pq);
+			h[i] = 2. * sqrt(pq.getTopWeight() / Scalarm(pq.getNofElements()));
+		}
 	}
 }
 
@@ -94,12 +98,20 @@ void MlsSurface<_MeshType>::setHessianHint(int h)
 }
 
 template<typename _MeshType>
-void MlsSurface<_MeshType>::computeNeighborhood(const VectorType& x, bool computeDerivatives) const
+void MlsSurface<_MeshType>::initBallTree() const
 {
 	if (!mBallTree) {
-		const_cast<BallTree<Scalar>*&>(mBallTree) = new BallTree<Scalar>(positions(), radii());
-		const_cast<BallTree<Scalar>*>(mBallTree)->setRadiusScale(mFilterScale);
+		mBallTree = std::make_shared<BallTree<Scalar>>(positions(), radii());
+		mBallTree->setRadiusScale(mFilterScale);
 	}
+	mBallTree->update();
+}
+
+template<typename _MeshType>
+void MlsSurface<_MeshType>::computeNeighborhood(const VectorType& x, bool computeDerivatives) const
+{
+	if (!mBallTree)
+		initBallTree();
 	mBallTree->computeNeighbors(x, &mNeighborhood);
 	size_t nofSamples = mNeighborhood.size();
 
@@ -63,6 +63,12 @@ class RIMLS : public MlsSurface<_MeshType>
 			mMaxRefittingIters = 3;
 		}
 
+		virtual RIMLS* clone() const
+		{
+			Base::initBallTree();
+			return new RIMLS(*this);
+		}
+
 		virtual Scalar potential(const VectorType& x, int* errorMask = 0) const;
 		virtual VectorType gradient(const VectorType& x, int* errorMask = 0) const;
 		virtual MatrixType hessian(const VectorType& x, int* errorMask = 0) const;
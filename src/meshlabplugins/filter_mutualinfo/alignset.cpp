@@ -1,4 +1,8 @@
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include <GL/glew.h>
 
@@ -24,7 +28,7 @@
 
 using namespace std;
 
-AlignSet::AlignSet(): mode(COMBINE),
+AlignSet::AlignSet(): mode(COMBINE), useCPU(false),
     target(NULL), render(NULL),error(0)
 {
         _cont = NULL;
@@ -161,6 +165,10 @@ void AlignSet::resize(int max_side) {
 
 void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component) 
 {
+    if(useCPU) {
+        renderSceneCPU(view, component);
+        return;
+    }
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
     frmt.setInternalTextureFormat(GL_RGBA);
@@ -274,6 +282,127 @@ void AlignSet::renderScene(vcg::Shot<MESHLAB_SCALAR> &view, int component)
 
 }
 
+// Software version of renderScene: same shading as the shaders in initializeGL,
+// rows are stored bottom-up as glReadPixels does, so they match the target image.
+void AlignSet::renderSceneCPU(vcg::Shot<MESHLAB_SCALAR> &view, int component)
+{
+    if (render) delete[] render;
+    render = new unsigned char[wt*ht];
+    memset(render, 0, wt*ht);
+    if(mesh->VN() == 0 || component > 2)
+        return;
+
+    bool use_colors = (mode == COLOR || mode == COMBINE || mode == SPECAMB);
+    bool use_reflection = (mode == SPECULAR || mode == SPECAMB);
+
+    // per vertex: window position and camera depth, color and the direction (normal or reflection) in eye space
+    const int vn = int(mesh->vert.size());
+    std::vector<vcg::Point3f> win(vn), col(vn), dir(vn);
+    const float sx = wt / float(view.Intrinsics.ViewportPx[0]);
+    const float sy = ht / float(view.Intrinsics.ViewportPx[1]);
+#pragma omp parallel for
+    for(int i = 0; i < vn; i++) {
+        const CVertexO &v = mesh->vert[i];
+        if(v.IsD()) { win[i] = vcg::Point3f(0, 0, -1); continue; }
+        // camera coordinates look along +z, OpenGL eye space along -z
+        vcg::Point3<MESHLAB_SCALAR> cp = view.ConvertWorldToCameraCoordinates(v.cP());
+        vcg::Point3<MESHLAB_SCALAR> cn = view.ConvertWorldToCameraCoordinates(v.cP() + v.cN()) - cp;
+        vcg::Point3f eyeP(cp[0], cp[1], -cp[2]);
+        vcg::Point3f eyeN(cn[0], cn[1], -cn[2]);
+        eyeN.Normalize();
+        vcg::Point2<MESHLAB_SCALAR> px = view.Project(v.cP());
+        win[i] = vcg::Point3f(px[0]*sx, px[1]*sy, cp[2]);
+        col[i] = use_colors ? vcg::Point3f(v.cC()[0], v.cC()[1], v.cC()[2])/255.0f : vcg::Point3f(1, 1, 1);
+        dir[i] = use_reflection ? eyeP - eyeN*(2*(eyeN*eyeP)) : eyeN;
+    }
+
+    auto shade = [&](const vcg::Point3f &c, vcg::Point3f d) -> float {
+        d.Normalize();
+        vcg::Point3f n = d*0.5f + vcg::Point3f(0.5f, 0.5f, 0.5f);
+        switch(mode) {
+        case COLOR:
+        case SILHOUETTE: return c[component];
+        case NORMALMAP:
+        case SPECULAR: return n[component];
+        case COMBINE:
+        case SPECAMB: { float t = c[0]*c[0]; return (1-t)*c[component] + t*n[component]; }
+        default: assert(0);
+        }
+        return 0;
+    };
+    auto toByte = [](float v) { return (unsigned char)std::min(255.0f, std::max(0.0f, v*255.0f + 0.5f)); };
+
+    // z buffer holds 1/depth, 0 is the background
+    std::vector<float> zbuf(wt*ht, 0.0f);
+
+    if(mesh->FN() == 0) {
+        for(int i = 0; i < vn; i++) {
+            if(win[i][2] <= 0) continue;
+            int x = int(std::floor(win[i][0])), y = int(std::floor(win[i][1]));
+            if(x < 0 || y < 0 || x >= wt || y >= ht) continue;
+            int o = y*wt + x;
+            float iz = 1.0f/win[i][2];
+            if(iz <= zbuf[o]) continue;
+            zbuf[o] = iz;
+            render[o] = toByte(shade(col[i], dir[i]));
+        }
+        return;
+    }
+
+    // faces are binned in horizontal bands that are then rasterized concurrently
+    const int bandH = 16;
+    const int bands = (ht + bandH - 1)/bandH;
+    std::vector<std::vector<int> > bandFaces(bands);
+    for(int f = 0; f < int(mesh->face.size()); f++) {
+        const CFaceO &face = mesh->face[f];
+        if(face.IsD()) continue;
+        const vcg::Point3f &p0 = win[face.cV(0) - &mesh->vert[0]];
+        const vcg::Point3f &p1 = win[face.cV(1) - &mesh->vert[0]];
+        const vcg::Point3f &p2 = win[face.cV(2) - &mesh->vert[0]];
+        // faces crossing the camera plane are dropped instead of clipped
+        if(p0[2] <= 0 || p1[2] <= 0 || p2[2] <= 0) continue;
+        int ymin = std::max(0, int(std::floor(std::min(p0[1], std::min(p1[1], p2[1])))));
+        int ymax = std::min(ht - 1, int(std::ceil(std::max(p0[1], std::max(p1[1], p2[1])))));
+        for(int b = ymin/bandH; b <= ymax/bandH && b < bands; b++)
+            bandFaces[b].push_back(f);
+    }
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int b = 0; b < bands; b++) {
+        const int y0 = b*bandH, y1 = std::min(ht, y0 + bandH);
+        for(int f : bandFaces[b]) {
+            const CFaceO &face = mesh->face[f];
+            int i0 = face.cV(0) - &mesh->vert[0], i1 = face.cV(1) - &mesh->vert[0], i2 = face.cV(2) - &mesh->vert[0];
+            const vcg::Point3f &p0 = win[i0], &p1 = win[i1], &p2 = win[i2];
+            float area = (p1[0]-p0[0])*(p2[1]-p0[1]) - (p2[0]-p0[0])*(p1[1]-p0[1]);
+            if(std::fabs(area) < 1e-12f) continue;
+            int xmin = std::max(0, int(std::floor(std::min(p0[0], std::min(p1[0], p2[0])))));
+            int xmax = std::min(wt - 1, int(std::ceil(std::max(p0[0], std::max(p1[0], p2[0])))));
+            int ymin = std::max(y0, int(std::floor(std::min(p0[1], std::min(p1[1], p2[1])))));
+            int ymax = std::min(y1 - 1, int(std::ceil(std::max(p0[1], std::max(p1[1], p2[1])))));
+            for(int y = ymin; y <= ymax; y++) {
+                float py = y + 0.5f;
+                for(int x = xmin; x <= xmax; x++) {
+                    float px = x + 0.5f;
+                    float w0 = ((p1[0]-px)*(p2[1]-py) - (p2[0]-px)*(p1[1]-py))/area;
+                    float w1 = ((p2[0]-px)*(p0[1]-py) - (p0[0]-px)*(p2[1]-py))/area;
+                    float w2 = 1 - w0 - w1;
+                    if(w0 < 0 || w1 < 0 || w2 < 0) continue;
+                    // 1/depth is linear in screen space, attributes are interpolated perspective correct
+                    float b0 = w0/p0[2], b1 = w1/p1[2], b2 = w2/p2[2];
+                    float iz = b0 + b1 + b2;
+                    int o = y*wt + x;
+                    if(iz <= zbuf[o]) continue;
+                    zbuf[o] = iz;
+                    b0 /= iz; b1 /= iz; b2 /= iz;
+                    render[o] = toByte(shade(col[i0]*b0 + col[i1]*b1 + col[i2]*b2,
+                                             dir[i0]*b0 + dir[i1]*b1 + dir[i2]*b2));
+                }
+            }
+        }
+    }
+}
+
 void AlignSet::readRender(int component) {
     QSize fbosize(wt,ht);
     QGLFramebufferObjectFormat frmt;
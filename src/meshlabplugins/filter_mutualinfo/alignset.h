@@ -42,6 +42,7 @@ class AlignSet {
   
   enum RenderingMode {COMBINE=0, NORMALMAP=1, COLOR=2, SPECULAR=3, SILHOUETTE=4, SPECAMB = 5};
   RenderingMode mode;
+  bool useCPU; //render with the software rasterizer, no GL context needed
 
   unsigned char *target, *render; //buffers for rendered images 
   double error; //alignment error in px
@@ -60,6 +61,7 @@ class AlignSet {
   void setPixelSizeMm(double ccdWidth);
 
   void renderScene(vcg::Shot<MESHLAB_SCALAR>& shot, int component);
+  void renderSceneCPU(vcg::Shot<MESHLAB_SCALAR>& shot, int component);
   void readRender(int component);
 
   void drawMeshPoints();
@@ -34,6 +34,10 @@
 
 #include <vcg/complex/algorithms/point_sampling.h>
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 FilterMutualInfoPlugin::FilterMutualInfoPlugin() 
 {
 	typeList= {FP_IMAGE_MUTUALINFO};
@@ -67,7 +71,8 @@ QString FilterMutualInfoPlugin::filterInfo(ActionIDType filterId) const
 {
 	switch(filterId) {
 	case FP_IMAGE_MUTUALINFO:
-		return "Register an image on a 3D model using Mutual Information. This filter is an implementation of Corsini et al. 'Image-to-geometry registration: a mutual information method exploiting illumination-related geometric properties', 2009, <a href=\"http://vcg.isti.cnr.it/Publications/2009/CDPS09/\" target=\"_blank\">Get link</a>";
+		return "Register an image on a 3D model using Mutual Information. This filter is an implementation of Corsini et al. 'Image-to-geometry registration: a mutual information method exploiting illumination-related geometric properties', 2009, <a href=\"http://vcg.isti.cnr.it/Publications/2009/CDPS09/\" target=\"_blank\">Get link</a>"
+			"<br>With CPU rendering the model is drawn by a software rasterizer, so no OpenGL context is needed, and all the visible rasters can be registered at once, concurrently, each one starting from its own shot.";
 	default :
 		assert(0);
 		return "Unknown Filter";
@@ -121,6 +126,8 @@ RichParameterList FilterMutualInfoPlugin::initParameterList(const QAction *actio
 		parlst.addParam(RichFloat("Tolerance", 0.1, "Tolerance", "Threshold to stop convergence"));
 		parlst.addParam(RichFloat("ExpectedVariance", 2.0, "Expected Variance", "Expected Variance"));
 		parlst.addParam(RichInt("BackgroundWeight", 2, "Background Weight", "Weight of background pixels (1, as all the other pixels; 2, one half of the other pixels etc etc)"));
+		parlst.addParam(RichBool("UseCPU", false, "CPU rendering", "Render the model with a software rasterizer instead of OpenGL. Slower for a single raster, but it does not need a GL context and allows to register several rasters concurrently"));
+		parlst.addParam(RichBool("AllRasters", false, "Align all visible rasters", "Register every visible raster, each one starting from its own shot (the Starting shot parameter is ignored). Requires CPU rendering"));
 		break;
 	default :
 		assert(0);
@@ -133,13 +140,28 @@ std::map<std::string, QVariant> FilterMutualInfoPlugin::applyFilter(
 		const RichParameterList & par,
 		MeshDocument &md,
 		unsigned int& /*postConditionMask*/,
-		vcg::CallBackPos* )
+		vcg::CallBackPos* cb)
 {
-	if (glContext == nullptr){
+	bool useCPU = par.getBool("UseCPU");
+	if (glContext == nullptr && !useCPU){
 		throw MLException("Fatal error: glContext not initialized");
 	}
 	switch(ID(action))	 {
 	case FP_IMAGE_MUTUALINFO :
+		if (useCPU) {
+			imageMutualInfoAlignCPU(
+						md,
+						par.getEnum("Rendering Mode"), par.getBool("Estimate Focal"),
+						par.getBool("Fine"), par.getFloat("ExpectedVariance"),
+						par.getFloat("Tolerance"), par.getInt("NumOfIterations"),
+						par.getInt("BackgroundWeight"), par.getShotf("Shot"),
+						par.getBool("AllRasters"), cb);
+			break;
+		}
+		if (par.getBool("AllRasters")) {
+			log(GLLogStream::FILTER, "Aligning all the rasters requires CPU rendering");
+			throw MLException("Aligning all the rasters requires CPU rendering");
+		}
 		imageMutualInfoAlign(
 					md,
 					par.getEnum("Rendering Mode"), par.getBool("Estimate Focal"),
@@ -158,6 +180,145 @@ int FilterMutualInfoPlugin::postCondition(const QAction*) const
 	return MeshModel::MM_NONE;
 }
 
+static AlignSet::RenderingMode renderingMode(int rendmode)
+{
+	switch(rendmode)
+	{
+	case 0: return AlignSet::COMBINE;
+	case 1: return AlignSet::NORMALMAP;
+	case 2: return AlignSet::COLOR;
+	case 3: return AlignSet::SPECULAR;
+	case 4: return AlignSet::SILHOUETTE;
+	case 5: return AlignSet::SPECAMB;
+	default: return AlignSet::COMBINE;
+	}
+}
+
+//the shot is optimized on the resized image, bring it back to the raster resolution
+static void storeAlignedShot(RasterModel &rm, const Shotm &alignedShot)
+{
+	rm.shot = alignedShot;
+	const QSize imgSize = rm.currentPlane->size();
+	float ratio=(float)imgSize.height()/(float)alignedShot.Intrinsics.ViewportPx[1];
+	rm.shot.Intrinsics.ViewportPx[0]=imgSize.width();
+	rm.shot.Intrinsics.ViewportPx[1]=imgSize.height();
+	rm.shot.Intrinsics.PixelSizeMm[1]/=ratio;
+	rm.shot.Intrinsics.PixelSizeMm[0]/=ratio;
+	rm.shot.Intrinsics.CenterPx[0]=(int)((float)rm.shot.Intrinsics.ViewportPx[0]/2.0);
+	rm.shot.Intrinsics.CenterPx[1]=(int)((float)rm.shot.Intrinsics.ViewportPx[1]/2.0);
+}
+
+//a whole registration on its own AlignSet, Solver and MutualInfo, so that several can run at the same time
+static Shotm alignRasterCPU(
+		CMeshO &mesh,
+		int meshid,
+		QImage &image,
+		const Shotm &startShot,
+		int rendmode,
+		bool estimateFocal,
+		bool fine,
+		Scalarm expectedVariance,
+		Scalarm tolerance,
+		int numIterations,
+		int backGroundWeight)
+{
+	AlignSet align;
+	Solver solver;
+	MutualInfo mutual;
+
+	align.useCPU = true;
+	align.image = &image;
+	align.mesh = &mesh;
+	align.meshid = meshid;
+	align.mode = renderingMode(rendmode);
+	align.shot = startShot;
+	align.shot.Intrinsics.ViewportPx[0]=int((double)align.shot.Intrinsics.ViewportPx[1]*align.image->width()/align.image->height());
+	align.shot.Intrinsics.CenterPx[0]=(int)(align.shot.Intrinsics.ViewportPx[0]/2);
+	align.resize(800);
+
+	solver.optimize_focal = estimateFocal;
+	solver.fine_alignment = fine;
+	solver.variance = expectedVariance;
+	solver.tolerance = tolerance;
+	mutual.bweight = backGroundWeight;
+
+	int rounds=(int)(numIterations/30);
+	for (int i=0; i<rounds; i++)
+	{
+		solver.maxiter=30;
+		if (solver.fine_alignment)
+			solver.optimize(&align, &mutual, align.shot);
+		else
+			solver.iterative(&align, &mutual, align.shot);
+	}
+	return align.shot;
+}
+
+void FilterMutualInfoPlugin::imageMutualInfoAlignCPU(
+		MeshDocument& md,
+		int rendmode,
+		bool estimateFocal,
+		bool fine,
+		Scalarm expectedVariance,
+		Scalarm tolerance,
+		int numIterations,
+		int backGroundWeight,
+		Shotm shot,
+		bool allRasters,
+		vcg::CallBackPos* cb)
+{
+	std::vector<RasterModel*> rasters;
+	std::vector<Shotm> shots;
+	if (allRasters) {
+		for (RasterModel& rm : md.rasterIterator()) {
+			if (rm.isVisible() && rm.currentPlane != nullptr && rm.shot.IsValid()) {
+				rasters.push_back(&rm);
+				shots.push_back(rm.shot);
+			}
+		}
+		if (rasters.empty()) {
+			log(GLLogStream::FILTER, "There are no visible rasters with a valid shot to align!");
+			throw MLException("There are no visible rasters with a valid shot to align!");
+		}
+	}
+	else {
+		if (!shot.IsValid()){
+			log(GLLogStream::FILTER, "Error: shot not valid. Press 'Get Shot' button before applying!");
+			throw MLException("Error: shot not valid. Press 'Get Shot' button before applying!");
+		}
+		if (md.rasterNumber()==0) {
+			log(GLLogStream::FILTER, "You need a Raster Model to apply this filter!");
+			throw MLException("You need a Raster Model to apply this filter!");
+		}
+		rasters.push_back(md.rm());
+		shots.push_back(shot);
+	}
+
+	CMeshO& mesh = md.mm()->cm;
+	int meshid = md.mm()->id();
+
+	//the rasters are processed in waves as large as the number of cores, the progress bar is updated between them
+	const int wave = std::max(1, (int)std::thread::hardware_concurrency());
+	const int rasterNum = (int)rasters.size();
+	for (int w0 = 0; w0 < rasterNum; w0 += wave) {
+		int w1 = std::min(rasterNum, w0 + wave);
+		if (cb != nullptr)
+			cb(100 * w0 / rasterNum, "Aligning rasters...");
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = w0; i < w1; i++) {
+			shots[i] = alignRasterCPU(
+						mesh, meshid, rasters[i]->currentPlane->image, shots[i], rendmode,
+						estimateFocal, fine, expectedVariance, tolerance, numIterations, backGroundWeight);
+		}
+	}
+
+	for (int i = 0; i < rasterNum; i++) {
+		storeAlignedShot(*rasters[i], shots[i]);
+		log("Aligned raster %s", qUtf8Printable(rasters[i]->label()));
+	}
+	md.documentUpdated();
+}
+
 void FilterMutualInfoPlugin::imageMutualInfoAlign(
 		MeshDocument& md,
 		int rendmode,
@@ -194,30 +355,8 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 	solver.maxiter = numIterations;
 	mutual.bweight = backGroundWeight;
 
-	switch(rendmode)
-	{
-	case 0:
-		align.mode=AlignSet::COMBINE;
-		break;
-	case 1:
-		align.mode=AlignSet::NORMALMAP;
-		break;
-	case 2:
-		align.mode=AlignSet::COLOR;
-		break;
-	case 3:
-		align.mode=AlignSet::SPECULAR;
-		break;
-	case 4:
-		align.mode=AlignSet::SILHOUETTE;
-		break;
-	case 5:
-		align.mode=AlignSet::SPECAMB;
-		break;
-	default:
-		align.mode=AlignSet::COMBINE;
-		break;
-	}
+	align.mode = renderingMode(rendmode);
+	align.useCPU = false;
 
 	align.shot = Shotm::Construct(shot);
 
@@ -247,14 +386,7 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 		else
 			solver.iterative(&align, &mutual, align.shot);
 
-		md.rm()->shot = Shotm::Construct(align.shot);
-		float ratio=(float)md.rm()->currentPlane->image.height()/(float)align.shot.Intrinsics.ViewportPx[1];
-		md.rm()->shot.Intrinsics.ViewportPx[0]=md.rm()->currentPlane->image.width();
-		md.rm()->shot.Intrinsics.ViewportPx[1]=md.rm()->currentPlane->image.height();
-		md.rm()->shot.Intrinsics.PixelSizeMm[1]/=ratio;
-		md.rm()->shot.Intrinsics.PixelSizeMm[0]/=ratio;
-		md.rm()->shot.Intrinsics.CenterPx[0]=(int)((float)md.rm()->shot.Intrinsics.ViewportPx[0]/2.0);
-		md.rm()->shot.Intrinsics.CenterPx[1]=(int)((float)md.rm()->shot.Intrinsics.ViewportPx[1]/2.0);
+		storeAlignedShot(*md.rm(), Shotm::Construct(align.shot));
 
 		QList<int> rl;
 		rl << md.rm()->id();
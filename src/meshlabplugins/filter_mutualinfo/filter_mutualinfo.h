@@ -72,6 +72,20 @@ private:
 			int backGroundWeight,
 			Shotm shot);
 
+	//software rendering version, the rasters are registered concurrently
+	void imageMutualInfoAlignCPU(
+			MeshDocument &md,
+			int rendmode,
+			bool estimateFocal,
+			bool fine,
+			Scalarm expectedVariance,
+			Scalarm tolerance,
+			int numIterations,
+			int backGroundWeight,
+			Shotm shot,
+			bool allRasters,
+			vcg::CallBackPos *cb);
+
 	bool initGLMutualInfo();
 };
 
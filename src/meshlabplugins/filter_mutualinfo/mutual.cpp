@@ -4,6 +4,7 @@
 #include <math.h>
 
 #include <iostream>
+#include <vector>
 #include <QImage> /*debug*/
 #include "mutual.h"
 
@@ -33,6 +34,20 @@ void MutualInfo::setBins(unsigned int _nbins) {
   histoB = new unsigned int[nbins];
 }
 
+void MutualInfo::accumulate(unsigned int *histo, int width,
+                            const unsigned char *target, const unsigned char *render,
+                            int startx, int endx, int starty, int endy, int k, int s) {
+  for(int y = starty; y < endy; y++) {
+    const unsigned char *t = target + width*y;
+    const unsigned char *r = render + width*y;
+    for(int x = startx; x < endx; x++) {
+      unsigned char a = t[x]>>k; //instead of /side;
+      unsigned char b = r[x]>>k; //instead of /side;
+      histo[a + (b<<s)] += 2;//bweight; //instead of nbins*s
+    }
+  }
+}
+
 double MutualInfo::info(int width, int height, 
                         unsigned char *target, unsigned char *render, 
                         int startx, int endx, 
@@ -103,12 +118,20 @@ void MutualInfo::histogram(int width, int height,
   int s = 0; 
   while ( bins>>=1) { ++s; }
 
-  for(int y = starty; y < endy; y++) {
-    int offset = width*y + startx;
-    for(int x = startx; x < endx; x++, offset++) {
-      unsigned char a = target[offset]>>k; //instead of /side;
-      unsigned char b = render[offset]>>k; //instead of /side;
-      histo2D[a + (b<<s)] += 2;//bweight; //instead of nbins*s
+  //small windows are not worth the threads
+  if((endx - startx)*(endy - starty) < (1<<16)) {
+    accumulate(histo2D, width, target, render, startx, endx, starty, endy, k, s);
+  } else {
+    //each thread fills its own histogram, they are summed at the end
+#pragma omp parallel
+    {
+      std::vector<unsigned int> local(nbins*nbins, 0);
+#pragma omp for nowait
+      for(int y = starty; y < endy; y++)
+        accumulate(local.data(), width, target, render, startx, endx, y, y+1, k, s);
+#pragma omp critical
+      for(unsigned int i = 0; i < nbins*nbins; i++)
+        histo2D[i] += local[i];
     }
   }
   //weight of background is divided.
@@ -16,6 +16,10 @@ class MutualInfo {
                  int startx = 0, int endx = 0, int starty = 0, int endy = 0);
 
  private:
+  static void accumulate(unsigned int *histo, int width,
+                         const unsigned char *target, const unsigned char *render,
+                         int startx, int endx, int starty, int endy, int k, int s);
+
   unsigned int nbins;
   unsigned int *histo2D; //matrix nbisXnbins
   unsigned int *histoA;  //vector nbins
@@ -26,10 +26,125 @@
 #include <vcg/complex/algorithms/smooth.h>
 #include <vcg/complex/algorithms/create/plymc/plymc.h>
 #include <vcg/complex/algorithms/create/plymc/simplemeshprovider.h>
+#include <vcg/complex/algorithms/clean.h>
 #include <QTemporaryFile>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <mutex>
+#include <thread>
 
 using namespace vcg;
 
+/* The SimpleMeshProvider loads the meshes with ImporterVMI, that keeps its reader
+ * state in function-static variables: the meshes loaded by the concurrent subvolumes
+ * are read one at a time, and the bounding boxes (whose scan opens the meshes too)
+ * are scanned once and shared by all the subvolumes. */
+class SerialLoadMeshProvider : public SimpleMeshProvider<SMesh>
+{
+	typedef SimpleMeshProvider<SMesh> Base;
+	std::vector<Box3f> sharedBB;
+	Box3f sharedFullBB;
+
+	static std::mutex& loadMutex()
+	{
+		static std::mutex m;
+		return m;
+	}
+
+public:
+	template <class IndexType>
+	bool Find(IndexType i, SMesh*& sm)
+	{
+		std::lock_guard<std::mutex> lock(loadMutex());
+		return Base::Find(i, sm);
+	}
+
+	bool InitBBox()
+	{
+		if(!sharedBB.empty())
+			return true;
+		std::lock_guard<std::mutex> lock(loadMutex());
+		return Base::InitBBox();
+	}
+
+	// use the bounding boxes already scanned by another provider of the same meshes
+	void shareBBox(SerialLoadMeshProvider& scanned)
+	{
+		sharedBB.clear();
+		for(int i=0; i<scanned.size(); ++i)
+			sharedBB.push_back(scanned.bb(i));
+		sharedFullBB = scanned.fullBB();
+	}
+
+	Box3f bb(int i) { return sharedBB.empty() ? Base::bb(i) : sharedBB[i]; }
+	Box3f fullBB() { return sharedBB.empty() ? Base::fullBB() : sharedFullBB; }
+};
+
+typedef tri::PlyMC<SMesh,SerialLoadMeshProvider> PlyMCType;
+
+// Upper bound of the memory used by a voxel of the volume, used to size the concurrent subvolumes
+#define PLYMC_BYTES_PER_VOXEL 32.0
+// Number of meshes kept loaded by each PlyMC instance
+#define PLYMC_MESH_CACHE_SIZE 64
+
+/* Process the subvolumes of the p.IDiv grid concurrently, at most jobs at a time, each one
+ * with its own PlyMC instance (and so its own volume and mesh cache) on the meshes of
+ * meshes, whose bounding boxes are scanned here once.
+ * The output file names are returned ordered by subvolume. */
+static void processSubVolumes(
+		const PlyMCType::Parameter& p,
+		SerialLoadMeshProvider& meshes,
+		int jobs,
+		std::vector<std::string>& outNames,
+		std::vector<std::string>& outSimpNames,
+		vcg::CallBackPos* cb)
+{
+	const Point3i div = p.IDiv;
+	const int subVolNum = div[0]*div[1]*div[2];
+	std::vector<std::vector<std::string> > outs(subVolNum), simpOuts(subVolNum);
+	std::string errorMessage;
+	meshes.InitBBox();
+	// only the calling thread reports the progress of its subvolumes
+	const std::thread::id caller = std::this_thread::get_id();
+
+	for(int begin=0; begin<subVolNum; begin+=jobs)
+	{
+		if(cb) cb(100*begin/subVolNum, "Processing subvolumes...");
+		const int end = std::min(subVolNum, begin+jobs);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(jobs)
+		for(int i=begin; i<end; ++i)
+		{
+			PlyMCType pmc;
+			pmc.MP.setCacheSize(PLYMC_MESH_CACHE_SIZE);
+			pmc.p = p;
+			pmc.p.IPosS = pmc.p.IPosE = Point3i(i%div[0], (i/div[0])%div[1], i/(div[0]*div[1]));
+			for(int m=0; m<meshes.size(); ++m)
+				pmc.MP.AddSingleMesh(meshes.MeshName(m).c_str(), meshes.Tr(m), meshes.W(m));
+			pmc.MP.shareBBox(meshes);
+			if(pmc.Process(std::this_thread::get_id() == caller ? cb : nullptr))
+			{
+				outs[i] = pmc.p.OutNameVec;
+				simpOuts[i] = pmc.p.OutNameSimpVec;
+			}
+			else
+			{
+#pragma omp critical
+				if(errorMessage.empty()) errorMessage = pmc.errorMessage;
+			}
+		}
+		if(!errorMessage.empty())
+			throw MLException(errorMessage.c_str());
+	}
+
+	outNames.clear(); outSimpNames.clear();
+	for(int i=0; i<subVolNum; ++i)
+	{
+		outNames.insert(outNames.end(), outs[i].begin(), outs[i].end());
+		outSimpNames.insert(outSimpNames.end(), simpOuts[i].begin(), simpOuts[i].end());
+	}
+}
+
 // Constructor usually performs only two simple tasks of filling the two lists
 //  - typeList: with all the possible id of the filtering actions
 //  - actionList with the corresponding actions. If you want to add icons to your filtering actions you can do here by construction the QActions accordingly
@@ -77,7 +192,8 @@ QString PlyMCPlugin::filterInfo(ActionIDType filterId) const
 	case FP_PLYMC :  return QString( "The surface reconstrction algorithm that have been used for a long time inside the ISTI-Visual Computer Lab."
 									 "It is mostly a variant of the Curless et al. e.g. a volumetric approach with some original weighting schemes,"
 									 "a different expansion rule, and another approach to hole filling through volume dilation/relaxations.<br>"
-									 "The filter is applied to <b>ALL</b> the visible layers. In practice, all the meshes/point clouds that are currently <i>visible</i> are used to build the volumetric distance field.");
+									 "The filter is applied to <b>ALL</b> the visible layers. In practice, all the meshes/point clouds that are currently <i>visible</i> are used to build the volumetric distance field.<br>"
+									 "When the volume is split in subvolumes, they are reconstructed concurrently and their meshes are welded together along the seams.");
 	case FP_MC_SIMPLIFY :  return QString( "A simplification/cleaning algorithm that works ONLY on meshes generated by Marching Cubes algorithm." );
 		
 	default : assert(0);
@@ -114,6 +230,8 @@ RichParameterList PlyMCPlugin::initParameterList(const QAction *action,const Mes
 	case FP_PLYMC :
 		parlst.addParam(RichPercentage("voxSize",m.cm.bbox.Diag()/100.0,0,m.cm.bbox.Diag(),"Voxel Side", "VoxelSide"));
 		parlst.addParam(    RichInt("subdiv",1,"SubVol Splitting","The level of recursive splitting of the subvolume reconstruction process. A value of '3' means that a 3x3x3 regular space subdivision is created and the reconstruction process generate 8 matching meshes. It is useful for reconsruction objects at a very high resolution. Default value (1) means no splitting."));
+		parlst.addParam(    RichInt("memoryBudget",0,"Memory Budget (MB)","When the volume is split, the subvolumes are reconstructed concurrently. This is the maximum amount of memory that the concurrent subvolumes can use, counting both their volumes and their caches of loaded meshes; the number of subvolumes processed at the same time is reduced to fit it. Default value (0) means no limit: one subvolume per core.",true));
+		parlst.addParam(   RichBool("mergeSubVol",true,"Merge SubVolumes","When the volume is split, the meshes of the subvolumes are loaded into a single layer, welding the vertices along the seams. If not checked each subvolume is loaded as a separate layer.",true));
 		parlst.addParam(  RichFloat("geodesic",2.0,"Geodesic Weighting","The influence of each range map is weighted with its geodesic distance from the borders. In this way when two (or more ) range maps overlaps their contribution blends smoothly hiding possible misalignments. "));
 		parlst.addParam(   RichBool("openResult",true,"Show Result","if not checked the result is only saved into the current directory"));
 		parlst.addParam(    RichInt("smoothNum",1,"Volume Laplacian iter","How many volume smoothing step are performed to clean out the eventually noisy borders"));
@@ -151,9 +269,9 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 			throw MLException("current folder is not writable.<br> VCG Merging needs to save intermediate files in the current working folder.<br> Project and meshes must be in a write-enabled folder.<br> Please save your data in a suitable folder before applying.");
 		}
 		
-		tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> > pmc;
-		pmc.MP.setCacheSize(64);
-		tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> >::Parameter &p = pmc.p;
+		PlyMCType pmc;
+		pmc.MP.setCacheSize(PLYMC_MESH_CACHE_SIZE);
+		PlyMCType::Parameter &p = pmc.p;
 		
 		int subdiv=par.getInt("subdiv");
 		
@@ -170,6 +288,8 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 		p.FullyPreprocessedFlag=true;
 		p.MergeColor=p.VertSplatFlag=par.getBool("mergeColor");
 		p.SimplificationFlag = par.getBool("simplification");
+		Box3f fullBB;
+		std::vector<double> meshMB;
 		for(MeshModel& mm: md.meshIterator())
 		{
 			if(mm.isVisible())
@@ -197,29 +317,72 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 					throw MLException("Failed to write vmi temp file " + mshTmpPath);
 				}
 				pmc.MP.AddSingleMesh(qUtf8Printable(mshTmpPath));
+				meshMB.push_back((sm.vert.size()*sizeof(SMesh::VertexType) + sm.face.size()*sizeof(SMesh::FaceType))/(1024.0*1024.0));
+				fullBB.Add(sm.bbox);
 				log("Preprocessing mesh %s",qUtf8Printable(mm.shortName()));
 			}
 		}
 		
-		if(pmc.Process(cb)==false)
+		if(subdiv==1)
 		{
-			throw MLException(pmc.errorMessage.c_str());
+			if(pmc.Process(cb)==false)
+			{
+				throw MLException(pmc.errorMessage.c_str());
+			}
+		}
+		else
+		{
+			// size the concurrency on the (dense) volume of a single subvolume
+			Point3f subDim = fullBB.Dim()/(p.VoxSize*subdiv);
+			double subVolMB = (subDim[0]+2*p.WideNum)*(subDim[1]+2*p.WideNum)*(subDim[2]+2*p.WideNum)*PLYMC_BYTES_PER_VOXEL/(1024.0*1024.0);
+			// each subvolume also keeps its own cache of loaded meshes, at worst the largest ones
+			std::sort(meshMB.begin(), meshMB.end(), std::greater<double>());
+			const size_t cachedNum = std::min<size_t>(meshMB.size(), PLYMC_MESH_CACHE_SIZE);
+			subVolMB += std::accumulate(meshMB.begin(), meshMB.begin()+cachedNum, 0.0);
+			int jobs = std::max(1u, std::thread::hardware_concurrency());
+			int memoryBudget = par.getInt("memoryBudget");
+			if(memoryBudget > 0)
+				jobs = std::max(1, std::min(jobs, int(memoryBudget/subVolMB)));
+			log("Processing %i subvolumes, %i at a time (about %.0f MB each)", subdiv*subdiv*subdiv, jobs, subVolMB);
+			processSubVolumes(p, pmc.MP, jobs, p.OutNameVec, p.OutNameSimpVec, cb);
 		}
-		
 		
 		if(par.getBool("openResult"))
 		{
-			for(size_t i=0;i<p.OutNameVec.size();++i)
-			{std::string name;
-				if(!p.SimplificationFlag) name = p.OutNameVec[i].c_str();
-				else name = p.OutNameSimpVec[i].c_str();
-				
-				MeshModel *mp=md.addNewMesh("",name.c_str(),true);  // created mesh is the current one, if multiple meshes are created last mesh is the current one
+			const std::vector<std::string>& outNames = p.SimplificationFlag ? p.OutNameSimpVec : p.OutNameVec;
+			const bool merge = outNames.size()>1 && par.getBool("mergeSubVol");
+			MeshModel *mp=nullptr;
+			for(size_t i=0;i<outNames.size();++i)
+			{
+				const std::string& name = outNames[i];
 				int loadMask=-1;
-				tri::io::ImporterPLY<CMeshO>::Open(mp->cm,name.c_str(),loadMask);
-				if(p.MergeColor) mp->updateDataMask(MeshModel::MM_VERTCOLOR);
-				mp->updateDataMask(MeshModel::MM_VERTQUALITY);
+				if(!merge || mp==nullptr)
+				{
+					mp=md.addNewMesh("",name.c_str(),true);  // created mesh is the current one, if multiple meshes are created last mesh is the current one
+					if(p.MergeColor) mp->updateDataMask(MeshModel::MM_VERTCOLOR);
+					mp->updateDataMask(MeshModel::MM_VERTQUALITY);
+				}
+				if(!merge)
+				{
+					tri::io::ImporterPLY<CMeshO>::Open(mp->cm,name.c_str(),loadMask);
+					mp->updateBoxAndNormals();
+				}
+				else
+				{
+					CMeshO subMesh;
+					tri::io::ImporterPLY<CMeshO>::Open(subMesh,name.c_str(),loadMask);
+					tri::Append<CMeshO,CMeshO>::MeshAppendConst(mp->cm,subMesh);
+				}
+			}
+			if(merge)
+			{
+				// the subvolumes share the boundary planes, so seam vertices coincide up to rounding
+				int welded = tri::Clean<CMeshO>::MergeCloseVertex(mp->cm,p.VoxSize*1e-3f);
+				tri::Clean<CMeshO>::RemoveDegenerateFace(mp->cm);
+				tri::Clean<CMeshO>::RemoveUnreferencedVertex(mp->cm);
+				tri::Allocator<CMeshO>::CompactEveryVector(mp->cm);
 				mp->updateBoxAndNormals();
+				log("Merged %i subvolume meshes, welded %i seam vertices",int(outNames.size()),welded);
 			}
 		}
 		
@@ -62,16 +62,10 @@ class BaseSampler
 public:
   BaseSampler(CMeshO* _m){
     m=_m;
-    uvSpaceFlag = false;
     qualitySampling=false;
     perFaceNormal=false;
-    tex=0;
   }
   CMeshO *m;
-  QImage* tex;
-  int texSamplingWidth;
-  int texSamplingHeight;
-  bool uvSpaceFlag;
   bool qualitySampling;
   bool perFaceNormal;  // default false; if true the sample normal is the face normal, otherwise it is interpolated
 
@@ -96,32 +90,131 @@ public:
     if (qualitySampling)
       m->vert.back().Q() = f.cV(0)->Q()*p[0] + f.cV(1)->Q()*p[1] + f.cV(2)->Q()*p[2];
   }
-  void AddTextureSample(const CMeshO::FaceType &f, const CMeshO::CoordType &p, const Point2i &tp, float edgeDist)
+
+}; // end class BaseSampler
+
+
+/* This sampler generates a sample for each texel whose center falls inside
+ * the wedge uv triangle of a face, with the same coverage rule of
+ * SurfaceSampling::Texture. The faces are rasterized in parallel in two
+ * passes: the first one counts the texels of each face, the second one writes
+ * each texel at the offset of its face in position, normal and color arrays
+ * sized once for all the samples, which are then appended to the destination
+ * mesh with a single allocation.
+ */
+class TexelSampler
+{
+public:
+  const QImage* tex=0;   // if set, the color of the samples is taken from it
+  int texSamplingWidth=0;
+  int texSamplingHeight=0;
+  bool uvSpaceFlag=false; // the samples are placed at their texel coords instead of on the surface
+
+  std::vector<Point3m> pos;
+  std::vector<Point3m> normal;
+  std::vector<Color4b> color;
+
+  void sample(const CMeshO &m)
   {
-    if (edgeDist != .0) return;
+    int faceNum = int(m.face.size());
+    std::vector<size_t> offset(faceNum+1,0);
 
-    tri::Allocator<CMeshO>::AddVertices(*m,1);
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int i=0;i<faceNum;++i)
+    {
+      if(m.face[i].IsD()) continue;
+      size_t cnt=0;
+      raster(m.face[i], [&](int, int, const CMeshO::CoordType &){ ++cnt; });
+      offset[i+1]=cnt;
+    }
+    for(int i=0;i<faceNum;++i)
+      offset[i+1]+=offset[i];
 
-    if(uvSpaceFlag) m->vert.back().P() = Point3m(float(tp[0]),float(tp[1]),0);
-    else m->vert.back().P() = f.cP(0)*p[0] + f.cP(1)*p[1] +f.cP(2)*p[2];
+    pos.resize(offset[faceNum]);
+    normal.resize(offset[faceNum]);
+    color.resize(tex ? offset[faceNum] : 0);
 
-    m->vert.back().N() = f.cV(0)->N()*p[0] + f.cV(1)->N()*p[1] +f.cV(2)->N()*p[2];
-    if(tex)
+    #pragma omp parallel for schedule(dynamic,256)
+    for(int i=0;i<faceNum;++i)
     {
-      QRgb val;
-      // Computing normalized texels position
-      int xpos = (int)(tex->width()  * (float(tp[0])/texSamplingWidth)) % tex->width();
-      int ypos = (int)(tex->height() * (1.0- float(tp[1])/texSamplingHeight)) % tex->height();
+      const CFaceO &f = m.face[i];
+      if(f.IsD()) continue;
+      size_t k=offset[i];
+      raster(f, [&](int x, int y, const CMeshO::CoordType &p)
+      {
+        if(uvSpaceFlag) pos[k] = Point3m(Scalarm(x),Scalarm(y),0);
+        else pos[k] = f.cP(0)*p[0] + f.cP(1)*p[1] + f.cP(2)*p[2];
+        normal[k] = f.cV(0)->cN()*p[0] + f.cV(1)->cN()*p[1] + f.cV(2)->cN()*p[2];
+        if(tex) color[k] = texel(x,y);
+        ++k;
+      });
+    }
+  }
 
-      if (xpos < 0) xpos += tex->width();
-      if (ypos < 0) ypos += tex->height();
+  void appendTo(CMeshO &m) const
+  {
+    int sampleNum = int(pos.size());
+    size_t first = m.vert.size();
+    tri::Allocator<CMeshO>::AddVertices(m,sampleNum);
 
-      val = tex->pixel(xpos,ypos);
-      m->vert.back().C()=Color4b(qRed(val),qGreen(val),qBlue(val),255);
+    #pragma omp parallel for schedule(static)
+    for(int i=0;i<sampleNum;++i)
+    {
+      CVertexO &v = m.vert[first+i];
+      v.P() = pos[i];
+      v.N() = normal[i];
+      if(!color.empty()) v.C() = color[i];
     }
+  }
+
+private:
+  // calls op(x,y,bary) for each texel center (x,y) covered by the uv triangle of f
+  template <class Op>
+  void raster(const CFaceO &f, Op op) const
+  {
+    Point2f v[3];
+    for(int i=0;i<3;++i)
+      v[i] = Point2f(f.cWT(i).U()*texSamplingWidth - 0.5f, f.cWT(i).V()*texSamplingHeight - 0.5f);
 
+    double de = v[0][0]*v[1][1]-v[0][1]*v[1][0] + v[1][0]*v[2][1]-v[1][1]*v[2][0] + v[2][0]*v[0][1]-v[2][1]*v[0][0];
+    if(de==0) return;
+
+    int x0 = int(floor(std::min(v[0][0],std::min(v[1][0],v[2][0])))) - 1;
+    int y0 = int(floor(std::min(v[0][1],std::min(v[1][1],v[2][1])))) - 1;
+    int x1 = int(ceil (std::max(v[0][0],std::max(v[1][0],v[2][0])))) + 1;
+    int y1 = int(ceil (std::max(v[0][1],std::max(v[1][1],v[2][1])))) + 1;
+
+    Point2f d[3] = { v[1]-v[0], v[2]-v[1], v[0]-v[2] };
+    for(int x=x0;x<=x1;++x)
+      for(int y=y0;y<=y1;++y)
+      {
+        float n[3];
+        for(int i=0;i<3;++i)
+          n[i] = (x-v[i][0])*d[i][1] - (y-v[i][1])*d[i][0];
+        if((n[0]>=0 && n[1]>=0 && n[2]>=0) || (n[0]<=0 && n[1]<=0 && n[2]<=0))
+        {
+          CMeshO::CoordType bary;
+          bary[0] =  (-y*v[1][0] + v[2][0]*y + v[1][1]*x - v[2][0]*v[1][1] + v[1][0]*v[2][1] - x*v[2][1])/de;
+          bary[1] = -( x*v[0][1] - x*v[2][1] - v[0][0]*y + v[0][0]*v[2][1] - v[2][0]*v[0][1] + v[2][0]*y)/de;
+          bary[2] = 1 - bary[0] - bary[1];
+          op(x,y,bary);
+        }
+      }
   }
-}; // end class BaseSampler
+
+  Color4b texel(int x, int y) const
+  {
+    // Computing normalized texels position
+    int xpos = (int)(tex->width()  * (float(x)/texSamplingWidth)) % tex->width();
+    int ypos = (int)(tex->height() * (1.0- float(y)/texSamplingHeight)) % tex->height();
+
+    if (xpos < 0) xpos += tex->width();
+    if (ypos < 0) ypos += tex->height();
+
+    QRgb val = tex->pixel(xpos,ypos);
+    return Color4b(qRed(val),qGreen(val),qBlue(val),255);
+  }
+}; // end class TexelSampler
 
 
 
@@ -873,19 +966,21 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		
 		MeshModel *mm= md.addNewMesh("", "Texel samples", true); // The new mesh is the current one
 		bool RecoverColor = par.getBool("RecoverColor");
-		BaseSampler mps(&(mm->cm));
-		mps.texSamplingWidth=par.getInt("TextureW");
-		mps.texSamplingHeight=par.getInt("TextureH");
+		TexelSampler ts;
+		ts.texSamplingWidth=par.getInt("TextureW");
+		ts.texSamplingHeight=par.getInt("TextureH");
 		
+		QImage tex;
 		if(RecoverColor && curMM->cm.textures.size()>0)
 		{
-			mps.tex= new QImage(curMM->getTexture(curMM->cm.textures[0]));
-			if(mps.texSamplingWidth==0)  mps.texSamplingWidth  = mps.tex->width();
-			if(mps.texSamplingHeight==0) mps.texSamplingHeight = mps.tex->height();
+			tex = curMM->getTexture(curMM->cm.textures[0]);
+			ts.tex = &tex;
+			if(ts.texSamplingWidth==0)  ts.texSamplingWidth  = tex.width();
+			if(ts.texSamplingHeight==0) ts.texSamplingHeight = tex.height();
 		}
-		mps.uvSpaceFlag = par.getBool("TextureSpace");
-		vcg::tri::UpdateFlags<CMeshO>::FaceClearB(curMM->cm);
-		tri::SurfaceSampling<CMeshO,BaseSampler>::Texture(curMM->cm,mps,mps.texSamplingWidth,mps.texSamplingHeight);
+		ts.uvSpaceFlag = par.getBool("TextureSpace");
+		ts.sample(curMM->cm);
+		ts.appendTo(mm->cm);
 		vcg::tri::UpdateBounding<CMeshO>::Box(mm->cm);
 		mm->updateDataMask(MeshModel::MM_VERTNORMAL | MeshModel::MM_VERTCOLOR);
 		log("Texel Sampling created a new mesh of %i points", mm->cm.vn);
@@ -151,6 +151,9 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 		pp.DensityFlag = true;
 		pp.CleanFlag = params.getBool("preClean");
 		pp.ThreadsVal = params.getInt("threads");
+		double memoryBudget = params.getInt("memoryBudget");
+		QString slabPath = currDirChanged ? tmpdir.path() : QDir::currentPath();
+		int slabNum = 1;
 
 		bool goodNormal=true, goodColor=true;
 		if(params.getBool("visibleLayer") == false) {
@@ -193,11 +196,21 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 			}
 
 			MeshDocumentPointStream<Scalarm> documentStream(md);
-			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&documentStream,bb,pm->cm,pp,cb);
+			if (memoryBudget > 0)
+				slabNum = _ExecuteSlabs<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&documentStream,bb,pm->cm,pp,memoryBudget,slabPath,cb);
+			else
+				_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&documentStream,bb,pm->cm,pp,cb);
 		}
 		else {
 			MeshModelPointStream<Scalarm> meshStream(md.mm()->cm);
-			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&meshStream,md.mm()->cm.bbox,pm->cm,pp,cb);
+			if (memoryBudget > 0)
+				slabNum = _ExecuteSlabs<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&meshStream,md.mm()->cm.bbox,pm->cm,pp,memoryBudget,slabPath,cb);
+			else
+				_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&meshStream,md.mm()->cm.bbox,pm->cm,pp,cb);
+		}
+		if (slabNum > 1) {
+			log("Reconstructed in %d slabs", slabNum);
+			log(GLLogStream::WARNING, "The slabs are reconstructed separately and their seams are not stitched: the mesh can have small cracks and overlapping faces along the %d cut planes", slabNum - 1);
 		}
 		pm->updateBoxAndNormals();
 		md.setVisible(pm->id(),true);
@@ -230,6 +243,7 @@ RichParameterList FilterScreenedPoissonPlugin::initParameterList(
 		parlist.addParam(RichBool("confidence", false, "Confidence Flag", "Enabling this flag tells the reconstructor to use the quality as confidence information; this is done by scaling the unit normals with the quality values. When the flag is not enabled, all normals are normalized to have unit-length prior to reconstruction."));
 		parlist.addParam(RichBool("preClean", false, "Pre-Clean", "Enabling this flag force a cleaning pre-pass on the data removing all unreferenced vertices or vertices with null normals."));
 		parlist.addParam(RichInt("threads", nThreads, "Number Threads", "Maximum number of threads that the reconstruction algorithm can use."));
+		parlist.addParam(RichInt("memoryBudget", 0, "Memory Budget (MB)", "If larger than zero, the reconstruction is performed out-of-core: the points are split along the largest dimension of their bounding box into overlapping slabs, each one small enough to be reconstructed within the given budget. Slabs are reconstructed one at a time, on the same octree grid, saved in the temporary folder and finally merged, welding the close vertices. Peak memory no longer grows with the whole point set, at the cost of a slightly longer processing time. Since each slab is a separate reconstruction, the seams are not stitched and the result can have small cracks and overlapping faces along the cut planes.", true));
 	}
 	return parlist;
 }
@@ -38,9 +38,15 @@
 
 #include "Src/MultiGridOctreeData.h"
 
+#include <QFile>
 #include <vcg/space/box3.h>
+#include <vcg/complex/append.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <wrap/io_trimesh/export_ply.h>
+#include <wrap/io_trimesh/import_ply.h>
 #include <common/ml_document/cmesh.h>
 #include <common/ml_document/mesh_model.h>
+#include <common/mlexception.h>
 
 inline void DumpOutput( const char* format , ... )
 {
@@ -285,6 +291,37 @@ public:
 
 };
 
+/*
+ * Point stream returning only the points of another stream whose coordinate
+ * along the given axis is in [minV, maxV). The points are filtered on the fly,
+ * nothing is copied.
+ */
+template< class Real >
+class SlabPointStream : public OrientedPointStreamWithData< Real, Point3m >
+{
+	OrientedPointStreamWithData< Real, Point3m > &_s;
+	int _axis;
+	Real _minV, _maxV;
+public:
+	SlabPointStream( OrientedPointStreamWithData< Real, Point3m > &s, int axis, Real minV, Real maxV ) :
+		_s(s), _axis(axis), _minV(minV), _maxV(maxV)
+	{
+	}
+
+	~SlabPointStream( void ){}
+
+	void reset( void ) { _s.reset(); }
+
+	bool nextPoint( OrientedPoint3D< Real >& pt, Point3m &d )
+	{
+		while(_s.nextPoint(pt, d)) {
+			if(pt.p[_axis] >= _minV && pt.p[_axis] < _maxV)
+				return true;
+		}
+		return false;
+	}
+};
+
 template< class Real>
 XForm4x4<Real> GetPointStreamScale(vcg::Box3<Real> &bb, float expFact)
 {
@@ -532,6 +569,162 @@ int _Execute(
 	return 1;
 }
 
+// Removes the temporary slab meshes when leaving _ExecuteSlabs, also when a
+// slab throws.
+struct SlabFiles
+{
+	std::vector<QString> names;
+	~SlabFiles()
+	{
+		for (const QString& fileName : names)
+			QFile::remove(fileName);
+	}
+};
+
+// Rough estimates of the peak memory used by the reconstruction for each input
+// sample and for each octree node; they are used only to choose the number of
+// slabs for a memory budget.
+const double POISSON_BYTES_PER_SAMPLE = 256.0;
+const double POISSON_BYTES_PER_NODE = 256.0;
+
+/*
+ * Rough estimate of the bytes used to reconstruct pointNum samples with the
+ * given parameters. The octree refines the surface down to the maximum depth:
+ * about 2*pi*4^depth finest cells for a closed surface filling the box (but
+ * not many more cells than samples), plus 1/3 of them for the coarser levels.
+ * The levels up to the full depth are dense, whatever the samples: that part is
+ * returned also in fixedBytes, since it is not reduced by splitting the points.
+ */
+template< class Real >
+double PoissonMemoryEstimate(size_t pointNum, const PoissonParam<Real> &pp, double &fixedBytes)
+{
+	const double surfaceCells = 2 * M_PI * std::pow(4.0, pp.MaxDepthVal) / (pp.ScaleVal * pp.ScaleVal);
+	const double finestNodes = std::min(surfaceCells, 27.0 * pointNum);
+	const double denseNodes = (std::pow(8.0, pp.FullDepthVal + 1) - 1) / 7;
+	fixedBytes = denseNodes * POISSON_BYTES_PER_NODE;
+	return pointNum * POISSON_BYTES_PER_SAMPLE + finestNodes * 4 / 3 * POISSON_BYTES_PER_NODE + fixedBytes;
+}
+
+/*
+ * Bounded memory version of _Execute.
+ *
+ * The domain is split along its largest dimension into slabs holding about the
+ * same number of points, so that the points of each slab (plus an overlap
+ * margin) fit in memoryBudgetMB. Each slab is reconstructed on its own, with
+ * the same global bounding box (hence the same octree grid) of a whole run,
+ * streaming only its points from pointStream; the triangles whose barycenter
+ * is in the core of the slab are written to a binary ply in tmpPath and the
+ * slab octree is released before the next one is built.
+ * Finally the slab meshes are appended to pm and the vertices closer than a
+ * quarter of voxel are welded.
+ *
+ * The seams are not stitched: each slab is a separate solve, with its own
+ * octree and iso-value, so the surfaces of two neighbouring slabs do not share
+ * vertices at the cut. Since faces are assigned to a slab by their barycenter,
+ * the result can have narrow cracks and overlapping faces along each cut
+ * plane; the caller should warn about it.
+ *
+ * Returns the number of slabs used.
+ */
+template< class Real , int Degree , BoundaryType BType , class Vertex >
+int _ExecuteSlabs(
+		OrientedPointStreamWithData< Real, Point3m > *pointStream,
+		Box3m bb, CMeshO &pm,
+		PoissonParam<Real> &pp,
+		double memoryBudgetMB,
+		const QString &tmpPath,
+		vcg::CallBackPos* cb)
+{
+	const int axis = bb.MaxDim();
+	const Real axisMin = bb.min[axis], axisLen = std::max<Real>(bb.Dim()[axis], std::numeric_limits<Real>::min());
+
+	// distribution of the points along the axis
+	const int binNum = 4096;
+	std::vector<size_t> hist(binNum, 0);
+	size_t pointNum = 0;
+	{
+		OrientedPoint3D< Real > pt;
+		Point3m d;
+		pointStream->reset();
+		while(pointStream->nextPoint(pt, d)) {
+			int b = int((pt.p[axis] - axisMin) / axisLen * binNum);
+			hist[std::min(std::max(b, 0), binNum - 1)]++;
+			++pointNum;
+		}
+		pointStream->reset();
+	}
+
+	// the part of the memory that grows with the points and the surface is
+	// split among the slabs, the dense levels are built by each slab
+	double fixedBytes;
+	const double totalBytes = PoissonMemoryEstimate(pointNum, pp, fixedBytes);
+	const double slabBytes = memoryBudgetMB * (1 << 20) - fixedBytes;
+	int slabNum = slabBytes > 0 ? int(std::min<double>(std::ceil((totalBytes - fixedBytes) / slabBytes), binNum)) : binNum;
+	slabNum = std::max(1, std::min(slabNum, binNum));
+	if (slabNum == 1) {
+		_Execute< Real, Degree, BType, Vertex >(pointStream, bb, pm, pp, cb);
+		return 1;
+	}
+
+	// cuts at the quantiles of the distribution
+	std::vector<Real> cuts(1, -std::numeric_limits<Real>::max());
+	size_t acc = 0;
+	for (int b = 0; b < binNum && (int)cuts.size() < slabNum; ++b) {
+		acc += hist[b];
+		if (acc >= pointNum * cuts.size() / slabNum)
+			cuts.push_back(axisMin + axisLen * (b + 1) / binNum);
+	}
+	cuts.push_back(std::numeric_limits<Real>::max());
+	slabNum = int(cuts.size()) - 1;
+
+	const Real voxel = bb.Dim()[bb.MaxDim()] * pp.ScaleVal / Real(1 << pp.MaxDepthVal);
+	const int mask = vcg::tri::io::Mask::IOM_VERTQUALITY | vcg::tri::io::Mask::IOM_VERTCOLOR;
+	SlabFiles slabFiles;
+	for (int k = 0; k < slabNum; ++k) {
+		const Real lo = std::max(cuts[k], axisMin);
+		const Real hi = std::min(cuts[k+1], axisMin + axisLen);
+		const Real margin = std::max<Real>(32 * voxel, (hi - lo) * 0.1);
+
+		SlabPointStream< Real > slabStream(*pointStream, axis, lo - margin, hi + margin);
+		CMeshO slabMesh;
+		PoissonParam<Real> spp = pp;
+		_Execute< Real, Degree, BType, Vertex >(&slabStream, bb, slabMesh, spp, cb);
+
+		for (auto fi = slabMesh.face.begin(); fi != slabMesh.face.end(); ++fi) {
+			Real c = vcg::Barycenter(*fi)[axis];
+			if (c < cuts[k] || c >= cuts[k+1])
+				vcg::tri::Allocator<CMeshO>::DeleteFace(slabMesh, *fi);
+		}
+		vcg::tri::Clean<CMeshO>::RemoveUnreferencedVertex(slabMesh);
+		vcg::tri::Allocator<CMeshO>::CompactEveryVector(slabMesh);
+
+		QString fileName = tmpPath + QString("/poisson_slab_%1.ply").arg(k);
+		if (vcg::tri::io::ExporterPLY<CMeshO>::Save(slabMesh, qUtf8Printable(fileName), mask, true) != 0)
+			throw MLException("Unable to save the temporary slab mesh " + fileName);
+		slabFiles.names.push_back(fileName);
+	}
+
+	if (cb != nullptr)
+		cb(95, "Merging slabs");
+	for (const QString& fileName : slabFiles.names) {
+		CMeshO slabMesh;
+		int loadMask = mask;
+		int result = vcg::tri::io::ImporterPLY<CMeshO>::Open(slabMesh, qUtf8Printable(fileName), loadMask);
+		if (result != 0)
+			throw MLException("Unable to load the temporary slab mesh " + fileName + ": " +
+				vcg::tri::io::ImporterPLY<CMeshO>::ErrorMsg(result));
+		vcg::tri::Append<CMeshO, CMeshO>::MeshAppendConst(pm, slabMesh);
+	}
+	vcg::tri::Clean<CMeshO>::MergeCloseVertex(pm, voxel * 0.25);
+	vcg::tri::Clean<CMeshO>::RemoveDegenerateFace(pm);
+	vcg::tri::Clean<CMeshO>::RemoveDuplicateFace(pm);
+	vcg::tri::Clean<CMeshO>::RemoveUnreferencedVertex(pm);
+	vcg::tri::Allocator<CMeshO>::CompactEveryVector(pm);
+	if (cb != nullptr)
+		cb(100, "Done");
+	return slabNum;
+}
+
 template <class MeshType>
 void PoissonClean(MeshType &m, bool scaleNormal, bool cleanFlag)
 {
@@ -1,4 +1,5 @@
 #include "filter_sdfgpu.h"
+#include "sdf_cpu.h"
 #include <common/GLExtensionsManager.h>
 
 #include <vcg/complex/complex.h>
@@ -57,6 +58,9 @@ RichParameterList SdfGpuPlugin::initParameterList(const QAction *action, const M
 	par.addParam(RichFloat("peelingTolerance", 0.0000001f, "Peeling Tolerance",
 						   "Depth tolerance used during depth peeling. This is the threshold used to differentiate layers between each others."
         "Two elements whose distance is below this value will be considered as belonging to the same layer."));
+	par.addParam(RichBool("useCPU", false, "Use CPU ray casting",
+						  "Trace the rays on the CPU against a bounding volume hierarchy of the mesh, in parallel, instead of using depth peeling on the GPU. "
+        "It does not need an OpenGL context and it is not limited by the texture sizes; the depth texture size is used as the resolution of the ray grid of the depth complexity."));
 
 	if(ID(action) != SDF_DEPTH_COMPLEXITY)
 		par.addParam(RichFloat("coneAngle",120,"Cone amplitude", "Cone amplitude around normals in degrees. Rays are traced within this cone."));
@@ -159,7 +163,8 @@ std::map<std::string, QVariant> SdfGpuPlugin::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos *cb)
 {
-	if (glContext == nullptr){
+	bool useCPU = pars.getBool("useCPU");
+	if (glContext == nullptr && !useCPU){
 		throw MLException("Fatal error: glContext not initialized");
 	}
 	MeshModel* mm = md.mm();
@@ -187,6 +192,12 @@ std::map<std::string, QVariant> SdfGpuPlugin::applyFilter(
 	//MESH CLEAN UP
 	setupMesh( md, mOnPrimitive );
 
+	if(useCPU)
+	{
+		traceRaysCPU(action, *mm, numViews, peel, cb);
+		return std::map<std::string, QVariant>();
+	}
+
 	//glContext->makeCurrent();
 	//GL INIT
 	if(!initGL(*mm))
@@ -611,8 +622,89 @@ void SdfGpuPlugin::setupMesh(MeshDocument& md, ONPRIMITIVE onPrimitive )
 	else if(!vcg::tri::HasPerFaceAttribute(m,"maxQualityDir") && onPrimitive == ON_FACES)
 		mMaxQualityDirPerFace = vcg::tri::Allocator<CMeshO>::AddPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
 
-	glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
+	if(glContext != nullptr)
+		glContext->meshAttributesUpdated(mm->id(),true,MLRenderingData::RendAtts());
+
+}
+
+void SdfGpuPlugin::traceRaysCPU(const QAction* action, MeshModel& mm, unsigned int numViews, int peel, vcg::CallBackPos* cb)
+{
+	CMeshO& m = mm.cm;
+	meshlab::MeshBVH bvh(m);
+
+	std::vector<Point3m> unifDirVec;
+	GenNormal<Scalarm>::Fibonacci(numViews,unifDirVec);
+	for(Point3m& d : unifDirVec)
+		d.Normalize();
+	log(GLLogStream::SYSTEM, "Number of rays: %i ", unifDirVec.size() );
+
+	//same scale of the depth buffer of the GPU version, see setCamera
+	const Scalarm scale = 2*0.1f + m.bbox.Diag();
 
+	if(ID(action) == SDF_DEPTH_COMPLEXITY)
+	{
+		vector<int> depthDistrib(peel,0);
+		int depthComplexity = sdfcpu::computeDepthComplexity(
+			bvh, unifDirVec, mPeelingTextureSize, peel, PIXEL_COUNT_THRESHOLD, mTolerance*scale, depthDistrib, cb);
+		if(depthComplexity == peel-1)
+			log(GLLogStream::SYSTEM,"WARNING: You may have underestimated the depth complexity of the mesh. Run the filter with a higher number of peeling iteration.");
+
+		log(GLLogStream::SYSTEM, "Mesh depth complexity %i (The accuracy of the result depends on the value you provided for the max number of peeling iterations, \n if you get warnings try increasing"
+			" the peeling iteration parameter)\n", depthComplexity );
+		log(GLLogStream::SYSTEM, "Depth complexity             NumberOfViews\n" );
+		for(int j = 0; j < peel; j++)
+			log(GLLogStream::SYSTEM, "   %i                             %i\n", j, depthDistrib[j] );
+		return;
+	}
+
+	//sample points and normals, on vertices or face barycenters
+	std::vector<Point3m> pos, nrm;
+	if(mOnPrimitive == ON_VERTICES)
+	{
+		for(const CVertexO& v : m.vert)
+		{
+			pos.push_back(v.cP());
+			nrm.push_back(Point3m(v.cN()).Normalize());
+		}
+	}
+	else
+	{
+		for(const CFaceO& f : m.face)
+		{
+			pos.push_back(Barycenter(f));
+			nrm.push_back(TriangleNormal(f).Normalize());
+		}
+	}
+
+	std::vector<Scalarm> value;
+	std::vector<Point3m> maxDir;
+	if(ID(action) == SDF_SDF)
+		sdfcpu::computeSdf(m, bvh, pos, nrm, unifDirVec, mMinCos, mRemoveFalse, mRemoveOutliers, value, maxDir, cb);
+	else
+		sdfcpu::computeObscurance(bvh, pos, nrm, unifDirVec, mTau/scale, value, maxDir, cb);
+
+	if(mOnPrimitive == ON_VERTICES)
+	{
+		auto dirH = tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3f>(m,std::string("maxQualityDir"));
+		for(int i = 0; i < m.vn; ++i)
+		{
+			m.vert[i].Q() = value[i];
+			dirH[i] = Point3f::Construct(maxDir[i]);
+		}
+		if(ID(action) == SDF_OBSCURANCE)
+			tri::UpdateColor<CMeshO>::PerVertexQualityGray(m,0.0f,0.0f);
+	}
+	else
+	{
+		auto dirH = tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3f>(m,std::string("maxQualityDir"));
+		for(int i = 0; i < m.fn; ++i)
+		{
+			m.face[i].Q() = value[i];
+			dirH[i] = Point3f::Construct(maxDir[i]);
+		}
+		if(ID(action) == SDF_OBSCURANCE)
+			tri::UpdateColor<CMeshO>::PerFaceQualityGray(m);
+	}
 }
 
 void SdfGpuPlugin::setCamera(Point3f camDir, Box3f meshBBox)
@@ -99,6 +99,9 @@ class SdfGpuPlugin : public QObject, public FilterPlugin
 	void preRender(unsigned int peelingIteration);
 	
 	bool postRender(unsigned int peelingIteration);
+
+	//Sdf, obscurance or depth complexity traced on the CPU, without GL context
+	void traceRaysCPU(const QAction* action, MeshModel& mm, unsigned int numViews, int peel, vcg::CallBackPos* cb);
 protected:
 	
 	ONPRIMITIVE        mOnPrimitive;
@@ -0,0 +1,206 @@
+#include "sdf_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sdfcpu {
+
+namespace {
+
+/* calls fn(i) for every sample in parallel, in chunks to report the progress */
+template<typename Fn>
+void forEachSample(int n, const char* msg, vcg::CallBackPos* cb, Fn fn)
+{
+	const int chunkSize = std::max(1024, n / 100);
+	for (int begin = 0; begin < n; begin += chunkSize) {
+		if (cb)
+			cb(100 * begin / n, msg);
+		const int end = std::min(n, begin + chunkSize);
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int i = begin; i < end; ++i)
+			fn(i);
+	}
+}
+
+/* distance below which hits are considered on the surface the rays start from */
+Scalarm rayEpsilon(const meshlab::MeshBVH& bvh)
+{
+	return bvh.boundingBox().Diag() * 1e-5;
+}
+
+struct RaySample
+{
+	Scalarm length;
+	Scalarm weight;
+	Point3m dir;
+};
+
+} // namespace
+
+void computeSdf(
+	const CMeshO&               m,
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& pos,
+	const std::vector<Point3m>& nrm,
+	const std::vector<Point3m>& dirs,
+	Scalarm                     minCos,
+	bool                        removeFalse,
+	bool                        removeOutliers,
+	std::vector<Scalarm>&       value,
+	std::vector<Point3m>&       maxDir,
+	vcg::CallBackPos*           cb)
+{
+	const int     n    = pos.size();
+	const Scalarm eps  = rayEpsilon(bvh);
+	const Scalarm tMax = std::numeric_limits<Scalarm>::max();
+	value.assign(n, 0);
+	maxDir.assign(n, Point3m(0, 0, 0));
+
+	forEachSample(n, "Tracing rays...", cb, [&](int i) {
+		std::vector<RaySample> samples;
+		samples.reserve(dirs.size());
+		for (const Point3m& d : dirs) {
+			Scalarm cosAngle = std::max<Scalarm>(0, nrm[i] * d);
+			if (cosAngle < minCos || cosAngle == 0)
+				continue;
+			meshlab::MeshBVH::Hit hit;
+			if (!bvh.closestHit(pos[i], -d, eps, tMax, hit))
+				continue;
+			if (removeFalse && vcg::TriangleNormal(m.face[hit.face]) * nrm[i] > 0)
+				continue;
+			samples.push_back({hit.t, cosAngle, d});
+		}
+
+		if (removeOutliers && samples.size() > 2) {
+			std::vector<Scalarm> lengths(samples.size());
+			Scalarm              mean = 0;
+			for (size_t k = 0; k < samples.size(); ++k) {
+				lengths[k] = samples[k].length;
+				mean += lengths[k];
+			}
+			mean /= samples.size();
+			Scalarm var = 0;
+			for (Scalarm l : lengths)
+				var += (l - mean) * (l - mean);
+			const Scalarm stdDev = std::sqrt(var / samples.size());
+			std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2, lengths.end());
+			const Scalarm median = lengths[lengths.size() / 2];
+			samples.erase(
+				std::remove_if(
+					samples.begin(),
+					samples.end(),
+					[&](const RaySample& s) { return std::abs(s.length - median) > stdDev; }),
+				samples.end());
+		}
+
+		Scalarm sum = 0, weightSum = 0;
+		Point3m dirSum(0, 0, 0);
+		for (const RaySample& s : samples) {
+			sum += s.length * s.weight;
+			weightSum += s.weight;
+			dirSum += s.dir * (s.length * s.weight);
+		}
+		value[i]  = weightSum > 0 ? sum / weightSum : 0;
+		maxDir[i] = dirSum.Normalize();
+	});
+}
+
+void computeObscurance(
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& pos,
+	const std::vector<Point3m>& nrm,
+	const std::vector<Point3m>& dirs,
+	Scalarm                     tau,
+	std::vector<Scalarm>&       value,
+	std::vector<Point3m>&       maxDir,
+	vcg::CallBackPos*           cb)
+{
+	const int     n    = pos.size();
+	const Scalarm eps  = rayEpsilon(bvh);
+	const Scalarm tMax = std::numeric_limits<Scalarm>::max();
+	value.assign(n, 0);
+	maxDir.assign(n, Point3m(0, 0, 0));
+
+	forEachSample(n, "Tracing rays...", cb, [&](int i) {
+		Scalarm sum = 0;
+		Point3m dirSum(0, 0, 0);
+		for (const Point3m& d : dirs) {
+			Scalarm cosAngle = nrm[i] * d;
+			if (cosAngle <= 0)
+				continue;
+			Scalarm                obscurance = cosAngle;
+			meshlab::MeshBVH::Hit hit;
+			if (bvh.closestHit(pos[i], d, eps, tMax, hit))
+				obscurance *= 1 - std::exp(-tau * hit.t);
+			sum += obscurance;
+			dirSum += d * obscurance;
+		}
+		value[i]  = dirs.empty() ? 0 : sum / dirs.size();
+		maxDir[i] = dirSum.Normalize();
+	});
+}
+
+int computeDepthComplexity(
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& dirs,
+	int                         gridSize,
+	int                         maxLayers,
+	int                         minRayCount,
+	Scalarm                     tolerance,
+	std::vector<int>&           distrib,
+	vcg::CallBackPos*           cb)
+{
+	const Box3m&  bb     = bvh.boundingBox();
+	const Scalarm radius = bb.Diag() / 2;
+	const Scalarm eps    = rayEpsilon(bvh);
+	const Scalarm tMax   = std::numeric_limits<Scalarm>::max();
+	const int     rayNum = gridSize * gridSize;
+	int           maxComplexity = 0;
+
+	for (size_t j = 0; j < dirs.size(); ++j) {
+		if (cb)
+			cb(100 * j / dirs.size(), "Tracing rays...");
+		const Point3m& d = dirs[j];
+
+		// orthonormal frame of the grid plane, placed outside the mesh
+		Point3m axis = std::abs(d[0]) < 0.5 ? Point3m(1, 0, 0) : Point3m(0, 1, 0);
+		Point3m u    = (d ^ axis).Normalize();
+		Point3m v    = d ^ u;
+		Point3m o    = bb.Center() + d * (radius + eps);
+		Scalarm cell = 2 * radius / gridSize;
+
+		// layerRays[k]: number of rays that hit at least k+1 layers
+		std::vector<int> layerRays(maxLayers + 1, 0);
+#pragma omp parallel
+		{
+			std::vector<int>                   localRays(maxLayers + 1, 0);
+			std::vector<meshlab::MeshBVH::Hit> hits;
+#pragma omp for schedule(dynamic, 256)
+			for (int r = 0; r < rayNum; ++r) {
+				Scalarm x = (r % gridSize + 0.5) * cell - radius;
+				Scalarm y = (r / gridSize + 0.5) * cell - radius;
+				bvh.allHits(o + u * x + v * y, -d, 0, tMax, hits);
+				int layers = hits.empty() ? 0 : 1;
+				for (size_t h = 1; h < hits.size() && layers <= maxLayers; ++h)
+					if (hits[h].t - hits[h - 1].t > tolerance)
+						++layers;
+				for (int k = 0; k < layers; ++k)
+					localRays[k]++;
+			}
+#pragma omp critical
+			for (int k = 0; k <= maxLayers; ++k)
+				layerRays[k] += localRays[k];
+		}
+
+		// as the depth peeling: after the first layer, count the layers reached by enough rays
+		int complexity = 0;
+		while (complexity + 1 < maxLayers && layerRays[complexity + 1] > minRayCount)
+			++complexity;
+		distrib[complexity]++;
+		maxComplexity = std::max(maxComplexity, complexity);
+	}
+	return maxComplexity;
+}
+
+} // namespace sdfcpu
@@ -0,0 +1,75 @@
+#ifndef SDF_CPU_H
+#define SDF_CPU_H
+
+#include <common/utilities/mesh_bvh.h>
+#include <vcg/space/point3.h>
+
+#include <vector>
+
+/*
+ * CPU versions of the depth peeling computations of SdfGpuPlugin.
+ * Rays are cast against a MeshBVH, in parallel over the sample points (the
+ * vertices or the face barycenters), so no OpenGL context is needed.
+ * The sample directions are the same of the GPU version: a ray direction d
+ * is used for a sample with normal n only if n*d is inside the cone.
+ */
+namespace sdfcpu {
+
+/*
+ * Shape diameter function: for each sample and each direction in the cone
+ * around the normal, the length of the inward ray (toward -d) to the other
+ * side of the mesh, averaged with the cosine weights.
+ * With removeFalse, hits on faces oriented as the sample are ignored; with
+ * removeOutliers, the lengths farther than one standard deviation from the
+ * median of the sample are discarded.
+ * maxDir receives the average direction weighted by the sdf contributions.
+ */
+void computeSdf(
+	const CMeshO&               m,
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& pos,
+	const std::vector<Point3m>& nrm,
+	const std::vector<Point3m>& dirs,
+	Scalarm                     minCos,
+	bool                        removeFalse,
+	bool                        removeOutliers,
+	std::vector<Scalarm>&       value,
+	std::vector<Point3m>&       maxDir,
+	vcg::CallBackPos*           cb);
+
+/*
+ * Volumetric obscurance: an unoccluded direction contributes its cosine,
+ * an occluded one its cosine times 1-exp(-tau*dist), where dist is the
+ * distance of the occluder. The sum is divided by the number of directions.
+ */
+void computeObscurance(
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& pos,
+	const std::vector<Point3m>& nrm,
+	const std::vector<Point3m>& dirs,
+	Scalarm                     tau,
+	std::vector<Scalarm>&       value,
+	std::vector<Point3m>&       maxDir,
+	vcg::CallBackPos*           cb);
+
+/*
+ * Depth complexity: for each direction a grid of gridSize^2 parallel rays
+ * covering the mesh is traversed, counting all the hits (hits closer than
+ * tolerance belong to the same layer). A layer is counted when more than
+ * minRayCount rays reach it, at most maxLayers layers are checked. The per
+ * direction complexity is accumulated in distrib (which must have maxLayers
+ * elements); returns the maximum.
+ */
+int computeDepthComplexity(
+	const meshlab::MeshBVH&     bvh,
+	const std::vector<Point3m>& dirs,
+	int                         gridSize,
+	int                         maxLayers,
+	int                         minRayCount,
+	Scalarm                     tolerance,
+	std::vector<int>&           distrib,
+	vcg::CallBackPos*           cb);
+
+} // namespace sdfcpu
+
+#endif // SDF_CPU_H
@@ -29,9 +29,11 @@
 #include "filter_texture.h"
 #include "pushpull.h"
 #include "rastering.h"
+#include "texture_baker.h"
+#include "parallel_voronoi_atlas.h"
+#include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/update/texture.h>
 #include<wrap/io_trimesh/export_ply.h>
-#include <vcg/complex/algorithms/parametrization/voronoi_atlas.h>
 #include <common/utilities/load_save.h>
 #include <QStandardPaths>
 
@@ -113,7 +115,7 @@ QString FilterTexturePlugin::filterInfo(ActionIDType filterId) const
 	case FP_PLANAR_MAPPING : return QString("Builds a trivial flat-plane parametrization.");
 	case FP_SET_TEXTURE : return QString("Set a texture associated with current mesh parametrization.<br>" "If the texture provided exists, then it will be simply associated to the current mesh; else the filter will fail with no further actions.");
 	case FP_COLOR_TO_TEXTURE : return QString("Fills the specified texture using per-vertex color data of the mesh.");
-	case FP_TRANSFER_TO_TEXTURE : return QString("Transfer texture color, vertex color or normal from one mesh the texture of another mesh. This may be useful to restore detail lost in simplification, or resample a texture in a different parametrization.");
+	case FP_TRANSFER_TO_TEXTURE : return QString("Transfer texture color, vertex color, normal, quality or a scalar attribute from one mesh the texture of another mesh. This may be useful to restore detail lost in simplification, bake a normal map, or resample a texture in a different parametrization.");
 	case FP_TEX_TO_VCOLOR_TRANSFER : return QString("Generates Vertex Color values picking color from a texture (same mesh or another mesh).");
 	default : assert(0);
 	}
@@ -259,8 +261,10 @@ RichParameterList FilterTexturePlugin::initParameterList(const QAction *action,
 								  "The mesh that contains the source data that we want to transfer"));
 		parlst.addParam(RichMesh ("targetMesh",trg->id(),&md, "Target Mesh",
 								  "The mesh whose texture will be filled according to source mesh data"));
-		parlst.addParam(RichEnum("AttributeEnum", 0, QStringList("Vertex Color")  << "Vertex Normal" << "Vertex Quality"<< "Texture Color", "Color Data Source",
-								 "Choose what attribute has to be transferred onto the target texture. You can choose between Per vertex attributes (color,normal,quality) or to transfer color information from source mesh texture"));
+		parlst.addParam(RichEnum("AttributeEnum", 0, QStringList("Vertex Color")  << "Vertex Normal" << "Vertex Quality"<< "Texture Color" << "Vertex Normal (tangent space)" << "Vertex Scalar Attribute", "Color Data Source",
+								 "Choose what attribute has to be transferred onto the target texture. You can choose between Per vertex attributes (color,normal,quality), to transfer color information from source mesh texture, "
+								 "to bake the source normals as a normal map in the tangent space of the target parametrization, or to transfer a custom per vertex scalar attribute (normalized to its range)"));
+		parlst.addParam(RichString("attributeName", "", "Scalar Attribute Name", "The name of the per vertex scalar attribute of the source mesh transferred by the 'Vertex Scalar Attribute' data source"));
 		parlst.addParam(RichPercentage("upperBound", md.mm()->cm.bbox.Diag()/50.0, 0.0f, md.mm()->cm.bbox.Diag(),
 									tr("Max Dist Search"), tr("Sample points for which we do not find anything within this distance are rejected and not considered for recovering data")));
 		parlst.addParam(RichString("textName", trgFileName, "Texture file", "The texture file to be created"));
@@ -366,6 +370,24 @@ T log_2(const T num)
 	return T(log(num) / log(T(2)));
 }
 
+/////// FUNCTIONS NEEDED BY "TO TEXTURE" FILTERS
+// Makes opaque the texels rasterized near a border edge (alpha < 255);
+// if keepEmpty, texels never rasterized (alpha 0) are left to PullPush.
+static void makeRasterizedTexelsOpaque(QImage &img, bool keepEmpty)
+{
+	uchar *bits = img.bits();
+	const int bytesPerLine = img.bytesPerLine();
+	const int w = img.width(), h = img.height();
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; ++y)
+	{
+		QRgb *row = reinterpret_cast<QRgb *>(bits + y * bytesPerLine);
+		for (int x = 0; x < w; ++x)
+			if (qAlpha(row[x]) < 255 && (!keepEmpty || qAlpha(row[x]) > 0))
+				row[x] |= 0xff000000;
+	}
+}
+
 // The Real Core Function doing the actual mesh processing.
 std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 			const QAction *filter,
@@ -390,28 +412,22 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		}
 		
 		MeshModel *paraModel=md.addNewMesh("","VoroAtlas",false);
-		tri::VoronoiAtlas<CMeshO>::VoronoiAtlasParam pp;
+		voronoiatlas::Param pp;
 		pp.sampleNum =par.getInt("regionNum");
 		pp.overlap=par.getBool("overlapFlag");
 		
 		paraModel->updateDataMask(MeshModel::MM_WEDGTEXCOORD);
-		// Note that CMesh has ocf texcoord and the append inside VoronoiAtlas class need that.
-		// This is a design bug of the VCGLib...
-		int bitToBeCleared =0;
-		if(!baseModel->hasDataMask(MeshModel::MM_WEDGTEXCOORD)) bitToBeCleared |=MeshModel::MM_WEDGTEXCOORD;
-		if(!baseModel->hasDataMask(MeshModel::MM_VERTTEXCOORD)) bitToBeCleared |=MeshModel::MM_VERTTEXCOORD;
-		baseModel->updateDataMask(MeshModel::MM_WEDGTEXCOORD | MeshModel::MM_VERTTEXCOORD);
-		tri::VoronoiAtlas<CMeshO>::Build(baseModel->cm,paraModel->cm, pp);
+		voronoiatlas::Stat vas = voronoiatlas::build(baseModel->cm, paraModel->cm, pp, cb);
 		if(pp.overlap==false)
 			tri::Clean<CMeshO>::RemoveDuplicateVertex(paraModel->cm);
 		
 		paraModel->updateBoxAndNormals();
-		baseModel->clearDataMask(bitToBeCleared);
-		log("Voronoi Atlas: Completed Processing in %i iterations",pp.vas.iterNum);
-		log("Asked %i generated %i regions",pp.sampleNum,pp.vas.regionNum);
-		log("Unwrap Time   %6.3f s", float(pp.vas.unwrapTime) / CLOCKS_PER_SEC);
-		log("Voronoi Time  %6.3f s", float(pp.vas.voronoiTime) / CLOCKS_PER_SEC);
-		log("Sampling Time %6.3f s", float(pp.vas.samplingTime) / CLOCKS_PER_SEC);
+		log("Voronoi Atlas: Completed Processing in %i iterations",vas.iterNum);
+		log("Asked %i generated %i regions",pp.sampleNum,vas.regionNum);
+		log("Unwrap Time   %6.3f s", vas.unwrapTime);
+		log("Voronoi Time  %6.3f s", vas.voronoiTime);
+		log("Sampling Time %6.3f s", vas.samplingTime);
+		log("Packing Time  %6.3f s", vas.packingTime);
 	}
 		break;
 		
@@ -777,13 +793,7 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		{
 			// Revert alpha values for border edge pixels to 255
 			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y<textH; ++y)
-				for (int x = 0; x<textW; ++x)
-				{
-					QRgb px = trgImgs[texInd].pixel(x, y);
-					if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-						trgImgs[texInd].setPixel(x, y, px | 0xff000000);
-				}
+			makeRasterizedTexelsOpaque(trgImgs[texInd], pp);
 
 			// PullPush
 			if (pp)
@@ -835,7 +845,6 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		}
 		
 		trgMesh->updateDataMask(MeshModel::MM_VERTCOLOR);
-		srcMesh->updateDataMask(MeshModel::MM_FACEMARK);
 		
 		// the meshes have to be transformed
 		// only if source different from target (if single mesh, it does not matter)
@@ -847,11 +856,9 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 				tri::UpdatePosition<CMeshO>::Matrix(trgMesh->cm, trgMesh->cm.Tr, true);
 		}
 		
-		tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
 		// Colorizing vertices
-		VertexSampler vs(srcMesh->cm, srcImgs, upperbound);
-		vs.InitCallback(cb, trgMesh->cm.vn);
-		tri::SurfaceSampling<CMeshO,VertexSampler>::VertexUniform(trgMesh->cm,vs,trgMesh->cm.vn);
+		TextureBaker baker(srcMesh->cm, TextureBaker::TEXTURE_COLOR, upperbound, srcImgs);
+		baker.bakeVertexColors(trgMesh->cm, cb);
 		
 		// the meshes have to return to their original position
 		// only if source different from target (if single mesh, it does not matter)
@@ -862,8 +869,6 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 			if (trgMesh->cm.Tr != Matrix44m::Identity())
 				tri::UpdatePosition<CMeshO>::Matrix(trgMesh->cm, Inverse(trgMesh->cm.Tr), true);
 		}
-		
-		srcMesh->clearDataMask(MeshModel::MM_FACEMARK);
 	}
 		break;
 		
@@ -902,13 +907,15 @@ void FilterTexturePlugin::transferToTexture(
 	MeshModel *trgMesh = md.getMesh(par.getMeshId("targetMesh"));
 	bool vertexSampling=false;
 	bool textureSampling=false;
-	int  vertexMode= -1;
+	TextureBaker::Channel channel = TextureBaker::VERTEX_COLOR;
 	switch (par.getEnum("AttributeEnum"))
 	{
-		case 0: vertexSampling= true; vertexMode=0; break;  // Color
-		case 1: vertexSampling= true; vertexMode=1; break;  // Normal
-		case 2: vertexSampling= true; vertexMode=2; break;  // Quality
-		case 3: textureSampling = true; break;
+		case 0: vertexSampling= true; channel=TextureBaker::VERTEX_COLOR; break;
+		case 1: vertexSampling= true; channel=TextureBaker::VERTEX_NORMAL; break;
+		case 2: vertexSampling= true; channel=TextureBaker::VERTEX_QUALITY; break;
+		case 3: textureSampling = true; channel=TextureBaker::TEXTURE_COLOR; break;
+		case 4: vertexSampling= true; channel=TextureBaker::TANGENT_NORMAL; break;
+		case 5: vertexSampling= true; channel=TextureBaker::VERTEX_SCALAR; break;
 		default: assert(0);
 	}
 	Scalarm upperbound = par.getAbsPerc("upperBound"); // maximum distance to stop search
@@ -926,9 +933,10 @@ void FilterTexturePlugin::transferToTexture(
 	CheckError(textH <= 0, "Texture Height has an incorrect value");
 
 	if (vertexSampling) {
-		if (vertexMode == 0) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTCOLOR), "Source mesh doesn't have Per-Vertex Color"); }
-		if (vertexMode == 1) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTNORMAL), "Source mesh doesn't have Per-Vertex Normal"); }
-		if (vertexMode == 2) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTQUALITY), "Source mesh doesn't have Per-Vertex Quality"); }
+		if (channel == TextureBaker::VERTEX_COLOR) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTCOLOR), "Source mesh doesn't have Per-Vertex Color"); }
+		if (channel == TextureBaker::VERTEX_NORMAL || channel == TextureBaker::TANGENT_NORMAL) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTNORMAL), "Source mesh doesn't have Per-Vertex Normal"); }
+		if (channel == TextureBaker::VERTEX_QUALITY) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTQUALITY), "Source mesh doesn't have Per-Vertex Quality"); }
+		if (channel == TextureBaker::VERTEX_SCALAR) { CheckError(!tri::HasPerVertexAttribute(srcMesh->cm, par.getString("attributeName").toStdString()), "Source mesh doesn't have the given Per-Vertex scalar attribute"); }
 	}
 	else {
 		CheckError(srcMesh->cm.fn == 0, "Source mesh needs to have faces");
@@ -981,6 +989,7 @@ void FilterTexturePlugin::transferToTexture(
 		for (srcTexInd = 0; srcTexInd < numSrcTex; srcTexInd++)
 		{
 			srcTextureFileNames[srcTexInd] = srcMesh->cm.textures[srcTexInd].c_str();
+			srcImgs[srcTexInd] = srcMesh->getTexture(srcMesh->cm.textures[srcTexInd]);
 		}
 	}
 
@@ -1019,19 +1028,9 @@ void FilterTexturePlugin::transferToTexture(
 	}
 
 	// Rasterizing faces
-	srcMesh->updateDataMask(MeshModel::MM_FACEMARK);
-	tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
-	if (vertexSampling)
-	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, upperbound, vertexMode); // color sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
-	}
-	else
 	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, &srcImgs, upperbound); // texture sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
+		TextureBaker baker(srcMesh->cm, channel, upperbound, srcImgs, par.getString("attributeName").toStdString());
+		baker.bake(trgMesh->cm, trgImgs, cb, 0, 80);
 	}
 
 	// the meshes have to return to their original position
@@ -1052,13 +1051,7 @@ void FilterTexturePlugin::transferToTexture(
 	{
 		// Revert alpha values for border edge pixels to 255
 		cb(81, "Cleaning up texture ...");
-		for (int y = 0; y<textH; ++y)
-			for (int x = 0; x<textW; ++x)
-			{
-				QRgb px = trgImgs[trgTexInd].pixel(x, y);
-				if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-					trgImgs[trgTexInd].setPixel(x, y, px | 0xff000000);
-			}
+		makeRasterizedTexelsOpaque(trgImgs[trgTexInd], pp);
 
 		// PullPush
 		if (pp)
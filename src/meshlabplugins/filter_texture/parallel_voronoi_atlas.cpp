@@ -0,0 +1,531 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "parallel_voronoi_atlas.h"
+
+#include <vcg/complex/algorithms/closest.h>
+#include <vcg/complex/algorithms/parametrization/poisson_solver.h>
+#include <vcg/complex/algorithms/point_sampling.h>
+#include <vcg/complex/algorithms/update/texture.h>
+#include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/rect_packer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace voronoiatlas {
+
+namespace {
+
+/* mesh used to sample the seeds and to flatten the regions; it has all the
+ * components needed by PoissonSampling and PoissonSolver */
+class VoroVertex;
+class VoroFace;
+class VoroEdge;
+
+struct VoroUsedTypes :
+		public vcg::UsedTypes<
+			vcg::Use<VoroVertex>::AsVertexType,
+			vcg::Use<VoroEdge>::AsEdgeType,
+			vcg::Use<VoroFace>::AsFaceType>
+{
+};
+
+class VoroVertex :
+		public vcg::Vertex<
+			VoroUsedTypes,
+			vcg::vertex::Coord3f,
+			vcg::vertex::Normal3f,
+			vcg::vertex::TexCoord2f,
+			vcg::vertex::VFAdj,
+			vcg::vertex::Qualityf,
+			vcg::vertex::Mark,
+			vcg::vertex::BitFlags>
+{
+};
+
+class VoroFace :
+		public vcg::Face<
+			VoroUsedTypes,
+			vcg::face::VertexRef,
+			vcg::face::Normal3f,
+			vcg::face::WedgeTexCoord2f,
+			vcg::face::FFAdj,
+			vcg::face::VFAdj,
+			vcg::face::Mark,
+			vcg::face::BitFlags>
+{
+};
+
+class VoroEdge : public vcg::Edge<VoroUsedTypes, vcg::edge::VertexRef, vcg::edge::BitFlags>
+{
+};
+
+class VoroMesh :
+		public vcg::tri::TriMesh<std::vector<VoroVertex>, std::vector<VoroFace>, std::vector<VoroEdge>>
+{
+};
+
+/* indexed triangle soup of the faces still to be parametrized */
+struct Surface
+{
+	std::vector<Point3m>      pos;
+	std::vector<vcg::Point3i> tri;
+};
+
+/* compressed adjacency lists: the elements adjacent to i are
+ * adj[first[i]] ... adj[first[i+1]-1] */
+struct Adjacency
+{
+	std::vector<int> first;
+	std::vector<int> adj;
+};
+
+struct Region
+{
+	std::vector<Point3m>      pos;
+	std::vector<vcg::Point2f> uv;
+	std::vector<vcg::Point3i> tri;
+	vcg::Box2f                box;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+float seconds(Clock::time_point t0)
+{
+	return std::chrono::duration<float>(Clock::now() - t0).count();
+}
+
+/* the vertices of the faces of s listed by index, renumbered */
+Surface subSurface(const Surface& s, const std::vector<int>& faces)
+{
+	Surface          sub;
+	std::vector<int> vIndex(s.pos.size(), -1);
+	sub.tri.resize(faces.size());
+	for (size_t i = 0; i < faces.size(); ++i) {
+		for (int k = 0; k < 3; ++k) {
+			int& vi = vIndex[s.tri[faces[i]][k]];
+			if (vi < 0) {
+				vi = sub.pos.size();
+				sub.pos.push_back(s.pos[s.tri[faces[i]][k]]);
+			}
+			sub.tri[i][k] = vi;
+		}
+	}
+	return sub;
+}
+
+void toVoroMesh(const Surface& s, VoroMesh& vm)
+{
+	vcg::tri::Allocator<VoroMesh>::AddVertices(vm, s.pos.size());
+	vcg::tri::Allocator<VoroMesh>::AddFaces(vm, s.tri.size());
+	for (size_t i = 0; i < s.pos.size(); ++i)
+		vm.vert[i].P() = vcg::Point3f::Construct(s.pos[i]);
+	for (size_t i = 0; i < s.tri.size(); ++i)
+		for (int k = 0; k < 3; ++k)
+			vm.face[i].V(k) = &vm.vert[s.tri[i][k]];
+	vcg::tri::UpdateBounding<VoroMesh>::Box(vm);
+}
+
+/* vertex-vertex (through the face edges) or vertex-face adjacency */
+Adjacency adjacency(const Surface& s, bool vertexFace)
+{
+	Adjacency a;
+	a.first.assign(s.pos.size() + 1, 0);
+	for (const vcg::Point3i& t : s.tri)
+		for (int k = 0; k < 3; ++k)
+			a.first[t[k] + 1] += vertexFace ? 1 : 2;
+	for (size_t i = 0; i < s.pos.size(); ++i)
+		a.first[i + 1] += a.first[i];
+	a.adj.resize(a.first.back());
+	std::vector<int> fill(a.first.begin(), a.first.end() - 1);
+	for (size_t f = 0; f < s.tri.size(); ++f) {
+		const vcg::Point3i& t = s.tri[f];
+		for (int k = 0; k < 3; ++k) {
+			if (vertexFace) {
+				a.adj[fill[t[k]]++] = f;
+			}
+			else {
+				a.adj[fill[t[k]]++] = t[(k + 1) % 3];
+				a.adj[fill[t[k]]++] = t[(k + 2) % 3];
+			}
+		}
+	}
+	return a;
+}
+
+/* vertices of s closest to a Poisson disk sampling of its surface */
+std::vector<int> sampleSeeds(const Surface& s, int sampleNum)
+{
+	VoroMesh vm;
+	toVoroMesh(s, vm);
+	std::vector<vcg::Point3f> samples;
+	float                     radius = 0;
+	vcg::tri::PoissonSampling<VoroMesh>(vm, samples, sampleNum, radius);
+
+	typedef vcg::GridStaticPtr<VoroVertex, float> VertexGrid;
+	VertexGrid grid;
+	grid.Set(vm.vert.begin(), vm.vert.end());
+	std::vector<int> seeds;
+	for (const vcg::Point3f& p : samples) {
+		float       dist = 0;
+		VoroVertex* v =
+			vcg::tri::GetClosestVertex<VoroMesh, VertexGrid>(vm, grid, p, vm.bbox.Diag(), dist);
+		if (v != nullptr)
+			seeds.push_back(vcg::tri::Index(vm, v));
+	}
+	std::sort(seeds.begin(), seeds.end());
+	seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+	if (seeds.empty())
+		seeds.push_back(0);
+	return seeds;
+}
+
+/* Multi-source shortest paths along the edges: region[v] is the seed closest
+ * to v, at distance dist[v]. Vertices of components without seeds start new
+ * regions. Returns the number of regions. */
+int growRegions(
+	const Surface&          s,
+	const Adjacency&        vv,
+	const std::vector<int>& seeds,
+	std::vector<int>&       region,
+	std::vector<Scalarm>&   dist)
+{
+	const int        vn = s.pos.size();
+	std::vector<int> stamp(vn, -1);
+	region.assign(vn, -1);
+	dist.assign(vn, std::numeric_limits<Scalarm>::max());
+
+	std::vector<int> frontier;
+	int              regionNum = 0;
+	for (int v : seeds) {
+		dist[v]   = 0;
+		region[v] = regionNum++;
+		frontier.push_back(v);
+	}
+
+	std::vector<int>                     candidates;
+	std::vector<std::pair<Scalarm, int>> proposal;
+	int                                  nextUnreached = 0;
+	for (int step = 0;; ++step) {
+		if (frontier.empty()) {
+			while (nextUnreached < vn && region[nextUnreached] >= 0)
+				++nextUnreached;
+			if (nextUnreached == vn)
+				break;
+			dist[nextUnreached]   = 0;
+			region[nextUnreached] = regionNum++;
+			frontier.push_back(nextUnreached);
+		}
+
+		// the neighbors of the updated vertices, once
+		candidates.clear();
+		for (int v : frontier) {
+			for (int k = vv.first[v]; k < vv.first[v + 1]; ++k) {
+				const int u = vv.adj[k];
+				if (stamp[u] != step) {
+					stamp[u] = step;
+					candidates.push_back(u);
+				}
+			}
+		}
+
+		// relax the candidates against the distances of the previous step...
+		const int cn = candidates.size();
+		proposal.resize(cn);
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < cn; ++i) {
+			const int c    = candidates[i];
+			Scalarm   best = dist[c];
+			int       r    = region[c];
+			for (int k = vv.first[c]; k < vv.first[c + 1]; ++k) {
+				const int w = vv.adj[k];
+				if (region[w] < 0)
+					continue;
+				Scalarm d = dist[w] + vcg::Distance(s.pos[c], s.pos[w]);
+				if (d < best) {
+					best = d;
+					r    = region[w];
+				}
+			}
+			proposal[i] = std::make_pair(best, r);
+		}
+
+		// ...and apply the improvements
+		frontier.clear();
+#pragma omp parallel
+		{
+			std::vector<int> updated;
+#pragma omp for schedule(static) nowait
+			for (int i = 0; i < cn; ++i) {
+				const int c = candidates[i];
+				if (proposal[i].first < dist[c]) {
+					dist[c]   = proposal[i].first;
+					region[c] = proposal[i].second;
+					updated.push_back(c);
+				}
+			}
+#pragma omp critical
+			frontier.insert(frontier.end(), updated.begin(), updated.end());
+		}
+	}
+	return regionNum;
+}
+
+/* Each face as its own region, laid flat with its edge lengths. */
+void flattenFaces(const Surface& s, const std::vector<int>& faces, std::vector<Region>& regions)
+{
+	for (int f : faces) {
+		Region r;
+		r.tri.push_back(vcg::Point3i(0, 1, 2));
+		for (int k = 0; k < 3; ++k)
+			r.pos.push_back(s.pos[s.tri[f][k]]);
+		const Point3m e1 = r.pos[1] - r.pos[0];
+		const Point3m e2 = r.pos[2] - r.pos[0];
+		const Scalarm l1 = e1.Norm();
+		const Scalarm x  = l1 > 0 ? (e1 * e2) / l1 : 0;
+		r.uv.push_back(vcg::Point2f(0, 0));
+		r.uv.push_back(vcg::Point2f(l1, 0));
+		r.uv.push_back(vcg::Point2f(x, std::sqrt(std::max<Scalarm>(0, e2.SquaredNorm() - x * x))));
+		for (const vcg::Point2f& uv : r.uv)
+			r.box.Add(uv);
+		regions.push_back(std::move(r));
+	}
+}
+
+/* Harmonic parametrization of a region, scaled to the area of its faces.
+ * Returns false if the region is not a disk or if the parametrization folds. */
+bool flatten(const Surface& s, const std::vector<int>& faces, Region& r)
+{
+	Surface sub = subSurface(s, faces);
+	VoroMesh vm;
+	toVoroMesh(sub, vm);
+	vcg::tri::UpdateTopology<VoroMesh>::FaceFace(vm);
+	vcg::tri::UpdateTopology<VoroMesh>::VertexFace(vm);
+	vcg::tri::UpdateFlags<VoroMesh>::FaceBorderFromFF(vm);
+
+	vcg::tri::PoissonSolver<VoroMesh> ps(vm);
+	if (!ps.IsFeasible())
+		return false;
+	ps.Init();
+	ps.FixDefaultVertices();
+	ps.SolvePoisson(false);
+
+	r.pos = std::move(sub.pos);
+	r.tri = std::move(sub.tri);
+	r.uv.resize(vm.vert.size());
+	for (size_t i = 0; i < vm.vert.size(); ++i) {
+		r.uv[i] = vm.vert[i].T().P();
+		if (!std::isfinite(r.uv[i].X()) || !std::isfinite(r.uv[i].Y()))
+			return false;
+	}
+
+	// all the faces must keep the same orientation
+	double area3D = 0, areaUV = 0;
+	int    positive = 0, negative = 0;
+	for (const vcg::Point3i& t : r.tri) {
+		double a = (r.uv[t[1]] - r.uv[t[0]]) ^ (r.uv[t[2]] - r.uv[t[0]]);
+		if (a > 0)
+			++positive;
+		else if (a < 0)
+			++negative;
+		areaUV += std::abs(a) / 2;
+		area3D += ((r.pos[t[1]] - r.pos[t[0]]) ^ (r.pos[t[2]] - r.pos[t[0]])).Norm() / 2;
+	}
+	if (positive > 0 && negative > 0)
+		return false;
+	if (areaUV <= 0)
+		return false;
+
+	const float scale = std::sqrt(area3D / areaUV);
+	for (vcg::Point2f& uv : r.uv) {
+		if (negative > 0)
+			uv.X() = -uv.X();
+		uv *= scale;
+		r.box.Add(uv);
+	}
+	return true;
+}
+
+} // namespace
+
+Stat build(const CMeshO& m, CMeshO& para, const Param& p, vcg::CallBackPos* cb)
+{
+	Stat st;
+
+	// compact copy of the input
+	Surface          all;
+	std::vector<int> vIndex(m.vert.size(), -1);
+	for (size_t i = 0; i < m.vert.size(); ++i) {
+		if (!m.vert[i].IsD()) {
+			vIndex[i] = all.pos.size();
+			all.pos.push_back(m.vert[i].cP());
+		}
+	}
+	for (const CFaceO& f : m.face) {
+		if (!f.IsD())
+			all.tri.push_back(vcg::Point3i(
+				vIndex[vcg::tri::Index(m, f.cV(0))],
+				vIndex[vcg::tri::Index(m, f.cV(1))],
+				vIndex[vcg::tri::Index(m, f.cV(2))]));
+	}
+
+	std::vector<Region> regions;
+	std::vector<int>    remaining(all.tri.size());
+	for (size_t i = 0; i < remaining.size(); ++i)
+		remaining[i] = i;
+	int sampleNum = std::max(1, p.sampleNum);
+
+	while (!remaining.empty()) {
+		st.iterNum++;
+		if (cb)
+			cb(90 * (all.tri.size() - remaining.size()) / all.tri.size(), "Computing Voronoi regions...");
+
+		Clock::time_point t0 = Clock::now();
+		Surface           s  = subSurface(all, remaining);
+		std::vector<int>  seeds = sampleSeeds(s, sampleNum);
+		st.samplingTime += seconds(t0);
+
+		t0 = Clock::now();
+		const Adjacency      vv = adjacency(s, false);
+		std::vector<int>     vertRegion;
+		std::vector<Scalarm> vertDist;
+		const int            regionNum = growRegions(s, vv, seeds, vertRegion, vertDist);
+
+		// each face goes to the region of its vertex closest to a seed
+		std::vector<std::vector<int>> regionFaces(regionNum);
+		for (size_t f = 0; f < s.tri.size(); ++f) {
+			int v = s.tri[f][0];
+			for (int k = 1; k < 3; ++k)
+				if (vertDist[s.tri[f][k]] < vertDist[v])
+					v = s.tri[f][k];
+			regionFaces[vertRegion[v]].push_back(f);
+		}
+		st.voronoiTime += seconds(t0);
+
+		t0 = Clock::now();
+		const Adjacency     vf = adjacency(s, true);
+		std::vector<Region> flattened(regionNum);
+		std::vector<char>   ok(regionNum, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int r = 0; r < regionNum; ++r) {
+			if (regionFaces[r].empty())
+				continue;
+			std::vector<int> faces = regionFaces[r];
+			if (p.overlap) {
+				// add the faces sharing a vertex with the region
+				for (int f : regionFaces[r])
+					for (int k = 0; k < 3; ++k)
+						for (int j = vf.first[s.tri[f][k]]; j < vf.first[s.tri[f][k] + 1]; ++j)
+							faces.push_back(vf.adj[j]);
+				std::sort(faces.begin(), faces.end());
+				faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+			}
+			ok[r] = flatten(s, faces, flattened[r]);
+		}
+		st.unwrapTime += seconds(t0);
+
+		// once the seeds outnumber the faces, the regions cannot shrink anymore
+		// and the faces of the rejected ones (degenerate or folded) are laid
+		// out one by one
+		const bool       lastIteration = sampleNum > (int) s.tri.size();
+		std::vector<int> next;
+		for (int r = 0; r < regionNum; ++r) {
+			if (ok[r]) {
+				regions.push_back(std::move(flattened[r]));
+			}
+			else if (lastIteration) {
+				flattenFaces(s, regionFaces[r], regions);
+			}
+			else {
+				for (int f : regionFaces[r])
+					next.push_back(remaining[f]);
+			}
+		}
+		// smaller regions are more likely to be disks
+		if (next.size() == remaining.size())
+			sampleNum *= 2;
+		remaining.swap(next);
+	}
+	st.regionNum = regions.size();
+
+	// pack the uv boxes, scaled so that the packing area is about 1024x1024
+	if (cb)
+		cb(90, "Packing regions...");
+	Clock::time_point t0        = Clock::now();
+	const int         regionNum = regions.size();
+	double            boxArea   = 0;
+	for (const Region& r : regions)
+		boxArea += r.box.Area();
+	const float             scale = boxArea > 0 ? 1024 / std::sqrt(boxArea) : 1;
+	std::vector<vcg::Box2f> boxes(regionNum);
+	float                   totalArea = 0;
+	for (int r = 0; r < regionNum; ++r) {
+		boxes[r] = vcg::Box2f(regions[r].box.min * scale, regions[r].box.max * scale);
+		boxes[r].Offset(vcg::Point2f(1, 1));
+		totalArea += boxes[r].Area();
+	}
+	std::vector<vcg::Similarity2f> packingTr;
+	vcg::Point2f                   covered(0, 0);
+	const int                      edgeLen = std::sqrt(totalArea);
+	vcg::RectPacker<float>::Pack(boxes, vcg::Point2i(edgeLen, edgeLen), packingTr, covered);
+	const float normalize = 1.0f / std::max(covered.X(), covered.Y());
+
+	// write the regions, each one on its own range of vertices and faces
+	std::vector<size_t> firstVert(regionNum + 1, 0), firstFace(regionNum + 1, 0);
+	for (int r = 0; r < regionNum; ++r) {
+		firstVert[r + 1] = firstVert[r] + regions[r].pos.size();
+		firstFace[r + 1] = firstFace[r] + regions[r].tri.size();
+	}
+	vcg::tri::Allocator<CMeshO>::AddVertices(para, firstVert[regionNum]);
+	vcg::tri::Allocator<CMeshO>::AddFaces(para, firstFace[regionNum]);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int r = 0; r < regionNum; ++r) {
+		const Region&            reg = regions[r];
+		const vcg::Similarity2f& tr  = packingTr[r];
+		const float              c   = std::cos(tr.rotRad);
+		const float              sn  = std::sin(tr.rotRad);
+		std::vector<vcg::Point2f> uv(reg.uv.size());
+		for (size_t i = 0; i < reg.uv.size(); ++i) {
+			const vcg::Point2f q = reg.uv[i] * scale;
+			uv[i].X() = ((c * q.X() - sn * q.Y()) * tr.sca + tr.tra.X()) * normalize;
+			uv[i].Y() = ((sn * q.X() + c * q.Y()) * tr.sca + tr.tra.Y()) * normalize;
+			para.vert[firstVert[r] + i].P() = reg.pos[i];
+		}
+		for (size_t i = 0; i < reg.tri.size(); ++i) {
+			CFaceO& f = para.face[firstFace[r] + i];
+			for (int k = 0; k < 3; ++k) {
+				f.V(k)      = &para.vert[firstVert[r] + reg.tri[i][k]];
+				f.WT(k).U() = uv[reg.tri[i][k]].X();
+				f.WT(k).V() = uv[reg.tri[i][k]].Y();
+				f.WT(k).N() = 0;
+			}
+		}
+	}
+	st.packingTime = seconds(t0);
+	return st;
+}
+
+} // namespace voronoiatlas
@@ -0,0 +1,70 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef PARALLEL_VORONOI_ATLAS_H
+#define PARALLEL_VORONOI_ATLAS_H
+
+#include <common/ml_document/mesh_model.h>
+
+/**
+ * Atlas parametrization built on a geodesic Voronoi partition of the
+ * surface, with the same scheme of vcg::tri::VoronoiAtlas, computed in
+ * parallel:
+ * - the regions are grown from all the seeds at once: at each step the
+ *   distances of the neighbors of the vertices updated in the previous step
+ *   are relaxed concurrently, until no distance changes;
+ * - each region is extracted and flattened with a harmonic (Poisson)
+ *   parametrization concurrently with the others;
+ * - the uv boxes of the regions are packed together, and the packed regions
+ *   are written to the output mesh in parallel.
+ * Regions that are not disks, or whose flattening folds, are partitioned
+ * again, with the other rejected faces, in the next iteration.
+ */
+namespace voronoiatlas {
+
+struct Param
+{
+	int  sampleNum = 10;    // wanted number of regions
+	bool overlap   = false; // each region includes the ring of faces around it
+};
+
+struct Stat
+{
+	int   iterNum      = 0;
+	int   regionNum    = 0;
+	float samplingTime = 0; // seconds
+	float voronoiTime  = 0;
+	float unwrapTime   = 0;
+	float packingTime  = 0;
+};
+
+/**
+ * Fills the empty mesh para with the regions of m, each one with its own
+ * vertices and with the atlas coordinates as wedge texture coordinates
+ * (para must have them enabled). m must be two manifold.
+ */
+Stat build(const CMeshO& m, CMeshO& para, const Param& p, vcg::CallBackPos* cb);
+
+} // namespace voronoiatlas
+
+#endif // PARALLEL_VORONOI_ATLAS_H
@@ -49,27 +49,48 @@ namespace vcg
 
     }
 
+    // rows of an ARGB32 image; bits() is called before the parallel loops so
+    // that the image is already detached when the threads write it
+    inline QRgb * PullPushRow(uchar * bits, int bytesPerLine, int y)
+    {
+        return reinterpret_cast<QRgb *>(bits + y*bytesPerLine);
+    }
+
+    inline const QRgb * PullPushRow(const uchar * bits, int bytesPerLine, int y)
+    {
+        return reinterpret_cast<const QRgb *>(bits + y*bytesPerLine);
+    }
+
     // Genera una mipmap pesata
     void PullPushMip( QImage & p, QImage & mip, QRgb  bkcolor )
     {
         assert(p.width()/2==mip.width());
         assert(p.height()/2==mip.height());
-        Byte w1,w2,w3,w4;
-        int x,y;
-        for(y=0;y<mip.height();++y)
-            for(x=0;x<mip.width();++x)
+        assert(p.depth()==32 && mip.depth()==32);
+        const uchar *pBits = p.constBits();
+        uchar *mipBits = mip.bits();
+        const int pLine = p.bytesPerLine(), mipLine = mip.bytesPerLine();
+        const int mipW = mip.width(), mipH = mip.height();
+#pragma omp parallel for schedule(static)
+        for(int y=0;y<mipH;++y)
+        {
+            const QRgb *r0 = PullPushRow(pBits, pLine, y*2  );
+            const QRgb *r1 = PullPushRow(pBits, pLine, y*2+1);
+            QRgb *m = PullPushRow(mipBits, mipLine, y);
+            for(int x=0;x<mipW;++x)
             {
-                if(p.pixel(x*2  ,y*2  )==bkcolor) w1=0; else w1=255;
-                if(p.pixel(x*2+1,y*2  )==bkcolor) w2=0; else w2=255;
-                if(p.pixel(x*2  ,y*2+1)==bkcolor) w3=0; else w3=255;
-                if(p.pixel(x*2+1,y*2+1)==bkcolor) w4=0; else w4=255;
+                Byte w1,w2,w3,w4;
+                if(r0[x*2  ]==bkcolor) w1=0; else w1=255;
+                if(r0[x*2+1]==bkcolor) w2=0; else w2=255;
+                if(r1[x*2  ]==bkcolor) w3=0; else w3=255;
+                if(r1[x*2+1]==bkcolor) w4=0; else w4=255;
                 if(w1+w2+w3+w4>0        )
-                    mip.setPixel(x, y, mean4Pixelw(
-                                                   p.pixel(x*2  ,y*2  ),w1,
-                                                   p.pixel(x*2+1,y*2  ),w2,
-                                                   p.pixel(x*2  ,y*2+1),w3,
-                                                   p.pixel(x*2+1,y*2+1),w4 ));
+                    m[x] = mean4Pixelw(r0[x*2  ],w1,
+                                       r0[x*2+1],w2,
+                                       r1[x*2  ],w3,
+                                       r1[x*2+1],w4 );
             }
+        }
     }
 
     // interpola a partire da una mipmap
@@ -77,33 +98,45 @@ namespace vcg
     {
         assert(p.width()/2==mip.width());
         assert(p.height()/2==mip.height());
-        //      byte w1,w2,w3,w4;
-        int x,y;
-        for(y=0;y<mip.height();++y)
-            for(x=0;x<mip.width();++x)
+        assert(p.depth()==32 && mip.depth()==32);
+        uchar *pBits = p.bits();
+        const uchar *mipBits = mip.constBits();
+        const int pLine = p.bytesPerLine(), mipLine = mip.bytesPerLine();
+        const int mipW = mip.width(), mipH = mip.height();
+        // each mip row fills two rows of p, that no other row reads
+#pragma omp parallel for schedule(static)
+        for(int y=0;y<mipH;++y)
+        {
+            const QRgb *m  = PullPushRow(mipBits, mipLine, y);
+            const QRgb *mu = y>0      ? PullPushRow(mipBits, mipLine, y-1) : 0;
+            const QRgb *md = y<mipH-1 ? PullPushRow(mipBits, mipLine, y+1) : 0;
+            QRgb *r0 = PullPushRow(pBits, pLine, y*2  );
+            QRgb *r1 = PullPushRow(pBits, pLine, y*2+1);
+            for(int x=0;x<mipW;++x)
             {
-                if(p.pixel(x*2 ,y*2)==bkg)
-                    p.setPixel(x*2 ,y*2 ,mean4Pixelw( mip.pixel(x  ,y  ) ,  Byte(144),
-                                                     (x>0 ? mip.pixel(x-1,y  ) : bkg),  (x>0 ? Byte( 48) : 0),
-                                                     (y>0 ? mip.pixel(x  ,y-1) : bkg),  (y>0 ? Byte( 48) : 0),
-                                                     ((x>0 && y>0 )? mip.pixel(x-1,y-1) : bkg), ((x>0 && y>0 )? Byte( 16) : 0)));
-                if(p.pixel(x*2+1,y*2  )==bkg)
-                    p.setPixel(x*2+1,y*2  ,mean4Pixelw(mip.pixel(x  ,y  ) ,Byte(144),
-                                                       (x<mip.width()-1 ? mip.pixel(x+1,y) : bkg),  (x<mip.width()-1 ? Byte( 48) : 0),
-                                                       (y>0  ? mip.pixel(x  ,y-1) : bkg),  (y>0  ? Byte( 48) : 0),
-                                                       ((x<mip.width()-1 && y>0) ? mip.pixel(x+1,y-1) : bkg), ((x<mip.width()-1 && y>0) ? Byte( 16) : 0)));
-                if(p.pixel(x*2  ,y*2+1)==bkg)
-                    p.setPixel(x*2  ,y*2+1, mean4Pixelw( mip.pixel(x  ,y  ), Byte(144),
-                                                        (x>0 ? mip.pixel(x-1,y  ) : bkg),  (x>0 ? Byte( 48) : 0),
-                                                        (y<mip.height()-1  ? mip.pixel(x  ,y+1) : bkg),  (y<mip.height()-1  ? Byte( 48) : 0),
-                                                        ((x>0 && y<mip.height()-1) ? mip.pixel(x-1,y+1) : bkg), ((x>0 && y<mip.height()-1 )? Byte( 16) : 0)));
-                if(p.pixel(x*2+1,y*2+1)==bkg)
-                    p.setPixel(x*2+1,y*2+1, mean4Pixelw(mip.pixel(x  ,y  ), Byte(144),
-                                                        (x<mip.width()-1 ? mip.pixel(x+1,y  ) : bkg), (x<mip.width()-1 ? Byte( 48) : 0),
-                                                        (y<mip.height()-1  ? mip.pixel(x  ,y+1) : bkg), ( y<mip.height()-1  ? Byte( 48) : 0),
-                                                        ((x<mip.width()-1  && y<mip.height()-1) ? mip.pixel(x+1,y+1) : bkg), ((x<mip.width()-1  && y<mip.height()-1) ? Byte( 16) : 0)));
-
+                const bool l = x>0, r = x<mipW-1;
+                if(r0[x*2  ]==bkg)
+                    r0[x*2  ] = mean4Pixelw(m[x], Byte(144),
+                                            (l ? m[x-1] : bkg),  (l ? Byte( 48) : 0),
+                                            (mu ? mu[x] : bkg),  (mu ? Byte( 48) : 0),
+                                            ((l && mu) ? mu[x-1] : bkg), ((l && mu) ? Byte( 16) : 0));
+                if(r0[x*2+1]==bkg)
+                    r0[x*2+1] = mean4Pixelw(m[x], Byte(144),
+                                            (r ? m[x+1] : bkg),  (r ? Byte( 48) : 0),
+                                            (mu ? mu[x] : bkg),  (mu ? Byte( 48) : 0),
+                                            ((r && mu) ? mu[x+1] : bkg), ((r && mu) ? Byte( 16) : 0));
+                if(r1[x*2  ]==bkg)
+                    r1[x*2  ] = mean4Pixelw(m[x], Byte(144),
+                                            (l ? m[x-1] : bkg),  (l ? Byte( 48) : 0),
+                                            (md ? md[x] : bkg),  (md ? Byte( 48) : 0),
+                                            ((l && md) ? md[x-1] : bkg), ((l && md) ? Byte( 16) : 0));
+                if(r1[x*2+1]==bkg)
+                    r1[x*2+1] = mean4Pixelw(m[x], Byte(144),
+                                            (r ? m[x+1] : bkg),  (r ? Byte( 48) : 0),
+                                            (md ? md[x] : bkg),  (md ? Byte( 48) : 0),
+                                            ((r && md) ? md[x+1] : bkg), ((r && md) ? Byte( 16) : 0));
             }
+        }
     }
 
 
@@ -0,0 +1,389 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "texture_baker.h"
+
+#include <common/mlexception.h>
+#include <vcg/complex/algorithms/closest.h>
+#include <vcg/complex/algorithms/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int TILE_SIZE  = 64;  // side of the tiles, in texels
+const int TILE_CHUNK = 256; // tiles baked between two progress updates
+const int VERT_CHUNK = 65536;
+
+typedef vcg::Point2<double> Point2d;
+
+double segmentDistance(const Point2d& p, const Point2d& a, const Point2d& b)
+{
+	Point2d ab = b - a;
+	double  l  = ab.SquaredNorm();
+	double  t  = l > 0 ? std::min(1.0, std::max(0.0, ((p - a) * ab) / l)) : 0.0;
+	return (a + ab * t - p).Norm();
+}
+
+} // namespace
+
+TextureBaker::TextureBaker(
+	CMeshO&                    src,
+	Channel                    channel,
+	Scalarm                    maxDist,
+	const std::vector<QImage>& srcImgs,
+	const std::string&         attributeName) :
+		src(src), channel(channel), maxDist(maxDist), srcImgs(srcImgs), minValue(0), maxValue(1)
+{
+	if (channel == TEXTURE_COLOR && src.fn == 0)
+		throw MLException("Source mesh needs to have faces");
+
+	if (channel == VERTEX_QUALITY) {
+		std::pair<Scalarm, Scalarm> minmax = vcg::tri::Stat<CMeshO>::ComputePerVertexQualityMinMax(src);
+		minValue = minmax.first;
+		maxValue = minmax.second;
+	}
+	else if (channel == VERTEX_SCALAR) {
+		scalar = vcg::tri::Allocator<CMeshO>::FindPerVertexAttribute<Scalarm>(src, attributeName);
+		if (!vcg::tri::Allocator<CMeshO>::IsValidHandle(src, scalar))
+			throw MLException(
+				"Source mesh doesn't have a Per-Vertex scalar attribute named \"" +
+				QString::fromStdString(attributeName) + "\"");
+		minValue = std::numeric_limits<Scalarm>::max();
+		maxValue = std::numeric_limits<Scalarm>::lowest();
+		for (CVertexO& v : src.vert) {
+			if (!v.IsD()) {
+				minValue = std::min(minValue, scalar[v]);
+				maxValue = std::max(maxValue, scalar[v]);
+			}
+		}
+	}
+
+	if (src.fn > 0) {
+		bvh.reset(new meshlab::MeshBVH(src));
+	}
+	else {
+		vertGrid.reset(new VertexGrid());
+		vertGrid->Set(src.vert.begin(), src.vert.end());
+	}
+}
+
+TextureBaker::~TextureBaker()
+{
+}
+
+void TextureBaker::bake(
+	const CMeshO&        trg,
+	std::vector<QImage>& trgImgs,
+	vcg::CallBackPos*    cb,
+	int                  start,
+	int                  offset)
+{
+	const int texNum = trgImgs.size();
+
+	// tiles of all the textures, in row major order inside each texture
+	std::vector<int>    firstTile(texNum + 1, 0);
+	std::vector<int>    tilesX(texNum);
+	std::vector<uchar*> bits(texNum);
+	for (int t = 0; t < texNum; ++t) {
+		if (trgImgs[t].format() != QImage::Format_ARGB32)
+			trgImgs[t] = trgImgs[t].convertToFormat(QImage::Format_ARGB32);
+		// detach here: the threads write the pixels through the raw pointer
+		bits[t]          = trgImgs[t].bits();
+		tilesX[t]        = (trgImgs[t].width() + TILE_SIZE - 1) / TILE_SIZE;
+		int tilesY       = (trgImgs[t].height() + TILE_SIZE - 1) / TILE_SIZE;
+		firstTile[t + 1] = firstTile[t] + tilesX[t] * tilesY;
+	}
+	const int tileNum = firstTile[texNum];
+
+	// faces overlapping each tile, in face order, so that overlaps are
+	// resolved as in a serial rasterization
+	std::vector<std::vector<const CFaceO*>> bins(tileNum);
+	for (const CFaceO& f : trg.face) {
+		if (f.IsD())
+			continue;
+		const int t = f.cWT(0).N();
+		if (t < 0 || t >= texNum)
+			continue;
+		const int w = trgImgs[t].width(), h = trgImgs[t].height();
+		double    minX = w, minY = h, maxX = -1, maxY = -1;
+		for (int i = 0; i < 3; ++i) {
+			minX = std::min(minX, f.cWT(i).U() * w - 0.5);
+			maxX = std::max(maxX, f.cWT(i).U() * w - 0.5);
+			minY = std::min(minY, f.cWT(i).V() * h - 0.5);
+			maxY = std::max(maxY, f.cWT(i).V() * h - 0.5);
+		}
+		// texels near a border edge are rasterized too
+		const int x0 = std::max(0, int(std::floor(minX - 1)));
+		const int y0 = std::max(0, int(std::floor(minY - 1)));
+		const int x1 = std::min(w - 1, int(std::ceil(maxX + 1)));
+		const int y1 = std::min(h - 1, int(std::ceil(maxY + 1)));
+		for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE && x0 <= x1; ++ty)
+			for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx)
+				bins[firstTile[t] + ty * tilesX[t] + tx].push_back(&f);
+	}
+
+	for (int c = 0; c < tileNum; c += TILE_CHUNK) {
+		if (cb)
+			cb(start + offset * c / tileNum, "Baking texture tiles...");
+		const int end = std::min(tileNum, c + TILE_CHUNK);
+#pragma omp parallel
+		{
+			std::vector<Texel> texels(TILE_SIZE * TILE_SIZE);
+#pragma omp for schedule(dynamic, 1)
+			for (int i = c; i < end; ++i) {
+				if (bins[i].empty())
+					continue;
+				const int t  = std::upper_bound(firstTile.begin(), firstTile.end(), i) - firstTile.begin() - 1;
+				const int w  = trgImgs[t].width(), h = trgImgs[t].height();
+				const int x0 = (i - firstTile[t]) % tilesX[t] * TILE_SIZE;
+				const int y0 = (i - firstTile[t]) / tilesX[t] * TILE_SIZE;
+				const int x1 = std::min(w, x0 + TILE_SIZE);
+				const int y1 = std::min(h, y0 + TILE_SIZE);
+
+				for (Texel& tx : texels) {
+					tx.f     = nullptr;
+					tx.alpha = 0;
+				}
+				for (const CFaceO* f : bins[i])
+					rasterize(*f, w, h, x0, y0, x1, y1, texels);
+
+				// closest point queries for the texels of the tile
+				const int bytesPerLine = trgImgs[t].bytesPerLine();
+				for (int y = y0; y < y1; ++y) {
+					// texture v goes up, image rows go down
+					QRgb* row = reinterpret_cast<QRgb*>(bits[t] + (h - 1 - y) * bytesPerLine);
+					for (int x = x0; x < x1; ++x) {
+						const Texel& tx = texels[(y - y0) * TILE_SIZE + (x - x0)];
+						if (tx.f == nullptr)
+							continue;
+						const CFaceO& f = *tx.f;
+						Point3m p = f.cP(0) * tx.bary[0] + f.cP(1) * tx.bary[1] + f.cP(2) * tx.bary[2];
+						SourcePoint sp;
+						if (!closest(p, sp))
+							continue;
+
+						Point3m frame[3];
+						if (channel == TANGENT_NORMAL) {
+							// tangent frame of the target at the texel
+							Point3m n = f.cV(0)->cN() * tx.bary[0] + f.cV(1)->cN() * tx.bary[1] +
+										f.cV(2)->cN() * tx.bary[2];
+							if (n.Norm() == 0)
+								n = vcg::TriangleNormal(f);
+							n.Normalize();
+							// tu and tv: directions of increasing u and v on the face
+							const Point3m e1  = f.cP(1) - f.cP(0);
+							const Point3m e2  = f.cP(2) - f.cP(0);
+							const Scalarm du1 = f.cWT(1).U() - f.cWT(0).U();
+							const Scalarm dv1 = f.cWT(1).V() - f.cWT(0).V();
+							const Scalarm du2 = f.cWT(2).U() - f.cWT(0).U();
+							const Scalarm dv2 = f.cWT(2).V() - f.cWT(0).V();
+							const Scalarm sign = (du1 * dv2 - du2 * dv1) < 0 ? -1 : 1;
+							Point3m tu = (e1 * dv2 - e2 * dv1) * sign;
+							Point3m tv = (e2 * du1 - e1 * du2) * sign;
+							tu = (tu - n * (n * tu)).Normalize();
+							// orthonormal frame, keeping the handedness of the parametrization
+							Point3m b = n ^ tu;
+							frame[0]  = tu;
+							frame[1]  = (b * tv < 0) ? -b : b;
+							frame[2]  = n;
+						}
+						QRgb c = evaluate(sp, frame);
+						row[x] = qRgba(qRed(c), qGreen(c), qBlue(c), tx.alpha);
+					}
+				}
+			}
+		}
+	}
+	if (cb)
+		cb(start + offset, "Baking texture tiles...");
+}
+
+void TextureBaker::bakeVertexColors(CMeshO& trg, vcg::CallBackPos* cb, int start, int offset)
+{
+	const int vn = trg.vert.size();
+	for (int c = 0; c < vn; c += VERT_CHUNK) {
+		if (cb)
+			cb(start + offset * c / vn, "Sampling vertices...");
+		const int end = std::min(vn, c + VERT_CHUNK);
+#pragma omp parallel for schedule(dynamic, 256)
+		for (int i = c; i < end; ++i) {
+			CVertexO&   v = trg.vert[i];
+			SourcePoint sp;
+			if (v.IsD() || !closest(v.cP(), sp))
+				continue;
+			QRgb px = evaluate(sp, nullptr);
+			v.C()   = vcg::Color4b(qRed(px), qGreen(px), qBlue(px), 255);
+		}
+	}
+}
+
+/* closest point of the source within maxDist; safe to call concurrently */
+bool TextureBaker::closest(const Point3m& p, SourcePoint& sp)
+{
+	if (bvh) {
+		meshlab::MeshBVH::ClosestPoint cp;
+		if (!bvh->closestPoint(p, maxDist, cp))
+			return false;
+		sp.f    = &src.face[cp.face];
+		sp.v    = nullptr;
+		sp.bary = Point3m(1 - cp.u - cp.v, cp.u, cp.v);
+		return true;
+	}
+	vcg::vertex::PointDistanceFunctor<Scalarm> distFunct;
+	NoMarker                                   marker;
+	Scalarm                                    dist = maxDist;
+	Point3m                                    closestPt;
+	sp.f = nullptr;
+	sp.v = vcg::GridClosest(*vertGrid, distFunct, marker, p, maxDist, dist, closestPt);
+	return sp.v != nullptr && dist < maxDist;
+}
+
+/* value of the channel at a source point, encoded as a color; tangentFrame
+ * is the (tu, tv, n) frame of the target, used only by TANGENT_NORMAL */
+QRgb TextureBaker::evaluate(const SourcePoint& sp, const Point3m* tangentFrame)
+{
+	auto interpolate = [&](auto attribute) {
+		if (sp.f == nullptr)
+			return attribute(sp.v);
+		return attribute(sp.f->cV(0)) * sp.bary[0] + attribute(sp.f->cV(1)) * sp.bary[1] +
+			   attribute(sp.f->cV(2)) * sp.bary[2];
+	};
+	auto encodeNormal = [](Point3m n) {
+		n.Normalize();
+		n = ((n + Point3m(1, 1, 1)) / 2) * 255;
+		return qRgb(int(n[0]), int(n[1]), int(n[2]));
+	};
+	auto gray = [&](Scalarm value) {
+		Scalarm range = maxValue - minValue;
+		int     g     = range > 0 ? int(255 * (value - minValue) / range) : 0;
+		return qRgb(g, g, g);
+	};
+
+	switch (channel) {
+	case VERTEX_COLOR: {
+		vcg::Color4b c;
+		if (sp.f == nullptr)
+			c = sp.v->cC();
+		else
+			c.lerp(sp.f->cV(0)->cC(), sp.f->cV(1)->cC(), sp.f->cV(2)->cC(), sp.bary);
+		return qRgb(c[0], c[1], c[2]);
+	}
+	case VERTEX_NORMAL:
+		return encodeNormal(interpolate([](const CVertexO* v) { return v->cN(); }));
+	case TANGENT_NORMAL: {
+		Point3m n = interpolate([](const CVertexO* v) { return v->cN(); });
+		return encodeNormal(Point3m(n * tangentFrame[0], n * tangentFrame[1], n * tangentFrame[2]));
+	}
+	case VERTEX_QUALITY:
+		return gray(interpolate([](const CVertexO* v) { return v->cQ(); }));
+	case VERTEX_SCALAR:
+		return gray(interpolate([&](const CVertexO* v) { return scalar[v]; }));
+	case TEXTURE_COLOR: {
+		const int t = sp.f->cWT(0).N();
+		if (t < 0 || t >= (int) srcImgs.size())
+			return qRgb(255, 255, 255);
+		Scalarm u = 0, v = 0;
+		for (int i = 0; i < 3; ++i) {
+			u += sp.f->cWT(i).U() * sp.bary[i];
+			v += sp.f->cWT(i).V() * sp.bary[i];
+		}
+		return texel(srcImgs[t], u, v);
+	}
+	}
+	return qRgb(0, 0, 0);
+}
+
+/* Writes in texels (the texels of the tile [x0,x1)x[y0,y1)) the texels
+ * covered by f, and those within one texel from its texture border edges.
+ * Texel centers are at integer coordinates, as in SurfaceSampling::Texture;
+ * a texel is replaced if covered, or if the new alpha is higher. */
+void TextureBaker::rasterize(
+	const CFaceO&       f,
+	int                 w,
+	int                 h,
+	int                 x0,
+	int                 y0,
+	int                 x1,
+	int                 y1,
+	std::vector<Texel>& texels) const
+{
+	Point2d ti[3];
+	for (int i = 0; i < 3; ++i)
+		ti[i] = Point2d(f.cWT(i).U() * w - 0.5, f.cWT(i).V() * h - 0.5);
+	const double area = (ti[1] - ti[0]) ^ (ti[2] - ti[0]);
+	if (std::abs(area) < 1e-12)
+		return;
+
+	const bool   border = f.IsB(0) || f.IsB(1) || f.IsB(2);
+	const double margin = border ? 1 : 0;
+	const int minX = std::max(x0, int(std::ceil(std::min({ti[0].X(), ti[1].X(), ti[2].X()}) - margin)));
+	const int maxX = std::min(x1 - 1, int(std::floor(std::max({ti[0].X(), ti[1].X(), ti[2].X()}) + margin)));
+	const int minY = std::max(y0, int(std::ceil(std::min({ti[0].Y(), ti[1].Y(), ti[2].Y()}) - margin)));
+	const int maxY = std::min(y1 - 1, int(std::floor(std::max({ti[0].Y(), ti[1].Y(), ti[2].Y()}) + margin)));
+
+	for (int y = minY; y <= maxY; ++y) {
+		for (int x = minX; x <= maxX; ++x) {
+			const Point2d p(x, y);
+			const double  b0 = ((ti[1] - p) ^ (ti[2] - p)) / area;
+			const double  b1 = ((ti[2] - p) ^ (ti[0] - p)) / area;
+			const double  b2 = 1 - b0 - b1;
+			int           alpha;
+			if (b0 >= 0 && b1 >= 0 && b2 >= 0) {
+				alpha = 255;
+			}
+			else {
+				if (!border)
+					continue;
+				double edgeDist = 2;
+				for (int i = 0; i < 3; ++i)
+					if (f.IsB(i))
+						edgeDist = std::min(edgeDist, segmentDistance(p, ti[i], ti[(i + 1) % 3]));
+				if (edgeDist > 1)
+					continue;
+				alpha = int(254 - edgeDist * 128);
+			}
+			Texel& tx = texels[(y - y0) * TILE_SIZE + (x - x0)];
+			if (alpha == 255 || tx.alpha < alpha) {
+				tx.f     = &f;
+				tx.bary  = Point3m(b0, b1, b2);
+				tx.alpha = alpha;
+			}
+		}
+	}
+}
+
+/* nearest texel, with repeat wrapping */
+QRgb TextureBaker::texel(const QImage& img, Scalarm u, Scalarm v)
+{
+	const int w = img.width(), h = img.height();
+	if (w == 0 || h == 0)
+		return qRgb(255, 255, 255);
+	int x = w * u;
+	int y = h * (1.0 - v);
+	x     = (x % w + w) % w;
+	y     = (y % h + h) % h;
+	return img.pixel(x, y);
+}
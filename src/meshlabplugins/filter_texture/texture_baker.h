@@ -0,0 +1,131 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+#include <common/ml_document/mesh_model.h>
+#include <common/utilities/mesh_bvh.h>
+#include <vcg/space/index/grid_static_ptr.h>
+
+#include <QImage>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Transfers the data of a source mesh to the textures, or to the vertex
+ * colors, of a target mesh, sampling the source at the closest point of
+ * each texel (or vertex) of the target.
+ *
+ * The texels of the target textures are rasterized in square tiles: the
+ * faces are binned on the tiles overlapped by their uv bounding box, and
+ * the tiles are baked in parallel, each one writing only its own texels.
+ * Once the face covering each texel of a tile is resolved, the closest
+ * points of the whole tile are queried as a batch against a MeshBVH of the
+ * source, shared read-only by all the threads (a grid of the vertices if
+ * the source is a point cloud).
+ */
+class TextureBaker
+{
+public:
+	enum Channel {
+		VERTEX_COLOR,
+		VERTEX_NORMAL,  // object space normal
+		VERTEX_QUALITY, // normalized to the quality range of the source
+		TEXTURE_COLOR,  // color of the source textures
+		TANGENT_NORMAL, // source normal, in the tangent space of the target
+		VERTEX_SCALAR   // per vertex Scalarm attribute, normalized to its range
+	};
+
+	/**
+	 * The source must not change while the baker is used. Throws an
+	 * MLException if the source lacks the data of the channel.
+	 * srcImgs are the source textures, needed only by TEXTURE_COLOR;
+	 * attributeName is the per vertex attribute sampled by VERTEX_SCALAR.
+	 */
+	TextureBaker(
+		CMeshO&                    src,
+		Channel                    channel,
+		Scalarm                    maxDist,
+		const std::vector<QImage>& srcImgs       = std::vector<QImage>(),
+		const std::string&         attributeName = std::string());
+	~TextureBaker();
+
+	/**
+	 * Fills trgImgs, indexed by the wedge texture index of the faces of trg.
+	 * Texels covered by a face get alpha 255; texels outside a face, within
+	 * one texel from a texture border edge (IsB, as set by
+	 * FaceFaceFromTexCoord), get an alpha in (0, 255) decreasing with their
+	 * distance. Texels without a source point within maxDist are left as they
+	 * are.
+	 */
+	void bake(const CMeshO& trg, std::vector<QImage>& trgImgs, vcg::CallBackPos* cb, int start = 0, int offset = 100);
+
+	/** sets the color of each vertex of trg to the channel value at its closest source point */
+	void bakeVertexColors(CMeshO& trg, vcg::CallBackPos* cb, int start = 0, int offset = 100);
+
+private:
+	struct SourcePoint
+	{
+		const CFaceO*   f;    // closest face, or null for a point cloud
+		const CVertexO* v;    // closest vertex of a point cloud
+		Point3m         bary; // barycentric coordinates of the point in f
+	};
+
+	struct Texel
+	{
+		const CFaceO* f;
+		Point3m       bary;
+		int           alpha;
+	};
+
+	/* the grid queries are issued concurrently: the vertex marks cannot be
+	 * used to skip the vertices already visited */
+	struct NoMarker
+	{
+		template<class T> bool IsMarked(T) const { return false; }
+		template<class T> void Mark(T) {}
+		void UnMarkAll() {}
+	};
+
+	typedef vcg::GridStaticPtr<CVertexO, Scalarm> VertexGrid;
+
+	bool closest(const Point3m& p, SourcePoint& sp);
+	QRgb evaluate(const SourcePoint& sp, const Point3m* tangentFrame);
+	void rasterize(const CFaceO& f, int w, int h, int x0, int y0, int x1, int y1, std::vector<Texel>& texels) const;
+
+	static QRgb texel(const QImage& img, Scalarm u, Scalarm v);
+
+	CMeshO&                           src;
+	Channel                           channel;
+	Scalarm                           maxDist;
+	std::vector<QImage>               srcImgs;
+	std::unique_ptr<meshlab::MeshBVH> bvh;
+	std::unique_ptr<VertexGrid>       vertGrid;
+	CMeshO::PerVertexAttributeHandle<Scalarm> scalar;
+	Scalarm                           minValue, maxValue;
+};
+
+#endif // TEXTURE_BAKER_H
@@ -158,12 +158,15 @@ void ARAP::ComputeSystemMatrix(Mesh& m, const std::vector<Cot>& cotan, Eigen::Sp
     L.makeCompressed();
 }
 
+/* Local step of the solver: the rotations of the faces are independent, and
+ * are fitted concurrently */
 static std::vector<Eigen::Matrix2d> ComputeRotations(Mesh& m)
 {
     auto tsa = GetTargetShapeAttribute(m);
-    std::vector<Eigen::Matrix2d> rotations;
-    rotations.reserve(m.FN());
-    for (auto& f : m.face) {
+    std::vector<Eigen::Matrix2d> rotations(m.face.size());
+#pragma omp parallel for schedule(static)
+    for (int fi = 0; fi < (int) m.face.size(); ++fi) {
+        Mesh::FaceType& f = m.face[fi];
         vcg::Point2d x10, x20;
         LocalIsometry(tsa[f].P[1] - tsa[f].P[0], tsa[f].P[2] - tsa[f].P[0], x10, x20);
         Eigen::Matrix2d Jf = ComputeTransformationMatrix(x10, x20, f.WT(1).P() - f.WT(0).P(), f.WT(2).P() - f.WT(0).P());
@@ -178,7 +181,7 @@ static std::vector<Eigen::Matrix2d> ComputeRotations(Mesh& m)
             R = U * V.transpose();
         }
 
-        rotations.push_back(R);
+        rotations[fi] = R;
     }
 
     return rotations;
@@ -190,8 +193,13 @@ void ARAP::ComputeRHS(Mesh& m, const std::vector<Eigen::Matrix2d>& rotations, co
     bu = Eigen::VectorXd::Constant(m.VN(), 0);
     bv = Eigen::VectorXd::Constant(m.VN(), 0);
     auto tsa = GetTargetShapeAttribute(m);
-    for (auto &f : m.face) {
-        int fi = tri::Index(m, f);
+
+    // the per-wedge terms are computed concurrently, and then gathered on the
+    // vertices in face order so that the sums do not depend on the schedule
+    std::vector<Eigen::Vector2d> wedgeRHS(3 * m.face.size());
+#pragma omp parallel for schedule(static)
+    for (int fi = 0; fi < (int) m.face.size(); ++fi) {
+        Mesh::FaceType& f = m.face[fi];
         const Eigen::Matrix2d& Rf = rotations[fi];
 
         Eigen::Vector2d t[3];
@@ -204,7 +212,6 @@ void ARAP::ComputeRHS(Mesh& m, const std::vector<Eigen::Matrix2d>& rotations, co
         t[2] = t[0] + x_20;
 
         for (int i = 0; i < 3; ++i) {
-            Mesh::VertexPointer vi = f.V0(i);
             int j = (i+1)%3;
             int k = (i+2)%3;
 
@@ -220,9 +227,14 @@ void ARAP::ComputeRHS(Mesh& m, const std::vector<Eigen::Matrix2d>& rotations, co
             Eigen::Vector2d x_ij = t[i] - t[j];
             Eigen::Vector2d x_ik = t[i] - t[k];
 
-            Eigen::Vector2d rhs = (weight_ij * Rf) * x_ij + (weight_ik * Rf) * x_ik;
-            bu(Idx(vi)) += rhs.x();
-            bv(Idx(vi)) += rhs.y();
+            wedgeRHS[3 * fi + i] = (weight_ij * Rf) * x_ij + (weight_ik * Rf) * x_ik;
+        }
+    }
+    for (unsigned fi = 0; fi < m.face.size(); ++fi) {
+        for (int i = 0; i < 3; ++i) {
+            int vi = Idx(m.face[fi].V0(i));
+            bu(vi) += wedgeRHS[3 * fi + i].x();
+            bv(vi) += wedgeRHS[3 * fi + i].y();
         }
     }
     for (unsigned i = 0; i < fixed_i.size(); ++i) {
@@ -250,7 +262,9 @@ double ARAP::ComputeEnergyFromStoredWedgeTC(const std::vector<Mesh::FacePointer>
     double n = 0;
     double d = 0;
     auto tsa = GetWedgeTexCoordStorageAttribute(m);
-    for (auto fptr : fpVec) {
+#pragma omp parallel for schedule(static) reduction(+:n,d)
+    for (int i = 0; i < (int) fpVec.size(); ++i) {
+        Mesh::FacePointer fptr = fpVec[i];
         vcg::Point2d x10 = tsa[fptr].tc[1].P() - tsa[fptr].tc[0].P();
         vcg::Point2d x20 = tsa[fptr].tc[2].P() - tsa[fptr].tc[0].P();
         vcg::Point2d u10 = fptr->WT(1).P() - fptr->WT(0).P();
@@ -274,7 +288,9 @@ double ARAP::ComputeEnergyFromStoredWedgeTC(Mesh& m, double *num, double *denom)
     double e = 0;
     double total_area = 0;
     auto tsa = GetWedgeTexCoordStorageAttribute(m);
-    for (auto& f : m.face) {
+#pragma omp parallel for schedule(static) reduction(+:e,total_area)
+    for (int fi = 0; fi < (int) m.face.size(); ++fi) {
+        Mesh::FaceType& f = m.face[fi];
         vcg::Point2d x10 = tsa[f].tc[1].P() - tsa[f].tc[0].P();
         vcg::Point2d x20 = tsa[f].tc[2].P() - tsa[f].tc[0].P();
         double area_f = std::abs(x10 ^ x20);
@@ -301,7 +317,9 @@ double ARAP::CurrentEnergy()
     double e = 0;
     double total_area = 0;
     auto tsa = GetTargetShapeAttribute(m);
-    for (auto& f : m.face) {
+#pragma omp parallel for schedule(static) reduction(+:e,total_area)
+    for (int fi = 0; fi < (int) m.face.size(); ++fi) {
+        Mesh::FaceType& f = m.face[fi];
         vcg::Point2d x10, x20;
         LocalIsometry(tsa[f].P[1] - tsa[f].P[0], tsa[f].P[2] - tsa[f].P[0], x10, x20);
         Eigen::Matrix2d Jf = ComputeTransformationMatrix(x10, x20, f.WT(1).P() - f.WT(0).P(), f.WT(2).P() - f.WT(0).P());
@@ -40,13 +40,14 @@ int Pack(const std::vector<ChartHandle>& charts, TextureObjectHandle textureObje
 
     texszVec.clear();
 
-    std::vector<Outline2f> outlines;
-
-    for (auto c : charts) {
-        // Save the outline of the parameterization for this portion of the mesh
-        Outline2f outline = ExtractOutline2f(*c);
-        outlines.push_back(outline);
-    }
+    // Save the outline of the parameterization of each chart. Charts are
+    // disconnected and have disjoint face sets, so the border visits (which
+    // use the face visited flag) are run concurrently
+    std::vector<Outline2f> outlines(charts.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) charts.size(); ++i)
+        outlines[i] = ExtractOutline2f(*charts[i]);
 
     int packingSize = 4096;
     std::vector<std::pair<double,double>> trs = textureObject->ComputeRelativeSizes();
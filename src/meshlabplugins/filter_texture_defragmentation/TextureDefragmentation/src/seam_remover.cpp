@@ -57,7 +57,8 @@ struct Perf {
 };
 
 
-static void InsertNewClusterInQueue(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
+static void InsertNewClustersInQueue(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
+static void InsertClusterInQueue(ClusteredSeamHandle csh, CostInfo ci, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params);
 static CostInfo ComputeCost(ClusteredSeamHandle csh, GraphHandle graph, const AlgoParameters& params, double penalty);
 static inline double GetPenalty(ClusteredSeamHandle csh, AlgoStateHandle state);
 static inline bool Valid(const WeightedSeam& ws, ConstAlgoStateHandle state);
@@ -284,8 +285,8 @@ AlgoStateHandle InitializeState(GraphHandle graph, const AlgoParameters& algoPar
             nself++;
         else
             ndisconnecting++;
-        InsertNewClusterInQueue(csh, state, graph, algoParameters);
     }
+    InsertNewClustersInQueue(cshvec, state, graph, algoParameters);
     LOG_INFO << "Found " << ndisconnecting << " disconnecting seams";
     LOG_INFO << "Found " << nself << " non-disconnecting seams";
 
@@ -413,11 +414,31 @@ void Finalize(GraphHandle graph, int *vndup)
 
 // -- static functions ---------------------------------------------------------
 
-static void InsertNewClusterInQueue(ClusteredSeamHandle csh, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
+/* Evaluates the clusters concurrently, and inserts them in the queue in the
+ * order of cshvec. ComputeCost() only reads the graph, so the lazily computed
+ * chart attributes and the penalties are filled before the parallel loop */
+static void InsertNewClustersInQueue(const std::vector<ClusteredSeamHandle>& cshvec, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
 {
-    ColorizeSeam(csh, vcg::Color4b::White);
+    std::vector<double> penalty(cshvec.size());
+    for (unsigned i = 0; i < cshvec.size(); ++i) {
+        ChartPair charts = GetCharts(cshvec[i], graph);
+        charts.first->AreaUV();
+        charts.second->AreaUV();
+        penalty[i] = GetPenalty(cshvec[i], state);
+    }
+
+    std::vector<CostInfo> costs(cshvec.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int) cshvec.size(); ++i)
+        costs[i] = ComputeCost(cshvec[i], graph, params, penalty[i]);
+
+    for (unsigned i = 0; i < cshvec.size(); ++i)
+        InsertClusterInQueue(cshvec[i], costs[i], state, graph, params);
+}
 
-    CostInfo ci = ComputeCost(csh, graph, params, GetPenalty(csh, state));
+static void InsertClusterInQueue(ClusteredSeamHandle csh, CostInfo ci, AlgoStateHandle state, GraphHandle graph, const AlgoParameters& params)
+{
+    ColorizeSeam(csh, vcg::Color4b::White);
 
     if (params.reduce) {
         while (ci.mvalue == CostInfo::UNFEASIBLE_MATCHING) {
@@ -1384,6 +1405,7 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
     EraseSeam(sd.csh, state, graph);
     state->penalty.erase(sd.csh);
 
+    std::vector<ClusteredSeamHandle> reinserted;
     for (auto csh : independentClusters) {
         auto it = state->status.find(csh);
         ensure(it != state->status.end());
@@ -1404,16 +1426,15 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
         if (invalidate || (params.ignoreOnReject && mv == CostInfo::REJECTED))
             InvalidateCluster(csh, state, graph, clusterStatus, 1.0);
         else
-            InsertNewClusterInQueue(csh, state, graph, params);
+            reinserted.push_back(csh);
     }
+    InsertNewClustersInQueue(reinserted, state, graph, params);
 
     for (auto csh : sharedClusters)
         EraseSeam(csh, state, graph);
 
     std::vector<ClusteredSeamHandle> cshvec = ClusterSeamsByChartId(shared);
-    for (auto csh : cshvec) {
-        InsertNewClusterInQueue(csh, state, graph, params);
-    }
+    InsertNewClustersInQueue(cshvec, state, graph, params);
 
     if (params.visitComponents) {
         // if potential islands are allowed to ignore the boundary length limit,
@@ -1426,10 +1447,9 @@ static void AcceptMove(const SeamData& sd, AlgoStateHandle state, GraphHandle gr
                 if (state->mvalue[csh] == CostInfo::MatchingValue::UNFEASIBLE_BOUNDARY)
                     unfeasibleBoundaryAdj.insert(csh);
 
-        for (ClusteredSeamHandle csh : unfeasibleBoundaryAdj) {
+        for (ClusteredSeamHandle csh : unfeasibleBoundaryAdj)
             EraseSeam(csh, state, graph);
-            InsertNewClusterInQueue(csh, state, graph, params);
-        }
+        InsertNewClustersInQueue(std::vector<ClusteredSeamHandle>(unfeasibleBoundaryAdj.begin(), unfeasibleBoundaryAdj.end()), state, graph, params);
     }
 
     PERF_TIMER_ACCUMULATE(t_accept);
@@ -34,9 +34,12 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 
 #include <QImage>
 
+#include <vcg/space/point4.h>
+
 
 
 static const char *vs_text[] = {
@@ -337,3 +340,257 @@ static std::shared_ptr<QImage> RenderTexture(std::vector<Mesh::FacePointer>& fve
 
     return textureImage;
 }
+
+
+// -- CPU rendering ------------------------------------------------------------
+
+/* Mip pyramid of an input texture, stored with the OpenGL convention (row 0
+ * is v = 0) so that it can be sampled with the same coordinates used by the
+ * shaders */
+struct MipPyramid {
+    std::vector<QImage> levels;
+
+    void Build(const QImage& img)
+    {
+        levels.clear();
+        QImage base = img.convertToFormat(QImage::Format_ARGB32);
+        Mirror(base);
+        levels.push_back(base);
+        while (levels.back().width() > 1 || levels.back().height() > 1) {
+            const QImage& src = levels.back();
+            QImage dst(std::max(1, src.width() / 2), std::max(1, src.height() / 2), QImage::Format_ARGB32);
+#pragma omp parallel for schedule(static)
+            for (int y = 0; y < dst.height(); ++y) {
+                const QRgb *r0 = (const QRgb *) src.constScanLine(std::min(2 * y, src.height() - 1));
+                const QRgb *r1 = (const QRgb *) src.constScanLine(std::min(2 * y + 1, src.height() - 1));
+                QRgb *out = (QRgb *) dst.scanLine(y);
+                for (int x = 0; x < dst.width(); ++x) {
+                    int x0 = std::min(2 * x, src.width() - 1);
+                    int x1 = std::min(2 * x + 1, src.width() - 1);
+                    QRgb c[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+                    int r = 0, g = 0, b = 0, a = 0;
+                    for (int k = 0; k < 4; ++k) {
+                        r += qRed(c[k]); g += qGreen(c[k]); b += qBlue(c[k]); a += qAlpha(c[k]);
+                    }
+                    out[x] = qRgba((r + 2) / 4, (g + 2) / 4, (b + 2) / 4, (a + 2) / 4);
+                }
+            }
+            levels.push_back(dst);
+        }
+    }
+
+    int Width() const { return levels[0].width(); }
+    int Height() const { return levels[0].height(); }
+};
+
+static inline vcg::Point4f Fetch(const QImage& img, int x, int y)
+{
+    // GL_REPEAT wrapping
+    x %= img.width();
+    y %= img.height();
+    if (x < 0) x += img.width();
+    if (y < 0) y += img.height();
+    QRgb c = ((const QRgb *) img.constScanLine(y))[x];
+    return vcg::Point4f(qRed(c), qGreen(c), qBlue(c), qAlpha(c));
+}
+
+static vcg::Point4f SampleNearest(const MipPyramid& pyr, double s, double t)
+{
+    const QImage& img = pyr.levels[0];
+    return Fetch(img, (int) std::floor(s * img.width()), (int) std::floor(t * img.height()));
+}
+
+static vcg::Point4f SampleBilinear(const QImage& img, double s, double t)
+{
+    double cx = s * img.width() - 0.5;
+    double cy = t * img.height() - 0.5;
+    int x0 = (int) std::floor(cx);
+    int y0 = (int) std::floor(cy);
+    float fx = float(cx - x0);
+    float fy = float(cy - y0);
+    vcg::Point4f c0 = Fetch(img, x0, y0) * (1 - fx) + Fetch(img, x0 + 1, y0) * fx;
+    vcg::Point4f c1 = Fetch(img, x0, y0 + 1) * (1 - fx) + Fetch(img, x0 + 1, y0 + 1) * fx;
+    return c0 * (1 - fy) + c1 * fy;
+}
+
+/* Equivalent of GL_LINEAR_MIPMAP_LINEAR filtering at the given level of detail */
+static vcg::Point4f SampleTrilinear(const MipPyramid& pyr, double s, double t, double lod)
+{
+    lod = std::max(0.0, std::min(lod, double(pyr.levels.size() - 1)));
+    int l0 = (int) std::floor(lod);
+    int l1 = std::min(l0 + 1, int(pyr.levels.size() - 1));
+    float f = float(lod - l0);
+    vcg::Point4f c = SampleBilinear(pyr.levels[l0], s, t);
+    if (f > 0 && l1 != l0)
+        c = c * (1 - f) + SampleBilinear(pyr.levels[l1], s, t) * f;
+    return c;
+}
+
+/* Bicubic B-spline lookup with four linear fetches, as in the fragment shader */
+static vcg::Point4f SampleCubic(const MipPyramid& pyr, double s, double t, double lod)
+{
+    const vcg::Point2d sz(pyr.Width(), pyr.Height());
+    vcg::Point4f tex[2][2];
+    vcg::Point2d g1, h0, h1;
+    for (int k = 0; k < 2; ++k) {
+        double coord = (k == 0 ? s : t) * sz[k] - 0.5;
+        double idx = std::floor(coord);
+        double fraction = coord - idx;
+        double one_frac = 1.0 - fraction;
+        double w0 = (1.0/6.0) * one_frac * one_frac * one_frac;
+        double w1 = (2.0/3.0) - 0.5 * fraction * fraction * (2.0 - fraction);
+        double w2 = (2.0/3.0) - 0.5 * one_frac * one_frac * (2.0 - one_frac);
+        double w3 = (1.0/6.0) * fraction * fraction * fraction;
+        double g0 = w0 + w1;
+        g1[k] = w2 + w3;
+        h0[k] = (w1 / g0) - 0.5 + idx;
+        h1[k] = (w3 / g1[k]) + 1.5 + idx;
+    }
+    tex[0][0] = SampleTrilinear(pyr, h0.X() / sz.X(), h0.Y() / sz.Y(), lod);
+    tex[1][0] = SampleTrilinear(pyr, h1.X() / sz.X(), h0.Y() / sz.Y(), lod);
+    tex[0][1] = SampleTrilinear(pyr, h0.X() / sz.X(), h1.Y() / sz.Y(), lod);
+    tex[1][1] = SampleTrilinear(pyr, h1.X() / sz.X(), h1.Y() / sz.Y(), lod);
+    float gx = float(g1.X());
+    float gy = float(g1.Y());
+    vcg::Point4f c0 = tex[0][0] * (1 - gy) + tex[0][1] * gy;
+    vcg::Point4f c1 = tex[1][0] * (1 - gy) + tex[1][1] * gy;
+    return c0 * (1 - gx) + c1 * gx;
+}
+
+static inline QRgb ToQRgb(const vcg::Point4f& c)
+{
+    auto ch = [](float v) { return std::max(0, std::min(255, (int) std::lround(v))); };
+    return qRgba(ch(c[0]), ch(c[1]), ch(c[2]), ch(c[3]));
+}
+
+static std::shared_ptr<QImage> RenderTextureCPU(std::vector<Mesh::FacePointer>& fvec,
+                                                Mesh &m, const std::vector<MipPyramid>& pyramids,
+                                                bool filter, RenderMode imode,
+                                                int textureWidth, int textureHeight)
+{
+    // rows are rasterized in bands, each band is filled by a single thread
+    // drawing its faces in the same order used by the OpenGL renderer
+    constexpr int BAND_HEIGHT = 16;
+
+    auto WTCSh = GetWedgeTexCoordStorageAttribute(m);
+
+    auto FaceComparatorByInputTexIndex = [&WTCSh](const Mesh::FacePointer& f1, const Mesh::FacePointer& f2) {
+        return WTCSh[f1].tc[0].N() < WTCSh[f2].tc[0].N();
+    };
+
+    std::stable_sort(fvec.begin(), fvec.end(), FaceComparatorByInputTexIndex);
+
+    std::shared_ptr<QImage> textureImage = std::make_shared<QImage>(textureWidth, textureHeight, QImage::Format_ARGB32);
+    textureImage->fill(qRgba(0, 255, 0, 128));
+
+    const int nBands = (textureHeight + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::vector<std::vector<int>> bandFaces(nBands);
+    for (int i = 0; i < (int) fvec.size(); ++i) {
+        double ymin = textureHeight;
+        double ymax = 0;
+        for (int k = 0; k < 3; ++k) {
+            ymin = std::min(ymin, fvec[i]->cWT(k).V() * textureHeight);
+            ymax = std::max(ymax, fvec[i]->cWT(k).V() * textureHeight);
+        }
+        int b0 = std::max(0, (int) std::floor(ymin - 0.5) / BAND_HEIGHT);
+        int b1 = std::min(nBands - 1, (int) std::ceil(ymax - 0.5) / BAND_HEIGHT);
+        for (int b = b0; b <= b1; ++b)
+            bandFaces[b].push_back(i);
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int band = 0; band < nBands; ++band) {
+        const int by0 = band * BAND_HEIGHT;
+        const int by1 = std::min(textureHeight, by0 + BAND_HEIGHT);
+        for (int i : bandFaces[band]) {
+            Mesh::FacePointer fptr = fvec[i];
+            const TexCoordStorage& tcs = WTCSh[fptr];
+            const MipPyramid& pyr = pyramids[tcs.tc[0].N()];
+
+            vcg::Point2d p[3];
+            vcg::Point2d uv[3];
+            for (int k = 0; k < 3; ++k) {
+                p[k] = vcg::Point2d(fptr->cWT(k).U() * textureWidth, fptr->cWT(k).V() * textureHeight);
+                uv[k] = vcg::Point2d(tcs.tc[k].U() / pyr.Width(), tcs.tc[k].V() / pyr.Height());
+            }
+
+            double area = (p[1] - p[0]) ^ (p[2] - p[0]);
+            if (area == 0)
+                continue;
+
+            // level of detail from the ratio between texel and pixel footprints
+            double texelArea = std::abs((tcs.tc[1].P() - tcs.tc[0].P()) ^ (tcs.tc[2].P() - tcs.tc[0].P()));
+            double lod = (texelArea > 0) ? std::max(0.0, 0.5 * std::log2(texelArea / std::abs(area))) : 0.0;
+
+            double xmin = std::min({p[0].X(), p[1].X(), p[2].X()});
+            double xmax = std::max({p[0].X(), p[1].X(), p[2].X()});
+            double ymin = std::min({p[0].Y(), p[1].Y(), p[2].Y()});
+            double ymax = std::max({p[0].Y(), p[1].Y(), p[2].Y()});
+            int x0 = std::max(0, (int) std::ceil(xmin - 0.5));
+            int x1 = std::min(textureWidth - 1, (int) std::floor(xmax - 0.5));
+            int y0 = std::max(by0, (int) std::ceil(ymin - 0.5));
+            int y1 = std::min(by1 - 1, (int) std::floor(ymax - 0.5));
+
+            for (int y = y0; y <= y1; ++y) {
+                QRgb *line = (QRgb *) textureImage->scanLine(y);
+                for (int x = x0; x <= x1; ++x) {
+                    vcg::Point2d c(x + 0.5, y + 0.5);
+                    double w0 = ((p[1] - c) ^ (p[2] - c)) / area;
+                    double w1 = ((p[2] - c) ^ (p[0] - c)) / area;
+                    double w2 = 1.0 - w0 - w1;
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+
+                    vcg::Point2d st = uv[0] * w0 + uv[1] * w1 + uv[2] * w2;
+                    switch (imode) {
+                    case Nearest:
+                    case Linear:
+                        if (st.X() < 0) {
+                            line[x] = qRgba(0, 255, 0, 255);
+                        } else {
+                            vcg::Point4f col = (imode == Nearest) ? SampleNearest(pyr, st.X(), st.Y())
+                                                                  : SampleTrilinear(pyr, st.X(), st.Y(), lod);
+                            col[3] = 255;
+                            line[x] = ToQRgb(col);
+                        }
+                        break;
+                    case Cubic:
+                        line[x] = ToQRgb(SampleCubic(pyr, st.X(), st.Y(), lod));
+                        break;
+                    case FaceColor:
+                        line[x] = qRgba(fptr->C()[0], fptr->C()[1], fptr->C()[2], fptr->C()[3]);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (filter)
+        vcg::PullPush(*textureImage, qRgba(0, 255, 0, 128));
+
+    Mirror(*textureImage);
+
+    return textureImage;
+}
+
+std::vector<std::shared_ptr<QImage>> RenderTextureCPU(Mesh& m, TextureObjectHandle textureObject, const std::vector<TextureSize> &texSizes,
+                                                      bool filter, RenderMode imode)
+{
+    std::vector<std::vector<Mesh::FacePointer>> facesByTexture;
+    int nTex = FacesByTextureIndex(m, facesByTexture);
+
+    ensure(nTex <= (int) texSizes.size());
+
+    std::vector<MipPyramid> pyramids(textureObject->ArraySize());
+    for (std::size_t i = 0; i < textureObject->ArraySize(); ++i)
+        pyramids[i].Build(textureObject->texInfoVec[i].texture);
+
+    std::vector<std::shared_ptr<QImage>> newTextures;
+    for (int i = 0; i < nTex; ++i) {
+        std::shared_ptr<QImage> teximg = RenderTextureCPU(facesByTexture[i], m, pyramids, filter, imode, texSizes[i].w, texSizes[i].h);
+        newTextures.push_back(teximg);
+    }
+
+    return newTextures;
+}
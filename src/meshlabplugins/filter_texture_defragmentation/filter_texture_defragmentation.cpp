@@ -32,8 +32,6 @@
 #include <vcg/complex/algorithms/update/topology.h>
 #include <vcg/complex/algorithms/update/normal.h>
 
-#include <common/GLExtensionsManager.h>
-
 #include "TextureDefragmentation/src/mesh.h"
 #include "TextureDefragmentation/src/texture_object.h"
 #include "TextureDefragmentation/src/mesh_attribute.h"
@@ -127,7 +125,7 @@ bool FilterTextureDefragPlugin::requiresGLContext(const QAction* a) const
 {
 	switch (ID(a)) {
 	case FP_TEXTURE_DEFRAG:
-		return true;
+		return false; // textures are resampled on the CPU
 	default:
 		assert(0);
 		return false;
@@ -375,10 +373,8 @@ std::map<std::string, QVariant> FilterTextureDefragPlugin::applyFilter(
 
 		IntegerShift(defragMesh, chartsToPack, texszVec, anchorMap, flipped);
 
-		glContext->makeCurrent();
-		GLExtensionsManager::initializeGLextensions();
-		std::vector<std::shared_ptr<QImage>> newTextures = RenderTexture(defragMesh, textureObject, texszVec, true, RenderMode::Linear);
-		glContext->doneCurrent();
+		cb(80, "Resampling textures...");
+		std::vector<std::shared_ptr<QImage>> newTextures = RenderTextureCPU(defragMesh, textureObject, texszVec, true, RenderMode::Linear);
 
 		// Copy wedge tex coords from defragMesh to cm
 		if (mm.cm.FN() != defragMesh.FN())
@@ -21,6 +21,7 @@
  *                                                                           *
  ****************************************************************************/
 #include "filter_unsharp.h"
+#include "harmonic_solver.h"
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/crease_cut.h>
@@ -288,6 +289,9 @@ QString FilterUnsharp::filterInfo(ActionIDType filterId) const
 			"field values for all the mesh vertices, which are stored in the "
 			"<a href='https://stackoverflow.com/questions/58610746'>quality per vertex "
 			"attribute</a> of the mesh.<br>"
+			"The factorized Laplace operator is cached with the mesh, so applying the filter "
+			"again on the unchanged mesh with different boundary conditions only requires "
+			"back-substitutions.<br>"
 			"For more details see:"
 			"<b>Dynamic Harmonic Fields for Surface Processing</b> by <i>Kai Xua, Hao Zhang, "
 			"Daniel Cohen-Or, Yueshan Xionga</i>. "
@@ -1069,21 +1073,23 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 			throw MLException("Error occurred for selected points.");
 		}
 
-		vcg::tri::Harmonic<CMeshO, FieldScalar>::ConstraintVec constraints;
-		constraints.push_back(vcg::tri::Harmonic<CMeshO, FieldScalar>::Constraint(
-			vp0, FieldScalar(par.getFloat("value1"))));
-		constraints.push_back(vcg::tri::Harmonic<CMeshO, FieldScalar>::Constraint(
-			vp1, FieldScalar(par.getFloat("value2"))));
+		std::vector<HarmonicFieldSolver::Constraint> constraints;
+		constraints.push_back(HarmonicFieldSolver::Constraint(
+			vcg::tri::Index(m, vp0), par.getFloat("value1")));
+		constraints.push_back(HarmonicFieldSolver::Constraint(
+			vcg::tri::Index(m, vp1), par.getFloat("value2")));
 
 		CMeshO::PerVertexAttributeHandle<FieldScalar> handle =
 			vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<FieldScalar>(m, "harmonic");
 
-		bool ok =
-			vcg::tri::Harmonic<CMeshO, FieldScalar>::ComputeScalarField(m, constraints, handle);
-
-		if (!ok) {
+		std::vector<double> field;
+		std::shared_ptr<HarmonicFieldSolver> solver = HarmonicFieldSolver::get(m, cb);
+		if (!solver->solve(constraints, field)) {
 			throw MLException("An error occurred.");
 		}
+		for (size_t i = 0; i < m.vert.size(); ++i)
+			handle[i] = FieldScalar(field[i]);
+
 		md.mm()->updateDataMask(MeshModel::MM_VERTQUALITY);
 		for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi)
 			vi->Q() = handle[vi];
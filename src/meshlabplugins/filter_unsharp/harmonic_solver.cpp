@@ -0,0 +1,175 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#include "harmonic_solver.h"
+
+#include <cstring>
+#include <Eigen/Dense>
+
+namespace {
+
+uint64_t mix(uint64_t x)
+{
+	// splitmix64 finalizer
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+uint64_t hashPoint(const Point3m& p)
+{
+	uint64_t h = 0;
+	for (int i = 0; i < 3; ++i) {
+		double   d = double(p[i]);
+		uint64_t bits;
+		std::memcpy(&bits, &d, sizeof(bits));
+		h = mix(h ^ bits);
+	}
+	return h;
+}
+
+} // namespace
+
+std::shared_ptr<HarmonicFieldSolver> HarmonicFieldSolver::get(CMeshO& m, vcg::CallBackPos* cb)
+{
+	auto cache = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<std::shared_ptr<HarmonicFieldSolver>>(
+		m, "HarmonicFieldSolver");
+
+	const uint64_t s = signature(m);
+	if (cache() == nullptr || cache()->sign != s) {
+		if (cb) cb(10, "Factorizing Laplacian...");
+		cache() = std::shared_ptr<HarmonicFieldSolver>(new HarmonicFieldSolver(m, s));
+	}
+	return cache();
+}
+
+uint64_t HarmonicFieldSolver::signature(const CMeshO& m)
+{
+	const int vn = (int) m.vert.size();
+	const int fn = (int) m.face.size();
+	uint64_t  h  = mix(uint64_t(vn) << 32 | uint64_t(fn));
+
+	// order dependent, but computed as a (commutative) sum of per element hashes
+	uint64_t vh = 0, fh = 0;
+#pragma omp parallel for reduction(+ : vh)
+	for (int i = 0; i < vn; ++i)
+		vh += mix(uint64_t(i) ^ hashPoint(m.vert[i].cP()));
+#pragma omp parallel for reduction(+ : fh)
+	for (int i = 0; i < fn; ++i) {
+		uint64_t fi = uint64_t(i);
+		for (int j = 0; j < 3; ++j)
+			fi = mix(fi ^ uint64_t(vcg::tri::Index(m, m.face[i].cV(j))));
+		fh += fi;
+	}
+	return mix(h ^ vh) ^ mix(fh);
+}
+
+HarmonicFieldSolver::HarmonicFieldSolver(const CMeshO& m, uint64_t signature) : sign(signature)
+{
+	typedef Eigen::Triplet<double> Triple;
+	const int n  = (int) m.vert.size();
+	const int fn = (int) m.face.size();
+
+	// cotangent weights, 12 triplets per face, assembled in parallel
+	std::vector<Triple> coeffs(size_t(fn) * 12);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < fn; ++i) {
+		const CFaceO& f = m.face[i];
+		Triple*       t = &coeffs[size_t(i) * 12];
+		for (int j = 0; j < 3; ++j) {
+			const int     a  = (int) vcg::tri::Index(m, f.cV0(j));
+			const int     b  = (int) vcg::tri::Index(m, f.cV1(j));
+			const Point3d e0 = Point3d::Construct(f.cP0(j) - f.cP2(j));
+			const Point3d e1 = Point3d::Construct(f.cP1(j) - f.cP2(j));
+			const double  sn = (e0 ^ e1).Norm();
+			// half the cotangent of the angle opposite to the edge (a,b)
+			const double w = sn > 0 ? 0.5 * e0.dot(e1) / sn : 0;
+			*t++ = Triple(a, a, w);
+			*t++ = Triple(b, b, w);
+			*t++ = Triple(a, b, -w);
+			*t++ = Triple(b, a, -w);
+		}
+	}
+
+	Eigen::SparseMatrix<double> L(n, n);
+	L.setFromTriplets(coeffs.begin(), coeffs.end());
+	std::vector<Triple>().swap(coeffs);
+
+	// the Laplacian is only semi-definite (constants are in its kernel)
+	double diag = 0;
+	for (int i = 0; i < n; ++i)
+		diag += L.coeff(i, i);
+	const double eps = 1e-8 * (n > 0 ? diag / n : 1.0);
+	for (int i = 0; i < n; ++i)
+		L.coeffRef(i, i) += eps;
+
+	ldlt.compute(L);
+	ok = ldlt.info() == Eigen::Success;
+}
+
+const Eigen::VectorXd& HarmonicFieldSolver::column(int v)
+{
+	auto it = columns.find(v);
+	if (it == columns.end()) {
+		if (columns.size() >= maxCachedColumns)
+			columns.clear();
+		Eigen::VectorXd e = Eigen::VectorXd::Zero(ldlt.rows());
+		e[v]              = 1;
+		it                = columns.insert(std::make_pair(v, ldlt.solve(e))).first;
+	}
+	return it->second;
+}
+
+bool HarmonicFieldSolver::solve(const std::vector<Constraint>& constraints, std::vector<double>& field)
+{
+	const int k = (int) constraints.size();
+	if (!ok || k == 0)
+		return false;
+
+	std::vector<const Eigen::VectorXd*> z(k);
+	for (int i = 0; i < k; ++i)
+		z[i] = &column(constraints[i].first);
+
+	Eigen::MatrixXd S(k, k);
+	Eigen::VectorXd c(k);
+	for (int i = 0; i < k; ++i) {
+		c[i] = constraints[i].second;
+		for (int j = 0; j < k; ++j)
+			S(i, j) = (*z[j])[constraints[i].first];
+	}
+	Eigen::FullPivLU<Eigen::MatrixXd> lu(S);
+	if (!lu.isInvertible())
+		return false;
+	const Eigen::VectorXd mu = lu.solve(c);
+
+	const int n = (int) ldlt.rows();
+	field.assign(n, 0.0);
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < n; ++v) {
+		double x = 0;
+		for (int i = 0; i < k; ++i)
+			x += mu[i] * (*z[i])[v];
+		field[v] = x;
+	}
+	return true;
+}
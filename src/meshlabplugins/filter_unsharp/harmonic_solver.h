@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#ifndef FILTER_UNSHARP_HARMONIC_SOLVER_H
+#define FILTER_UNSHARP_HARMONIC_SOLVER_H
+
+#include <map>
+#include <memory>
+#include <Eigen/Sparse>
+#include <common/ml_document/cmesh.h>
+
+/**
+ * Factorized cotangent Laplacian of a mesh, used to solve scalar harmonic
+ * fields with arbitrary point constraints by back-substitution only.
+ *
+ * The solver is cached in a per mesh attribute, together with a signature of
+ * the connectivity and of the geometry of the mesh: get() returns the cached
+ * solver while the mesh is unchanged and rebuilds it otherwise.
+ *
+ * The (slightly regularized) Laplacian L is factorized once; a field with
+ * constraints x[v_i] = c_i is the minimizer of x'Lx subject to the
+ * constraints, i.e. x = Z mu with Z = L^-1 [e_v1 ... e_vk] and (Z_v) mu = c.
+ * The columns of Z are cached per constrained vertex, so that solving again
+ * with the same vertices and new values costs O(kn).
+ *
+ * The mesh vectors must be compact.
+ */
+class HarmonicFieldSolver
+{
+public:
+	typedef std::pair<int, double> Constraint; // vertex index, value
+
+	static std::shared_ptr<HarmonicFieldSolver> get(CMeshO& m, vcg::CallBackPos* cb = nullptr);
+
+	bool solve(const std::vector<Constraint>& constraints, std::vector<double>& field);
+
+private:
+	HarmonicFieldSolver(const CMeshO& m, uint64_t signature);
+
+	static uint64_t signature(const CMeshO& m);
+
+	const Eigen::VectorXd& column(int v);
+
+	static const size_t maxCachedColumns = 64;
+
+	uint64_t                                           sign;
+	bool                                               ok;
+	Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt;
+	std::map<int, Eigen::VectorXd>                     columns;
+};
+
+#endif // FILTER_UNSHARP_HARMONIC_SOLVER_H
@@ -27,6 +27,8 @@
 
 #include <QTextStream>
 
+#include <common/utilities/load_save.h>
+
 #include <wrap/io_trimesh/import_ply.h>
 #include <wrap/io_trimesh/import_stl.h>
 #include <wrap/io_trimesh/import_obj.h>
@@ -388,6 +390,16 @@ void BaseMeshIOPlugin::open(const QString &formatName, const QString &fileName,
 	if (cb != NULL)	(*cb)(99, "Done");
 }
 
+/*
+	the VMI importer keeps the file and the reader state in static variables;
+	the readers of FBX and GTS have not been checked
+*/
+bool BaseMeshIOPlugin::isOpenReentrant(const QString& format) const
+{
+	const QString f = format.toUpper();
+	return f == "PLY" || f == "STL" || f == "OBJ" || f == "QOBJ" || f == "OFF" || f == "PTX";
+}
+
 void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName, MeshModel &m, const int mask, const RichParameterList & par, CallBackPos *cb)
 {
 	QString errorMsgFormat = "Error encountered while exportering file %1:\n%2";
@@ -615,7 +627,8 @@ std::vector<MeshModel*> BaseMeshIOPlugin::openProject(
 			meshList = loadNVM(filenames.first(), md, unloadedImgs, cb);
 		}
 		else if (format.toUpper() =="MLP" || format.toUpper() == "MLB") {
-			meshList = loadMLP(filenames.first(), md, rendOpt, unloadedImgs, cb);
+			meshList = loadMLP(
+				filenames.first(), md, rendOpt, unloadedImgs, cb, meshlab::maxProjectLoadingJobs());
 		}
 		if (unloadedImgs.size() > 0){
 			QString msg = "Unable to load the following " +
@@ -651,7 +664,8 @@ void BaseMeshIOPlugin::saveProject(
 		CallBackPos* cb)
 {
 	if (format.toUpper() == "MLP" || format.toUpper() == "MLB") {
-		saveMLP(fileName, md, onlyVisibleMeshes, rendOpt, cb);
+		for (const QString& w : saveMLP(fileName, md, onlyVisibleMeshes, rendOpt, cb))
+			log(GLLogStream::WARNING, w.toStdString());
 	}
 	else if (format.toUpper() == "ALN") {
 		saveALN(fileName, md, onlyVisibleMeshes, cb);
@@ -1,6 +1,10 @@
 #include "load_project.h"
+#include "mlb_container.h"
 
 #include <QDir>
+#include <QImageReader>
+
+#include <iterator>
 
 #include <wrap/io_trimesh/alnParser.h>
 #include <wrap/io_trimesh/import_out.h>
@@ -10,6 +14,19 @@
 #include <common/ml_document/mesh_document.h>
 #include <common/utilities/load_save.h>
 
+/**
+ * When raster planes are kept out of core, the project planes are not decoded
+ * at load time: only the header of the file is read, to check that it can be
+ * decoded later. Unreadable files are replaced by the dummy image.
+ */
+static RasterPlane* outOfCorePlane(const QString& filename, std::vector<std::string>& unloadedImgList)
+{
+	if (QImageReader(filename).canRead())
+		return new RasterPlane(filename, RasterPlane::RGBA);
+	unloadedImgList.push_back(filename.toStdString());
+	return new RasterPlane(QImage(":/img/dummy.png"), filename, RasterPlane::RGBA);
+}
+
 std::vector<MeshModel*> loadALN(
 		const QString& filename,
 		MeshDocument& md,
@@ -82,15 +99,20 @@ std::vector<MeshModel*> loadOUT(
 		md.addNewRaster();
 		const QString fullpath_image_filename = image_filenames_q[int(i)];
 
-		QImage img(":/img/dummy.png");
-		try {
-			img = meshlab::loadImage(fullpath_image_filename);
-		}
-		catch(const MLException& e){
-			unloadedImgList.push_back(fullpath_image_filename.toStdString());
+		if (RasterPlane::memoryBudget() > 0) {
+			md.rm()->addPlane(outOfCorePlane(fullpath_image_filename, unloadedImgList));
 		}
+		else {
+			QImage img(":/img/dummy.png");
+			try {
+				img = meshlab::loadImage(fullpath_image_filename);
+			}
+			catch(const MLException& e){
+				unloadedImgList.push_back(fullpath_image_filename.toStdString());
+			}
 
-		md.rm()->addPlane(new RasterPlane(img, fullpath_image_filename, RasterPlane::RGBA));
+			md.rm()->addPlane(new RasterPlane(img, fullpath_image_filename, RasterPlane::RGBA));
+		}
 		int count=fullpath_image_filename.count('\\');
 		if (count==0)
 		{
@@ -136,15 +158,20 @@ std::vector<MeshModel*> loadNVM(
 	for(size_t i=0 ; i<shots.size() ; i++){
 		md.addNewRaster();
 		const QString fullpath_image_filename = image_filenames_q[int(i)];
-		QImage img(":/img/dummy.png");
-		try {
-			img = meshlab::loadImage(fullpath_image_filename);
-		}
-		catch(const MLException& e){
-			unloadedImgList.push_back(fullpath_image_filename.toStdString());
+		if (RasterPlane::memoryBudget() > 0) {
+			md.rm()->addPlane(outOfCorePlane(fullpath_image_filename, unloadedImgList));
 		}
+		else {
+			QImage img(":/img/dummy.png");
+			try {
+				img = meshlab::loadImage(fullpath_image_filename);
+			}
+			catch(const MLException& e){
+				unloadedImgList.push_back(fullpath_image_filename.toStdString());
+			}
 
-		md.rm()->addPlane(new RasterPlane(fullpath_image_filename,RasterPlane::RGBA));
+			md.rm()->addPlane(new RasterPlane(fullpath_image_filename,RasterPlane::RGBA));
+		}
 		md.rm()->setLabel(image_filenames_q[int(i)].section('/',1,2));
 		md.rm()->shot = shots[int(i)];
 	}
@@ -155,12 +182,239 @@ std::vector<MeshModel*> loadNVM(
 	return meshList;
 }
 
+static void readMeshMatrix(const QDomNode& mesh, bool binary, Matrix44m& m)
+{
+	QDomNode tr = mesh.firstChildElement("MLMatrix44");
+
+	if (!tr.isNull()) {
+		if (tr.childNodes().size() == 1) {
+			if (!binary) {
+				Scalarm* v = m.V();
+				const QStringList rows = tr.firstChild().nodeValue().split("\n", Qt::SkipEmptyParts);
+				unsigned int i = 0;
+				for (const QString& row: rows) {
+					const QStringList values = row.split(" ", Qt::SkipEmptyParts);
+					for (const QString& value: values) {
+						if (i >= 16u) break;
+						v[i++] = value.toFloat();
+					}
+				}
+			}
+			else {
+				QString str = tr.firstChild().nodeValue();
+				QByteArray value = QByteArray::fromBase64(str.toLocal8Bit());
+				memcpy(m.V(), value.data(), sizeof(Matrix44m::ScalarType) * 16);
+			}
+		}
+	}
+}
+
+static void readRenderingOption(const QDomNode& mesh, std::vector<MLRenderingData>& rendOpt)
+{
+	QDomNode renderingOpt = mesh.firstChildElement("RenderingOption");
+	if (!renderingOpt.isNull())
+	{
+		QString value = renderingOpt.firstChild().nodeValue();
+		MLRenderingData::GLOptionsType opt;
+		if (renderingOpt.attributes().contains("pointSize"))
+			opt._perpoint_pointsize = renderingOpt.attributes().namedItem("pointSize").nodeValue().toFloat();
+		if (renderingOpt.attributes().contains("wireWidth"))
+			opt._perwire_wirewidth = renderingOpt.attributes().namedItem("wireWidth").nodeValue().toFloat();
+		if (renderingOpt.attributes().contains("boxColor"))
+		{
+			QStringList values = renderingOpt.attributes().namedItem("boxColor").nodeValue().split(" ", QString::SkipEmptyParts);
+			opt._perbbox_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
+		}
+		if (renderingOpt.attributes().contains("pointColor"))
+		{
+			QStringList values = renderingOpt.attributes().namedItem("pointColor").nodeValue().split(" ", QString::SkipEmptyParts);
+			opt._perpoint_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
+		}
+		if (renderingOpt.attributes().contains("wireColor"))
+		{
+			QStringList values = renderingOpt.attributes().namedItem("wireColor").nodeValue().split(" ", QString::SkipEmptyParts);
+			opt._perwire_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
+		}
+		if (renderingOpt.attributes().contains("solidColor"))
+		{
+			QStringList values = renderingOpt.attributes().namedItem("solidColor").nodeValue().split(" ", QString::SkipEmptyParts);
+			opt._persolid_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
+		}
+		MLRenderingData data;
+		data.set(opt);
+		if (data.deserialize(value.toStdString()))
+			rendOpt.push_back(data);
+	}
+}
+
+static void readMeshAttributes(const QDomNode& mesh, QString& label, bool& visible, int& idInFile)
+{
+	label = mesh.attributes().namedItem("label").nodeValue();
+	visible = true;
+	if (mesh.attributes().contains("visible"))
+		visible = (mesh.attributes().namedItem("visible").nodeValue().toInt() == 1);
+	idInFile = -1;
+	if (mesh.attributes().contains("idInFile"))
+		idInFile = mesh.attributes().namedItem("idInFile").nodeValue().toInt();
+}
+
+static QDomDocument readProjectXML(QIODevice* dev, const QByteArray& content, const QString& filename)
+{
+	QDomDocument doc("MeshLabDocument");    //It represents the XML document
+	bool ok = dev != nullptr ? doc.setContent(dev) : doc.setContent(content);
+	if (!ok)
+		throw MLException(filename + " is not a MeshLab project.");
+	return doc;
+}
+
+/// collects the mesh layers and the rasters, in the order of the project
+static void collectProjectNodes(
+		const QDomElement& root,
+		std::vector<QDomNode>& meshNodes,
+		std::vector<QDomNode>& rasterNodes)
+{
+	for (QDomNode node = root.firstChild(); !node.isNull(); node = node.nextSibling()) {
+		if (QString::compare(node.nodeName(), "MeshGroup") == 0) {
+			for (QDomNode mesh = node.firstChild(); !mesh.isNull(); mesh = mesh.nextSibling())
+				meshNodes.push_back(mesh);
+		}
+		// READ IN POINT CORRESPONDECES INCOMPLETO!!
+		else if (QString::compare(node.nodeName(), "RasterGroup") == 0) {
+			for (QDomNode raster = node.firstChild(); !raster.isNull(); raster = raster.nextSibling())
+				rasterNodes.push_back(raster);
+		}
+	}
+}
+
+/**
+ * Decodes the planes concurrently, then adds the rasters in project order.
+ * If planes are kept out of core, they are not decoded here.
+ */
+static void loadRasters(
+		const std::vector<QDomNode>& rasterNodes,
+		const QDir& projectDir,
+		MeshDocument& md,
+		std::vector<std::string>& unloadedImgList,
+		unsigned int maxInFlight,
+		vcg::CallBackPos* cb)
+{
+	QStringList planeFiles;
+	for (const QDomNode& raster : rasterNodes) {
+		QDomElement el = raster.firstChildElement("Plane");
+		while (!el.isNull()) {
+			planeFiles.push_back(projectDir.absoluteFilePath(el.attribute("fileName")));
+			el = el.nextSiblingElement("Plane");
+		}
+	}
+	const bool outOfCore = RasterPlane::memoryBudget() > 0;
+	std::vector<QImage> images;
+	if (!outOfCore)
+		images = meshlab::loadImagesConcurrently(planeFiles, maxInFlight, nullptr, cb);
+
+	int plane = 0;
+	for (const QDomNode& raster : rasterNodes) {
+		md.addNewRaster();
+		QString labelRaster = raster.attributes().namedItem("label").nodeValue();
+		md.rm()->setLabel(labelRaster);
+		QDomNode sh = raster.firstChild();
+		ReadShotFromQDomNode(md.rm()->shot, sh);
+
+		QDomElement el = raster.firstChildElement("Plane");
+		while (!el.isNull()) {
+			const QString& nm = planeFiles[plane];
+			if (outOfCore) {
+				md.rm()->addPlane(outOfCorePlane(nm, unloadedImgList));
+			}
+			else {
+				QImage img = images[plane];
+				if (img.isNull()) {
+					img = QImage(":/img/dummy.png");
+					unloadedImgList.push_back(nm.toStdString());
+				}
+				md.rm()->addPlane(new RasterPlane(img, nm, RasterPlane::RGBA));
+			}
+			++plane;
+			el = el.nextSiblingElement("Plane");
+		}
+	}
+}
+
+/**
+ * Loads a binary container: the i-th MLMesh element of the project is
+ * materialized from the i-th layer of the container, without opening any
+ * mesh file.
+ */
+static std::vector<MeshModel*> loadMLBContainer(
+		const QString& filename,
+		MeshDocument& md,
+		std::vector<MLRenderingData>& rendOpt,
+		std::vector<std::string>& unloadedImgList,
+		vcg::CallBackPos* cb,
+		unsigned int maxInFlight)
+{
+	std::vector<MeshModel*> meshList;
+	mlb::Reader reader(filename);
+	QDomDocument doc = readProjectXML(nullptr, reader.projectXml(), filename);
+	const QDir projectDir = QFileInfo(filename).absoluteDir();
+
+	std::vector<QDomNode> meshNodes, rasterNodes;
+	collectProjectNodes(doc.documentElement(), meshNodes, rasterNodes);
+	if (meshNodes.size() != reader.meshNumber())
+		throw MLException(filename + " is corrupted.");
+
+	for (unsigned int i = 0; i < meshNodes.size(); ++i) {
+		const QDomNode& mesh = meshNodes[i];
+		if (cb != nullptr)
+			cb(100 * i / meshNodes.size(), "Loading meshes...");
+		QString label;
+		bool visible;
+		int idInFile;
+		readMeshAttributes(mesh, label, visible, idInFile);
+		QString filen = projectDir.absoluteFilePath(mesh.attributes().namedItem("filename").nodeValue());
+
+		MeshModel* mm = md.addNewMesh(filen, label);
+		try {
+			reader.loadMesh(i, *mm);
+		}
+		catch (const MLException& e) {
+			md.delMesh(mm->id());
+			for (MeshModel* m : meshList)
+				md.delMesh(m->id());
+			throw e;
+		}
+		mm->setIdInFile(idInFile);
+		mm->setVisible(visible);
+		readMeshMatrix(mesh, true, mm->cm.Tr);
+		readRenderingOption(mesh, rendOpt);
+		meshList.push_back(mm);
+	}
+
+	loadRasters(rasterNodes, projectDir, md, unloadedImgList, maxInFlight, cb);
+
+	if (rendOpt.size() != meshList.size()){
+		std::cerr << "cannot load rend options\n";
+	}
+
+	return meshList;
+}
+
+/**
+ * The project is read in three steps: the xml is scanned to collect the mesh
+ * and image files, the files are decoded concurrently (at most maxInFlight at
+ * a time, 0 means one per core), and then labels, transformations, shots and
+ * planes are assigned serially, in the order of the project.
+ *
+ * Binary projects saved as a container are read by loadMLBContainer; older
+ * .mlb files, that are xml with a binary encoding of matrices and shots, are
+ * read as .mlp files.
+ */
 std::vector<MeshModel*> loadMLP(
 		const QString& filename,
 		MeshDocument& md,
 		std::vector<MLRenderingData>& rendOpt,
 		std::vector<std::string>& unloadedImgList,
-		vcg::CallBackPos*)
+		vcg::CallBackPos* cb,
+		unsigned int maxInFlight)
 {
 	std::vector<MeshModel*> meshList;
 	unloadedImgList.clear();
@@ -172,158 +426,76 @@ std::vector<MeshModel*> loadMLP(
 	if (!qf.open(QIODevice::ReadOnly))
 		throw MLException("File not found.");
 
-	QDomDocument doc("MeshLabDocument");    //It represents the XML document
-
-	if (!doc.setContent(&qf))
-		throw MLException(filename + " is not a MeshLab project.");
-
-	QDomElement root = doc.documentElement();
-
-	QDomNode node;
-
-	node = root.firstChild();
+	if (binary && mlb::isContainer(filename)) {
+		qf.close();
+		return loadMLBContainer(filename, md, rendOpt, unloadedImgList, cb, maxInFlight);
+	}
 
-	QDir tmpDir = QDir::current();
-	QDir::setCurrent(qfInfo.absoluteDir().absolutePath());
-	//Devices
-	while (!node.isNull()) {
-		if (QString::compare(node.nodeName(), "MeshGroup") == 0) {
-			QDomNode mesh;
-			QString filen, label;
-			mesh = node.firstChild();
-			while (!mesh.isNull()) {
-				//return true;
-				filen = mesh.attributes().namedItem("filename").nodeValue();
-				label = mesh.attributes().namedItem("label").nodeValue();
-				bool visible = true;
-				if (mesh.attributes().contains("visible"))
-					visible = (mesh.attributes().namedItem("visible").nodeValue().toInt() == 1);
-				//MeshModel* mm = md.addNewMesh(filen, label);
-
-				//mm->visible = visible;
-
-				int idInFile = -1;
-				if (mesh.attributes().contains("idInFile")){
-					idInFile = mesh.attributes().namedItem("idInFile").nodeValue().toInt();
-				}
-				if (idInFile <= 0){
-					//load the file just if it is the first layer contained
-					//in the file (or it is the only one)
-					try {
-						auto tmp = meshlab::loadMeshWithStandardParameters(filen, md);
-						for (auto m : tmp){
-							m->setVisible(visible);
-							m->setLabel(label);
-						}
-						meshList.insert(meshList.end(), tmp.begin(), tmp.end());
-					}
-					catch(const MLException& e) {
-						for (MeshModel* mm : meshList)
-							md.delMesh(mm->id());
-						throw MLException(filen + " mesh file not found.");
-					}
-				}
+	QDomDocument doc = readProjectXML(&qf, QByteArray(), filename);
+	qf.close();
 
-				QDomNode tr = mesh.firstChildElement("MLMatrix44");
-
-				if (!tr.isNull()) {
-					if (tr.childNodes().size() == 1) {
-						if (!binary) {
-							Scalarm* v = md.mm()->cm.Tr.V();
-							const QStringList rows = tr.firstChild().nodeValue().split("\n", Qt::SkipEmptyParts);
-							unsigned int i = 0;
-							for (const QString& row: rows) {
-								const QStringList values = row.split(" ", Qt::SkipEmptyParts);
-								for (const QString& value: values) {
-									if (i >= 16u) break;
-									v[i++] = value.toFloat();
-								}
-							}
-						}
-						else {
-							QString str = tr.firstChild().nodeValue();
-							QByteArray value = QByteArray::fromBase64(str.toLocal8Bit());
-							memcpy(md.mm()->cm.Tr.V(), value.data(), sizeof(Matrix44m::ScalarType) * 16);
-						}
-					}
-				}
+	const QDir projectDir = qfInfo.absoluteDir();
+
+	std::vector<QDomNode> meshNodes, rasterNodes;
+	collectProjectNodes(doc.documentElement(), meshNodes, rasterNodes);
+
+	// a file is loaded just for the first layer contained in the file (or
+	// if it is the only one); the following layers refer to the same file
+	QStringList meshFiles;
+	std::vector<int> fileOfNode(meshNodes.size(), -1);
+	for (unsigned int i = 0; i < meshNodes.size(); ++i) {
+		const QDomNamedNodeMap attr = meshNodes[i].attributes();
+		int idInFile = -1;
+		if (attr.contains("idInFile"))
+			idInFile = attr.namedItem("idInFile").nodeValue().toInt();
+		if (idInFile <= 0)
+			meshFiles.push_back(projectDir.absoluteFilePath(attr.namedItem("filename").nodeValue()));
+		fileOfNode[i] = meshFiles.size() - 1;
+	}
 
-				QDomNode renderingOpt = mesh.firstChildElement("RenderingOption");
-				if (!renderingOpt.isNull())
-				{
-					QString value = renderingOpt.firstChild().nodeValue();
-					MLRenderingData::GLOptionsType opt;
-					if (renderingOpt.attributes().contains("pointSize"))
-						opt._perpoint_pointsize = renderingOpt.attributes().namedItem("pointSize").nodeValue().toFloat();
-					if (renderingOpt.attributes().contains("wireWidth"))
-						opt._perwire_wirewidth = renderingOpt.attributes().namedItem("wireWidth").nodeValue().toFloat();
-					if (renderingOpt.attributes().contains("boxColor"))
-					{
-						QStringList values = renderingOpt.attributes().namedItem("boxColor").nodeValue().split(" ", QString::SkipEmptyParts);
-						opt._perbbox_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
-					}
-					if (renderingOpt.attributes().contains("pointColor"))
-					{
-						QStringList values = renderingOpt.attributes().namedItem("pointColor").nodeValue().split(" ", QString::SkipEmptyParts);
-						opt._perpoint_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
-					}
-					if (renderingOpt.attributes().contains("wireColor"))
-					{
-						QStringList values = renderingOpt.attributes().namedItem("wireColor").nodeValue().split(" ", QString::SkipEmptyParts);
-						opt._perwire_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
-					}
-					if (renderingOpt.attributes().contains("solidColor"))
-					{
-						QStringList values = renderingOpt.attributes().namedItem("solidColor").nodeValue().split(" ", QString::SkipEmptyParts);
-						opt._persolid_fixed_color = vcg::Color4b(values[0].toInt(), values[1].toInt(), values[2].toInt(), values[3].toInt());
-					}
-					MLRenderingData data;
-					data.set(opt);
-					if (data.deserialize(value.toStdString()))
-						rendOpt.push_back(data);
-				}
+	// decode the meshes concurrently
+	std::vector<std::list<MeshModel*>> fileMeshes;
+	try {
+		fileMeshes = meshlab::loadMeshesConcurrently(meshFiles, md, maxInFlight, cb);
+	}
+	catch (const MLException& e) {
+		throw MLException("Unable to load the meshes of the project: " + QString(e.what()));
+	}
 
-				mesh = mesh.nextSibling();
+	// assign the project data to the loaded layers
+	for (const std::list<MeshModel*>& l : fileMeshes)
+		meshList.insert(meshList.end(), l.begin(), l.end());
+
+	for (unsigned int i = 0; i < meshNodes.size(); ++i) {
+		const QDomNode& mesh = meshNodes[i];
+		if (fileOfNode[i] < 0)
+			continue;
+		const std::list<MeshModel*>& meshes = fileMeshes[fileOfNode[i]];
+		QString label;
+		bool visible;
+		int idInFile;
+		readMeshAttributes(mesh, label, visible, idInFile);
+
+		MeshModel* mm = nullptr;
+		if (idInFile <= 0) {
+			for (MeshModel* m : meshes) {
+				m->setVisible(visible);
+				m->setLabel(label);
 			}
+			mm = meshes.empty() ? nullptr : meshes.front();
 		}
-		// READ IN POINT CORRESPONDECES INCOMPLETO!!
-		else if (QString::compare(node.nodeName(), "RasterGroup") == 0)
-		{
-			QDomNode raster;
-			raster = node.firstChild();
-			while (!raster.isNull())
-			{
-				//return true;
-				md.addNewRaster();
-				QString labelRaster = raster.attributes().namedItem("label").nodeValue();
-				md.rm()->setLabel(labelRaster);
-				QDomNode sh = raster.firstChild();
-				ReadShotFromQDomNode(md.rm()->shot, sh);
-
-				QDomElement el = raster.firstChildElement("Plane");
-				while (!el.isNull())
-				{
-					QString filen = el.attribute("fileName");
-					QFileInfo fi(filen);
-					QString nm = fi.absoluteFilePath();
-					QImage img(":/img/dummy.png");
-					try {
-						img = meshlab::loadImage(nm);
-					}
-					catch(const MLException& e){
-						unloadedImgList.push_back(nm.toStdString());
-					}
-					md.rm()->addPlane(new RasterPlane(img, nm, RasterPlane::RGBA));
-					el = node.nextSiblingElement("Plane");
-				}
-				raster = raster.nextSibling();
-			}
+		else if ((unsigned int) idInFile < meshes.size()) {
+			mm = *std::next(meshes.begin(), idInFile);
+			mm->setVisible(visible);
+			mm->setLabel(label);
 		}
-		node = node.nextSibling();
+		if (mm != nullptr)
+			readMeshMatrix(mesh, binary, mm->cm.Tr);
+
+		readRenderingOption(mesh, rendOpt);
 	}
 
-	QDir::setCurrent(tmpDir.absolutePath());
-	qf.close();
+	loadRasters(rasterNodes, projectDir, md, unloadedImgList, maxInFlight, cb);
 
 	if (rendOpt.size() != meshList.size()){
 		std::cerr << "cannot load rend options\n";
@@ -26,6 +26,7 @@ std::vector<MeshModel*> loadMLP(
 		MeshDocument& md,
 		std::vector<MLRenderingData>& rendOpt,
 		std::vector<std::string>& unloadedImgList,
-		vcg::CallBackPos* cb);
+		vcg::CallBackPos* cb,
+		unsigned int maxInFlight = 0);
 
 #endif // LOAD_PROJECT_H
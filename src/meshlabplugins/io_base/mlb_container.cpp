@@ -0,0 +1,666 @@
+#include "mlb_container.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <QFileInfo>
+
+#include <common/mlexception.h>
+#include <common/utilities/load_save.h>
+
+namespace mlb {
+
+static const char     MAGIC[8]   = {'M', 'L', 'B', 'P', 'R', 'O', 'J', '\0'};
+static const uint32_t VERSION    = 1;
+static const uint32_t BYTE_ORDER = 0x01020304;
+static const int      ALIGNMENT  = 16;
+
+// attributes that are stored in the container; the other components of the
+// data mask (topology, marks...) are recomputed or enabled after loading
+static const int STORED_MASK =
+	MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNORMAL | MeshModel::MM_VERTFLAG |
+	MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTTEXCOORD |
+	MeshModel::MM_VERTRADIUS | MeshModel::MM_FACEVERT | MeshModel::MM_FACENORMAL | MeshModel::MM_FACEFLAG |
+	MeshModel::MM_FACECOLOR | MeshModel::MM_FACEQUALITY | MeshModel::MM_WEDGTEXCOORD |
+	MeshModel::MM_POLYGONAL;
+
+bool isContainer(const QString& filename)
+{
+	QFile f(filename);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	char magic[sizeof(MAGIC)];
+	return f.read(magic, sizeof(MAGIC)) == sizeof(MAGIC) &&
+		   std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+/****************************************************************************
+ * Writing
+ ****************************************************************************/
+
+namespace {
+
+class Writer
+{
+public:
+	Writer(const QString& filename) : file(filename)
+	{
+		if (!file.open(QIODevice::WriteOnly))
+			throw MLException("Impossible to write " + filename);
+		Header h;
+		std::memset(&h, 0, sizeof(Header));
+		writeRaw(&h, sizeof(Header));
+	}
+
+	void addChunk(ChunkType type, uint32_t layer, const std::vector<char>& payload, bool compress = false)
+	{
+		ChunkEntry e;
+		std::memset(&e, 0, sizeof(ChunkEntry));
+		e.type    = type;
+		e.layer   = layer;
+		e.rawSize = payload.size();
+
+		QByteArray compressed;
+		if (compress && payload.size() < (size_t) std::numeric_limits<int>::max()) {
+			compressed = qCompress((const uchar*) payload.data(), (int) payload.size());
+			if ((size_t) compressed.size() >= payload.size())
+				compressed.clear();
+			else
+				e.flags |= COMPRESSED;
+		}
+
+		static const char zeros[ALIGNMENT] = {};
+		writeRaw(zeros, (ALIGNMENT - file.pos() % ALIGNMENT) % ALIGNMENT);
+		e.offset = file.pos();
+		if (e.flags & COMPRESSED) {
+			e.storedSize = compressed.size();
+			writeRaw(compressed.constData(), compressed.size());
+		}
+		else {
+			e.storedSize = payload.size();
+			writeRaw(payload.data(), payload.size());
+		}
+		index.push_back(e);
+	}
+
+	void close()
+	{
+		Header h;
+		std::memset(&h, 0, sizeof(Header));
+		std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+		h.version     = VERSION;
+		h.byteOrder   = BYTE_ORDER;
+		h.scalarSize  = sizeof(Scalarm);
+		h.chunkCount  = index.size();
+		h.indexOffset = file.pos();
+		writeRaw(index.data(), index.size() * sizeof(ChunkEntry));
+		file.seek(0);
+		writeRaw(&h, sizeof(Header));
+		file.close();
+	}
+
+private:
+	void writeRaw(const void* p, qint64 n)
+	{
+		if (n > 0 && file.write((const char*) p, n) != n)
+			throw MLException("Impossible to write " + file.fileName());
+	}
+
+	QFile                   file;
+	std::vector<ChunkEntry> index;
+};
+
+/**
+ * Packs perElem values of type T for each of the given elements, in parallel.
+ */
+template<typename T, typename ElemType, typename Get>
+std::vector<char> packArray(const std::vector<const ElemType*>& elems, unsigned int perElem, Get get)
+{
+	std::vector<char> buf(elems.size() * perElem * sizeof(T));
+	T* out = reinterpret_cast<T*>(buf.data());
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < (int) elems.size(); ++i)
+		get(*elems[i], out + (size_t) i * perElem);
+	return buf;
+}
+
+template<typename T>
+std::vector<char> toBytes(const std::vector<T>& v)
+{
+	std::vector<char> buf(v.size() * sizeof(T));
+	if (!v.empty())
+		std::memcpy(buf.data(), v.data(), buf.size());
+	return buf;
+}
+
+/**
+ * Writes the chunk of a custom per element attribute of type Scalarm or
+ * Point3m, for the given (live) elements.
+ */
+template<typename AttrType, typename ElemType, typename Handle>
+void writeAttribute(
+	Writer&                             w,
+	ChunkType                           type,
+	uint32_t                            layer,
+	const std::string&                  name,
+	const std::vector<const ElemType*>& elems,
+	const ElemType*                     base,
+	Handle                              h)
+{
+	const uint32_t components = sizeof(AttrType) / sizeof(Scalarm);
+	std::vector<char> values = packArray<Scalarm>(elems, components, [&](const ElemType& e, Scalarm* o) {
+		std::memcpy(o, &h[&e - base], sizeof(AttrType));
+	});
+	AttributeHeader ah = {(uint32_t) name.size(), components};
+	std::vector<char> buf(sizeof(AttributeHeader) + name.size());
+	std::memcpy(buf.data(), &ah, sizeof(AttributeHeader));
+	std::memcpy(buf.data() + sizeof(AttributeHeader), name.data(), name.size());
+	buf.insert(buf.end(), values.begin(), values.end());
+	w.addChunk(type, layer, buf);
+}
+
+/// names of the attributes in attrs that are not in the stored ones
+template<typename AttrSet>
+void unstoredAttributes(
+	const AttrSet&                  attrs,
+	const std::vector<std::string>& stored,
+	const QString&                  kind,
+	QStringList&                    dropped)
+{
+	for (const auto& a : attrs)
+		if (!a._name.empty() && std::find(stored.begin(), stored.end(), a._name) == stored.end())
+			dropped.push_back(kind + " attribute " + QString::fromStdString(a._name));
+}
+
+/// writes the chunks of the given layer, returns what could not be stored
+QStringList writeMesh(Writer& w, uint32_t layer, const MeshModel& mm, bool compressTextures)
+{
+	const CMeshO& m = mm.cm;
+
+	// deleted elements are not stored: indices are remapped on the live ones
+	std::vector<const CVertexO*> verts;
+	std::vector<int>             vertRemap(m.vert.size(), -1);
+	verts.reserve(m.vn);
+	for (size_t i = 0; i < m.vert.size(); ++i) {
+		if (!m.vert[i].IsD()) {
+			vertRemap[i] = verts.size();
+			verts.push_back(&m.vert[i]);
+		}
+	}
+	std::vector<const CFaceO*> faces;
+	faces.reserve(m.fn);
+	for (const CFaceO& f : m.face)
+		if (!f.IsD())
+			faces.push_back(&f);
+	std::vector<const CEdgeO*> edges;
+	edges.reserve(m.en);
+	for (const CEdgeO& e : m.edge)
+		if (!e.IsD())
+			edges.push_back(&e);
+
+	const CVertexO* vbase = m.vert.empty() ? nullptr : &m.vert[0];
+
+	std::vector<uint32_t> info = {
+		(uint32_t) verts.size(),
+		(uint32_t) faces.size(),
+		(uint32_t) edges.size(),
+		(uint32_t) (mm.dataMask() & STORED_MASK)};
+	w.addChunk(MESH_INFO, layer, toBytes(info));
+
+	w.addChunk(VERT_COORD, layer, packArray<Scalarm>(verts, 3, [](const CVertexO& v, Scalarm* o) {
+		o[0] = v.cP()[0]; o[1] = v.cP()[1]; o[2] = v.cP()[2];
+	}));
+	w.addChunk(VERT_NORMAL, layer, packArray<Scalarm>(verts, 3, [](const CVertexO& v, Scalarm* o) {
+		o[0] = v.cN()[0]; o[1] = v.cN()[1]; o[2] = v.cN()[2];
+	}));
+	w.addChunk(VERT_FLAGS, layer, packArray<int32_t>(verts, 1, [](const CVertexO& v, int32_t* o) {
+		o[0] = v.cFlags();
+	}));
+	if (mm.hasDataMask(MeshModel::MM_VERTCOLOR))
+		w.addChunk(VERT_COLOR, layer, packArray<unsigned char>(verts, 4, [](const CVertexO& v, unsigned char* o) {
+			std::memcpy(o, v.cC().V(), 4);
+		}));
+	if (mm.hasDataMask(MeshModel::MM_VERTQUALITY))
+		w.addChunk(VERT_QUALITY, layer, packArray<Scalarm>(verts, 1, [](const CVertexO& v, Scalarm* o) {
+			o[0] = v.cQ();
+		}));
+	if (mm.hasDataMask(MeshModel::MM_VERTTEXCOORD))
+		w.addChunk(VERT_TEXCOORD, layer, packArray<TexCoord>(verts, 1, [](const CVertexO& v, TexCoord* o) {
+			o[0] = {v.cT().U(), v.cT().V(), v.cT().N()};
+		}));
+	if (mm.hasDataMask(MeshModel::MM_VERTRADIUS))
+		w.addChunk(VERT_RADIUS, layer, packArray<Scalarm>(verts, 1, [](const CVertexO& v, Scalarm* o) {
+			o[0] = v.cR();
+		}));
+
+	w.addChunk(FACE_VERT, layer, packArray<int32_t>(faces, 3, [&](const CFaceO& f, int32_t* o) {
+		for (int k = 0; k < 3; ++k)
+			o[k] = vertRemap[f.cV(k) - vbase];
+	}));
+	w.addChunk(FACE_FLAGS, layer, packArray<int32_t>(faces, 1, [](const CFaceO& f, int32_t* o) {
+		o[0] = f.cFlags();
+	}));
+	if (mm.hasDataMask(MeshModel::MM_FACENORMAL))
+		w.addChunk(FACE_NORMAL, layer, packArray<Scalarm>(faces, 3, [](const CFaceO& f, Scalarm* o) {
+			o[0] = f.cN()[0]; o[1] = f.cN()[1]; o[2] = f.cN()[2];
+		}));
+	if (mm.hasDataMask(MeshModel::MM_FACECOLOR))
+		w.addChunk(FACE_COLOR, layer, packArray<unsigned char>(faces, 4, [](const CFaceO& f, unsigned char* o) {
+			std::memcpy(o, f.cC().V(), 4);
+		}));
+	if (mm.hasDataMask(MeshModel::MM_FACEQUALITY))
+		w.addChunk(FACE_QUALITY, layer, packArray<Scalarm>(faces, 1, [](const CFaceO& f, Scalarm* o) {
+			o[0] = f.cQ();
+		}));
+	if (mm.hasDataMask(MeshModel::MM_WEDGTEXCOORD))
+		w.addChunk(FACE_WEDGETEX, layer, packArray<TexCoord>(faces, 3, [](const CFaceO& f, TexCoord* o) {
+			for (int k = 0; k < 3; ++k)
+				o[k] = {f.cWT(k).U(), f.cWT(k).V(), f.cWT(k).N()};
+		}));
+
+	if (!edges.empty())
+		w.addChunk(EDGE_VERT, layer, packArray<int32_t>(edges, 2, [&](const CEdgeO& e, int32_t* o) {
+			o[0] = vertRemap[e.cV(0) - vbase];
+			o[1] = vertRemap[e.cV(1) - vbase];
+		}));
+
+	// custom attributes: the Scalarm and Point3m ones, as the ply files do
+	std::vector<std::string> vScalar, vPoint, fScalar, fPoint;
+	vcg::tri::Allocator<CMeshO>::GetAllPerVertexAttribute<Scalarm>(m, vScalar);
+	vcg::tri::Allocator<CMeshO>::GetAllPerVertexAttribute<Point3m>(m, vPoint);
+	vcg::tri::Allocator<CMeshO>::GetAllPerFaceAttribute<Scalarm>(m, fScalar);
+	vcg::tri::Allocator<CMeshO>::GetAllPerFaceAttribute<Point3m>(m, fPoint);
+	const CFaceO* fbase = m.face.empty() ? nullptr : &m.face[0];
+	for (const std::string& name : vScalar)
+		writeAttribute<Scalarm>(w, VERT_ATTRIBUTE, layer, name, verts, vbase,
+			vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m, name));
+	for (const std::string& name : vPoint)
+		writeAttribute<Point3m>(w, VERT_ATTRIBUTE, layer, name, verts, vbase,
+			vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3m>(m, name));
+	for (const std::string& name : fScalar)
+		writeAttribute<Scalarm>(w, FACE_ATTRIBUTE, layer, name, faces, fbase,
+			vcg::tri::Allocator<CMeshO>::GetPerFaceAttribute<Scalarm>(m, name));
+	for (const std::string& name : fPoint)
+		writeAttribute<Point3m>(w, FACE_ATTRIBUTE, layer, name, faces, fbase,
+			vcg::tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3m>(m, name));
+
+	QStringList dropped;
+	if (mm.hasDataMask(MeshModel::MM_VERTCURV))
+		dropped.push_back("curvature");
+	if (mm.hasDataMask(MeshModel::MM_VERTCURVDIR) || mm.hasDataMask(MeshModel::MM_FACECURVDIR))
+		dropped.push_back("curvature directions");
+	vScalar.insert(vScalar.end(), vPoint.begin(), vPoint.end());
+	fScalar.insert(fScalar.end(), fPoint.begin(), fPoint.end());
+	unstoredAttributes(m.vert_attr, vScalar, "per vertex", dropped);
+	unstoredAttributes(m.face_attr, fScalar, "per face", dropped);
+	unstoredAttributes(m.mesh_attr, std::vector<std::string>(), "per mesh", dropped);
+
+	// textures: the names in the order of the mesh, then the pixels of each
+	if (!m.textures.empty()) {
+		QByteArray names;
+		for (const std::string& tn : m.textures)
+			names += QByteArray::fromStdString(tn) + '\n';
+		w.addChunk(TEXTURE_NAMES, layer, std::vector<char>(names.begin(), names.end()));
+	}
+	for (const std::string& tn : m.textures) {
+		// one texture at a time, to respect the texture memory budget
+		const QImage img = mm.getTexture(tn).convertToFormat(QImage::Format_ARGB32);
+		if (img.isNull())
+			continue;
+		TextureHeader th;
+		std::memset(&th, 0, sizeof(TextureHeader));
+		th.width    = img.width();
+		th.height   = img.height();
+		th.nameSize = tn.size();
+		std::vector<char> buf(sizeof(TextureHeader) + th.nameSize + (size_t) th.width * th.height * 4);
+		char* out = buf.data();
+		std::memcpy(out, &th, sizeof(TextureHeader));
+		std::memcpy(out + sizeof(TextureHeader), tn.data(), th.nameSize);
+		out += sizeof(TextureHeader) + th.nameSize;
+		for (uint32_t y = 0; y < th.height; ++y)
+			std::memcpy(out + (size_t) y * th.width * 4, img.constScanLine(y), th.width * 4);
+		w.addChunk(TEXTURE, layer, buf, compressTextures);
+	}
+	return dropped;
+}
+
+} // namespace
+
+QStringList save(
+	const QString&                       filename,
+	const QByteArray&                    projectXml,
+	const std::vector<const MeshModel*>& meshes,
+	bool                                 compressTextures,
+	vcg::CallBackPos*                    cb)
+{
+	Writer w(filename);
+	w.addChunk(PROJECT_XML, 0, std::vector<char>(projectXml.begin(), projectXml.end()));
+	QStringList warnings;
+	for (unsigned int i = 0; i < meshes.size(); ++i) {
+		if (cb != nullptr)
+			cb(100 * i / meshes.size(), "Saving project...");
+		QStringList dropped = writeMesh(w, i, *meshes[i], compressTextures);
+		if (!dropped.isEmpty())
+			warnings.push_back(
+				"Layer " + meshes[i]->label() + ": not stored in " +
+				QFileInfo(filename).fileName() + ": " + dropped.join(", "));
+	}
+	w.close();
+	return warnings;
+}
+
+/****************************************************************************
+ * Reading
+ ****************************************************************************/
+
+Reader::Reader(const QString& filename) : file(filename), data(nullptr), size(0), scalarSize(0)
+{
+	if (!file.open(QIODevice::ReadOnly))
+		throw MLException("Unable to open " + filename);
+	size = file.size();
+	if (size < (qint64) sizeof(Header))
+		throw MLException(filename + " is not a MeshLab binary project.");
+
+	data = file.map(0, size);
+	if (data == nullptr) {
+		fallback = file.readAll();
+		data     = (const uchar*) fallback.constData();
+	}
+
+	Header h;
+	std::memcpy(&h, data, sizeof(Header));
+	if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw MLException(filename + " is not a MeshLab binary project.");
+	if (h.version > VERSION)
+		throw MLException(filename + " was saved by a newer version of MeshLab.");
+	if (h.byteOrder != BYTE_ORDER)
+		throw MLException(filename + " was saved on a machine with a different byte order.");
+	if (h.scalarSize != sizeof(float) && h.scalarSize != sizeof(double))
+		throw MLException(filename + " is corrupted.");
+	if (h.indexOffset > (uint64_t) size ||
+		(size - h.indexOffset) / sizeof(ChunkEntry) < h.chunkCount)
+		throw MLException(filename + " is corrupted.");
+	scalarSize = h.scalarSize;
+
+	index.resize(h.chunkCount);
+	std::memcpy(index.data(), data + h.indexOffset, h.chunkCount * sizeof(ChunkEntry));
+	for (const ChunkEntry& e : index)
+		if (e.offset > (uint64_t) size || e.storedSize > (uint64_t) size - e.offset)
+			throw MLException(filename + " is corrupted.");
+	if (findChunk(PROJECT_XML, 0) == nullptr)
+		throw MLException(filename + " is corrupted.");
+}
+
+Reader::~Reader()
+{
+	if (fallback.isNull() && data != nullptr)
+		file.unmap(const_cast<uchar*>(data));
+}
+
+QByteArray Reader::projectXml() const
+{
+	Payload p = chunkData(*findChunk(PROJECT_XML, 0));
+	return QByteArray((const char*) p.ptr, p.size);
+}
+
+unsigned int Reader::meshNumber() const
+{
+	unsigned int n = 0;
+	for (const ChunkEntry& e : index)
+		if (e.type == MESH_INFO)
+			++n;
+	return n;
+}
+
+Reader::Payload Reader::chunkData(const ChunkEntry& e) const
+{
+	Payload p;
+	if (e.flags & COMPRESSED) {
+		if (e.storedSize > (uint64_t) std::numeric_limits<int>::max())
+			throw MLException(file.fileName() + " is corrupted.");
+		p.owner = qUncompress(data + e.offset, (int) e.storedSize);
+		if ((uint64_t) p.owner.size() != e.rawSize)
+			throw MLException(file.fileName() + " is corrupted.");
+		p.ptr  = (const uchar*) p.owner.constData();
+		p.size = p.owner.size();
+	}
+	else {
+		p.ptr  = data + e.offset;
+		p.size = e.storedSize;
+	}
+	return p;
+}
+
+const ChunkEntry* Reader::findChunk(ChunkType type, uint32_t layer) const
+{
+	for (const ChunkEntry& e : index)
+		if (e.type == type && e.layer == layer)
+			return &e;
+	return nullptr;
+}
+
+namespace {
+
+// values are read with memcpy: the payloads are only 16 bytes aligned
+template<typename T>
+inline T readValue(const uchar* p, uint64_t i)
+{
+	T v;
+	std::memcpy(&v, p + i * sizeof(T), sizeof(T));
+	return v;
+}
+
+inline Scalarm readScalar(const uchar* p, uint64_t i, uint32_t scalarSize)
+{
+	if (scalarSize == sizeof(float))
+		return (Scalarm) readValue<float>(p, i);
+	return (Scalarm) readValue<double>(p, i);
+}
+
+} // namespace
+
+void Reader::loadMesh(unsigned int i, MeshModel& mm) const
+{
+	const ChunkEntry* infoChunk = findChunk(MESH_INFO, i);
+	if (infoChunk == nullptr || infoChunk->storedSize != 4 * sizeof(uint32_t))
+		throw MLException(file.fileName() + " is corrupted.");
+	Payload        info = chunkData(*infoChunk);
+	const uint32_t vn   = readValue<uint32_t>(info.ptr, 0);
+	const uint32_t fn   = readValue<uint32_t>(info.ptr, 1);
+	const uint32_t en   = readValue<uint32_t>(info.ptr, 2);
+	const int      mask = (int) readValue<uint32_t>(info.ptr, 3);
+
+	// returns the payload of the chunk if it is there and has the right size
+	auto chunk = [&](ChunkType type, uint64_t elemSize, uint64_t count, Payload& p) {
+		const ChunkEntry* e = findChunk(type, i);
+		if (e == nullptr)
+			return false;
+		if (e->rawSize != elemSize * count)
+			throw MLException(file.fileName() + " is corrupted.");
+		p = chunkData(*e);
+		return true;
+	};
+
+	CMeshO& m = mm.cm;
+	mm.updateDataMask(mask & STORED_MASK);
+	vcg::tri::Allocator<CMeshO>::AddVertices(m, vn);
+	vcg::tri::Allocator<CMeshO>::AddFaces(m, fn);
+	vcg::tri::Allocator<CMeshO>::AddEdges(m, en);
+
+	Payload p;
+	if (chunk(VERT_COORD, 3 * scalarSize, vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			for (int k = 0; k < 3; ++k)
+				m.vert[v].P()[k] = readScalar(p.ptr, 3 * (uint64_t) v + k, scalarSize);
+	}
+	if (chunk(VERT_NORMAL, 3 * scalarSize, vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			for (int k = 0; k < 3; ++k)
+				m.vert[v].N()[k] = readScalar(p.ptr, 3 * (uint64_t) v + k, scalarSize);
+	}
+	if (chunk(VERT_FLAGS, sizeof(int32_t), vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			m.vert[v].Flags() = readValue<int32_t>(p.ptr, v);
+	}
+	if (chunk(VERT_COLOR, 4, vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			std::memcpy(m.vert[v].C().V(), p.ptr + 4 * (uint64_t) v, 4);
+	}
+	if (chunk(VERT_QUALITY, scalarSize, vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			m.vert[v].Q() = readScalar(p.ptr, v, scalarSize);
+	}
+	if (m.vert.IsRadiusEnabled() && chunk(VERT_RADIUS, scalarSize, vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v)
+			m.vert[v].R() = readScalar(p.ptr, v, scalarSize);
+	}
+	if (m.vert.IsTexCoordEnabled() && chunk(VERT_TEXCOORD, sizeof(TexCoord), vn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vn; ++v) {
+			TexCoord t = readValue<TexCoord>(p.ptr, v);
+			m.vert[v].T().U() = t.u;
+			m.vert[v].T().V() = t.v;
+			m.vert[v].T().N() = t.n;
+		}
+	}
+
+	if (chunk(FACE_VERT, 3 * sizeof(int32_t), fn, p)) {
+		bool valid = true;
+#pragma omp parallel for schedule(static) reduction(&& : valid)
+		for (int f = 0; f < (int) fn; ++f) {
+			for (int k = 0; k < 3; ++k) {
+				int32_t vi = readValue<int32_t>(p.ptr, 3 * (uint64_t) f + k);
+				if (vi >= 0 && (uint32_t) vi < vn)
+					m.face[f].V(k) = &m.vert[vi];
+				else
+					valid = false;
+			}
+		}
+		if (!valid)
+			throw MLException(file.fileName() + " is corrupted.");
+	}
+	if (chunk(FACE_FLAGS, sizeof(int32_t), fn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < (int) fn; ++f)
+			m.face[f].Flags() = readValue<int32_t>(p.ptr, f);
+	}
+	if (chunk(FACE_NORMAL, 3 * scalarSize, fn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < (int) fn; ++f)
+			for (int k = 0; k < 3; ++k)
+				m.face[f].N()[k] = readScalar(p.ptr, 3 * (uint64_t) f + k, scalarSize);
+	}
+	if (m.face.IsColorEnabled() && chunk(FACE_COLOR, 4, fn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < (int) fn; ++f)
+			std::memcpy(m.face[f].C().V(), p.ptr + 4 * (uint64_t) f, 4);
+	}
+	if (m.face.IsQualityEnabled() && chunk(FACE_QUALITY, scalarSize, fn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < (int) fn; ++f)
+			m.face[f].Q() = readScalar(p.ptr, f, scalarSize);
+	}
+	if (m.face.IsWedgeTexCoordEnabled() && chunk(FACE_WEDGETEX, 3 * sizeof(TexCoord), fn, p)) {
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < (int) fn; ++f) {
+			for (int k = 0; k < 3; ++k) {
+				TexCoord t = readValue<TexCoord>(p.ptr, 3 * (uint64_t) f + k);
+				m.face[f].WT(k).U() = t.u;
+				m.face[f].WT(k).V() = t.v;
+				m.face[f].WT(k).N() = t.n;
+			}
+		}
+	}
+
+	if (chunk(EDGE_VERT, 2 * sizeof(int32_t), en, p)) {
+		for (uint32_t e = 0; e < en; ++e) {
+			for (int k = 0; k < 2; ++k) {
+				int32_t vi = readValue<int32_t>(p.ptr, 2 * (uint64_t) e + k);
+				if (vi < 0 || (uint32_t) vi >= vn)
+					throw MLException(file.fileName() + " is corrupted.");
+				m.edge[e].V(k) = &m.vert[vi];
+			}
+		}
+	}
+
+	// custom attributes
+	for (const ChunkEntry& e : index) {
+		if ((e.type != VERT_ATTRIBUTE && e.type != FACE_ATTRIBUTE) || e.layer != i)
+			continue;
+		Payload a = chunkData(e);
+		if (a.size < sizeof(AttributeHeader))
+			throw MLException(file.fileName() + " is corrupted.");
+		AttributeHeader ah = readValue<AttributeHeader>(a.ptr, 0);
+		const uint64_t n = e.type == VERT_ATTRIBUTE ? vn : fn;
+		if ((ah.components != 1 && ah.components != 3) ||
+			a.size != sizeof(AttributeHeader) + ah.nameSize + n * ah.components * scalarSize)
+			throw MLException(file.fileName() + " is corrupted.");
+		std::string name((const char*) a.ptr + sizeof(AttributeHeader), ah.nameSize);
+		const uchar* values = a.ptr + sizeof(AttributeHeader) + ah.nameSize;
+		if (e.type == VERT_ATTRIBUTE && ah.components == 1) {
+			auto h = vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m, name);
+			for (uint32_t v = 0; v < vn; ++v)
+				h[v] = readScalar(values, v, scalarSize);
+		}
+		else if (e.type == VERT_ATTRIBUTE) {
+			auto h = vcg::tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3m>(m, name);
+			for (uint32_t v = 0; v < vn; ++v)
+				for (int k = 0; k < 3; ++k)
+					h[v][k] = readScalar(values, 3 * (uint64_t) v + k, scalarSize);
+		}
+		else if (ah.components == 1) {
+			auto h = vcg::tri::Allocator<CMeshO>::GetPerFaceAttribute<Scalarm>(m, name);
+			for (uint32_t f = 0; f < fn; ++f)
+				h[f] = readScalar(values, f, scalarSize);
+		}
+		else {
+			auto h = vcg::tri::Allocator<CMeshO>::GetPerFaceAttribute<Point3m>(m, name);
+			for (uint32_t f = 0; f < fn; ++f)
+				for (int k = 0; k < 3; ++k)
+					h[f][k] = readScalar(values, 3 * (uint64_t) f + k, scalarSize);
+		}
+	}
+
+	// textures: names in order, images decoded from the stored pixels
+	std::map<std::string, QImage> images;
+	for (const ChunkEntry& e : index) {
+		if (e.type != TEXTURE || e.layer != i)
+			continue;
+		Payload t = chunkData(e);
+		if (t.size < sizeof(TextureHeader))
+			throw MLException(file.fileName() + " is corrupted.");
+		TextureHeader th = readValue<TextureHeader>(t.ptr, 0);
+		if (t.size != sizeof(TextureHeader) + th.nameSize + (uint64_t) th.width * th.height * 4)
+			throw MLException(file.fileName() + " is corrupted.");
+		std::string name((const char*) t.ptr + sizeof(TextureHeader), th.nameSize);
+		const uchar* pixels = t.ptr + sizeof(TextureHeader) + th.nameSize;
+		QImage img(th.width, th.height, QImage::Format_ARGB32);
+		for (uint32_t y = 0; y < th.height; ++y)
+			std::memcpy(img.scanLine(y), pixels + (size_t) y * th.width * 4, th.width * 4);
+		images[name] = img;
+	}
+	const ChunkEntry* namesChunk = findChunk(TEXTURE_NAMES, i);
+	if (namesChunk != nullptr) {
+		Payload n = chunkData(*namesChunk);
+		const QList<QByteArray> names = QByteArray((const char*) n.ptr, n.size).split('\n');
+		for (const QByteArray& nm : names) {
+			if (nm.isEmpty())
+				continue;
+			auto it = images.find(nm.toStdString());
+			mm.addTexture(nm.toStdString(), it != images.end() ? it->second : meshlab::getDummyTexture());
+		}
+	}
+
+	// the bounding box is not stored; topology is rebuilt by the filters that
+	// need it, as for any other loaded mesh
+	vcg::tri::UpdateBounding<CMeshO>::Box(m);
+}
+
+} // namespace mlb
@@ -0,0 +1,152 @@
+#ifndef MLB_CONTAINER_H
+#define MLB_CONTAINER_H
+
+#include <cstdint>
+
+#include <QFile>
+#include <QStringList>
+
+#include <common/ml_document/mesh_model.h>
+
+/**
+ * MeshLab Binary Project container.
+ *
+ * The file is a sequence of chunks followed by an index:
+ *
+ *   Header | chunk 0 | chunk 1 | ... | chunk n-1 | Index (n ChunkEntry)
+ *
+ * The first chunk is the xml project (the same document of a .mlp file);
+ * the i-th MLMesh element of the xml is stored in the chunks of layer i.
+ * Mesh attributes are stored as plain arrays, in the layout used by CMeshO
+ * (Scalarm coordinates, 4 byte colors, int indices), so that they can be
+ * copied straight from the mapped file into the mesh. Each chunk can be
+ * zlib-compressed on its own. Raster planes are still referenced by path.
+ */
+namespace mlb {
+
+enum ChunkType : uint32_t {
+	PROJECT_XML = 0,
+	MESH_INFO,      // vn, fn, en, dataMask
+	VERT_COORD,     // 3 Scalarm per vertex
+	VERT_NORMAL,    // 3 Scalarm per vertex
+	VERT_COLOR,     // 4 uchar per vertex
+	VERT_QUALITY,   // 1 Scalarm per vertex
+	VERT_TEXCOORD,  // TexCoord per vertex
+	VERT_FLAGS,     // 1 int per vertex
+	FACE_VERT,      // 3 int per face
+	FACE_NORMAL,    // 3 Scalarm per face
+	FACE_COLOR,     // 4 uchar per face
+	FACE_QUALITY,   // 1 Scalarm per face
+	FACE_WEDGETEX,  // 3 TexCoord per face
+	FACE_FLAGS,     // 1 int per face
+	EDGE_VERT,      // 2 int per edge
+	TEXTURE_NAMES,  // '\n' separated utf8 names, in the order of cm.textures
+	TEXTURE,        // TextureHeader, utf8 name, ARGB32 pixels
+	VERT_RADIUS,    // 1 Scalarm per vertex
+	VERT_ATTRIBUTE, // AttributeHeader, utf8 name, components Scalarm per vertex
+	FACE_ATTRIBUTE  // AttributeHeader, utf8 name, components Scalarm per face
+};
+
+enum ChunkFlags : uint32_t {
+	COMPRESSED = 0x1
+};
+
+struct Header
+{
+	char     magic[8];     // "MLBPROJ\0"
+	uint32_t version;
+	uint32_t byteOrder;    // 0x01020304 written in native order
+	uint32_t scalarSize;   // sizeof(Scalarm) of the writer
+	uint32_t chunkCount;
+	uint64_t indexOffset;
+};
+
+struct ChunkEntry
+{
+	uint32_t type;
+	uint32_t layer;
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t storedSize;
+	uint64_t rawSize;
+};
+
+struct TexCoord
+{
+	float   u, v;
+	int32_t n;
+};
+
+struct TextureHeader
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t nameSize;
+	uint32_t reserved;
+};
+
+// custom Scalarm (1 component) or Point3m (3 components) attribute
+struct AttributeHeader
+{
+	uint32_t nameSize;
+	uint32_t components;
+};
+
+/// true if the file starts with the container header (old .mlb files are xml)
+bool isContainer(const QString& filename);
+
+/**
+ * Writes the container. meshes must be the layers listed, in order, in the
+ * MLMesh elements of projectXml. If compressTextures is true, texture chunks
+ * are zlib-compressed; geometry is always stored raw so that it can be
+ * copied from the mapped file.
+ * Returns, for each layer that has them, a message listing the components and
+ * the custom attributes that cannot be stored and have been dropped.
+ */
+QStringList save(
+	const QString&                       filename,
+	const QByteArray&                    projectXml,
+	const std::vector<const MeshModel*>& meshes,
+	bool                                 compressTextures,
+	vcg::CallBackPos*                    cb);
+
+/**
+ * Reads a container through a memory mapping of the file. The payloads are
+ * not read until a layer is materialized by loadMesh.
+ */
+class Reader
+{
+public:
+	Reader(const QString& filename);
+	~Reader();
+
+	QByteArray   projectXml() const;
+	unsigned int meshNumber() const;
+
+	/// fills the given (empty) layer with the geometry and textures of layer i
+	void loadMesh(unsigned int i, MeshModel& mm) const;
+
+private:
+	/// a chunk payload: points into the mapping, or into owner if compressed
+	struct Payload
+	{
+		const uchar* ptr  = nullptr;
+		uint64_t     size = 0;
+		QByteArray   owner;
+	};
+
+	Payload           chunkData(const ChunkEntry& e) const;
+	const ChunkEntry* findChunk(ChunkType type, uint32_t layer) const;
+
+	QFile                   file;
+	const uchar*            data;
+	QByteArray              fallback; // file content, if it cannot be mapped
+	qint64                  size;
+	uint32_t                scalarSize;
+	std::vector<ChunkEntry> index;
+};
+
+} // namespace mlb
+
+#endif // MLB_CONTAINER_H
@@ -1,4 +1,5 @@
 #include "save_project.h"
+#include "mlb_container.h"
 
 #include <QDir>
 #include <QTextStream>
@@ -123,7 +124,7 @@ QDomDocument meshDocumentToXML(
 }
 } // namespace mlp
 
-void saveMLP(
+QStringList saveMLP(
 		const QString& filename,
 		const MeshDocument& md,
 		bool onlyVisibleLayers,
@@ -135,12 +136,30 @@ void saveMLP(
 	QDir tmpDir = QDir::current();
 	QDir::setCurrent(fi.absoluteDir().absolutePath());
 	QDomDocument doc = mlp::meshDocumentToXML(md, onlyVisibleLayers, binary, rendOpt);
-	QFile file(filename);
-	file.open(QIODevice::WriteOnly);
-	QTextStream qstream(&file);
-	doc.save(qstream, 1);
-	file.close();
+	QStringList warnings;
+	if (binary) {
+		// the layers are stored in the container, in the order of the xml
+		std::vector<const MeshModel*> meshes;
+		for(const MeshModel& mmp : md.meshIterator())
+			if ((!onlyVisibleLayers) || (mmp.isVisible()))
+				meshes.push_back(&mmp);
+		try {
+			warnings = mlb::save(filename, doc.toByteArray(1), meshes, true, cb);
+		}
+		catch (const MLException& e) {
+			QDir::setCurrent(tmpDir.absolutePath());
+			throw e;
+		}
+	}
+	else {
+		QFile file(filename);
+		file.open(QIODevice::WriteOnly);
+		QTextStream qstream(&file);
+		doc.save(qstream, 1);
+		file.close();
+	}
 	QDir::setCurrent(tmpDir.absolutePath());
+	return warnings;
 }
 
 void saveALN(
@@ -3,7 +3,8 @@
 
 #include <common/ml_document/mesh_document.h>
 
-void saveMLP(
+// returns the warnings about the data that the project file cannot store
+QStringList saveMLP(
 		const QString& filename,
 		const MeshDocument& md,
 		bool onlyVisibleLayers,